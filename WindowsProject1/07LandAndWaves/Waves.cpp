@@ -3,13 +3,286 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../Common/JobSystem.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WAVES_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC emits VEX-encoded code for intrinsics regardless of /arch.
+#define WAVES_TARGET_AVX2
+#else
+#define WAVES_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
 
 using namespace DirectX;
 
+namespace
+{
+	// Vertices per job when StreamVertices is split over the job system.
+	const int StreamGrainSize = 8192;
+
+	// Consecutive quiet steps after which a tile goes to sleep.  A short grace period
+	// keeps tiles that a wave is just entering or leaving from flickering.
+	const int SleepStepCount = 8;
+
+	// Edges of a tile, indexing TileState::EdgeActivity.
+	enum TileEdge
+	{
+		North,
+		South,
+		West,
+		East
+	};
+
+	// Largest |height| or |height change| over columns [begin, end) of a row that
+	// was just stepped from curr to next.
+	float RowActivity(const float* next, const float* curr, int begin, int end)
+	{
+		int j = begin;
+		float activity = 0.0f;
+
+#if defined(WAVES_X86)
+		// Clearing the sign bit gives the absolute value.
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 activity4 = _mm_setzero_ps();
+		for (; j + 4 <= end; j += 4)
+		{
+			const __m128 h = _mm_loadu_ps(next + j);
+			const __m128 v = _mm_sub_ps(h, _mm_loadu_ps(curr + j));
+			activity4 = _mm_max_ps(activity4, _mm_and_ps(h, absMask));
+			activity4 = _mm_max_ps(activity4, _mm_and_ps(v, absMask));
+		}
+
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, activity4);
+		activity = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+		for (; j < end; ++j)
+			activity = std::max(activity, std::max(fabsf(next[j]), fabsf(next[j] - curr[j])));
+		return activity;
+	}
+
+	// One row of the height update.  up is row i-1 and down is row i+1; only columns
+	// [begin, end) are written.
+	typedef void (*StepRowFn)(float* prev, const float* curr, const float* up, const float* down,
+		int begin, int end, float k1, float k2, float k3);
+
+	// One row of the normal/tangent finite differences over columns [begin, end).
+	typedef void (*NormalRowFn)(const float* curr, const float* up, const float* down,
+		float* nx, float* ny, float* nz, float* tx, float* ty,
+		int begin, int end, float twoDx);
+
+	void StepRowScalar(float* prev, const float* curr, const float* up, const float* down,
+		int begin, int end, float k1, float k2, float k3)
+	{
+		for (int j = begin; j < end; ++j)
+		{
+			prev[j] = k1 * prev[j] + k2 * curr[j] +
+				k3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+		}
+	}
+
+	void NormalRowScalar(const float* curr, const float* up, const float* down,
+		float* nx, float* ny, float* nz, float* tx, float* ty,
+		int begin, int end, float twoDx)
+	{
+		for (int j = begin; j < end; ++j)
+		{
+			float l = curr[j - 1];
+			float r = curr[j + 1];
+			float t = up[j];
+			float b = down[j];
+
+			// n = normalize(l - r, 2dx, b - t)
+			float x = l - r;
+			float z = b - t;
+			float invLen = 1.0f / sqrtf(x * x + twoDx * twoDx + z * z);
+			nx[j] = x * invLen;
+			ny[j] = twoDx * invLen;
+			nz[j] = z * invLen;
+
+			// T = normalize(2dx, r - l, 0)
+			float invLenT = 1.0f / sqrtf(twoDx * twoDx + x * x);
+			tx[j] = twoDx * invLenT;
+			ty[j] = -x * invLenT;
+		}
+	}
+
+#if defined(WAVES_X86)
+	void StepRowSse(float* prev, const float* curr, const float* up, const float* down,
+		int begin, int end, float k1, float k2, float k3)
+	{
+		const __m128 vk1 = _mm_set1_ps(k1);
+		const __m128 vk2 = _mm_set1_ps(k2);
+		const __m128 vk3 = _mm_set1_ps(k3);
+
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			// Same association as the scalar kernel so both paths agree bit for bit.
+			__m128 sum = _mm_add_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+			__m128 h = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(vk1, _mm_loadu_ps(prev + j)), _mm_mul_ps(vk2, _mm_loadu_ps(curr + j))),
+				_mm_mul_ps(vk3, sum));
+
+			_mm_storeu_ps(prev + j, h);
+		}
+
+		StepRowScalar(prev, curr, up, down, j, end, k1, k2, k3);
+	}
+
+	void NormalRowSse(const float* curr, const float* up, const float* down,
+		float* nx, float* ny, float* nz, float* tx, float* ty,
+		int begin, int end, float twoDx)
+	{
+		const __m128 vTwoDx = _mm_set1_ps(twoDx);
+		const __m128 vTwoDxSq = _mm_set1_ps(twoDx * twoDx);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			__m128 x = _mm_sub_ps(_mm_loadu_ps(curr + j - 1), _mm_loadu_ps(curr + j + 1));
+			__m128 z = _mm_sub_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+
+			__m128 xx = _mm_add_ps(_mm_mul_ps(x, x), vTwoDxSq);
+			__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(xx, _mm_mul_ps(z, z))));
+			__m128 invLenT = _mm_div_ps(one, _mm_sqrt_ps(xx));
+
+			_mm_storeu_ps(nx + j, _mm_mul_ps(x, invLen));
+			_mm_storeu_ps(ny + j, _mm_mul_ps(vTwoDx, invLen));
+			_mm_storeu_ps(nz + j, _mm_mul_ps(z, invLen));
+			_mm_storeu_ps(tx + j, _mm_mul_ps(vTwoDx, invLenT));
+			_mm_storeu_ps(ty + j, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(x, invLenT)));
+		}
+
+		NormalRowScalar(curr, up, down, nx, ny, nz, tx, ty, j, end, twoDx);
+	}
+
+	WAVES_TARGET_AVX2 void StepRowAvx2(float* prev, const float* curr, const float* up, const float* down,
+		int begin, int end, float k1, float k2, float k3)
+	{
+		const __m256 vk1 = _mm256_set1_ps(k1);
+		const __m256 vk2 = _mm256_set1_ps(k2);
+		const __m256 vk3 = _mm256_set1_ps(k3);
+
+		int j = begin;
+		for (; j + 8 <= end; j += 8)
+		{
+			__m256 sum = _mm256_add_ps(
+				_mm256_add_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j)),
+				_mm256_add_ps(_mm256_loadu_ps(curr + j + 1), _mm256_loadu_ps(curr + j - 1)));
+
+			__m256 h = _mm256_fmadd_ps(vk1, _mm256_loadu_ps(prev + j),
+				_mm256_fmadd_ps(vk2, _mm256_loadu_ps(curr + j), _mm256_mul_ps(vk3, sum)));
+
+			_mm256_storeu_ps(prev + j, h);
+		}
+
+		// The tail runs legacy SSE code, which stalls on dirty upper YMM halves.
+		_mm256_zeroupper();
+		StepRowSse(prev, curr, up, down, j, end, k1, k2, k3);
+	}
+
+	WAVES_TARGET_AVX2 void NormalRowAvx2(const float* curr, const float* up, const float* down,
+		float* nx, float* ny, float* nz, float* tx, float* ty,
+		int begin, int end, float twoDx)
+	{
+		const __m256 vTwoDx = _mm256_set1_ps(twoDx);
+		const __m256 vTwoDxSq = _mm256_set1_ps(twoDx * twoDx);
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		int j = begin;
+		for (; j + 8 <= end; j += 8)
+		{
+			__m256 x = _mm256_sub_ps(_mm256_loadu_ps(curr + j - 1), _mm256_loadu_ps(curr + j + 1));
+			__m256 z = _mm256_sub_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+
+			__m256 xx = _mm256_fmadd_ps(x, x, vTwoDxSq);
+			__m256 invLen = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_fmadd_ps(z, z, xx)));
+			__m256 invLenT = _mm256_div_ps(one, _mm256_sqrt_ps(xx));
+
+			_mm256_storeu_ps(nx + j, _mm256_mul_ps(x, invLen));
+			_mm256_storeu_ps(ny + j, _mm256_mul_ps(vTwoDx, invLen));
+			_mm256_storeu_ps(nz + j, _mm256_mul_ps(z, invLen));
+			_mm256_storeu_ps(tx + j, _mm256_mul_ps(vTwoDx, invLenT));
+			_mm256_storeu_ps(ty + j, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(x, invLenT)));
+		}
+
+		// The tail runs legacy SSE code, which stalls on dirty upper YMM halves.
+		_mm256_zeroupper();
+		NormalRowSse(curr, up, down, nx, ny, nz, tx, ty, j, end, twoDx);
+	}
+
+	bool CpuSupportsAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// AVX and FMA, and the OS must save the YMM registers on context switches.
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!fma || !osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+#endif
+
+	StepRowFn GetStepRowFn(Waves::SolverPath path)
+	{
+		switch (path)
+		{
+#if defined(WAVES_X86)
+		case Waves::SolverPath::Sse:
+			return StepRowSse;
+		case Waves::SolverPath::Avx2:
+			return StepRowAvx2;
+#endif
+		default:
+			return StepRowScalar;
+		}
+	}
+
+	NormalRowFn GetNormalRowFn(Waves::SolverPath path)
+	{
+		switch (path)
+		{
+#if defined(WAVES_X86)
+		case Waves::SolverPath::Sse:
+			return NormalRowSse;
+		case Waves::SolverPath::Avx2:
+			return NormalRowAvx2;
+#endif
+		default:
+			return NormalRowScalar;
+		}
+	}
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
 	mNumRows = m;
@@ -27,28 +300,19 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 	mK2 = (4.0f - 8.0f * e) / d;
 	mK3 = (2.0f * e) / d;
 
-	mPrevSolution.resize(m * n);
-	mCurrSolution.resize(m * n);
-	mNormals.resize(m * n);
-	mTangentX.resize(m * n);
-
-	// Generate grid vertices in system memory.
+	// The surface starts flat: zero height, normals up and tangents along +x.
+	mPrevHeights.assign(m * n, 0.0f);
+	mCurrHeights.assign(m * n, 0.0f);
+	mNormalX.assign(m * n, 0.0f);
+	mNormalY.assign(m * n, 1.0f);
+	mNormalZ.assign(m * n, 0.0f);
+	mTangentX.assign(m * n, 1.0f);
+	mTangentY.assign(m * n, 0.0f);
 
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
-	for (int i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i * dx;
-		for (int j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j * dx;
+	SetSolverPath(SolverPath::Auto);
 
-			mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		}
-	}
+	// Nothing moves yet, so every tile starts asleep.
+	BuildTiles(false);
 }
 
 Waves::~Waves()
@@ -85,73 +349,586 @@ float Waves::Depth()const
 	return mNumRows * mSpatialStep;
 }
 
-void Waves::Update(float dt)
+XMFLOAT3 Waves::Position(int i)const
+{
+	const int row = i / mNumCols;
+	const int col = i % mNumCols;
+
+	const float halfWidth = (mNumCols - 1) * mSpatialStep * 0.5f;
+	const float halfDepth = (mNumRows - 1) * mSpatialStep * 0.5f;
+
+	return XMFLOAT3(-halfWidth + col * mSpatialStep, mCurrHeights[i], halfDepth - row * mSpatialStep);
+}
+
+XMFLOAT3 Waves::Normal(int i)const
+{
+	return XMFLOAT3(mNormalX[i], mNormalY[i], mNormalZ[i]);
+}
+
+XMFLOAT3 Waves::TangentX(int i)const
 {
-	static float t = 0;
+	return XMFLOAT3(mTangentX[i], mTangentY[i], 0.0f);
+}
+
+void Waves::WriteVertices(void* dst, std::size_t vertexStride, int normalOffset, int tangentOffset,
+	int firstRow, int rowCount)const
+{
+	assert(firstRow >= 0 && firstRow + rowCount <= mNumRows);
 
+	const float halfWidth = (mNumCols - 1) * mSpatialStep * 0.5f;
+	const float halfDepth = (mNumRows - 1) * mSpatialStep * 0.5f;
+	const float alpha = InterpolationAlpha();
+
+	unsigned char* out = static_cast<unsigned char*>(dst);
+	for (int i = firstRow; i < firstRow + rowCount; ++i)
+	{
+		const float z = halfDepth - i * mSpatialStep;
+		for (int j = 0; j < mNumCols; ++j)
+		{
+			const int k = i * mNumCols + j;
+
+			XMFLOAT3 p(-halfWidth + j * mSpatialStep, mCurrHeights[k], z);
+			if (mIsInterpolating)
+				p.y = mPrevHeights[k] + (p.y - mPrevHeights[k]) * alpha;
+			std::memcpy(out, &p, sizeof(p));
+
+			if (normalOffset >= 0)
+			{
+				XMFLOAT3 n(mNormalX[k], mNormalY[k], mNormalZ[k]);
+				std::memcpy(out + normalOffset, &n, sizeof(n));
+			}
+
+			if (tangentOffset >= 0)
+			{
+				XMFLOAT3 t(mTangentX[k], mTangentY[k], 0.0f);
+				std::memcpy(out + tangentOffset, &t, sizeof(t));
+			}
+
+			out += vertexStride;
+		}
+	}
+}
+
+void Waves::StreamVertices(void* dst, int firstRow, int rowCount)const
+{
+	assert(firstRow >= 0 && firstRow + rowCount <= mNumRows);
+
+	const float halfWidth = (mNumCols - 1) * mSpatialStep * 0.5f;
+	const float halfDepth = (mNumRows - 1) * mSpatialStep * 0.5f;
+
+	const float alpha = InterpolationAlpha();
+
+	// Height of cell k in the render output.
+	auto height = [this, alpha](int k)
+		{
+			return mIsInterpolating ? mPrevHeights[k] + (mCurrHeights[k] - mPrevHeights[k]) * alpha : mCurrHeights[k];
+		};
+
+	float* const out = static_cast<float*>(dst);
+	auto streamRows = [this, out, firstRow, halfWidth, halfDepth, alpha, &height](int first, int last)
+		{
+			float* p = out + 6 * static_cast<std::size_t>(first - firstRow) * mNumCols;
+			for (int i = first; i < last; ++i)
+			{
+				const int row = i * mNumCols;
+				const float z = halfDepth - i * mSpatialStep;
+				int j = 0;
+
+#if defined(WAVES_X86)
+				// Vertices are 24 bytes, so every other one starts on a 16-byte boundary
+				// as long as the row starts on an 8-byte one.
+				const bool bStream = (reinterpret_cast<std::uintptr_t>(p) & 7) == 0;
+				if (bStream && (reinterpret_cast<std::uintptr_t>(p) & 15) != 0)
+				{
+					p[0] = -halfWidth;
+					p[1] = height(row);
+					p[2] = z;
+					p[3] = mNormalX[row];
+					p[4] = mNormalY[row];
+					p[5] = mNormalZ[row];
+					p += 6;
+					j = 1;
+				}
+
+				if (bStream)
+				{
+					const __m128 vHalfWidth = _mm_set1_ps(-halfWidth);
+					const __m128 vDx = _mm_set1_ps(mSpatialStep);
+					const __m128 vZ = _mm_set1_ps(z);
+					const __m128 vAlpha = _mm_set1_ps(alpha);
+
+					for (; j + 4 <= mNumCols; j += 4)
+					{
+						const __m128 x = _mm_add_ps(vHalfWidth,
+							_mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(j, j + 1, j + 2, j + 3)), vDx));
+
+						// x, y, z, nx of each vertex, and ny, nz of two vertices per register.
+						__m128 a0 = x;
+						__m128 a1 = _mm_loadu_ps(&mCurrHeights[row + j]);
+						if (mIsInterpolating)
+						{
+							const __m128 prev = _mm_loadu_ps(&mPrevHeights[row + j]);
+							a1 = _mm_add_ps(prev, _mm_mul_ps(_mm_sub_ps(a1, prev), vAlpha));
+						}
+						__m128 a2 = vZ;
+						__m128 a3 = _mm_loadu_ps(&mNormalX[row + j]);
+						_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+
+						const __m128 ny = _mm_loadu_ps(&mNormalY[row + j]);
+						const __m128 nz = _mm_loadu_ps(&mNormalZ[row + j]);
+						const __m128 b01 = _mm_unpacklo_ps(ny, nz);
+						const __m128 b23 = _mm_unpackhi_ps(ny, nz);
+
+						_mm_stream_ps(p + 0, a0);
+						_mm_stream_ps(p + 4, _mm_movelh_ps(b01, a1));
+						_mm_stream_ps(p + 8, _mm_movehl_ps(b01, a1));
+						_mm_stream_ps(p + 12, a2);
+						_mm_stream_ps(p + 16, _mm_movelh_ps(b23, a3));
+						_mm_stream_ps(p + 20, _mm_movehl_ps(b23, a3));
+						p += 24;
+					}
+				}
+#endif
+
+				for (; j < mNumCols; ++j)
+				{
+					p[0] = -halfWidth + j * mSpatialStep;
+					p[1] = height(row + j);
+					p[2] = z;
+					p[3] = mNormalX[row + j];
+					p[4] = mNormalY[row + j];
+					p[5] = mNormalZ[row + j];
+					p += 6;
+				}
+			}
+
+#if defined(WAVES_X86)
+			// Streaming stores are weakly ordered; make them visible before the job ends.
+			_mm_sfence();
+#endif
+		};
+
+	const int grainRows = std::max(1, StreamGrainSize / mNumCols);
+	JobSystem::Default().ParallelForRange(firstRow, firstRow + rowCount, grainRows, streamRows);
+}
+
+void Waves::SetSolverPath(SolverPath path)
+{
+	if (path == SolverPath::Auto)
+	{
+#if defined(WAVES_X86)
+		path = CpuSupportsAvx2() ? SolverPath::Avx2 : SolverPath::Sse;
+#else
+		path = SolverPath::Scalar;
+#endif
+	}
+
+#if !defined(WAVES_X86)
+	path = SolverPath::Scalar;
+#endif
+
+	mSolverPath = path;
+}
+
+Waves::SolverPath Waves::GetSolverPath()const
+{
+	return mSolverPath;
+}
+
+void Waves::SetMaxSubsteps(int steps)
+{
+	assert(steps >= 1);
+	mMaxSubsteps = steps;
+}
+
+int Waves::MaxSubsteps()const
+{
+	return mMaxSubsteps;
+}
+
+void Waves::SetInterpolation(bool bInterpolate)
+{
+	mIsInterpolating = bInterpolate;
+}
+
+bool Waves::IsInterpolating()const
+{
+	return mIsInterpolating;
+}
+
+float Waves::InterpolationAlpha()const
+{
+	return std::min(mAccumulatedTime / mTimeStep, 1.0f);
+}
+
+void Waves::SetTileRowCount(int rows)
+{
+	assert(rows > 0);
+	mTileRowCount = rows;
+	BuildTiles(true);
+}
+
+int Waves::TileRowCount()const
+{
+	return mTileRowCount;
+}
+
+void Waves::SetTileColumnCount(int columns)
+{
+	assert(columns > 0);
+	mTileColumnCount = columns;
+	BuildTiles(true);
+}
+
+int Waves::TileColumnCount()const
+{
+	return mTileColumnCount;
+}
+
+void Waves::SetSleepThreshold(float threshold)
+{
+	assert(threshold >= 0.0f);
+	mSleepThreshold = threshold;
+}
+
+float Waves::SleepThreshold()const
+{
+	return mSleepThreshold;
+}
+
+int Waves::TileCount()const
+{
+	return (int)mTiles.size();
+}
+
+Waves::TileRect Waves::TileBounds(int tile)const
+{
+	const int tileRow = tile / mTilesAcross;
+	const int tileCol = tile % mTilesAcross;
+
+	TileRect rect;
+	rect.FirstRow = 1 + tileRow * mTileRowCount;
+	rect.RowEnd = std::min(rect.FirstRow + mTileRowCount, mNumRows - 1);
+	rect.FirstColumn = 1 + tileCol * mTileColumnCount;
+	rect.ColumnEnd = std::min(rect.FirstColumn + mTileColumnCount, mNumCols - 1);
+	return rect;
+}
+
+bool Waves::IsTileAwake(int tile)const
+{
+	return mTiles[tile].bAwake;
+}
+
+int Waves::AwakeTileCount()const
+{
+	int count = 0;
+	for (const TileState& state : mTiles)
+		count += state.bAwake ? 1 : 0;
+	return count;
+}
+
+const std::vector<int>& Waves::ChangedTiles()const
+{
+	return mChangedTiles;
+}
+
+long long Waves::StepCount()const
+{
+	return mStepCount;
+}
+
+long long Waves::TileChangeStep(int tile)const
+{
+	return mTiles[tile].ChangeStep;
+}
+
+bool Waves::ChangedRows(long long sinceStep, int& firstRow, int& rowCount)const
+{
+	if (sinceStep < 0)
+	{
+		firstRow = 0;
+		rowCount = mNumRows;
+		return true;
+	}
+
+	int first = mNumRows;
+	int end = 0;
+	for (int tile = 0; tile < (int)mTiles.size(); ++tile)
+	{
+		// The last two solutions differ in the tiles the last step changed and in
+		// the ones disturbed since, which are awake.
+		const TileState& state = mTiles[tile];
+		const bool bBlended = mIsInterpolating && (state.bAwake || state.ChangeStep == mStepCount);
+		if (state.ChangeStep > sinceStep || bBlended)
+		{
+			const TileRect rect = TileBounds(tile);
+			first = std::min(first, rect.FirstRow);
+			end = std::max(end, rect.RowEnd);
+		}
+	}
+
+	if (first >= end)
+		return false;
+
+	firstRow = first;
+	rowCount = end - first;
+	return true;
+}
+
+double Waves::CellsPerSecond()const
+{
+	return mStepSeconds > 0.0 ? mSteppedCells / mStepSeconds : 0.0;
+}
+
+float Waves::DroppedTime()const
+{
+	return mDroppedTime;
+}
+
+void Waves::ResetStats()
+{
+	mStepSeconds = 0.0;
+	mSteppedCells = 0;
+	mDroppedTime = 0.0f;
+}
+
+int Waves::Update(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulatedTime += dt;
+
+	// Only update the simulation at the specified time step, as many times as the
+	// accumulated time allows.  The remainder carries over to the next update.
+	int steps = 0;
+	while (mAccumulatedTime >= mTimeStep && steps < mMaxSubsteps)
+	{
+		Step();
+		mAccumulatedTime -= mTimeStep;
+		++steps;
+	}
+
+	if (mAccumulatedTime >= mTimeStep)
+	{
+		const float dropped = floorf(mAccumulatedTime / mTimeStep) * mTimeStep;
+		mAccumulatedTime -= dropped;
+		mDroppedTime += dropped;
+	}
+
+	return steps;
+}
+
+void Waves::UpdateAll(Waves* const* waves, int count, float dt)
+{
+	// The grids share no state, and each one still spreads its own steps over the
+	// job system; waiting inside a job runs other jobs, so the nesting is safe.
+	JobSystem::Default().ParallelFor(0, count, 1, [waves, dt](int k)
+		{
+			waves[k]->Update(dt);
+		});
+}
+
+void Waves::Step()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	const StepRowFn stepRow = GetStepRowFn(mSolverPath);
+	const NormalRowFn normalRow = GetNormalRowFn(mSolverPath);
+	const float twoDx = 2.0f * mSpatialStep;
+
+	// After this update we will be discarding the old previous
+	// buffer, so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element)
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to
+	// keep consistent with our row indices going down.
+	auto step = [this, stepRow](int i, int begin, int end)
+		{
+			const float* curr = &mCurrHeights[i * mNumCols];
+			stepRow(&mPrevHeights[i * mNumCols], curr, curr - mNumCols, curr + mNumCols,
+				begin, end, mK1, mK2, mK3);
+		};
+
+	// Compute normals using finite difference scheme.  Until the swap below the
+	// new solution lives in mPrevHeights.
+	auto buildNormals = [this, normalRow, twoDx](int i, int begin, int end)
+		{
+			const int row = i * mNumCols;
+			const float* next = &mPrevHeights[row];
+			normalRow(next, next - mNumCols, next + mNumCols,
+				&mNormalX[row], &mNormalY[row], &mNormalZ[row], &mTangentX[row], &mTangentY[row],
+				begin, end, twoDx);
+		};
+
+	// Rebuilds the normals along the border of rect, whose neighbors lie in other
+	// tiles.  Columns next to the fixed boundary have no such neighbor.
+	auto buildBorderNormals = [this, &buildNormals](const TileRect& rect)
+		{
+			buildNormals(rect.FirstRow, rect.FirstColumn, rect.ColumnEnd);
+			if (rect.RowEnd - 1 > rect.FirstRow)
+				buildNormals(rect.RowEnd - 1, rect.FirstColumn, rect.ColumnEnd);
+
+			// A column with seams on both sides is built once.  One next to the west
+			// boundary is left out of the interior normals of its span, so when it is
+			// the only column it still needs building here.
+			const bool bWestSeam = rect.FirstColumn > 1;
+			const bool bEastSeam = rect.ColumnEnd < mNumCols - 1 &&
+				(rect.ColumnEnd - 1 > rect.FirstColumn || !bWestSeam);
+			for (int i = rect.FirstRow + 1; i < rect.RowEnd - 1; ++i)
+			{
+				if (bWestSeam)
+					buildNormals(i, rect.FirstColumn, rect.FirstColumn + 1);
+				if (bEastSeam)
+					buildNormals(i, rect.ColumnEnd - 1, rect.ColumnEnd);
+			}
+		};
 
-	// Only update the simulation at the specified time step.
-	if (t >= mTimeStep)
+	// Only update interior points; we use zero boundary conditions.  The interior
+	// is split into tiles and only the awake ones are stepped; sleeping tiles are
+	// flat in both buffers, so the awake tiles see them as still water.
+	++mStepCount;
+	mChangedTiles.clear();
+
+	// Tiles that went to sleep after the last step are flattened before anything
+	// reads them, and runs of awake tiles in a row of tiles are merged into spans
+	// so a surface that is awake everywhere is still swept in full rows.
+	mAwakeSpans.clear();
+	for (int tileRow = 0; tileRow < mTilesDown; ++tileRow)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows-1; ++i)
+		for (int tileCol = 0; tileCol < mTilesAcross; ++tileCol)
+		{
+			const int tile = tileRow * mTilesAcross + tileCol;
+			TileState& state = mTiles[tile];
+
+			if (state.bFlatten)
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
+				FlattenTile(tile);
+				state.bFlatten = false;
+				MarkTileChanged(tile, true);
+			}
+
+			state.bStepped = state.bAwake;
+			if (!state.bAwake)
+				continue;
+
+			if (tileCol > 0 && mTiles[tile - 1].bAwake)
+				mAwakeSpans.back().TileEnd = tile + 1;
+			else
+				mAwakeSpans.push_back({ tile, tile + 1 });
+		}
+	}
+
+	// Each span steps a row and then builds the normals of the row above it, whose
+	// new neighbors are all in the span by then, so the rows involved are still in
+	// cache.  The border cells of a span need new heights from the neighboring
+	// tiles, so they are finished once all spans are done.
+	JobSystem& jobs = JobSystem::Default();
+
+	jobs.ParallelFor(0, (int)mAwakeSpans.size(), 1, [this, &step, &buildNormals](int k)
+		{
+			const TileSpan& span = mAwakeSpans[k];
+			const TileRect rect = SpanBounds(span);
+			const int normalBegin = rect.FirstColumn > 1 ? rect.FirstColumn + 1 : rect.FirstColumn;
+			const int normalEnd = rect.ColumnEnd < mNumCols - 1 ? rect.ColumnEnd - 1 : rect.ColumnEnd;
+
+			for (int tile = span.FirstTile; tile < span.TileEnd; ++tile)
+			{
+				mTiles[tile].Activity = 0.0f;
+				for (float& edgeActivity : mTiles[tile].EdgeActivity)
+					edgeActivity = 0.0f;
+			}
+
+			for (int i = rect.FirstRow; i < rect.RowEnd; ++i)
+			{
+				step(i, rect.FirstColumn, rect.ColumnEnd);
+
+				const float* next = &mPrevHeights[i * mNumCols];
+				const float* curr = &mCurrHeights[i * mNumCols];
+				for (int tile = span.FirstTile; tile < span.TileEnd; ++tile)
 				{
-					// After this update we will be discarding the old previous
-					// buffer, so overwrite that buffer with the new update.
-					// Note how we can do this inplace (read/write to same element) 
-					// because we won't need prev_ij again and the assignment happens last.
-
-					// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-					// Moreover, our +z axis goes "down"; this is just to 
-					// keep consistent with our row indices going down.
-
-					mPrevSolution[i * mNumCols + j].y =
-						mK1 * mPrevSolution[i * mNumCols + j].y +
-						mK2 * mCurrSolution[i * mNumCols + j].y +
-						mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-							mCurrSolution[(i - 1) * mNumCols + j].y +
-							mCurrSolution[i * mNumCols + j + 1].y +
-							mCurrSolution[i * mNumCols + j - 1].y);
+					TileState& state = mTiles[tile];
+					const TileRect tileRect = TileBounds(tile);
+
+					const float rowActivity = RowActivity(next, curr, tileRect.FirstColumn, tileRect.ColumnEnd);
+					state.Activity = std::max(state.Activity, rowActivity);
+					if (i == rect.FirstRow)
+						state.EdgeActivity[North] = rowActivity;
+					if (i == rect.RowEnd - 1)
+						state.EdgeActivity[South] = rowActivity;
+
+					const int west = tileRect.FirstColumn;
+					const int east = tileRect.ColumnEnd - 1;
+					state.EdgeActivity[West] = std::max(state.EdgeActivity[West],
+						std::max(fabsf(next[west]), fabsf(next[west] - curr[west])));
+					state.EdgeActivity[East] = std::max(state.EdgeActivity[East],
+						std::max(fabsf(next[east]), fabsf(next[east] - curr[east])));
 				}
-			});
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+				if (i - 1 > rect.FirstRow)
+					buildNormals(i - 1, normalBegin, normalEnd);
+			}
+		});
 
-		t = 0.0f; // reset time
+	// Tiles that stayed quiet long enough go to sleep, and tiles with a lively edge
+	// wake the neighbor across it.  Every stepped tile and its edge neighbors have
+	// changed.
+	long long steppedCells = 0;
+	for (const TileSpan& span : mAwakeSpans)
+	{
+		const TileRect rect = SpanBounds(span);
+		steppedCells += static_cast<long long>(rect.RowEnd - rect.FirstRow) * (rect.ColumnEnd - rect.FirstColumn);
+
+		for (int tile = span.FirstTile; tile < span.TileEnd; ++tile)
+		{
+			TileState& state = mTiles[tile];
+			int neighbors[4];
+			GetTileNeighbors(tile, neighbors);
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows - 1; ++i)
+			state.QuietSteps = state.Activity < mSleepThreshold ? state.QuietSteps + 1 : 0;
+			if (state.QuietSteps >= SleepStepCount)
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
+				state.bAwake = false;
+				state.bFlatten = true;
+			}
+			else
+			{
+				for (int edge = 0; edge < 4; ++edge)
 				{
-					float l = mCurrSolution[i * mNumCols + j - 1].y;
-					float r = mCurrSolution[i * mNumCols + j + 1].y;
-					float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-					float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-					mNormals[i * mNumCols + j].x = -r + l;
-					mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-					mNormals[i * mNumCols + j].z = b - t;
-
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-					XMStoreFloat3(&mNormals[i * mNumCols + j], n);
-
-					mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-					XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
+					if (neighbors[edge] >= 0 && state.EdgeActivity[edge] >= mSleepThreshold)
+						WakeTile(neighbors[edge]);
 				}
-			});
+			}
+
+			MarkTileChanged(tile, true);
+		}
+	}
+
+	// The borders of the spans, and of the sleeping tiles next to them.
+	mBorderTiles.clear();
+	for (int tile : mChangedTiles)
+	{
+		if (!mTiles[tile].bStepped)
+			mBorderTiles.push_back(tile);
 	}
+
+	const int spanCount = (int)mAwakeSpans.size();
+	jobs.ParallelFor(0, spanCount + (int)mBorderTiles.size(), 1, [this, spanCount, &buildBorderNormals](int k)
+		{
+			if (k < spanCount)
+				buildBorderNormals(SpanBounds(mAwakeSpans[k]));
+			else
+				buildBorderNormals(TileBounds(mBorderTiles[k - spanCount]));
+		});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevHeights, mCurrHeights);
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	mStepSeconds += elapsed.count();
+	mSteppedCells += steppedCells;
 }
 
 void Waves::Disturb(int i, int j, float magnitude)
@@ -163,10 +940,100 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f * magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i * mNumCols + j].y += magnitude;
-	mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-	mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-	mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-	mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
+	mCurrHeights[i * mNumCols + j] += magnitude;
+	mCurrHeights[i * mNumCols + j + 1] += halfMag;
+	mCurrHeights[i * mNumCols + j - 1] += halfMag;
+	mCurrHeights[(i + 1) * mNumCols + j] += halfMag;
+	mCurrHeights[(i - 1) * mNumCols + j] += halfMag;
+
+	WakeTileAt(i, j);
+	WakeTileAt(i, j + 1);
+	WakeTileAt(i, j - 1);
+	WakeTileAt(i + 1, j);
+	WakeTileAt(i - 1, j);
+}
+
+Waves::TileRect Waves::SpanBounds(const TileSpan& span)const
+{
+	TileRect rect = TileBounds(span.FirstTile);
+	rect.ColumnEnd = TileBounds(span.TileEnd - 1).ColumnEnd;
+	return rect;
+}
+
+void Waves::BuildTiles(bool bAwake)
+{
+	mTilesDown = (mNumRows - 2 + mTileRowCount - 1) / mTileRowCount;
+	mTilesAcross = (mNumCols - 2 + mTileColumnCount - 1) / mTileColumnCount;
+
+	TileState state;
+	state.bAwake = bAwake;
+	state.ChangeStep = mStepCount;
+	mTiles.assign(mTilesDown * mTilesAcross, state);
+
+	mAwakeSpans.clear();
+	mBorderTiles.clear();
+	mChangedTiles.clear();
+}
+
+void Waves::WakeTile(int tile)
+{
+	mTiles[tile].bAwake = true;
+	mTiles[tile].bFlatten = false;
+	mTiles[tile].QuietSteps = 0;
+}
+
+void Waves::WakeTileAt(int i, int j)
+{
+	WakeTile(((i - 1) / mTileRowCount) * mTilesAcross + (j - 1) / mTileColumnCount);
 }
 
+void Waves::GetTileNeighbors(int tile, int neighbors[4])const
+{
+	const int tileRow = tile / mTilesAcross;
+	const int tileCol = tile % mTilesAcross;
+
+	neighbors[North] = tileRow > 0 ? tile - mTilesAcross : -1;
+	neighbors[South] = tileRow + 1 < mTilesDown ? tile + mTilesAcross : -1;
+	neighbors[West] = tileCol > 0 ? tile - 1 : -1;
+	neighbors[East] = tileCol + 1 < mTilesAcross ? tile + 1 : -1;
+}
+
+void Waves::MarkTileChanged(int tile, bool bWithNeighbors)
+{
+	if (mTiles[tile].ChangeStep != mStepCount)
+	{
+		mTiles[tile].ChangeStep = mStepCount;
+		mChangedTiles.push_back(tile);
+	}
+
+	// New heights along an edge change the normals on the other side of it.
+	if (bWithNeighbors)
+	{
+		int neighbors[4];
+		GetTileNeighbors(tile, neighbors);
+		for (int neighbor : neighbors)
+		{
+			if (neighbor >= 0)
+				MarkTileChanged(neighbor, false);
+		}
+	}
+}
+
+void Waves::FlattenTile(int tile)
+{
+	// Clears both buffers so the tile stays flat whichever one is current.
+	const TileRect rect = TileBounds(tile);
+	for (int i = rect.FirstRow; i < rect.RowEnd; ++i)
+	{
+		const int first = i * mNumCols + rect.FirstColumn;
+		const int last = i * mNumCols + rect.ColumnEnd;
+
+		std::fill(mPrevHeights.begin() + first, mPrevHeights.begin() + last, 0.0f);
+		std::fill(mCurrHeights.begin() + first, mCurrHeights.begin() + last, 0.0f);
+		std::fill(mNormalX.begin() + first, mNormalX.begin() + last, 0.0f);
+		std::fill(mNormalY.begin() + first, mNormalY.begin() + last, 1.0f);
+		std::fill(mNormalZ.begin() + first, mNormalZ.begin() + last, 0.0f);
+		std::fill(mTangentX.begin() + first, mTangentX.begin() + last, 1.0f);
+		std::fill(mTangentY.begin() + first, mTangentY.begin() + last, 0.0f);
+	}
+}
@@ -347,17 +347,15 @@ void LitWavesApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	waves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the new solution.  Each frame resource has
+	// its own buffer, so it needs the rows changed by every step since it was last
+	// written; Waves writes them straight into the mapped buffer.
 	auto currWavesVB = currFrameResource->WavesVB.get();
-	for (int i = 0; i < waves->VertexCount(); ++i)
-	{
-		Vertex v;
-
-		v.Pos = waves->Position(i);
-		v.Normal = waves->Normal(i);
-
-		currWavesVB->CopyData(i, v);
-	}
+	int firstRow = 0;
+	int rowCount = 0;
+	if (waves->ChangedRows(currFrameResource->WavesStep, firstRow, rowCount))
+		waves->StreamVertices(currWavesVB->GetMappedData(firstRow * waves->ColumnCount()), firstRow, rowCount);
+	currFrameResource->WavesStep = waves->StepCount();
 
 	// Set the dynamic VB of the wave renderitem to the current frame VB.
 	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
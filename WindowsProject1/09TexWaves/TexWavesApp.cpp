@@ -165,6 +165,9 @@ void TexWavesApp::Draw(const GameTimer& gt)
 
 	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)]);
 
+	commandList->SetPipelineState(PSOs["waves"].Get());
+	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::Waves)]);
+
 	auto barrierDraw = CD3DX12_RESOURCE_BARRIER::Transition(
 		currentBackBuffer,
 		D3D12_RESOURCE_STATE_RENDER_TARGET,
@@ -381,22 +384,15 @@ void TexWavesApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	waves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the new solution.  Each frame resource has
+	// its own buffer, so it needs the rows changed by every step since it was last
+	// written; Waves writes them straight into the mapped buffer.
 	auto currWavesVB = currFrameResource->WavesVB.get();
-	for (int i = 0; i < waves->VertexCount(); ++i)
-	{
-		Vertex v;
-
-		v.Pos = waves->Position(i);
-		v.Normal = waves->Normal(i);
-
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / waves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / waves->Depth();
-
-		currWavesVB->CopyData(i, v);
-	}
+	int firstRow = 0;
+	int rowCount = 0;
+	if (waves->ChangedRows(currFrameResource->WavesStep, firstRow, rowCount))
+		waves->StreamVertices(currWavesVB->GetMappedData(firstRow * waves->ColumnCount()), firstRow, rowCount);
+	currFrameResource->WavesStep = waves->StepCount();
 
 	// Set the dynamic VB of the wave renderitem to the current frame VB.
 	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -578,6 +574,15 @@ void TexWavesApp::BuildShadersAndInputLayout()
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	// The waves stream positions and normals every frame; their texture
+	// coordinates never change and come from a second, static stream.
+	wavesInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
 void TexWavesApp::BuildLandGeometry()
@@ -663,7 +668,18 @@ void TexWavesApp::BuildWavesGeometryBuffers()
 		}
 	}
 
-	UINT vbByteSize = waves->VertexCount() * sizeof(Vertex);
+	// Derive tex-coords from position by mapping [-w/2,w/2] --> [0,1].  The grid
+	// never moves in x and z, so they are built once into the static stream.
+	std::vector<XMFLOAT2> texCoords(waves->VertexCount());
+	for (int i = 0; i < waves->VertexCount(); ++i)
+	{
+		XMFLOAT3 p = waves->Position(i);
+		texCoords[i].x = 0.5f + p.x / waves->Width();
+		texCoords[i].y = 0.5f - p.z / waves->Depth();
+	}
+
+	UINT vbByteSize = waves->VertexCount() * sizeof(WaveVertex);
+	UINT staticVbByteSize = waves->VertexCount() * sizeof(XMFLOAT2);
 	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
@@ -681,8 +697,13 @@ void TexWavesApp::BuildWavesGeometryBuffers()
 	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
 		commandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->StaticVertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
+		commandList.Get(), texCoords.data(), staticVbByteSize, geo->StaticVertexBufferUploader);
+
+	geo->VertexByteStride = sizeof(WaveVertex);
 	geo->VertexBufferByteSize = vbByteSize;
+	geo->StaticVertexByteStride = sizeof(XMFLOAT2);
+	geo->StaticVertexBufferByteSize = staticVbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
@@ -727,6 +748,13 @@ void TexWavesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = device->GetMsaaState() ? (device->GetMsaaQuality() - 1) : 0;
 	opaquePsoDesc.DSVFormat = device->GetDepthStencilFormat();
 	ThrowIfFailed(device->GetD3DDevice()->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&PSOs["opaque"])));
+
+	//
+	// PSO for the waves, which take their texture coordinates from a second stream.
+	//
+	auto wavesPsoDesc = opaquePsoDesc;
+	wavesPsoDesc.InputLayout = { wavesInputLayout.data(), (UINT)wavesInputLayout.size() };
+	ThrowIfFailed(device->GetD3DDevice()->CreateGraphicsPipelineState(&wavesPsoDesc, IID_PPV_ARGS(&PSOs["waves"])));
 }
 
 void TexWavesApp::BuildFrameResources()
@@ -783,7 +811,7 @@ void TexWavesApp::BuildRenderItems()
 
 	this->wavesRitem = wavesRitem.get();
 
-	RitemLayer[(int)RenderLayer::OpaqueFrustumCull].push_back(wavesRitem.get());
+	RitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
@@ -819,6 +847,11 @@ void TexWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std:
 		auto indexBufferView = ri->Geo->IndexBufferView();
 
 		cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+		if (ri->Geo->StaticVertexBufferGPU != nullptr)
+		{
+			auto staticVertexBufferView = ri->Geo->StaticVertexBufferView();
+			cmdList->IASetVertexBuffers(1, 1, &staticVertexBufferView);
+		}
 		cmdList->IASetIndexBuffer(&indexBufferView);
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
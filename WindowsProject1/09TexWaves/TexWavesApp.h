@@ -59,6 +59,7 @@ struct RenderItem
 enum class RenderLayer : int
 {
 	OpaqueFrustumCull = 0,
+	Waves = OpaqueFrustumCull + 1,
 	Count
 };
 
@@ -124,6 +125,7 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> PSOs;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> wavesInputLayout;
 
 	RenderItem* wavesRitem = nullptr;
 
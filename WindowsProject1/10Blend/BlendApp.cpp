@@ -116,6 +116,8 @@ void BlendApp::Update(const GameTimer& gt)
 	UpdateMainPassCB(gt);
 	AnimateMaterials(gt);
 	UpdateWaves(gt);
+	SortBackToFront(RenderLayer::Waves);
+	SortBackToFront(RenderLayer::OpaqueNonFrustumCull);
 }
 
 void BlendApp::Draw(const GameTimer& gt)
@@ -167,8 +169,11 @@ void BlendApp::Draw(const GameTimer& gt)
 	commandList->SetPipelineState(PSOs["opaque"].Get());
 	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)]);
 
+	commandList->SetPipelineState(PSOs["waves"].Get());
+	DrawRenderItems(commandList.Get(), sortedRitemLayer[static_cast<int>(RenderLayer::Waves)]);
+
 	commandList->SetPipelineState(PSOs["transparent"].Get());
-	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)]);
+	DrawRenderItems(commandList.Get(), sortedRitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)]);
 
 	auto barrierDraw = CD3DX12_RESOURCE_BARRIER::Transition(
 		currentBackBuffer,
@@ -390,25 +395,41 @@ void BlendApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	waves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the new solution.  Each frame resource has
+	// its own buffer, so it needs the rows changed by every step since it was last
+	// written; Waves writes them straight into the mapped buffer.
 	auto currWavesVB = currFrameResource->WavesVB.get();
-	for (int i = 0; i < waves->VertexCount(); ++i)
-	{
-		Vertex v;
+	int firstRow = 0;
+	int rowCount = 0;
+	if (waves->ChangedRows(currFrameResource->WavesStep, firstRow, rowCount))
+		waves->StreamVertices(currWavesVB->GetMappedData(firstRow * waves->ColumnCount()), firstRow, rowCount);
+	currFrameResource->WavesStep = waves->StepCount();
 
-		v.Pos = waves->Position(i);
-		v.Normal = waves->Normal(i);
+	// Set the dynamic VB of the wave renderitem to the current frame VB.
+	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+}
 
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / waves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / waves->Depth();
+void BlendApp::SortBackToFront(RenderLayer layer)
+{
+	const auto& ritems = RitemLayer[static_cast<int>(layer)];
+	const XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
 
-		currWavesVB->CopyData(i, v);
+	// Depth of an item's origin is close enough to order whole items.
+	layerDepths.resize(ritems.size());
+	for (size_t i = 0; i < ritems.size(); ++i)
+	{
+		const XMFLOAT4X4& world = ritems[i]->World;
+		const XMVECTOR origin = XMVectorSet(world._41, world._42, world._43, 1.0f);
+		layerDepths[i] = XMVectorGetZ(XMVector3TransformCoord(origin, viewMatrix));
 	}
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	auto& sorter = layerSorters[static_cast<int>(layer)];
+	sorter.SortBackToFront(layerDepths.data(), static_cast<uint32_t>(ritems.size()));
+
+	auto& sorted = sortedRitemLayer[static_cast<int>(layer)];
+	sorted.resize(ritems.size());
+	for (size_t i = 0; i < ritems.size(); ++i)
+		sorted[i] = ritems[sorter.GetOrder()[i]];
 }
 
 void BlendApp::LoadTexture(std::wstring filePath, std::string textureName)
@@ -587,6 +608,15 @@ void BlendApp::BuildShadersAndInputLayout()
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	// The waves stream positions and normals every frame; their texture
+	// coordinates never change and come from a second, static stream.
+	wavesInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
 void BlendApp::BuildLandGeometry()
@@ -727,7 +757,18 @@ void BlendApp::BuildWavesGeometryBuffers()
 		}
 	}
 
-	UINT vbByteSize = waves->VertexCount() * sizeof(Vertex);
+	// Derive tex-coords from position by mapping [-w/2,w/2] --> [0,1].  The grid
+	// never moves in x and z, so they are built once into the static stream.
+	std::vector<XMFLOAT2> texCoords(waves->VertexCount());
+	for (int i = 0; i < waves->VertexCount(); ++i)
+	{
+		XMFLOAT3 p = waves->Position(i);
+		texCoords[i].x = 0.5f + p.x / waves->Width();
+		texCoords[i].y = 0.5f - p.z / waves->Depth();
+	}
+
+	UINT vbByteSize = waves->VertexCount() * sizeof(WaveVertex);
+	UINT staticVbByteSize = waves->VertexCount() * sizeof(XMFLOAT2);
 	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
@@ -745,8 +786,13 @@ void BlendApp::BuildWavesGeometryBuffers()
 	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
 		commandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->StaticVertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
+		commandList.Get(), texCoords.data(), staticVbByteSize, geo->StaticVertexBufferUploader);
+
+	geo->VertexByteStride = sizeof(WaveVertex);
 	geo->VertexBufferByteSize = vbByteSize;
+	geo->StaticVertexByteStride = sizeof(XMFLOAT2);
+	geo->StaticVertexBufferByteSize = staticVbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
@@ -814,6 +860,17 @@ void BlendApp::BuildPSOs()
 		)
 	);
 
+	//
+	// PSO for the waves: transparent, with the texture coordinates in a second stream.
+	//
+	auto wavesPsoDesc = transparentPsoDesc;
+	wavesPsoDesc.InputLayout = { wavesInputLayout.data(), (UINT)wavesInputLayout.size() };
+	ThrowIfFailed(
+		device->GetD3DDevice()->CreateGraphicsPipelineState(
+			&wavesPsoDesc, IID_PPV_ARGS(&PSOs["waves"])
+		)
+	);
+
 }
 
 void BlendApp::BuildFrameResources()
@@ -908,7 +965,7 @@ void BlendApp::BuildRenderItems()
 
 	this->wavesRitem = wavesRitem.get();
 
-	RitemLayer[(int)RenderLayer::OpaqueNonFrustumCull].push_back(wavesRitem.get());
+	RitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
 
 	allRitems.push_back(std::move(gridRitem));
 	allRitems.push_back(std::move(crateRitem));
@@ -932,6 +989,11 @@ void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 		auto indexBufferView = ri->Geo->IndexBufferView();
 
 		cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+		if (ri->Geo->StaticVertexBufferGPU != nullptr)
+		{
+			auto staticVertexBufferView = ri->Geo->StaticVertexBufferView();
+			cmdList->IASetVertexBuffers(1, 1, &staticVertexBufferView);
+		}
 		cmdList->IASetIndexBuffer(&indexBufferView);
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
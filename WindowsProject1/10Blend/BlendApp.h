@@ -12,6 +12,7 @@
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
 #include "../Common/DDSTextureLoader.h"
+#include "../Common/DepthSorter.h"
 
 #include "FrameResource.h"
 #include "Waves.h"
@@ -60,6 +61,7 @@ enum class RenderLayer : int
 {
 	OpaqueFrustumCull = 0,
 	OpaqueNonFrustumCull = OpaqueFrustumCull + 1,
+	Waves = OpaqueNonFrustumCull + 1,
 	Count
 };
 
@@ -89,6 +91,7 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void SortBackToFront(RenderLayer layer);
 	void LoadTexture(std::wstring filePath, std::string textureName);
 
 	void LoadTextures();
@@ -127,6 +130,7 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> PSOs;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> wavesInputLayout;
 
 	RenderItem* wavesRitem = nullptr;
 
@@ -136,6 +140,11 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> RitemLayer[(int)RenderLayer::Count];
 
+	// Blended layers, back to front for this frame.
+	std::vector<RenderItem*> sortedRitemLayer[(int)RenderLayer::Count];
+	DepthSorter layerSorters[(int)RenderLayer::Count];
+	std::vector<float> layerDepths;
+
 	std::unique_ptr<Waves> waves;
 
 	PassConstants mainPassCB;
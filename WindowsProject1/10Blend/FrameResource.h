@@ -48,6 +48,14 @@ struct Vertex
     DirectX::XMFLOAT2 TexC;
 };
 
+// The part of a wave vertex that changes every step.  The texture coordinates
+// never change, so they live in a static second stream.
+struct WaveVertex
+{
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT3 Normal;
+};
+
 // Stores the resources needed for the CPU to build the command lists
 // for a frame.  
 struct FrameResource
@@ -72,7 +80,10 @@ public:
 
     // We cannot update a dynamic vertex buffer until the GPU is done processing
     // the commands that reference it.  So each frame needs their own.
-    std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+    std::unique_ptr<UploadBuffer<WaveVertex>> WavesVB = nullptr;
+
+    // Waves::StepCount when WavesVB was last written, -1 before the first write.
+    long long WavesStep = -1;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
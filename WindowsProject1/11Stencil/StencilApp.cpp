@@ -115,7 +115,7 @@ void StencilApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
-	UpdateReflectedItem(gt);
+	UpdateTransforms();
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
@@ -201,6 +201,9 @@ void StencilApp::Draw(const GameTimer& gt)
 	);
 	commandList->OMSetStencilRef(0);
 
+	commandList->SetPipelineState(PSOs["waves"].Get());
+	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::Waves)]);
+
 	commandList->SetPipelineState(PSOs["transparent"].Get());
 	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)]);
 	
@@ -277,21 +280,17 @@ void StencilApp::OnMouseMove(int x, int y, short keyState)
 	lastMousePos.y = y;
 }
 
-void StencilApp::UpdateReflectedItem(const GameTimer& gt)
+void StencilApp::UpdateTransforms()
 {
-	// Update reflection world matrix.
-	XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f); // xy plane
-	XMMATRIX R = XMMatrixReflect(mirrorPlane);
-	//XMStoreFloat4x4(&mReflectedSkullRitem->World, skullWorld * R);
-
-	for (auto& each : RitemLayer[static_cast<int>(RenderLayer::Reflected)])
+	// Nothing moves after the first frame, so Update usually finds no work.
+	for (TransformHierarchy::Node node : transforms.Update())
 	{
-		auto reflectedRenderItem = static_cast<ReflectedRenderItem*>(each);
+		RenderItem* ritem = ritemOfTransform[node];
+		if (ritem == nullptr)
+			continue;
 
-		XMStoreFloat4x4(&reflectedRenderItem->World,
-		                XMLoadFloat4x4(&reflectedRenderItem->OriginalRenderItem->World) * R);
-
-		each->NumFramesDirty = gNumFrameResources;
+		ritem->World = transforms.GetWorld(node);
+		ritem->NumFramesDirty = gNumFrameResources;
 	}
 }
 
@@ -484,22 +483,15 @@ void StencilApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	waves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the new solution.  Each frame resource has
+	// its own buffer, so it needs the rows changed by every step since it was last
+	// written; Waves writes them straight into the mapped buffer.
 	auto currWavesVB = currFrameResource->WavesVB.get();
-	for (int i = 0; i < waves->VertexCount(); ++i)
-	{
-		Vertex v;
-
-		v.Pos = waves->Position(i);
-		v.Normal = waves->Normal(i);
-
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / waves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / waves->Depth();
-
-		currWavesVB->CopyData(i, v);
-	}
+	int firstRow = 0;
+	int rowCount = 0;
+	if (waves->ChangedRows(currFrameResource->WavesStep, firstRow, rowCount))
+		waves->StreamVertices(currWavesVB->GetMappedData(firstRow * waves->ColumnCount()), firstRow, rowCount);
+	currFrameResource->WavesStep = waves->StepCount();
 
 	// Set the dynamic VB of the wave renderitem to the current frame VB.
 	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
@@ -685,6 +677,15 @@ void StencilApp::BuildShadersAndInputLayout()
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	// The waves stream positions and normals every frame; their texture
+	// coordinates never change and come from a second, static stream.
+	wavesInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
 void StencilApp::BuildLandGeometry()
@@ -825,7 +826,18 @@ void StencilApp::BuildWavesGeometryBuffers()
 		}
 	}
 
-	UINT vbByteSize = waves->VertexCount() * sizeof(Vertex);
+	// Derive tex-coords from position by mapping [-w/2,w/2] --> [0,1].  The grid
+	// never moves in x and z, so they are built once into the static stream.
+	std::vector<XMFLOAT2> texCoords(waves->VertexCount());
+	for (int i = 0; i < waves->VertexCount(); ++i)
+	{
+		XMFLOAT3 p = waves->Position(i);
+		texCoords[i].x = 0.5f + p.x / waves->Width();
+		texCoords[i].y = 0.5f - p.z / waves->Depth();
+	}
+
+	UINT vbByteSize = waves->VertexCount() * sizeof(WaveVertex);
+	UINT staticVbByteSize = waves->VertexCount() * sizeof(XMFLOAT2);
 	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
@@ -843,8 +855,13 @@ void StencilApp::BuildWavesGeometryBuffers()
 	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
 		commandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->StaticVertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
+		commandList.Get(), texCoords.data(), staticVbByteSize, geo->StaticVertexBufferUploader);
+
+	geo->VertexByteStride = sizeof(WaveVertex);
 	geo->VertexBufferByteSize = vbByteSize;
+	geo->StaticVertexByteStride = sizeof(XMFLOAT2);
+	geo->StaticVertexBufferByteSize = staticVbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
@@ -1016,6 +1033,17 @@ void StencilApp::BuildPSOs()
 		)
 	);
 
+	//
+	// PSO for the waves: transparent, with the texture coordinates in a second stream.
+	//
+	auto wavesPsoDesc = transparentPsoDesc;
+	wavesPsoDesc.InputLayout = { wavesInputLayout.data(), (UINT)wavesInputLayout.size() };
+	ThrowIfFailed(
+		device->GetD3DDevice()->CreateGraphicsPipelineState(
+			&wavesPsoDesc, IID_PPV_ARGS(&PSOs["waves"])
+		)
+	);
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC markMirrorsDepthPsoDesc = opaquePsoDesc;
 	markMirrorsDepthPsoDesc.PS =
 	{
@@ -1257,27 +1285,26 @@ void StencilApp::BuildRenderItems()
 
 	this->wavesRitem = wavesRitem.get();
 
-	RitemLayer[(int)RenderLayer::OpaqueNonFrustumCull].push_back(wavesRitem.get());
+	RitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
+
 
+	AddTransform(gridRitem.get());
+	AddTransform(crateRitem.get());
+	AddTransform(wavesRitem.get());
 
 	allRitems.push_back(std::move(gridRitem));
 	allRitems.push_back(std::move(crateRitem));
 	allRitems.push_back(std::move(wavesRitem));
 
 
-	// Update reflection world matrix.
-	XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f); // xy plane
-	XMMATRIX R = XMMatrixReflect(mirrorPlane);
-	//XMStoreFloat4x4(&mReflectedSkullRitem->World, skullWorld * R);
+	// Reflection through the xy plane.
+	const XMMATRIX reflection = XMMatrixReflect(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
 
 	int objectCBIndex = 3;
 	
 	for (auto& each : RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)])
 	{
-		auto reflectedRitem = std::make_unique<ReflectedRenderItem>();
-		XMStoreFloat4x4(&reflectedRitem->World,
-			XMLoadFloat4x4(&each->World) * R);
-		reflectedRitem->World = MathHelper::Identity4x4();
+		auto reflectedRitem = std::make_unique<RenderItem>();
 		reflectedRitem->ObjCBIndex = objectCBIndex++;
 		reflectedRitem->Mat = each->Mat;
 		reflectedRitem->Geo = each->Geo;
@@ -1285,7 +1312,7 @@ void StencilApp::BuildRenderItems()
 		reflectedRitem->IndexCount = each->IndexCount;
 		reflectedRitem->StartIndexLocation = each->StartIndexLocation;
 		reflectedRitem->BaseVertexLocation = each->BaseVertexLocation;
-		reflectedRitem->OriginalRenderItem = each;
+		AddWorldSpaceTransform(reflectedRitem.get(), each, reflection);
 
 		RitemLayer[static_cast<int>(RenderLayer::Reflected)].push_back(reflectedRitem.get());
 		allRitems.push_back(std::move(reflectedRitem));
@@ -1301,6 +1328,8 @@ void StencilApp::BuildRenderItems()
 	mirrorRitem->StartIndexLocation = mirrorRitem->Geo->DrawArgs["mirror"].StartIndexLocation;
 	mirrorRitem->BaseVertexLocation = mirrorRitem->Geo->DrawArgs["mirror"].BaseVertexLocation;
 
+	AddTransform(mirrorRitem.get());
+
 	RitemLayer[static_cast<int>(RenderLayer::Mirrors)].push_back(mirrorRitem.get());
 	RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)].push_back(mirrorRitem.get());
 	allRitems.push_back(std::move(mirrorRitem));
@@ -1316,10 +1345,41 @@ void StencilApp::BuildRenderItems()
 	wallRitem->StartIndexLocation = wallRitem->Geo->DrawArgs["wall"].StartIndexLocation;
 	wallRitem->BaseVertexLocation = wallRitem->Geo->DrawArgs["wall"].BaseVertexLocation;
 
+	AddTransform(wallRitem.get());
+
 	RitemLayer[static_cast<int>(RenderLayer::Clear)].push_back(wallRitem.get());
 	allRitems.push_back(std::move(wallRitem));
 }
 
+void StencilApp::AddTransform(RenderItem* ritem)
+{
+	XMVECTOR S;
+	XMVECTOR Q;
+	XMVECTOR T;
+	XMMatrixDecompose(&S, &Q, &T, XMLoadFloat4x4(&ritem->World));
+
+	XMFLOAT3 scale;
+	XMFLOAT4 rotation;
+	XMFLOAT3 translation;
+	XMStoreFloat3(&scale, S);
+	XMStoreFloat4(&rotation, Q);
+	XMStoreFloat3(&translation, T);
+
+	ritem->Transform = transforms.AddNode(TransformHierarchy::InvalidNode, scale, rotation, translation);
+	ritemOfTransform.resize(transforms.GetNodeCount());
+	ritemOfTransform[ritem->Transform] = ritem;
+}
+
+void StencilApp::AddWorldSpaceTransform(RenderItem* ritem, const RenderItem* source, FXMMATRIX worldTransform)
+{
+	XMFLOAT4X4 transform;
+	XMStoreFloat4x4(&transform, worldTransform);
+
+	ritem->Transform = transforms.AddWorldSpaceNode(source->Transform, transform);
+	ritemOfTransform.resize(transforms.GetNodeCount());
+	ritemOfTransform[ritem->Transform] = ritem;
+}
+
 void StencilApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
 	UINT objCBByteSize = DxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
@@ -1337,6 +1397,11 @@ void StencilApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::
 		auto indexBufferView = ri->Geo->IndexBufferView();
 
 		cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+		if (ri->Geo->StaticVertexBufferGPU != nullptr)
+		{
+			auto staticVertexBufferView = ri->Geo->StaticVertexBufferView();
+			cmdList->IASetVertexBuffers(1, 1, &staticVertexBufferView);
+		}
 		cmdList->IASetIndexBuffer(&indexBufferView);
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
@@ -5,6 +5,7 @@
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
 #include "../Common/DDSTextureLoader.h"
+#include "../Common/TransformHierarchy.h"
 
 #include "FrameResource.h"
 #include "Waves.h"
@@ -28,6 +29,9 @@ struct RenderItem
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
+	// Node whose world matrix World is copied from when it changes.
+	TransformHierarchy::Node Transform = TransformHierarchy::InvalidNode;
+
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify obect data we should set 
@@ -49,13 +53,6 @@ struct RenderItem
 	int BaseVertexLocation = 0;
 };
 
-struct ReflectedRenderItem : RenderItem
-{
-	ReflectedRenderItem() = default;
-
-	RenderItem* OriginalRenderItem = nullptr;
-};
-
 enum class RenderLayer : int
 {
 	OpaqueFrustumCull = 0,
@@ -64,6 +61,7 @@ enum class RenderLayer : int
 	Reflected = Mirrors + 1,
 	Shadow = Reflected + 1,
 	Clear = Shadow + 1,
+	Waves = Clear + 1,
 	Count
 };
 
@@ -85,7 +83,7 @@ private:
 	void OnMouseLeftDown(int x, int y, short keyState)override;
 	void OnMouseLeftUp(int x, int y, short keyState)override;
 	void OnMouseMove(int x, int y, short keyState)override;
-	void UpdateReflectedItem(const GameTimer& gt);
+	void UpdateTransforms();
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
@@ -113,6 +111,8 @@ private:
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
+	void AddTransform(RenderItem* ritem);
+	void AddWorldSpaceTransform(RenderItem* ritem, const RenderItem* source, FXMMATRIX worldTransform);
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 
 	float GetHillsHeight(float x, float z)const;
@@ -136,6 +136,7 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> PSOs;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> wavesInputLayout;
 
 	RenderItem* wavesRitem = nullptr;
 
@@ -145,6 +146,11 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> RitemLayer[(int)RenderLayer::Count];
 
+	// Reflected items are world-space nodes of the item they copy, so they
+	// follow it when it moves.
+	TransformHierarchy transforms;
+	std::vector<RenderItem*> ritemOfTransform;
+
 	std::unique_ptr<Waves> waves;
 
 	PassConstants mainPassCB;
@@ -48,6 +48,14 @@ struct Vertex
     DirectX::XMFLOAT2 TexC;
 };
 
+// The part of a wave vertex that changes every step.  The texture coordinates
+// never change, so they live in a static second stream.
+struct WaveVertex
+{
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT3 Normal;
+};
+
 struct TreeVertex
 {
     DirectX::XMFLOAT3 Pos;
@@ -60,7 +68,8 @@ struct FrameResource
 {
 public:
 
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount,
+        UINT treeSpriteCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -78,7 +87,14 @@ public:
 
     // We cannot update a dynamic vertex buffer until the GPU is done processing
     // the commands that reference it.  So each frame needs their own.
-    std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+    std::unique_ptr<UploadBuffer<WaveVertex>> WavesVB = nullptr;
+
+    // Waves::StepCount when WavesVB was last written, -1 before the first write.
+    long long WavesStep = -1;
+
+    // Tree sprite indices, back to front, and the version of the order they hold.
+    std::unique_ptr<UploadBuffer<std::uint32_t>> TreeIB = nullptr;
+    long long TreeOrderVersion = -1;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
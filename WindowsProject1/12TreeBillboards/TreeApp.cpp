@@ -121,6 +121,9 @@ void TreeApp::Update(const GameTimer& gt)
 	UpdateMainPassCB(gt);
 	AnimateMaterials(gt);
 	UpdateWaves(gt);
+	UpdateTreeSprites(gt);
+	SortBackToFront(RenderLayer::Waves);
+	SortBackToFront(RenderLayer::OpaqueNonFrustumCull);
 }
 
 void TreeApp::Draw(const GameTimer& gt)
@@ -176,8 +179,11 @@ void TreeApp::Draw(const GameTimer& gt)
 	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::Tree)]);
 
 
+	commandList->SetPipelineState(PSOs["waves"].Get());
+	DrawRenderItems(commandList.Get(), sortedRitemLayer[static_cast<int>(RenderLayer::Waves)]);
+
 	commandList->SetPipelineState(PSOs["transparent"].Get());
-	DrawRenderItems(commandList.Get(), RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)]);
+	DrawRenderItems(commandList.Get(), sortedRitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)]);
 
 	auto barrierDraw = CD3DX12_RESOURCE_BARRIER::Transition(
 		currentBackBuffer,
@@ -399,25 +405,70 @@ void TreeApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	waves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the new solution.  Each frame resource has
+	// its own buffer, so it needs the rows changed by every step since it was last
+	// written; Waves writes them straight into the mapped buffer.
 	auto currWavesVB = currFrameResource->WavesVB.get();
-	for (int i = 0; i < waves->VertexCount(); ++i)
+	int firstRow = 0;
+	int rowCount = 0;
+	if (waves->ChangedRows(currFrameResource->WavesStep, firstRow, rowCount))
+		waves->StreamVertices(currWavesVB->GetMappedData(firstRow * waves->ColumnCount()), firstRow, rowCount);
+	currFrameResource->WavesStep = waves->StepCount();
+
+	// Set the dynamic VB of the wave renderitem to the current frame VB.
+	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+}
+
+void TreeApp::UpdateTreeSprites(const GameTimer& gt)
+{
+	// The sprites are in world space, so their view depth is the z row of the
+	// view matrix applied to their position.
+	const XMFLOAT4X4& v = view;
+	treeDepths.resize(treePositions.size());
+	for (size_t i = 0; i < treePositions.size(); ++i)
 	{
-		Vertex v;
+		const XMFLOAT3& p = treePositions[i];
+		treeDepths[i] = p.x * v._13 + p.y * v._23 + p.z * v._33 + v._43;
+	}
 
-		v.Pos = waves->Position(i);
-		v.Normal = waves->Normal(i);
+	treeSorter.SortBackToFront(treeDepths.data(), static_cast<uint32_t>(treeDepths.size()));
+	if (treeSorter.GetLastPath() != DepthSorter::SortPath::AlreadySorted)
+		++treeOrderVersion;
 
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / waves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / waves->Depth();
+	// Like the waves, each frame resource has its own index buffer, rewritten
+	// only when the order has changed since it was last written.
+	auto currTreeIB = currFrameResource->TreeIB.get();
+	if (currFrameResource->TreeOrderVersion != treeOrderVersion)
+	{
+		const auto& order = treeSorter.GetOrder();
+		memcpy(currTreeIB->GetMappedData(0), order.data(), order.size() * sizeof(std::uint32_t));
+		currFrameResource->TreeOrderVersion = treeOrderVersion;
+	}
 
-		currWavesVB->CopyData(i, v);
+	treeRitem->Geo->IndexBufferGPU = currTreeIB->Resource();
+}
+
+void TreeApp::SortBackToFront(RenderLayer layer)
+{
+	const auto& ritems = RitemLayer[static_cast<int>(layer)];
+	const XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+
+	// Depth of an item's origin is close enough to order whole items.
+	layerDepths.resize(ritems.size());
+	for (size_t i = 0; i < ritems.size(); ++i)
+	{
+		const XMFLOAT4X4& world = ritems[i]->World;
+		const XMVECTOR origin = XMVectorSet(world._41, world._42, world._43, 1.0f);
+		layerDepths[i] = XMVectorGetZ(XMVector3TransformCoord(origin, viewMatrix));
 	}
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	wavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	auto& sorter = layerSorters[static_cast<int>(layer)];
+	sorter.SortBackToFront(layerDepths.data(), static_cast<uint32_t>(ritems.size()));
+
+	auto& sorted = sortedRitemLayer[static_cast<int>(layer)];
+	sorted.resize(ritems.size());
+	for (size_t i = 0; i < ritems.size(); ++i)
+		sorted[i] = ritems[sorter.GetOrder()[i]];
 }
 
 void TreeApp::LoadTexture(std::wstring filePath, std::string textureName)
@@ -644,6 +695,15 @@ void TreeApp::BuildShadersAndInputLayout()
 		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{"SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	// The waves stream positions and normals every frame; their texture
+	// coordinates never change and come from a second, static stream.
+	wavesInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
 void TreeApp::BuildLandGeometry()
@@ -768,39 +828,36 @@ void TreeApp::BuildTree()
 		);
 
 	std::vector<TreeVertex> vertices(points.Vertices.size());
-	auto indices = points.GetIndices16();
+	treePositions.resize(points.Vertices.size());
 
 	for (int i = 0; i < vertices.size(); ++i)
 	{
 		vertices[i].Pos = points.Vertices[i].Position;
 		vertices[i].Size = DirectX::XMFLOAT2 { 10.0f, 30.0f };
+		treePositions[i] = points.Vertices[i].Position;
 	}
 
 	auto treeGeometry = std::make_unique<MeshGeometry>();
 	auto vbByteSize = sizeof(TreeVertex) * vertices.size();
-	auto ibByteSize = sizeof(std::uint16_t) * indices.size();
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &treeGeometry->VertexBufferCPU));
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &treeGeometry->IndexBufferCPU));
-
 	CopyMemory(treeGeometry->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-	CopyMemory(treeGeometry->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
 	auto commandList = device->GetCommandList();
 
 	treeGeometry->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
 		commandList.Get(), vertices.data(), vbByteSize, treeGeometry->VertexBufferUploader);
 
-	treeGeometry->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		commandList.Get(), indices.data(), ibByteSize, treeGeometry->IndexBufferUploader);
-
+	// The index buffer holds the sprites in back to front order and is set each
+	// frame from the current frame resource.  32-bit indices leave room for more
+	// sprites than 16-bit ones would.
 	treeGeometry->VertexByteStride = sizeof(TreeVertex);
 	treeGeometry->VertexBufferByteSize = vbByteSize;
-	treeGeometry->IndexFormat = DXGI_FORMAT_R16_UINT;
-	treeGeometry->IndexBufferByteSize = ibByteSize;
+	treeGeometry->IndexFormat = DXGI_FORMAT_R32_UINT;
+	treeGeometry->IndexBufferByteSize = static_cast<UINT>(sizeof(std::uint32_t) * vertices.size());
 
 	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
+	submesh.IndexCount = (UINT)vertices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
@@ -834,7 +891,18 @@ void TreeApp::BuildWavesGeometryBuffers()
 		}
 	}
 
-	UINT vbByteSize = waves->VertexCount() * sizeof(Vertex);
+	// Derive tex-coords from position by mapping [-w/2,w/2] --> [0,1].  The grid
+	// never moves in x and z, so they are built once into the static stream.
+	std::vector<XMFLOAT2> texCoords(waves->VertexCount());
+	for (int i = 0; i < waves->VertexCount(); ++i)
+	{
+		XMFLOAT3 p = waves->Position(i);
+		texCoords[i].x = 0.5f + p.x / waves->Width();
+		texCoords[i].y = 0.5f - p.z / waves->Depth();
+	}
+
+	UINT vbByteSize = waves->VertexCount() * sizeof(WaveVertex);
+	UINT staticVbByteSize = waves->VertexCount() * sizeof(XMFLOAT2);
 	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
@@ -852,8 +920,13 @@ void TreeApp::BuildWavesGeometryBuffers()
 	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
 		commandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->StaticVertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
+		commandList.Get(), texCoords.data(), staticVbByteSize, geo->StaticVertexBufferUploader);
+
+	geo->VertexByteStride = sizeof(WaveVertex);
 	geo->VertexBufferByteSize = vbByteSize;
+	geo->StaticVertexByteStride = sizeof(XMFLOAT2);
+	geo->StaticVertexBufferByteSize = staticVbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
@@ -922,6 +995,17 @@ void TreeApp::BuildPSOs()
 		)
 	);
 
+	//
+	// PSO for the waves: transparent, with the texture coordinates in a second stream.
+	//
+	auto wavesPsoDesc = transparentPsoDesc;
+	wavesPsoDesc.InputLayout = { wavesInputLayout.data(), (UINT)wavesInputLayout.size() };
+	ThrowIfFailed(
+		device->GetD3DDevice()->CreateGraphicsPipelineState(
+			&wavesPsoDesc, IID_PPV_ARGS(&PSOs["waves"])
+		)
+	);
+
 	auto treePsoDesc = opaquePsoDesc;
 
 	treePsoDesc.InputLayout = 
@@ -960,7 +1044,8 @@ void TreeApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		frameResources.push_back(std::make_unique<FrameResource>(device->GetD3DDevice().Get(),
-			1, static_cast<UINT>(allRitems.size()), static_cast<UINT>(materials.size()), waves->VertexCount()));
+			1, static_cast<UINT>(allRitems.size()), static_cast<UINT>(materials.size()), waves->VertexCount(),
+			static_cast<UINT>(treePositions.size())));
 	}
 }
 
@@ -1048,6 +1133,7 @@ void TreeApp::BuildRenderItems()
 	allRitems.push_back(std::move(crateRitem));
 	
 	auto treeRitem = std::make_unique<RenderItem>();
+	this->treeRitem = treeRitem.get();
 	treeRitem->World = MathHelper::Identity4x4();
 	treeRitem->ObjCBIndex = 3;
 	treeRitem->Mat = materials["tree"].get();
@@ -1073,7 +1159,7 @@ void TreeApp::BuildRenderItems()
 
 	this->wavesRitem = wavesRitem.get();
 
-	RitemLayer[(int)RenderLayer::OpaqueNonFrustumCull].push_back(wavesRitem.get());
+	RitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
 
 	allRitems.push_back(std::move(wavesRitem));
 }
@@ -1095,6 +1181,11 @@ void TreeApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vec
 		auto indexBufferView = ri->Geo->IndexBufferView();
 
 		cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+		if (ri->Geo->StaticVertexBufferGPU != nullptr)
+		{
+			auto staticVertexBufferView = ri->Geo->StaticVertexBufferView();
+			cmdList->IASetVertexBuffers(1, 1, &staticVertexBufferView);
+		}
 		cmdList->IASetIndexBuffer(&indexBufferView);
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
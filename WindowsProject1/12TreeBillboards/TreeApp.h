@@ -6,6 +6,7 @@
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
 #include "../Common/DDSTextureLoader.h"
+#include "../Common/DepthSorter.h"
 
 #include "FrameResource.h"
 #include "Waves.h"
@@ -55,6 +56,7 @@ enum class RenderLayer : int
 	OpaqueFrustumCull = 0,
 	OpaqueNonFrustumCull = OpaqueFrustumCull + 1,
 	Tree = OpaqueNonFrustumCull + 1,
+	Waves = Tree + 1,
 	Count
 };
 
@@ -84,6 +86,8 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateTreeSprites(const GameTimer& gt);
+	void SortBackToFront(RenderLayer layer);
 	void LoadTexture(std::wstring filePath, std::string textureName);
 	void LoadTextureArray(std::wstring filePath, std::string textureName);
 
@@ -126,8 +130,17 @@ private:
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> defaultInputLayout;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> treeInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> wavesInputLayout;
 
 	RenderItem* wavesRitem = nullptr;
+	RenderItem* treeRitem = nullptr;
+
+	// Tree sprites are drawn back to front through a per-frame index buffer.
+	// The order changes whenever treeOrderVersion does.
+	std::vector<XMFLOAT3> treePositions;
+	std::vector<float> treeDepths;
+	DepthSorter treeSorter;
+	long long treeOrderVersion = 0;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> allRitems;
@@ -135,6 +148,11 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> RitemLayer[(int)RenderLayer::Count];
 
+	// Blended layers, back to front for this frame.
+	std::vector<RenderItem*> sortedRitemLayer[(int)RenderLayer::Count];
+	DepthSorter layerSorters[(int)RenderLayer::Count];
+	std::vector<float> layerDepths;
+
 	std::unique_ptr<Waves> waves;
 
 	PassConstants mainPassCB;
@@ -56,6 +56,7 @@ enum class RenderLayer : int
 	OpaqueFrustumCull = 0,
 	OpaqueNonFrustumCull = OpaqueFrustumCull + 1,
 	Tree = OpaqueNonFrustumCull + 1,
+	Waves = Tree + 1,
 	Count
 };
 
@@ -132,6 +133,7 @@ private:
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> defaultInputLayout;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> treeInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> wavesInputLayout;
 
 	RenderItem* wavesRitem = nullptr;
 
@@ -9,11 +9,23 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
 #include <DirectXMath.h>
 
 class Waves
 {
 public:
+    // Selects the kernels used to step the height field and rebuild the normals and
+    // tangents.  Auto picks the widest instruction set the CPU supports; the explicit
+    // paths exist so the SIMD kernels can be validated against the scalar one.
+    enum class SolverPath
+    {
+        Auto,
+        Scalar,
+        Sse,
+        Avx2
+    };
+
     Waves(int m, int n, float dx, float dt, float speed, float damping);
     Waves(const Waves& rhs) = delete;
     Waves& operator=(const Waves& rhs) = delete;
@@ -27,18 +39,161 @@ public:
     float Depth()const;
 
     // Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+    DirectX::XMFLOAT3 Position(int i)const;
 
     // Returns the solution normal at the ith grid point.
-    const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+    DirectX::XMFLOAT3 Normal(int i)const;
 
     // Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-    const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+    DirectX::XMFLOAT3 TangentX(int i)const;
+
+    // The solution is stored as separate float planes in row-major order.  The x and z
+    // coordinates never change, so only the heights are kept; the tangent always lies in
+    // the xy-plane, so it has no z plane.
+    const float* Heights()const { return mCurrHeights.data(); }
+    const float* NormalsX()const { return mNormalX.data(); }
+    const float* NormalsY()const { return mNormalY.data(); }
+    const float* NormalsZ()const { return mNormalZ.data(); }
+    const float* TangentsX()const { return mTangentX.data(); }
+    const float* TangentsY()const { return mTangentY.data(); }
+
+    // Expands rows [firstRow, firstRow + rowCount) of the render output into interleaved
+    // vertices of vertexStride bytes.  The position is written at byte offset 0, the
+    // normal and tangent at the given offsets; pass -1 to skip an attribute.
+    void WriteVertices(void* dst, std::size_t vertexStride, int normalOffset, int tangentOffset,
+        int firstRow, int rowCount)const;
+
+    // Writes rows [firstRow, firstRow + rowCount) as 24-byte vertices, the position
+    // followed by the normal, with non-temporal stores.  Meant for mapped upload
+    // heap memory, which is write-combined: it is only written, front to back.
+    void StreamVertices(void* dst, int firstRow, int rowCount)const;
+
+    void SetSolverPath(SolverPath path);
+    SolverPath GetSolverPath()const;
+
+    // Update runs at most this many steps.  Time beyond that is dropped, so a long
+    // frame costs a bounded amount of simulation instead of stalling the next ones.
+    void SetMaxSubsteps(int steps);
+    int MaxSubsteps()const;
+
+    // With interpolation on, WriteVertices and StreamVertices blend the heights of
+    // the last two solutions by InterpolationAlpha, so the surface moves smoothly
+    // when the frame rate and the time step do not line up.  It renders up to one
+    // step behind the simulation.  Normals are those of the latest solution.
+    // Buffers written before a change of the setting should be rewritten in full.
+    void SetInterpolation(bool bInterpolate);
+    bool IsInterpolating()const;
+
+    // Fraction of a time step accumulated towards the next step, in [0, 1).
+    float InterpolationAlpha()const;
+
+    // The interior of the grid is split into tiles of TileRowCount x TileColumnCount
+    // cells.  A tile is stepped and has its normals rebuilt in one sweep, so it should
+    // be small enough to stay in L2.  Changing the tile size wakes every tile.
+    void SetTileRowCount(int rows);
+    int TileRowCount()const;
+    void SetTileColumnCount(int columns);
+    int TileColumnCount()const;
+
+    // A tile whose heights and per-step height changes have all stayed below the
+    // sleep threshold for a few steps is flattened and put to sleep.  Disturb wakes
+    // the tiles it touches, and an awake tile wakes the neighbor across any edge
+    // that is above the threshold.  Only awake tiles are stepped, so the cost of an
+    // update follows the disturbed area rather than the size of the grid.
+    void SetSleepThreshold(float threshold);
+    float SleepThreshold()const;
+
+    // Cells [FirstRow, RowEnd) x [FirstColumn, ColumnEnd) of the grid.
+    struct TileRect
+    {
+        int FirstRow = 0;
+        int RowEnd = 0;
+        int FirstColumn = 0;
+        int ColumnEnd = 0;
+    };
+
+    int TileCount()const;
+    TileRect TileBounds(int tile)const;
+    bool IsTileAwake(int tile)const;
+    int AwakeTileCount()const;
+
+    // Tiles whose heights or normals the last step changed: the tiles that were
+    // stepped or flattened, and their edge neighbors, whose border normals see the
+    // new heights.
+    // Disturbed tiles show up with the next step, which is when their normals are
+    // rebuilt.  Cells outside these tiles are the same as before the step.  An
+    // Update that takes several steps only leaves the tiles of the last one here;
+    // TileChangeStep covers all of them.
+    const std::vector<int>& ChangedTiles()const;
+
+    // Number of simulation steps taken, and the step that last changed a tile (0 if
+    // none has).  A consumer that keeps several copies of the surface, such as one
+    // vertex buffer per frame resource, can remember the StepCount it last wrote
+    // each copy at and rewrite only the tiles changed since.
+    long long StepCount()const;
+    long long TileChangeStep(int tile)const;
+
+    // Smallest range of rows holding every cell changed by the steps after
+    // sinceStep; a negative sinceStep asks for the whole grid.  With interpolation
+    // on, the rows whose last two solutions differ are rewritten every time, since
+    // the blend moves them.  Returns false if nothing has changed since.
+    bool ChangedRows(long long sinceStep, int& firstRow, int& rowCount)const;
 
-    void Update(float dt);
+    // Throughput of the simulation steps taken since construction or the last
+    // ResetStats, in interior grid cells per second.
+    double CellsPerSecond()const;
+
+    // Simulated time dropped because an Update needed more than MaxSubsteps steps.
+    float DroppedTime()const;
+    void ResetStats();
+
+    // Adds dt to the time accumulated by this grid and takes one step per whole time
+    // step in it, up to MaxSubsteps.  Returns the number of steps taken.
+    int Update(float dt);
     void Disturb(int i, int j, float magnitude);
 
+    // Updates independent grids side by side on the job system.  Each grid keeps
+    // its own clock, so the result is the same as updating them one after another.
+    static void UpdateAll(Waves* const* waves, int count, float dt);
+
 private:
+    struct TileState
+    {
+        bool bAwake = false;
+        bool bStepped = false;
+
+        // Set when the tile falls asleep; it is flattened at the start of the next
+        // step unless something wakes it first.
+        bool bFlatten = false;
+
+        int QuietSteps = 0;
+        long long ChangeStep = 0;
+
+        // Written while the tile is stepped: the largest |height| or |height change|
+        // over the whole tile and along its north, south, west and east edges.
+        float Activity = 0.0f;
+        float EdgeActivity[4] = {};
+    };
+
+    // Awake tiles [FirstTile, TileEnd) of one row of tiles.
+    struct TileSpan
+    {
+        int FirstTile;
+        int TileEnd;
+    };
+
+    void Step();
+
+    TileRect SpanBounds(const TileSpan& span)const;
+
+    void BuildTiles(bool bAwake);
+    void WakeTile(int tile);
+    void WakeTileAt(int i, int j);
+    // North, south, west and east neighbors, -1 past the edge of the grid.
+    void GetTileNeighbors(int tile, int neighbors[4])const;
+    void MarkTileChanged(int tile, bool bWithNeighbors);
+    void FlattenTile(int tile);
+
     int mNumRows = 0;
     int mNumCols = 0;
 
@@ -53,8 +208,34 @@ private:
     float mTimeStep = 0.0f;
     float mSpatialStep = 0.0f;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
-    std::vector<DirectX::XMFLOAT3> mNormals;
-    std::vector<DirectX::XMFLOAT3> mTangentX;
-};
\ No newline at end of file
+    SolverPath mSolverPath = SolverPath::Scalar;
+    int mTileRowCount = 32;
+    int mTileColumnCount = 32;
+    float mSleepThreshold = 0.001f;
+
+    // Time accumulated towards the next step.
+    float mAccumulatedTime = 0.0f;
+    int mMaxSubsteps = 4;
+    bool mIsInterpolating = false;
+
+    double mStepSeconds = 0.0;
+    long long mSteppedCells = 0;
+    float mDroppedTime = 0.0f;
+
+    std::vector<float> mPrevHeights;
+    std::vector<float> mCurrHeights;
+    std::vector<float> mNormalX;
+    std::vector<float> mNormalY;
+    std::vector<float> mNormalZ;
+    std::vector<float> mTangentX;
+    std::vector<float> mTangentY;
+
+    // Tiles in row-major order, mTilesAcross to a row of tiles.
+    int mTilesDown = 0;
+    int mTilesAcross = 0;
+    long long mStepCount = 0;
+    std::vector<TileState> mTiles;
+    std::vector<TileSpan> mAwakeSpans;
+    std::vector<int> mBorderTiles;
+    std::vector<int> mChangedTiles;
+};
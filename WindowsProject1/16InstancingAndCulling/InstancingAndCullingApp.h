@@ -4,6 +4,7 @@
 #include "../Common/MathHelper.h"
 #include "../Common/DxUtil.h"
 #include "../Common/Camera.h"
+#include "../Common/MeshFile.h"
 #include "FrameResource.h"
 
 extern const int gNumFrameResources;
@@ -80,6 +81,7 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildMaterials();
 	void BuildSkullGeometry();
+	bool ConvertSkullGeometry(const std::wstring& meshFilename);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildRenderItems();
@@ -41,6 +41,8 @@ bool PickingApp::Initialize()
     BuildMaterials();
     BuildSkullGeometry();
     BuildRenderItems();
+    BuildPickingBvh();
+    BuildCullingIndex();
     BuildFrameResources();
     BuildPSOs();
 
@@ -65,8 +67,6 @@ void PickingApp::OnResize()
         1.0f,
         1000.0f
     );
-
-    BoundingFrustum::CreateFromMatrix(camFrustum, camera.GetProj());
 }
 
 void PickingApp::Update(const GameTimer& gt)
@@ -241,71 +241,30 @@ void PickingApp::Pick(int sx, int sy)
     XMVECTOR viewDeterminant = XMMatrixDeterminant(view);
     XMMATRIX invView = XMMatrixInverse(&viewDeterminant, view);
 
-    float tmin = MathHelper::Infinity;
-
-    for(auto ri : RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)])
-    {
-        auto geo = ri->Geo;
-
-        if (!ri->Visible)
-            continue;
-
-        for(auto instance : ri->Instances)
-        {
-            XMMATRIX world = XMLoadFloat4x4(&instance.World);
-            XMVECTOR worldDeterminant = XMMatrixDeterminant(world);
-            XMMATRIX invWorld = XMMatrixInverse(&worldDeterminant, world);
-
-            XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
-
-            XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-            XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
-
-            rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-            rayDir = XMVector3TransformNormal(rayDir, toLocal);
-            rayDir = XMVector3Normalize(rayDir);
+    // Cast the ray in world space.  The instance hierarchy moves it into each
+    // candidate's local space itself.
+    XMVECTOR rayOrigin = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView);
+    XMVECTOR rayDir = XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView);
+    rayDir = XMVector3Normalize(rayDir);
 
-            float tminLocal = 0.0f;
-
-            if (!ri->Bounds.Intersects(rayOrigin, rayDir, tminLocal))
-                continue;
-
-            auto vertices = static_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
-            auto indices = static_cast<std::uint32_t*> (geo->IndexBufferCPU->GetBufferPointer());
-            UINT triCount = ri->IndexCount / 3;
-
-            for (UINT i = 0; i < triCount; ++i)
-            {
-                UINT i0 = indices[i * 3 + 0];
-                UINT i1 = indices[i * 3 + 1];
-                UINT i2 = indices[i * 3 + 2];
-
-                XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-                XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-                XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-                float t = 0.0f;
-                if (!TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-                    continue;
+    BvhHit hit;
+    if (!pickingBvh.Intersect(rayOrigin, rayDir, hit))
+        return;
 
-                if (t >= tmin)
-                    continue;
+    const PickableInstance& pickable = pickableInstances[hit.InstanceIndex];
+    const RenderItem* ri = pickable.Ritem;
+    const InstanceData& instance = ri->Instances[pickable.InstanceIndex];
 
-                tmin = t;
-                UINT pickedTriangle = i;
-                pickedRitem->Visible = true;
-                pickedRitem->IndexCount = 3;
-                pickedRitem->BaseVertexLocation = 0;
-                pickedRitem->StartIndexLocation = 3 * pickedTriangle;
-                
-                pickedRitem->Instances[0].World = instance.World;
+    pickedRitem->Visible = true;
+    pickedRitem->Geo = ri->Geo;
+    pickedRitem->IndexCount = 3;
+    pickedRitem->BaseVertexLocation = ri->BaseVertexLocation;
+    pickedRitem->StartIndexLocation = ri->StartIndexLocation + 3 * hit.TriangleIndex;
 
-                pickedRitem->Instances[0].TexTransform = instance.TexTransform;
-                pickedRitem->Instances[0].MaterialIndex = instance.MaterialIndex;
+    pickedRitem->Instances[0].World = instance.World;
 
-            }
-        }        
-    }
+    pickedRitem->Instances[0].TexTransform = instance.TexTransform;
+    pickedRitem->Instances[0].MaterialIndex = instance.MaterialIndex;
 }
 
 void PickingApp::UpdateCamera(const GameTimer& gt)
@@ -330,13 +289,31 @@ void PickingApp::UpdateCamera(const GameTimer& gt)
 
 void PickingApp::UpdateInstanceBuffer(const GameTimer& gt)
 {
-    XMMATRIX view = camera.GetView();
-    auto viewDeterminant = XMMatrixDeterminant(view);
-    XMMATRIX invView = XMMatrixInverse(&viewDeterminant, view);
+    // One walk of the culling index in world space instead of transforming the
+    // frustum into the local space of every instance.  Sorted, the visible
+    // handles of each item are one run.
+    cullingIndex.Update();
+
+    visibleHandles.clear();
+    cullingIndex.QueryFrustum(
+        SpatialIndex::Frustum::FromViewProj(XMMatrixMultiply(camera.GetView(), camera.GetProj())),
+        visibleHandles);
+    std::sort(visibleHandles.begin(), visibleHandles.end());
 
     int visibleInstanceCount = 0;
 
 	auto currInstanceBuffer = currFrameResource->InstanceBuffer.get();
+    auto writeInstance = [&](const InstanceData& instance)
+    {
+        InstanceData data;
+        XMStoreFloat4x4(&data.World, XMMatrixTranspose(XMLoadFloat4x4(&instance.World)));
+        XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&instance.TexTransform)));
+        data.MaterialIndex = instance.MaterialIndex;
+
+        // Write the instance data to structured buffer for the visible objects.
+        currInstanceBuffer->CopyData(visibleInstanceCount++, data);
+    };
+
     for (auto& e : allRitems)
     {
         if (!e->Visible)
@@ -344,33 +321,19 @@ void PickingApp::UpdateInstanceBuffer(const GameTimer& gt)
 
         const auto& instanceData = e->Instances;
 
-
-        for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+        if (e->FirstCullingHandle == SpatialIndex::InvalidHandle)
         {
-            XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-            XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
-
-            auto worldDeterminant = XMMatrixDeterminant(world);
-            XMMATRIX invWorld = XMMatrixInverse(&worldDeterminant, world);
-
-            // View space to the object's local space.
-            XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
-
-            // Transform the camera frustum from view space to the object's local space.
-            BoundingFrustum localSpaceFrustum;
-            camFrustum.Transform(localSpaceFrustum, viewToLocal);
-
-            // Perform the box/frustum intersection test in local space.
-            if (localSpaceFrustum.Contains(e->Bounds) != DirectX::DISJOINT)
-            {
-                InstanceData data;
-                XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-                XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-                data.MaterialIndex = instanceData[i].MaterialIndex;
+            for (const InstanceData& instance : instanceData)
+                writeInstance(instance);
+        }
+        else
+        {
+            const SpatialIndex::Handle first = e->FirstCullingHandle;
+            auto begin = std::lower_bound(visibleHandles.begin(), visibleHandles.end(), first);
+            auto end = std::lower_bound(begin, visibleHandles.end(), first + (UINT)instanceData.size());
 
-                // Write the instance data to structured buffer for the visible objects.
-                currInstanceBuffer->CopyData(visibleInstanceCount++, data);
-            }
+            for (auto handle = begin; handle != end; ++handle)
+                writeInstance(instanceData[*handle - first]);
         }
         e->InstanceCount = visibleInstanceCount;
     }
@@ -628,13 +591,39 @@ void PickingApp::BuildMaterials()
 }
 
 void PickingApp::BuildSkullGeometry()
+{
+    // The text model is only parsed when the binary cache is missing or older
+    // than it; every other run maps the cache and uploads it as is.
+    const std::wstring meshFilename = L"Models/skull.sphereuv.mesh";
+
+    MeshFile meshFile;
+    if (!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+    {
+        if (!ConvertSkullGeometry(meshFilename) ||
+            !meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+        {
+            return;
+        }
+    }
+
+    auto geo = meshFile.CreateGeometry("skullGeo",
+        device->GetD3DDevice().Get(), device->GetCommandList().Get());
+
+    auto skullBvh = std::make_unique<TriangleBvh>();
+    skullBvh->Build(*geo, geo->DrawArgs["skull"]);
+    meshBvhs["skull"] = std::move(skullBvh);
+
+    geometries[geo->Name] = std::move(geo);
+}
+
+bool PickingApp::ConvertSkullGeometry(const std::wstring& meshFilename)
 {
     std::ifstream fin("Models/skull.txt");
 
     if (!fin)
     {
         MessageBox(0, L"Models/skull.txt not found.", 0, 0);
-        return;
+        return false;
     }
 
     UINT vcount = 0;
@@ -696,43 +685,23 @@ void PickingApp::BuildSkullGeometry()
 
     fin.close();
 
-    //
-    // Pack the indices of all the meshes into one index buffer.
-    //
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-
-    auto geo = std::make_unique<MeshGeometry>();
-    geo->Name = "skullGeo";
-
-    ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-    ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-    geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-        device->GetCommandList().Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-        device->GetCommandList().Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-    geo->VertexByteStride = sizeof(Vertex);
-    geo->VertexBufferByteSize = vbByteSize;
-    geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-    geo->IndexBufferByteSize = ibByteSize;
-
-    SubmeshGeometry submesh;
+    MeshFileSubmesh submesh;
+    submesh.SetName("skull");
     submesh.IndexCount = (UINT)indices.size();
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
     submesh.Bounds = bounds;
 
-    geo->DrawArgs["skull"] = submesh;
+    if (!MeshFile::Write(meshFilename, L"Models/skull.txt",
+        vertices.data(), sizeof(Vertex), (UINT)vertices.size(),
+        indices.data(), DXGI_FORMAT_R32_UINT, (UINT)indices.size(),
+        { submesh }))
+    {
+        MessageBox(0, (L"Could not write " + meshFilename).c_str(), 0, 0);
+        return false;
+    }
 
-    geometries[geo->Name] = std::move(geo);
+    return true;
 }
 
 void PickingApp::BuildPSOs()
@@ -832,6 +801,7 @@ void PickingApp::BuildRenderItems()
     skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
     skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
     skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
+    skullRitem->MeshBvh = meshBvhs["skull"].get();
 
     // Generate instance data.
     const int n = 5;
@@ -895,6 +865,48 @@ void PickingApp::BuildRenderItems()
     allRitems.push_back(std::move(picked));
 }
 
+void PickingApp::BuildPickingBvh()
+{
+    std::vector<InstanceBvh::Instance> instances;
+    pickableInstances.clear();
+
+    for (auto ri : RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)])
+    {
+        if (!ri->Visible || ri->MeshBvh == nullptr)
+            continue;
+
+        for (UINT i = 0; i < (UINT)ri->Instances.size(); ++i)
+        {
+            InstanceBvh::Instance instance;
+            instance.Mesh = ri->MeshBvh;
+            instance.World = ri->Instances[i].World;
+            instances.push_back(instance);
+
+            pickableInstances.push_back(PickableInstance{ ri, i });
+        }
+    }
+
+    pickingBvh.Build(instances);
+}
+
+void PickingApp::BuildCullingIndex()
+{
+    for (auto ri : RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)])
+    {
+        for (UINT i = 0; i < (UINT)ri->Instances.size(); ++i)
+        {
+            BoundingBox worldBounds;
+            ri->Bounds.Transform(worldBounds, XMLoadFloat4x4(&ri->Instances[i].World));
+
+            const SpatialIndex::Handle handle = cullingIndex.Insert(worldBounds);
+            if (i == 0)
+                ri->FirstCullingHandle = handle;
+        }
+    }
+
+    cullingIndex.Rebuild();
+}
+
 void PickingApp::DrawRenderItemsWithInstancing(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
     // For each render item...
@@ -4,6 +4,9 @@
 #include "../Common/MathHelper.h"
 #include "../Common/DxUtil.h"
 #include "../Common/Camera.h"
+#include "../Common/Bvh.h"
+#include "../Common/SpatialIndex.h"
+#include "../Common/MeshFile.h"
 #include "FrameResource.h"
 
 extern const int gNumFrameResources;
@@ -29,6 +32,13 @@ struct RenderItem
 	DirectX::BoundingBox Bounds;
 	std::vector<InstanceData> Instances;
 
+	// Triangle hierarchy of the submesh drawn by this item, used for picking.
+	const TriangleBvh* MeshBvh = nullptr;
+
+	// Handle of the first instance in the culling index; the other instances
+	// follow it in order.  InvalidHandle if the item is not culled.
+	SpatialIndex::Handle FirstCullingHandle = SpatialIndex::InvalidHandle;
+
 	// DrawIndexedInstanced parameters.
 	UINT InstanceCount = 0;
 	UINT IndexCount = 0;
@@ -74,9 +84,12 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildMaterials();
 	void BuildSkullGeometry();
+	bool ConvertSkullGeometry(const std::wstring& meshFilename);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildRenderItems();
+	void BuildPickingBvh();
+	void BuildCullingIndex();
 	void DrawRenderItemsWithInstancing(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 
 
@@ -110,7 +123,21 @@ private:
 	RenderItem* pickedRitem;
 	int instanceCount;
 
-	DirectX::BoundingFrustum camFrustum;
+	// Pickable instances in the order they were given to pickingBvh.
+	struct PickableInstance
+	{
+		RenderItem* Ritem;
+		UINT InstanceIndex;
+	};
+
+	std::unordered_map<std::string, std::unique_ptr<TriangleBvh>> meshBvhs;
+	std::vector<PickableInstance> pickableInstances;
+	InstanceBvh pickingBvh;
+
+	// World bounds of the instances of the frustum-culled items, and the handles
+	// the last query found visible.
+	SpatialIndex cullingIndex;
+	std::vector<SpatialIndex::Handle> visibleHandles;
 
 	// Render items divided by PSO.
 	std::vector<RenderItem*> RitemLayer[(int)RenderLayer::Count];
@@ -266,24 +266,26 @@ void DisplacementMapApp::UpdateCamera(const GameTimer& gt)
 
 void DisplacementMapApp::UpdateInstanceBuffer(const GameTimer& gt)
 {
+    occlusionCuller.RenderOccluders(XMMatrixMultiply(camera.GetView(), camera.GetProj()));
+
     int bufferOffset = 0;
     auto instanceBuffer = currFrameResource->InstanceBuffer.get();
     for(auto& e : RitemLayer[static_cast<int>(RenderLayer::OpaqueFrustumCull)])
     {
         bufferOffset += 
-            e->UploadWithFrustumCulling(camera, *instanceBuffer, bufferOffset);
+            e->UploadWithFrustumCulling(camera, *instanceBuffer, bufferOffset, currFrameResourceIndex, &occlusionCuller);
     }
 
     for (auto& e : RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)])
     {
         bufferOffset +=
-            e->UploadWithoutFrustumCulling(*instanceBuffer, bufferOffset);
+            e->UploadWithoutFrustumCulling(*instanceBuffer, bufferOffset, currFrameResourceIndex);
     }
 
     for (auto& e : RitemLayer[static_cast<int>(RenderLayer::Sky)])
     {
         bufferOffset +=
-            e->UploadWithoutFrustumCulling(*instanceBuffer, bufferOffset);
+            e->UploadWithoutFrustumCulling(*instanceBuffer, bufferOffset, currFrameResourceIndex);
     }
 }
 
@@ -644,13 +646,35 @@ void DisplacementMapApp::BuildMaterials()
 }
 
 void DisplacementMapApp::BuildSkullGeometry()
+{
+    // The text model is only parsed when the binary cache is missing or older
+    // than it; every other run maps the cache and uploads it as is.
+    const std::wstring meshFilename = L"Models/skull.sphereuv_tangent.mesh";
+
+    MeshFile meshFile;
+    if (!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+    {
+        if (!ConvertSkullGeometry(meshFilename) ||
+            !meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+        {
+            return;
+        }
+    }
+
+    auto geo = meshFile.CreateGeometry("skullGeo",
+        device->GetD3DDevice().Get(), device->GetCommandList().Get());
+
+    geometries[geo->Name] = std::move(geo);
+}
+
+bool DisplacementMapApp::ConvertSkullGeometry(const std::wstring& meshFilename)
 {
     std::ifstream fin("Models/skull.txt");
 
     if (!fin)
     {
         MessageBox(0, L"Models/skull.txt not found.", 0, 0);
-        return;
+        return false;
     }
 
     UINT vcount = 0;
@@ -712,43 +736,23 @@ void DisplacementMapApp::BuildSkullGeometry()
 
     fin.close();
 
-    //
-    // Pack the indices of all the meshes into one index buffer.
-    //
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-
-    auto geo = std::make_unique<MeshGeometry>();
-    geo->Name = "skullGeo";
-
-    ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-    ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-    geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-        device->GetCommandList().Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-        device->GetCommandList().Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-    geo->VertexByteStride = sizeof(Vertex);
-    geo->VertexBufferByteSize = vbByteSize;
-    geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-    geo->IndexBufferByteSize = ibByteSize;
-
-    SubmeshGeometry submesh;
+    MeshFileSubmesh submesh;
+    submesh.SetName("skull");
     submesh.IndexCount = (UINT)indices.size();
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
     submesh.Bounds = bounds;
 
-    geo->DrawArgs["skull"] = submesh;
+    if (!MeshFile::Write(meshFilename, L"Models/skull.txt",
+        vertices.data(), sizeof(Vertex), (UINT)vertices.size(),
+        indices.data(), DXGI_FORMAT_R32_UINT, (UINT)indices.size(),
+        { submesh }))
+    {
+        MessageBox(0, (L"Could not write " + meshFilename).c_str(), 0, 0);
+        return false;
+    }
 
-    geometries[geo->Name] = std::move(geo);
+    return true;
 }
 
 void DisplacementMapApp::BuildShapeGeometry()
@@ -1162,6 +1166,9 @@ void DisplacementMapApp::BuildRenderItems()
     RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)].push_back(cylinderRitem.get());
     RitemLayer[static_cast<int>(RenderLayer::OpaqueNonFrustumCull)].push_back(sphereRitem.get());
 
+    boxRitem->AddOccluders(occlusionCuller);
+    cylinderRitem->AddOccluders(occlusionCuller);
+
 
 	allRitems.push_back(std::move(skullRitem));
     allRitems.push_back(std::move(skyRitem));
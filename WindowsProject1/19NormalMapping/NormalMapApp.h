@@ -5,6 +5,7 @@
 #include "../Common/DxUtil.h"
 #include "../Common/Camera.h"
 #include "../Common/InstancedRenderItem.h"
+#include "../Common/MeshFile.h"
 #include "FrameResource.h"
 
 extern const int gNumFrameResources;
@@ -76,6 +77,7 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildMaterials();
 	void BuildSkullGeometry();
+	bool ConvertSkullGeometry(const std::wstring& meshFilename);
 	void BuildShapeGeometry();
 	void BuildPSOs();
 	void BuildFrameResources();
@@ -963,13 +963,35 @@ void SsaoApp::BuildShapeGeometry()
 
 
 void SsaoApp::BuildSkullGeometry()
+{
+	// The text model is only parsed when the binary cache is missing or older
+	// than it; every other run maps the cache and uploads it as is.
+	const std::wstring meshFilename = L"Models/skull.tangent.mesh";
+
+	MeshFile meshFile;
+	if (!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+	{
+		if (!ConvertSkullGeometry(meshFilename) ||
+			!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+		{
+			return;
+		}
+	}
+
+	auto geo = meshFile.CreateGeometry("skullGeo",
+		device->GetD3DDevice().Get(), device->GetCommandList().Get());
+
+	mGeometries[geo->Name] = std::move(geo);
+}
+
+bool SsaoApp::ConvertSkullGeometry(const std::wstring& meshFilename)
 {
 	std::ifstream fin("Models/skull.txt");
 
 	if (!fin)
 	{
 		MessageBox(0, L"Models / skull.txt not found.", 0, 0);
-		return;
+		return false;
 	}
 
 	UINT vcount = 0;
@@ -1035,43 +1057,23 @@ void SsaoApp::BuildSkullGeometry()
 
 	fin.close();
 
-	//
-	// Pack the indices of all the meshes into one index buffer.
-	//
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "skullGeo";
-
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
-	SubmeshGeometry submesh;
+	MeshFileSubmesh submesh;
+	submesh.SetName("skull");
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 	submesh.Bounds = bounds;
 
-	geo->DrawArgs["skull"] = submesh;
+	if (!MeshFile::Write(meshFilename, L"Models/skull.txt",
+		vertices.data(), sizeof(Vertex), (UINT)vertices.size(),
+		indices.data(), DXGI_FORMAT_R32_UINT, (UINT)indices.size(),
+		{ submesh }))
+	{
+		MessageBox(0, (L"Could not write " + meshFilename).c_str(), 0, 0);
+		return false;
+	}
 
-	mGeometries[geo->Name] = std::move(geo);
+	return true;
 }
 
 void SsaoApp::BuildPSOs()
@@ -7,6 +7,7 @@
 #include "FrameResource.h"
 #include "ShadowMap.h"
 #include "../Common/Camera.h"
+#include "../Common/MeshFile.h"
 #include "Ssao.h"
 
 extern const int gNumFrameResources;
@@ -82,6 +83,7 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
 	void BuildSkullGeometry();
+	bool ConvertSkullGeometry(const std::wstring& meshFilename);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
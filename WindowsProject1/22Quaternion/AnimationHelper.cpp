@@ -33,24 +33,33 @@ float BoneAnimation::GetEndTime()const
 }
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	XMFLOAT3 scale;
+	XMFLOAT4 rotationQuat;
+	XMFLOAT3 translation;
+	Interpolate(t, scale, rotationQuat, translation);
+
+	XMVECTOR S = XMLoadFloat3(&scale);
+	XMVECTOR P = XMLoadFloat3(&translation);
+	XMVECTOR Q = XMLoadFloat4(&rotationQuat);
+
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT3& scale, XMFLOAT4& rotationQuat, XMFLOAT3& translation)const
 {
 	if (t <= Keyframes.front().TimePos)
 	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		scale = Keyframes.front().Scale;
+		rotationQuat = Keyframes.front().RotationQuat;
+		translation = Keyframes.front().Translation;
 	}
 	else if (t >= Keyframes.back().TimePos)
 	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		scale = Keyframes.back().Scale;
+		rotationQuat = Keyframes.back().RotationQuat;
+		translation = Keyframes.back().Translation;
 	}
 	else
 	{
@@ -69,12 +78,9 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
 				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
-
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+				XMStoreFloat3(&scale, XMVectorLerp(s0, s1, lerpPercent));
+				XMStoreFloat3(&translation, XMVectorLerp(p0, p1, lerpPercent));
+				XMStoreFloat4(&rotationQuat, XMQuaternionSlerp(q0, q1, lerpPercent));
 
 				break;
 			}
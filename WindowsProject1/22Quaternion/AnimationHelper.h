@@ -19,6 +19,8 @@ struct BoneAnimation
 	float GetEndTime() const;
 
 	void Interpolate(float t, DirectX::XMFLOAT4X4& M) const;
+	void Interpolate(float t, DirectX::XMFLOAT3& scale, DirectX::XMFLOAT4& rotationQuat,
+		DirectX::XMFLOAT3& translation) const;
 
 	std::vector<Keyframe> Keyframes;
 };
\ No newline at end of file
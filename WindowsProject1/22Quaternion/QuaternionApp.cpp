@@ -54,6 +54,7 @@ bool QuaternionApp::Initialize()
 	BuildSkullGeometry();
 	BuildMaterials();
 	BuildRenderItems();
+	BuildTransforms();
 	BuildFrameResources();
 	BuildPSOs();
 
@@ -95,9 +96,13 @@ void QuaternionApp::Update(const GameTimer& gt)
 		mAnimTimePos = 0.0f;
 	}
 
-	mSkullAnimation.Interpolate(mAnimTimePos, mSkullWorld);
-	mSkullRitem->World = mSkullWorld;
-	mSkullRitem->NumFramesDirty = gNumFrameResources;
+	XMFLOAT3 skullScale;
+	XMFLOAT4 skullRotation;
+	XMFLOAT3 skullTranslation;
+	mSkullAnimation.Interpolate(mAnimTimePos, skullScale, skullRotation, skullTranslation);
+	mTransforms.SetLocal(mSkullRitem->Transform, skullScale, skullRotation, skullTranslation);
+
+	UpdateTransforms();
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -328,6 +333,17 @@ void QuaternionApp::AnimateMaterials(const GameTimer& gt)
 
 }
 
+void QuaternionApp::UpdateTransforms()
+{
+	// Only the nodes that moved come back, so the static scene costs nothing here.
+	for (TransformHierarchy::Node node : mTransforms.Update())
+	{
+		RenderItem* ritem = mRitemOfTransform[node];
+		ritem->World = mTransforms.GetWorld(node);
+		ritem->NumFramesDirty = gNumFrameResources;
+	}
+}
+
 void QuaternionApp::UpdateObjectCBs(const GameTimer& gt)
 {
 	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
@@ -974,13 +990,35 @@ void QuaternionApp::BuildShapeGeometry()
 
 
 void QuaternionApp::BuildSkullGeometry()
+{
+	// The text model is only parsed when the binary cache is missing or older
+	// than it; every other run maps the cache and uploads it as is.
+	const std::wstring meshFilename = L"Models/skull.tangent.mesh";
+
+	MeshFile meshFile;
+	if (!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+	{
+		if (!ConvertSkullGeometry(meshFilename) ||
+			!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+		{
+			return;
+		}
+	}
+
+	auto geo = meshFile.CreateGeometry("skullGeo",
+		device->GetD3DDevice().Get(), device->GetCommandList().Get());
+
+	mGeometries[geo->Name] = std::move(geo);
+}
+
+bool QuaternionApp::ConvertSkullGeometry(const std::wstring& meshFilename)
 {
 	std::ifstream fin("Models/skull.txt");
 
 	if (!fin)
 	{
 		MessageBox(0, L"Models / skull.txt not found.", 0, 0);
-		return;
+		return false;
 	}
 
 	UINT vcount = 0;
@@ -1046,43 +1084,23 @@ void QuaternionApp::BuildSkullGeometry()
 
 	fin.close();
 
-	//
-	// Pack the indices of all the meshes into one index buffer.
-	//
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "skullGeo";
-
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
-	SubmeshGeometry submesh;
+	MeshFileSubmesh submesh;
+	submesh.SetName("skull");
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 	submesh.Bounds = bounds;
 
-	geo->DrawArgs["skull"] = submesh;
+	if (!MeshFile::Write(meshFilename, L"Models/skull.txt",
+		vertices.data(), sizeof(Vertex), (UINT)vertices.size(),
+		indices.data(), DXGI_FORMAT_R32_UINT, (UINT)indices.size(),
+		{ submesh }))
+	{
+		MessageBox(0, (L"Could not write " + meshFilename).c_str(), 0, 0);
+		return false;
+	}
 
-	mGeometries[geo->Name] = std::move(geo);
+	return true;
 }
 
 void QuaternionApp::BuildPSOs()
@@ -1457,6 +1475,33 @@ void QuaternionApp::BuildRenderItems()
 	}
 }
 
+void QuaternionApp::BuildTransforms()
+{
+	mTransforms.Reserve(mAllRitems.size());
+	mRitemOfTransform.reserve(mAllRitems.size());
+
+	// Every item is a root for now; the world matrices set up above become the
+	// local transforms.
+	for (auto& ritem : mAllRitems)
+	{
+		XMVECTOR S;
+		XMVECTOR Q;
+		XMVECTOR T;
+		XMMatrixDecompose(&S, &Q, &T, XMLoadFloat4x4(&ritem->World));
+
+		XMFLOAT3 scale;
+		XMFLOAT4 rotation;
+		XMFLOAT3 translation;
+		XMStoreFloat3(&scale, S);
+		XMStoreFloat4(&rotation, Q);
+		XMStoreFloat3(&translation, T);
+
+		ritem->Transform = mTransforms.AddNode(TransformHierarchy::InvalidNode, scale, rotation, translation);
+		mRitemOfTransform.push_back(ritem.get());
+	}
+
+	UpdateTransforms();
+}
 
 void QuaternionApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
@@ -8,6 +8,8 @@
 #include "FrameResource.h"
 #include "ShadowMap.h"
 #include "../Common/Camera.h"
+#include "../Common/MeshFile.h"
+#include "../Common/TransformHierarchy.h"
 #include "Ssao.h"
 
 extern const int gNumFrameResources;
@@ -22,6 +24,9 @@ struct RenderItem
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
+	// Node whose world matrix World is copied from when it changes.
+	TransformHierarchy::Node Transform = TransformHierarchy::InvalidNode;
+
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify obect data we should set 
@@ -68,6 +73,7 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
+	void UpdateTransforms();
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateShadowTransform(const GameTimer& gt);
@@ -84,10 +90,12 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
 	void BuildSkullGeometry();
+	bool ConvertSkullGeometry(const std::wstring& meshFilename);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
+	void BuildTransforms();
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 	void DrawSceneToShadowMap();
 	void DrawNormalsAndDepth();
@@ -165,7 +173,9 @@ private:
 	DirectX::XMFLOAT3 mRotatedLightDirections[3];
 
 	RenderItem* mSkullRitem = nullptr;
-	DirectX::XMFLOAT4X4 mSkullWorld = MathHelper::Identity4x4();
+
+	TransformHierarchy mTransforms;
+	std::vector<RenderItem*> mRitemOfTransform;
 
 	float mAnimTimePos = 0.0f;
 	BoneAnimation mSkullAnimation;
@@ -1,257 +1,675 @@
 #include "M3dLoader.h"
+#include "../Common/MappedFile.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstring>
 
 using namespace DirectX;
 
-bool M3DLoader::LoadM3d(const std::string& filename,
-	std::vector<Vertex>& vertices,
-	std::vector<USHORT>& indices,
-	std::vector<Subset>& subsets,
-	std::vector<M3dMaterial>& mats)
+namespace
 {
-	std::ifstream fin(filename);
+	// Every per-vertex attribute an .m3d file can store.  Both vertex formats of
+	// the loader are built from it, so one parse (or sidecar) serves either.
+	struct FileVertex
+	{
+		XMFLOAT3 Pos = { 0.0f, 0.0f, 0.0f };
+		XMFLOAT4 TangentU = { 0.0f, 0.0f, 0.0f, 0.0f };
+		XMFLOAT3 Normal = { 0.0f, 0.0f, 0.0f };
+		XMFLOAT2 TexC = { 0.0f, 0.0f };
+		XMFLOAT4 BoneWeights = { 0.0f, 0.0f, 0.0f, 0.0f };
+		int BoneIndices[4] = {};
+	};
+
+	struct M3dModel
+	{
+		std::vector<M3DLoader::M3dMaterial> Materials;
+		std::vector<M3DLoader::Subset> Subsets;
+		std::vector<FileVertex> Vertices;
+		std::vector<USHORT> Indices;
+		std::vector<XMFLOAT4X4> BoneOffsets;
+		std::vector<int> BoneHierarchy;
+		std::unordered_map<std::string, AnimationClip> Animations;
+	};
+
+	// Walks the text of a mapped .m3d file the way formatted extraction from an
+	// ifstream would, but parses numbers in place with std::from_chars.
+	class TextReader
+	{
+	public:
+		TextReader(const char* begin, const char* end)
+			: cursor(begin),
+			end(end)
+		{
+		}
 
-	UINT numMaterials = 0;
-	UINT numVertices = 0;
-	UINT numTriangles = 0;
-	UINT numBones = 0;
-	UINT numAnimationClips = 0;
+		bool IsGood() const noexcept { return bGood; }
 
-	std::string ignore;
+		// Skips whitespace-delimited tokens, such as the labels in front of values.
+		void Skip(int tokenCount = 1)
+		{
+			for (int i = 0; i < tokenCount; ++i)
+			{
+				SkipWhitespace();
+				while (cursor < end && !IsSpace(*cursor))
+					++cursor;
+			}
+		}
 
-	if (fin)
-	{
-		fin >> ignore; // file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
-
-		ReadMaterials(fin, numMaterials, mats);
-		ReadSubsetTable(fin, numMaterials, subsets);
-		ReadVertices(fin, numVertices, vertices);
-		ReadTriangles(fin, numTriangles, indices);
-
-		return true;
-	}
-	return false;
-}
+		std::string ReadString()
+		{
+			SkipWhitespace();
+			const char* first = cursor;
+			while (cursor < end && !IsSpace(*cursor))
+				++cursor;
+
+			if (first == cursor)
+				bGood = false;
+			return std::string(first, cursor);
+		}
 
-bool M3DLoader::LoadM3d(const std::string& filename,
-	std::vector<SkinnedVertex>& vertices,
-	std::vector<USHORT>& indices,
-	std::vector<Subset>& subsets,
-	std::vector<M3dMaterial>& mats,
-	SkinnedData& skinInfo)
-{
-	std::ifstream fin(filename);
+		template<typename T>
+		T Read()
+		{
+			SkipWhitespace();
+
+			T value{};
+			const std::from_chars_result result = std::from_chars(cursor, end, value);
+			if (result.ec != std::errc())
+			{
+				bGood = false;
+				return T{};
+			}
+
+			cursor = result.ptr;
+			return value;
+		}
 
-	UINT numMaterials = 0;
-	UINT numVertices = 0;
-	UINT numTriangles = 0;
-	UINT numBones = 0;
-	UINT numAnimationClips = 0;
+	private:
+		static bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+		}
 
-	std::string ignore;
+		void SkipWhitespace()
+		{
+			while (cursor < end && IsSpace(*cursor))
+				++cursor;
+		}
 
-	if (fin)
+		const char* cursor;
+		const char* end;
+		bool bGood = true;
+	};
+
+	void ReadMaterials(TextReader& reader, UINT numMaterials, std::vector<M3DLoader::M3dMaterial>& mats)
 	{
-		fin >> ignore; // file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
-
-		std::vector<XMFLOAT4X4> boneOffsets;
-		std::vector<int> boneIndexToParentIndex;
-		std::unordered_map<std::string, AnimationClip> animations;
-
-		ReadMaterials(fin, numMaterials, mats);
-		ReadSubsetTable(fin, numMaterials, subsets);
-		ReadSkinnedVertices(fin, numVertices, vertices);
-		ReadTriangles(fin, numTriangles, indices);
-		ReadBoneOffsets(fin, numBones, boneOffsets);
-		ReadBoneHierarchy(fin, numBones, boneIndexToParentIndex);
-		ReadAnimationClips(fin, numBones, numAnimationClips, animations);
-
-		skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
-
-		return true;
+		mats.resize(numMaterials);
+
+		reader.Skip(); // materials header text
+		for (UINT i = 0; i < numMaterials; ++i)
+		{
+			reader.Skip(); mats[i].Name = reader.ReadString();
+			reader.Skip();
+			mats[i].DiffuseAlbedo.x = reader.Read<float>();
+			mats[i].DiffuseAlbedo.y = reader.Read<float>();
+			mats[i].DiffuseAlbedo.z = reader.Read<float>();
+			reader.Skip();
+			mats[i].FresnelR0.x = reader.Read<float>();
+			mats[i].FresnelR0.y = reader.Read<float>();
+			mats[i].FresnelR0.z = reader.Read<float>();
+			reader.Skip(); mats[i].Roughness = reader.Read<float>();
+			reader.Skip(); mats[i].AlphaClip = reader.Read<int>() != 0;
+			reader.Skip(); mats[i].MaterialTypeName = reader.ReadString();
+			reader.Skip(); mats[i].DiffuseMapName = reader.ReadString();
+			reader.Skip(); mats[i].NormalMapName = reader.ReadString();
+		}
 	}
-	return false;
-}
 
-void M3DLoader::ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats)
-{
-	std::string ignore;
-	mats.resize(numMaterials);
+	void ReadSubsetTable(TextReader& reader, UINT numSubsets, std::vector<M3DLoader::Subset>& subsets)
+	{
+		subsets.resize(numSubsets);
 
-	std::string diffuseMapName;
-	std::string normalMapName;
+		reader.Skip(); // subset header text
+		for (UINT i = 0; i < numSubsets; ++i)
+		{
+			reader.Skip(); subsets[i].Id = reader.Read<UINT>();
+			reader.Skip(); subsets[i].VertexStart = reader.Read<UINT>();
+			reader.Skip(); subsets[i].VertexCount = reader.Read<UINT>();
+			reader.Skip(); subsets[i].FaceStart = reader.Read<UINT>();
+			reader.Skip(); subsets[i].FaceCount = reader.Read<UINT>();
+		}
+	}
 
-	fin >> ignore; // materials header text
-	for (UINT i = 0; i < numMaterials; ++i)
+	// Files with bones carry blend weights and bone indices after the texture
+	// coordinates of every vertex.
+	void ReadVertices(TextReader& reader, UINT numVertices, bool bSkinned, std::vector<FileVertex>& vertices)
 	{
-		fin >> ignore >> mats[i].Name;
-		fin >> ignore >> mats[i].DiffuseAlbedo.x >> mats[i].DiffuseAlbedo.y >> mats[i].DiffuseAlbedo.z;
-		fin >> ignore >> mats[i].FresnelR0.x >> mats[i].FresnelR0.y >> mats[i].FresnelR0.z;
-		fin >> ignore >> mats[i].Roughness;
-		fin >> ignore >> mats[i].AlphaClip;
-		fin >> ignore >> mats[i].MaterialTypeName;
-		fin >> ignore >> mats[i].DiffuseMapName;
-		fin >> ignore >> mats[i].NormalMapName;
+		vertices.resize(numVertices);
+
+		reader.Skip(); // vertices header text
+		for (UINT i = 0; i < numVertices; ++i)
+		{
+			FileVertex& v = vertices[i];
+
+			reader.Skip();
+			v.Pos.x = reader.Read<float>();
+			v.Pos.y = reader.Read<float>();
+			v.Pos.z = reader.Read<float>();
+			reader.Skip();
+			v.TangentU.x = reader.Read<float>();
+			v.TangentU.y = reader.Read<float>();
+			v.TangentU.z = reader.Read<float>();
+			v.TangentU.w = reader.Read<float>();
+			reader.Skip();
+			v.Normal.x = reader.Read<float>();
+			v.Normal.y = reader.Read<float>();
+			v.Normal.z = reader.Read<float>();
+			reader.Skip();
+			v.TexC.x = reader.Read<float>();
+			v.TexC.y = reader.Read<float>();
+
+			if (!bSkinned)
+				continue;
+
+			reader.Skip();
+			v.BoneWeights.x = reader.Read<float>();
+			v.BoneWeights.y = reader.Read<float>();
+			v.BoneWeights.z = reader.Read<float>();
+			v.BoneWeights.w = reader.Read<float>();
+			reader.Skip();
+			for (int k = 0; k < 4; ++k)
+				v.BoneIndices[k] = reader.Read<int>();
+		}
 	}
-}
 
-void M3DLoader::ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets)
-{
-	std::string ignore;
-	subsets.resize(numSubsets);
+	void ReadTriangles(TextReader& reader, UINT numTriangles, std::vector<USHORT>& indices)
+	{
+		indices.resize(numTriangles * 3);
 
-	fin >> ignore; // subset header text
-	for (UINT i = 0; i < numSubsets; ++i)
+		reader.Skip(); // triangles header text
+		for (UINT i = 0; i < numTriangles * 3; ++i)
+			indices[i] = reader.Read<USHORT>();
+	}
+
+	void ReadBoneOffsets(TextReader& reader, UINT numBones, std::vector<XMFLOAT4X4>& boneOffsets)
 	{
-		fin >> ignore >> subsets[i].Id;
-		fin >> ignore >> subsets[i].VertexStart;
-		fin >> ignore >> subsets[i].VertexCount;
-		fin >> ignore >> subsets[i].FaceStart;
-		fin >> ignore >> subsets[i].FaceCount;
+		boneOffsets.resize(numBones);
+
+		reader.Skip(); // BoneOffsets header text
+		for (UINT i = 0; i < numBones; ++i)
+		{
+			reader.Skip();
+			for (int r = 0; r < 4; ++r)
+			{
+				for (int c = 0; c < 4; ++c)
+					boneOffsets[i](r, c) = reader.Read<float>();
+			}
+		}
 	}
-}
 
-void M3DLoader::ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices)
-{
-	std::string ignore;
-	vertices.resize(numVertices);
+	void ReadBoneHierarchy(TextReader& reader, UINT numBones, std::vector<int>& boneIndexToParentIndex)
+	{
+		boneIndexToParentIndex.resize(numBones);
 
-	fin >> ignore; // vertices header text
-	for (UINT i = 0; i < numVertices; ++i)
+		reader.Skip(); // BoneHierarchy header text
+		for (UINT i = 0; i < numBones; ++i)
+		{
+			reader.Skip();
+			boneIndexToParentIndex[i] = reader.Read<int>();
+		}
+	}
+
+	void ReadBoneKeyframes(TextReader& reader, BoneAnimation& boneAnimation)
 	{
-		fin >> ignore >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> ignore >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> vertices[i].TangentU.w;
-		fin >> ignore >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-		fin >> ignore >> vertices[i].TexC.x >> vertices[i].TexC.y;
+		reader.Skip(2);
+		const UINT numKeyframes = reader.Read<UINT>();
+		reader.Skip(); // {
+
+		boneAnimation.Keyframes.resize(numKeyframes);
+		for (UINT i = 0; i < numKeyframes; ++i)
+		{
+			Keyframe& keyframe = boneAnimation.Keyframes[i];
+
+			reader.Skip();
+			keyframe.TimePos = reader.Read<float>();
+			reader.Skip();
+			keyframe.Translation.x = reader.Read<float>();
+			keyframe.Translation.y = reader.Read<float>();
+			keyframe.Translation.z = reader.Read<float>();
+			reader.Skip();
+			keyframe.Scale.x = reader.Read<float>();
+			keyframe.Scale.y = reader.Read<float>();
+			keyframe.Scale.z = reader.Read<float>();
+			reader.Skip();
+			keyframe.RotationQuat.x = reader.Read<float>();
+			keyframe.RotationQuat.y = reader.Read<float>();
+			keyframe.RotationQuat.z = reader.Read<float>();
+			keyframe.RotationQuat.w = reader.Read<float>();
+		}
+
+		reader.Skip(); // }
 	}
-}
 
-void M3DLoader::ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices)
-{
-	std::string ignore;
-	vertices.resize(numVertices);
+	void ReadAnimationClips(TextReader& reader, UINT numBones, UINT numAnimationClips,
+		std::unordered_map<std::string, AnimationClip>& animations)
+	{
+		animations.reserve(numAnimationClips);
 
-	fin >> ignore; // vertices header text
-	int boneIndices[4];
-	float weights[4];
-	for (UINT i = 0; i < numVertices; ++i)
+		reader.Skip(); // AnimationClips header text
+		for (UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
+		{
+			reader.Skip();
+			AnimationClip& clip = animations[reader.ReadString()];
+			reader.Skip(); // {
+
+			clip.BoneAnimations.resize(numBones);
+			for (UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
+				ReadBoneKeyframes(reader, clip.BoneAnimations[boneIndex]);
+
+			reader.Skip(); // }
+		}
+	}
+
+	bool ParseText(const char* begin, const char* end, M3dModel& model)
 	{
-		float blah;
-		fin >> ignore >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> ignore >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> blah /*vertices[i].TangentU.w*/;
-		fin >> ignore >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-		fin >> ignore >> vertices[i].TexC.x >> vertices[i].TexC.y;
-		fin >> ignore >> weights[0] >> weights[1] >> weights[2] >> weights[3];
-		fin >> ignore >> boneIndices[0] >> boneIndices[1] >> boneIndices[2] >> boneIndices[3];
-
-		vertices[i].BoneWeights.x = weights[0];
-		vertices[i].BoneWeights.y = weights[1];
-		vertices[i].BoneWeights.z = weights[2];
-
-		vertices[i].BoneIndices[0] = (BYTE)boneIndices[0];
-		vertices[i].BoneIndices[1] = (BYTE)boneIndices[1];
-		vertices[i].BoneIndices[2] = (BYTE)boneIndices[2];
-		vertices[i].BoneIndices[3] = (BYTE)boneIndices[3];
+		TextReader reader(begin, end);
+
+		reader.Skip(); // file header text
+		reader.Skip(); const UINT numMaterials = reader.Read<UINT>();
+		reader.Skip(); const UINT numVertices = reader.Read<UINT>();
+		reader.Skip(); const UINT numTriangles = reader.Read<UINT>();
+		reader.Skip(); const UINT numBones = reader.Read<UINT>();
+		reader.Skip(); const UINT numAnimationClips = reader.Read<UINT>();
+
+		if (!reader.IsGood())
+			return false;
+
+		ReadMaterials(reader, numMaterials, model.Materials);
+		ReadSubsetTable(reader, numMaterials, model.Subsets);
+		ReadVertices(reader, numVertices, numBones > 0, model.Vertices);
+		ReadTriangles(reader, numTriangles, model.Indices);
+		ReadBoneOffsets(reader, numBones, model.BoneOffsets);
+		ReadBoneHierarchy(reader, numBones, model.BoneHierarchy);
+		ReadAnimationClips(reader, numBones, numAnimationClips, model.Animations);
+
+		return reader.IsGood();
 	}
-}
 
-void M3DLoader::ReadTriangles(std::ifstream& fin, UINT numTriangles, std::vector<USHORT>& indices)
-{
-	std::string ignore;
-	indices.resize(numTriangles * 3);
+	//
+	// Binary sidecar.  The header is followed by the sections of the text file in
+	// the same order; strings are stored as a length and the characters, arrays
+	// as their raw elements.
+	//
+
+	constexpr UINT SidecarMagic = 'B' << 24 | 'D' << 16 | '3' << 8 | 'M';
+	constexpr UINT SidecarVersion = 1;
 
-	fin >> ignore; // triangles header text
-	for (UINT i = 0; i < numTriangles; ++i)
+	struct SidecarHeader
 	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-}
+		UINT Magic;
+		UINT Version;
+		UINT64 SourceByteSize;
+		UINT64 SourceWriteTime;
+		UINT NumMaterials;
+		UINT NumVertices;
+		UINT NumIndices;
+		UINT NumBones;
+		UINT NumAnimationClips;
+		UINT Reserved;
+	};
+
+	struct KeyframeRecord
+	{
+		float TimePos;
+		XMFLOAT3 Translation;
+		XMFLOAT3 Scale;
+		XMFLOAT4 RotationQuat;
+	};
 
-void M3DLoader::ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<XMFLOAT4X4>& boneOffsets)
-{
-	std::string ignore;
-	boneOffsets.resize(numBones);
+	class BinaryWriter
+	{
+	public:
+		template<typename T>
+		void Write(const T& value)
+		{
+			WriteBytes(&value, sizeof(T));
+		}
+
+		template<typename T>
+		void WriteArray(const std::vector<T>& values)
+		{
+			WriteBytes(values.data(), sizeof(T) * values.size());
+		}
+
+		void WriteString(const std::string& value)
+		{
+			Write((UINT)value.size());
+			WriteBytes(value.data(), value.size());
+		}
+
+		void WriteBytes(const void* data, size_t byteSize)
+		{
+			const auto first = static_cast<const char*>(data);
+			bytes.insert(bytes.end(), first, first + byteSize);
+		}
+
+		const std::vector<char>& GetBytes() const noexcept { return bytes; }
+
+	private:
+		std::vector<char> bytes;
+	};
+
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const unsigned char* begin, const unsigned char* end)
+			: cursor(begin),
+			end(end)
+		{
+		}
+
+		bool IsGood() const noexcept { return bGood; }
+
+		template<typename T>
+		void Read(T& value)
+		{
+			ReadBytes(&value, sizeof(T));
+		}
+
+		template<typename T>
+		void ReadArray(std::vector<T>& values, size_t count)
+		{
+			if (!CanRead(sizeof(T) * count))
+				return;
+
+			values.resize(count);
+			ReadBytes(values.data(), sizeof(T) * count);
+		}
+
+		std::string ReadString()
+		{
+			UINT length = 0;
+			Read(length);
+			if (!CanRead(length))
+				return std::string();
+
+			std::string value(reinterpret_cast<const char*>(cursor), length);
+			cursor += length;
+			return value;
+		}
+
+		void ReadBytes(void* data, size_t byteSize)
+		{
+			if (!CanRead(byteSize))
+				return;
+
+			std::memcpy(data, cursor, byteSize);
+			cursor += byteSize;
+		}
 
-	fin >> ignore; // BoneOffsets header text
-	for (UINT i = 0; i < numBones; ++i)
+	private:
+		bool CanRead(size_t byteSize)
+		{
+			if (bGood && byteSize <= static_cast<size_t>(end - cursor))
+				return true;
+
+			bGood = false;
+			return false;
+		}
+
+		const unsigned char* cursor;
+		const unsigned char* end;
+		bool bGood = true;
+	};
+
+	std::wstring GetSidecarFilename(const std::string& filename)
 	{
-		fin >> ignore >>
-			boneOffsets[i](0, 0) >> boneOffsets[i](0, 1) >> boneOffsets[i](0, 2) >> boneOffsets[i](0, 3) >>
-			boneOffsets[i](1, 0) >> boneOffsets[i](1, 1) >> boneOffsets[i](1, 2) >> boneOffsets[i](1, 3) >>
-			boneOffsets[i](2, 0) >> boneOffsets[i](2, 1) >> boneOffsets[i](2, 2) >> boneOffsets[i](2, 3) >>
-			boneOffsets[i](3, 0) >> boneOffsets[i](3, 1) >> boneOffsets[i](3, 2) >> boneOffsets[i](3, 3);
+		return AnsiToWString(filename + "b");
 	}
-}
 
-void M3DLoader::ReadBoneHierarchy(std::ifstream& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex)
-{
-	std::string ignore;
-	boneIndexToParentIndex.resize(numBones);
+	bool WriteSidecar(const std::string& filename, const M3dModel& model)
+	{
+		SidecarHeader header = {};
+		header.Magic = SidecarMagic;
+		header.Version = SidecarVersion;
+		MappedFile::GetFileStamp(AnsiToWString(filename), header.SourceByteSize, header.SourceWriteTime);
+		header.NumMaterials = (UINT)model.Materials.size();
+		header.NumVertices = (UINT)model.Vertices.size();
+		header.NumIndices = (UINT)model.Indices.size();
+		header.NumBones = (UINT)model.BoneOffsets.size();
+		header.NumAnimationClips = (UINT)model.Animations.size();
+
+		BinaryWriter writer;
+		writer.Write(header);
+
+		for (const auto& mat : model.Materials)
+		{
+			writer.WriteString(mat.Name);
+			writer.Write(mat.DiffuseAlbedo);
+			writer.Write(mat.FresnelR0);
+			writer.Write(mat.Roughness);
+			writer.Write((UINT)mat.AlphaClip);
+			writer.WriteString(mat.MaterialTypeName);
+			writer.WriteString(mat.DiffuseMapName);
+			writer.WriteString(mat.NormalMapName);
+		}
+
+		writer.WriteArray(model.Subsets);
+		writer.WriteArray(model.Vertices);
+		writer.WriteArray(model.Indices);
+		writer.WriteArray(model.BoneOffsets);
+		writer.WriteArray(model.BoneHierarchy);
+
+		std::vector<KeyframeRecord> records;
+		for (const auto& animation : model.Animations)
+		{
+			writer.WriteString(animation.first);
+			for (const BoneAnimation& boneAnimation : animation.second.BoneAnimations)
+			{
+				records.resize(boneAnimation.Keyframes.size());
+				for (size_t i = 0; i < records.size(); ++i)
+				{
+					const Keyframe& keyframe = boneAnimation.Keyframes[i];
+					records[i] = { keyframe.TimePos, keyframe.Translation, keyframe.Scale, keyframe.RotationQuat };
+				}
+
+				writer.Write((UINT)records.size());
+				writer.WriteArray(records);
+			}
+		}
 
-	fin >> ignore; // BoneHierarchy header text
-	for (UINT i = 0; i < numBones; ++i)
+		// Write next to the target and swap it in, so a half-written sidecar is never
+		// picked up by a later run.
+		const std::wstring sidecarFilename = GetSidecarFilename(filename);
+		const std::wstring tempFilename = sidecarFilename + L".tmp";
+		{
+			std::ofstream fout(tempFilename, std::ios::binary | std::ios::trunc);
+			if (!fout)
+				return false;
+
+			fout.write(writer.GetBytes().data(), (std::streamsize)writer.GetBytes().size());
+			if (!fout)
+				return false;
+		}
+
+		return MoveFileExW(tempFilename.c_str(), sidecarFilename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	}
+
+	bool ReadSidecar(const std::string& filename, M3dModel& model, size_t& fileByteSize)
 	{
-		fin >> ignore >> boneIndexToParentIndex[i];
+		MappedFile file;
+		if (!file.Open(GetSidecarFilename(filename)))
+			return false;
+
+		BinaryReader reader(file.GetData(), file.GetData() + file.GetSize());
+
+		SidecarHeader header = {};
+		reader.Read(header);
+		if (!reader.IsGood() || header.Magic != SidecarMagic || header.Version != SidecarVersion)
+			return false;
+
+		// A sidecar converted from another revision of the model is stale.
+		UINT64 sourceByteSize = 0;
+		UINT64 sourceWriteTime = 0;
+		if (MappedFile::GetFileStamp(AnsiToWString(filename), sourceByteSize, sourceWriteTime) &&
+			(header.SourceByteSize != sourceByteSize || header.SourceWriteTime != sourceWriteTime))
+		{
+			return false;
+		}
+
+		model.Materials.resize(header.NumMaterials);
+		for (auto& mat : model.Materials)
+		{
+			UINT alphaClip = 0;
+			mat.Name = reader.ReadString();
+			reader.Read(mat.DiffuseAlbedo);
+			reader.Read(mat.FresnelR0);
+			reader.Read(mat.Roughness);
+			reader.Read(alphaClip);
+			mat.AlphaClip = alphaClip != 0;
+			mat.MaterialTypeName = reader.ReadString();
+			mat.DiffuseMapName = reader.ReadString();
+			mat.NormalMapName = reader.ReadString();
+		}
+
+		reader.ReadArray(model.Subsets, header.NumMaterials);
+		reader.ReadArray(model.Vertices, header.NumVertices);
+		reader.ReadArray(model.Indices, header.NumIndices);
+		reader.ReadArray(model.BoneOffsets, header.NumBones);
+		reader.ReadArray(model.BoneHierarchy, header.NumBones);
+
+		std::vector<KeyframeRecord> records;
+		model.Animations.reserve(header.NumAnimationClips);
+		for (UINT clipIndex = 0; clipIndex < header.NumAnimationClips && reader.IsGood(); ++clipIndex)
+		{
+			AnimationClip& clip = model.Animations[reader.ReadString()];
+			clip.BoneAnimations.resize(header.NumBones);
+
+			for (BoneAnimation& boneAnimation : clip.BoneAnimations)
+			{
+				UINT numKeyframes = 0;
+				reader.Read(numKeyframes);
+				reader.ReadArray(records, numKeyframes);
+				if (!reader.IsGood())
+					break;
+
+				boneAnimation.Keyframes.resize(numKeyframes);
+				for (UINT i = 0; i < numKeyframes; ++i)
+				{
+					Keyframe& keyframe = boneAnimation.Keyframes[i];
+					keyframe.TimePos = records[i].TimePos;
+					keyframe.Translation = records[i].Translation;
+					keyframe.Scale = records[i].Scale;
+					keyframe.RotationQuat = records[i].RotationQuat;
+				}
+			}
+		}
+
+		fileByteSize = file.GetSize();
+		return reader.IsGood();
 	}
-}
 
-void M3DLoader::ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips,
-	std::unordered_map<std::string, AnimationClip>& animations)
-{
-	std::string ignore;
-	fin >> ignore; // AnimationClips header text
-	for (UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
+	bool LoadModel(const std::string& filename, bool bUseSidecar, M3dModel& model, M3DLoader::LoadStats& stats)
 	{
-		std::string clipName;
-		fin >> ignore >> clipName;
-		fin >> ignore; // {
+		const auto start = std::chrono::steady_clock::now();
+		stats = M3DLoader::LoadStats();
 
-		AnimationClip clip;
-		clip.BoneAnimations.resize(numBones);
+		bool bLoaded = false;
+		if (bUseSidecar && ReadSidecar(filename, model, stats.FileByteSize))
+		{
+			stats.bFromSidecar = true;
+			bLoaded = true;
+		}
 
-		for (UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		if (!bLoaded)
 		{
-			ReadBoneKeyframes(fin, numBones, clip.BoneAnimations[boneIndex]);
+			model = M3dModel();
+
+			MappedFile file;
+			if (file.Open(AnsiToWString(filename)))
+			{
+				const char* text = reinterpret_cast<const char*>(file.GetData());
+				bLoaded = ParseText(text, text + file.GetSize(), model);
+				stats.FileByteSize = file.GetSize();
+			}
+
+			if (bLoaded && bUseSidecar)
+				WriteSidecar(filename, model);
 		}
-		fin >> ignore; // }
 
-		animations[clipName] = clip;
+		stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return bLoaded;
 	}
 }
 
-void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation)
+bool M3DLoader::LoadM3d(const std::string& filename,
+	std::vector<Vertex>& vertices,
+	std::vector<USHORT>& indices,
+	std::vector<Subset>& subsets,
+	std::vector<M3dMaterial>& mats)
 {
-	std::string ignore;
-	UINT numKeyframes = 0;
-	fin >> ignore >> ignore >> numKeyframes;
-	fin >> ignore; // {
+	M3dModel model;
+	if (!LoadModel(filename, bBinarySidecarEnabled, model, lastLoadStats))
+		return false;
 
-	boneAnimation.Keyframes.resize(numKeyframes);
-	for (UINT i = 0; i < numKeyframes; ++i)
+	vertices.resize(model.Vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
 	{
-		float t = 0.0f;
-		XMFLOAT3 p(0.0f, 0.0f, 0.0f);
-		XMFLOAT3 s(1.0f, 1.0f, 1.0f);
-		XMFLOAT4 q(0.0f, 0.0f, 0.0f, 1.0f);
-		fin >> ignore >> t;
-		fin >> ignore >> p.x >> p.y >> p.z;
-		fin >> ignore >> s.x >> s.y >> s.z;
-		fin >> ignore >> q.x >> q.y >> q.z >> q.w;
-
-		boneAnimation.Keyframes[i].TimePos = t;
-		boneAnimation.Keyframes[i].Translation = p;
-		boneAnimation.Keyframes[i].Scale = s;
-		boneAnimation.Keyframes[i].RotationQuat = q;
+		const FileVertex& v = model.Vertices[i];
+		vertices[i].Pos = v.Pos;
+		vertices[i].Normal = v.Normal;
+		vertices[i].TexC = v.TexC;
+		vertices[i].TangentU = v.TangentU;
 	}
 
-	fin >> ignore; // }
-}
\ No newline at end of file
+	indices = std::move(model.Indices);
+	subsets = std::move(model.Subsets);
+	mats = std::move(model.Materials);
+
+	return true;
+}
+
+bool M3DLoader::LoadM3d(const std::string& filename,
+	std::vector<SkinnedVertex>& vertices,
+	std::vector<USHORT>& indices,
+	std::vector<Subset>& subsets,
+	std::vector<M3dMaterial>& mats,
+	SkinnedData& skinInfo)
+{
+	M3dModel model;
+	if (!LoadModel(filename, bBinarySidecarEnabled, model, lastLoadStats))
+		return false;
+
+	vertices.resize(model.Vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const FileVertex& v = model.Vertices[i];
+		vertices[i].Pos = v.Pos;
+		vertices[i].Normal = v.Normal;
+		vertices[i].TexC = v.TexC;
+		vertices[i].TangentU = XMFLOAT3(v.TangentU.x, v.TangentU.y, v.TangentU.z);
+		vertices[i].BoneWeights = XMFLOAT3(v.BoneWeights.x, v.BoneWeights.y, v.BoneWeights.z);
+
+		for (int k = 0; k < 4; ++k)
+			vertices[i].BoneIndices[k] = (BYTE)v.BoneIndices[k];
+	}
+
+	indices = std::move(model.Indices);
+	subsets = std::move(model.Subsets);
+	mats = std::move(model.Materials);
+
+	skinInfo.Set(model.BoneHierarchy, model.BoneOffsets, model.Animations);
+
+	return true;
+}
+
+void M3DLoader::SetBinarySidecarEnabled(bool enabled)
+{
+	bBinarySidecarEnabled = enabled;
+}
+
+const M3DLoader::LoadStats& M3DLoader::GetLastLoadStats() const
+{
+	return lastLoadStats;
+}
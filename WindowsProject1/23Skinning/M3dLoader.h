@@ -46,6 +46,8 @@ public:
         std::string NormalMapName;
     };
 
+    // Both overloads read the same data, so a sidecar written by one also serves
+    // the other.
     bool LoadM3d(const std::string& filename,
         std::vector<Vertex>& vertices,
         std::vector<USHORT>& indices,
@@ -58,14 +60,22 @@ public:
         std::vector<M3dMaterial>& mats,
         SkinnedData& skinInfo);
 
+    // When enabled, loading foo.m3d reads the binary sidecar foo.m3db if it was
+    // converted from the current file, and writes it after parsing the text
+    // otherwise.
+    void SetBinarySidecarEnabled(bool enabled);
+
+    struct LoadStats
+    {
+        double Seconds = 0.0;
+        size_t FileByteSize = 0;
+        bool bFromSidecar = false;
+    };
+
+    // Timing of the last LoadM3d call, for comparing the text and sidecar paths.
+    const LoadStats& GetLastLoadStats() const;
+
 private:
-    void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
-    void ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets);
-    void ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices);
-    void ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices);
-    void ReadTriangles(std::ifstream& fin, UINT numTriangles, std::vector<USHORT>& indices);
-    void ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<DirectX::XMFLOAT4X4>& boneOffsets);
-    void ReadBoneHierarchy(std::ifstream& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex);
-    void ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations);
-    void ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation);
+    bool bBinarySidecarEnabled = false;
+    LoadStats lastLoadStats;
 };
\ No newline at end of file
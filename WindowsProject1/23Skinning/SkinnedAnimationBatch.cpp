@@ -0,0 +1,436 @@
+#include "SkinnedAnimationBatch.h"
+#include "../Common/JobSystem.h"
+
+#include <chrono>
+
+using namespace DirectX;
+
+namespace
+{
+	// Groups of four instances per job.
+	const int GroupGrainSize = 8;
+
+	// Components of the affine part of a matrix that are kept per bone: three
+	// columns of the four rows, the last column being (0, 0, 0, 1).
+	const UINT AffineComponentCount = 12;
+
+	// Components of a key in the flattened arrays.
+	const UINT TranslationOffset = 0;
+	const UINT RotationOffset = 3;
+	const UINT ScaleOffset = 7;
+}
+
+SkinnedAnimationBatch::SkinnedAnimationBatch(const SkinnedData& skinnedInfo)
+	: mBoneParents(skinnedInfo.GetBoneHierarchy()),
+	mBoneOffsets(skinnedInfo.GetBoneOffsets())
+{
+	const UINT boneCount = (UINT)mBoneParents.size();
+
+	//
+	// Flatten the keyframes of every clip.
+	//
+
+	mClips.resize(skinnedInfo.GetClipCount());
+	for (int c = 0; c < (int)mClips.size(); ++c)
+	{
+		const AnimationClip& source = skinnedInfo.GetClip(c);
+		Clip& clip = mClips[c];
+
+		clip.EndTime = skinnedInfo.GetClipEndTime(c);
+		clip.Tracks.resize(boneCount);
+
+		UINT keyCount = 0;
+		for (const BoneAnimation& bone : source.BoneAnimations)
+			keyCount += (UINT)bone.Keyframes.size();
+
+		clip.KeyTimes.reserve(keyCount);
+		clip.KeyValues.reserve(keyCount * KeyComponentCount);
+
+		for (UINT b = 0; b < boneCount && b < (UINT)source.BoneAnimations.size(); ++b)
+		{
+			const std::vector<Keyframe>& keyframes = source.BoneAnimations[b].Keyframes;
+
+			clip.Tracks[b].FirstKey = (UINT)clip.KeyTimes.size();
+			clip.Tracks[b].KeyCount = (UINT)keyframes.size();
+
+			for (const Keyframe& key : keyframes)
+			{
+				clip.KeyTimes.push_back(key.TimePos);
+
+				clip.KeyValues.push_back(key.Translation.x);
+				clip.KeyValues.push_back(key.Translation.y);
+				clip.KeyValues.push_back(key.Translation.z);
+				clip.KeyValues.push_back(key.RotationQuat.x);
+				clip.KeyValues.push_back(key.RotationQuat.y);
+				clip.KeyValues.push_back(key.RotationQuat.z);
+				clip.KeyValues.push_back(key.RotationQuat.w);
+				clip.KeyValues.push_back(key.Scale.x);
+				clip.KeyValues.push_back(key.Scale.y);
+				clip.KeyValues.push_back(key.Scale.z);
+			}
+		}
+	}
+
+	//
+	// Sort the bones by depth so that parents are always evaluated first, even
+	// if the file does not list them in that order.
+	//
+
+	std::vector<UINT> depths(boneCount, 0);
+	for (UINT b = 0; b < boneCount; ++b)
+	{
+		UINT depth = 0;
+		for (int parent = mBoneParents[b]; parent >= 0 && depth < boneCount; parent = mBoneParents[parent])
+			++depth;
+
+		depths[b] = depth;
+	}
+
+	mBoneOrder.resize(boneCount);
+	for (UINT b = 0; b < boneCount; ++b)
+		mBoneOrder[b] = b;
+
+	std::stable_sort(mBoneOrder.begin(), mBoneOrder.end(), [&](UINT a, UINT b)
+		{
+			return depths[a] < depths[b];
+		});
+}
+
+UINT SkinnedAnimationBatch::AddInstance(int clip, float timePos)
+{
+	assert(clip >= 0 && clip < (int)mClips.size());
+
+	const UINT instance = (UINT)mInstanceClips.size();
+	const UINT boneCount = GetBoneCount();
+
+	mInstanceClips.push_back(clip);
+	mInstanceTimePos.push_back(timePos);
+	mKeyframeCursors.resize(mKeyframeCursors.size() + boneCount, 0);
+	mFinalTransforms.resize(mFinalTransforms.size() + boneCount, MathHelper::Identity4x4());
+
+	return instance;
+}
+
+void SkinnedAnimationBatch::SetInstance(UINT instance, int clip, float timePos)
+{
+	assert(instance < GetInstanceCount());
+	assert(clip >= 0 && clip < (int)mClips.size());
+
+	// The cursors index the keyframes of the clip played so far.
+	if (mInstanceClips[instance] != clip)
+	{
+		const UINT boneCount = GetBoneCount();
+		std::fill_n(mKeyframeCursors.begin() + (size_t)instance * boneCount, boneCount, 0);
+	}
+
+	mInstanceClips[instance] = clip;
+	mInstanceTimePos[instance] = timePos;
+}
+
+void SkinnedAnimationBatch::Clear()
+{
+	mInstanceClips.clear();
+	mInstanceTimePos.clear();
+	mKeyframeCursors.clear();
+	mFinalTransforms.clear();
+}
+
+UINT SkinnedAnimationBatch::GetInstanceCount()const
+{
+	return (UINT)mInstanceClips.size();
+}
+
+UINT SkinnedAnimationBatch::GetBoneCount()const
+{
+	return (UINT)mBoneParents.size();
+}
+
+void SkinnedAnimationBatch::Update(float dt)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	const UINT instanceCount = GetInstanceCount();
+	for (UINT i = 0; i < instanceCount; ++i)
+	{
+		float& timePos = mInstanceTimePos[i];
+		timePos += dt;
+
+		// Loop animation
+		if (timePos > mClips[mInstanceClips[i]].EndTime)
+			timePos = 0.0f;
+	}
+
+	const int groupCount = (int)((instanceCount + LaneCount - 1) / LaneCount);
+	const size_t scratchCount = (size_t)GetBoneCount() * AffineComponentCount;
+
+	JobSystem& jobSystem = JobSystem::Default();
+	jobSystem.ParallelForRange(0, groupCount, GroupGrainSize, [&](int first, int last)
+		{
+			ScratchArena& scratch = jobSystem.GetScratch();
+			ScratchScope scope(scratch);
+
+			XMVECTOR* toRootLanes = scratch.AllocateArray<XMVECTOR>(scratchCount);
+
+			for (int g = first; g < last; ++g)
+			{
+				const UINT firstInstance = (UINT)g * LaneCount;
+				EvaluateGroup(firstInstance, std::min(LaneCount, instanceCount - firstInstance), toRootLanes);
+			}
+		});
+
+	mLastUpdateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const XMFLOAT4X4* SkinnedAnimationBatch::GetFinalTransforms(UINT instance)const
+{
+	assert(instance < GetInstanceCount());
+	return &mFinalTransforms[(size_t)instance * GetBoneCount()];
+}
+
+double SkinnedAnimationBatch::GetLastUpdateSeconds()const
+{
+	return mLastUpdateSeconds;
+}
+
+void SkinnedAnimationBatch::EvaluateGroup(UINT firstInstance, UINT instanceCount, XMVECTOR* toRootLanes)
+{
+	const UINT boneCount = GetBoneCount();
+
+	// Lanes without an instance animate an identity key and are not written out.
+	static const float IdentityKey[KeyComponentCount] = {
+		0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 1.0f };
+
+	alignas(16) float from[KeyComponentCount][LaneCount];
+	alignas(16) float to[KeyComponentCount][LaneCount];
+	alignas(16) float lerpPercents[LaneCount];
+
+	for (UINT bone : mBoneOrder)
+	{
+		//
+		// Find the bracketing keys of every lane and gather them component-wise.
+		//
+
+		for (UINT lane = 0; lane < LaneCount; ++lane)
+		{
+			const float* key0 = IdentityKey;
+			const float* key1 = IdentityKey;
+			float lerpPercent = 0.0f;
+
+			if (lane < instanceCount)
+			{
+				const UINT instance = firstInstance + lane;
+				const Clip& clip = mClips[mInstanceClips[instance]];
+				const Track& track = clip.Tracks[bone];
+				const float t = mInstanceTimePos[instance];
+
+				if (track.KeyCount > 0)
+				{
+					const float* times = &clip.KeyTimes[track.FirstKey];
+					const float* values = &clip.KeyValues[(size_t)track.FirstKey * KeyComponentCount];
+
+					if (t <= times[0])
+					{
+						key0 = key1 = values;
+					}
+					else if (t >= times[track.KeyCount - 1])
+					{
+						key0 = key1 = values + (size_t)(track.KeyCount - 1) * KeyComponentCount;
+					}
+					else
+					{
+						// Same cursor walk as BoneAnimation::Interpolate.
+						UINT& cursor = mKeyframeCursors[(size_t)instance * boneCount + bone];
+						const UINT lastPair = track.KeyCount - 2;
+						if (cursor > lastPair || t < times[cursor])
+							cursor = 0;
+
+						while (cursor < lastPair && t > times[cursor + 1])
+							++cursor;
+
+						key0 = values + (size_t)cursor * KeyComponentCount;
+						key1 = key0 + KeyComponentCount;
+						lerpPercent = (t - times[cursor]) / (times[cursor + 1] - times[cursor]);
+					}
+				}
+			}
+
+			for (UINT c = 0; c < KeyComponentCount; ++c)
+			{
+				from[c][lane] = key0[c];
+				to[c][lane] = key1[c];
+			}
+			lerpPercents[lane] = lerpPercent;
+		}
+
+		//
+		// Blend the keys of all lanes at once.
+		//
+
+		const XMVECTOR s = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(lerpPercents));
+
+		XMVECTOR v0[KeyComponentCount];
+		XMVECTOR v1[KeyComponentCount];
+		for (UINT c = 0; c < KeyComponentCount; ++c)
+		{
+			v0[c] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(from[c]));
+			v1[c] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(to[c]));
+		}
+
+		// Take the short way around: flip the second rotation where the two
+		// quaternions point into opposite hemispheres.
+		XMVECTOR dot = XMVectorMultiply(v0[RotationOffset], v1[RotationOffset]);
+		for (UINT c = RotationOffset + 1; c < ScaleOffset; ++c)
+			dot = XMVectorMultiplyAdd(v0[c], v1[c], dot);
+
+		const XMVECTOR flip = XMVectorLess(dot, XMVectorZero());
+		for (UINT c = RotationOffset; c < ScaleOffset; ++c)
+			v1[c] = XMVectorSelect(v1[c], XMVectorNegate(v1[c]), flip);
+
+		XMVECTOR k[KeyComponentCount];
+		for (UINT c = 0; c < KeyComponentCount; ++c)
+			k[c] = XMVectorMultiplyAdd(XMVectorSubtract(v1[c], v0[c]), s, v0[c]);
+
+		XMVECTOR lengthSq = XMVectorMultiply(k[RotationOffset], k[RotationOffset]);
+		for (UINT c = RotationOffset + 1; c < ScaleOffset; ++c)
+			lengthSq = XMVectorMultiplyAdd(k[c], k[c], lengthSq);
+
+		const XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+		for (UINT c = RotationOffset; c < ScaleOffset; ++c)
+			k[c] = XMVectorMultiply(k[c], invLength);
+
+		//
+		// Build the to-parent matrix, S * R(Q) * T like XMMatrixAffineTransformation.
+		//
+
+		const XMVECTOR one = XMVectorSplatOne();
+		const XMVECTOR two = XMVectorReplicate(2.0f);
+
+		const XMVECTOR& qx = k[RotationOffset + 0];
+		const XMVECTOR& qy = k[RotationOffset + 1];
+		const XMVECTOR& qz = k[RotationOffset + 2];
+		const XMVECTOR& qw = k[RotationOffset + 3];
+
+		const XMVECTOR x2 = XMVectorMultiply(qx, two);
+		const XMVECTOR y2 = XMVectorMultiply(qy, two);
+		const XMVECTOR z2 = XMVectorMultiply(qz, two);
+
+		const XMVECTOR xx = XMVectorMultiply(qx, x2);
+		const XMVECTOR yy = XMVectorMultiply(qy, y2);
+		const XMVECTOR zz = XMVectorMultiply(qz, z2);
+		const XMVECTOR xy = XMVectorMultiply(qx, y2);
+		const XMVECTOR xz = XMVectorMultiply(qx, z2);
+		const XMVECTOR yz = XMVectorMultiply(qy, z2);
+		const XMVECTOR wx = XMVectorMultiply(qw, x2);
+		const XMVECTOR wy = XMVectorMultiply(qw, y2);
+		const XMVECTOR wz = XMVectorMultiply(qw, z2);
+
+		const XMVECTOR& sx = k[ScaleOffset + 0];
+		const XMVECTOR& sy = k[ScaleOffset + 1];
+		const XMVECTOR& sz = k[ScaleOffset + 2];
+
+		XMVECTOR local[AffineComponentCount];
+		local[0] = XMVectorMultiply(sx, XMVectorSubtract(one, XMVectorAdd(yy, zz)));
+		local[1] = XMVectorMultiply(sx, XMVectorAdd(xy, wz));
+		local[2] = XMVectorMultiply(sx, XMVectorSubtract(xz, wy));
+
+		local[3] = XMVectorMultiply(sy, XMVectorSubtract(xy, wz));
+		local[4] = XMVectorMultiply(sy, XMVectorSubtract(one, XMVectorAdd(xx, zz)));
+		local[5] = XMVectorMultiply(sy, XMVectorAdd(yz, wx));
+
+		local[6] = XMVectorMultiply(sz, XMVectorAdd(xz, wy));
+		local[7] = XMVectorMultiply(sz, XMVectorSubtract(yz, wx));
+		local[8] = XMVectorMultiply(sz, XMVectorSubtract(one, XMVectorAdd(xx, yy)));
+
+		local[9] = k[TranslationOffset + 0];
+		local[10] = k[TranslationOffset + 1];
+		local[11] = k[TranslationOffset + 2];
+
+		//
+		// Concatenate with the parent, which the sort guarantees is done already.
+		//
+
+		XMVECTOR* toRoot = toRootLanes + (size_t)bone * AffineComponentCount;
+
+		const int parent = mBoneParents[bone];
+		if (parent < 0)
+		{
+			for (UINT c = 0; c < AffineComponentCount; ++c)
+				toRoot[c] = local[c];
+		}
+		else
+		{
+			const XMVECTOR* parentToRoot = toRootLanes + (size_t)parent * AffineComponentCount;
+
+			for (UINT row = 0; row < 4; ++row)
+			{
+				const XMVECTOR a0 = local[row * 3 + 0];
+				const XMVECTOR a1 = local[row * 3 + 1];
+				const XMVECTOR a2 = local[row * 3 + 2];
+
+				for (UINT col = 0; col < 3; ++col)
+				{
+					XMVECTOR v = XMVectorMultiply(a0, parentToRoot[0 * 3 + col]);
+					v = XMVectorMultiplyAdd(a1, parentToRoot[1 * 3 + col], v);
+					v = XMVectorMultiplyAdd(a2, parentToRoot[2 * 3 + col], v);
+
+					// The translation row picks up the parent's translation.
+					if (row == 3)
+						v = XMVectorAdd(v, parentToRoot[3 * 3 + col]);
+
+					toRoot[row * 3 + col] = v;
+				}
+			}
+		}
+
+		//
+		// Premultiply by the bone offset and write out the transposed result.
+		//
+
+		const XMFLOAT4X4& offset = mBoneOffsets[bone];
+
+		XMVECTOR finalLanes[4][3];
+		for (UINT row = 0; row < 4; ++row)
+		{
+			const XMVECTOR o0 = XMVectorReplicate(offset.m[row][0]);
+			const XMVECTOR o1 = XMVectorReplicate(offset.m[row][1]);
+			const XMVECTOR o2 = XMVectorReplicate(offset.m[row][2]);
+			const XMVECTOR o3 = XMVectorReplicate(offset.m[row][3]);
+
+			for (UINT col = 0; col < 3; ++col)
+			{
+				XMVECTOR v = XMVectorMultiply(o0, toRoot[0 * 3 + col]);
+				v = XMVectorMultiplyAdd(o1, toRoot[1 * 3 + col], v);
+				v = XMVectorMultiplyAdd(o2, toRoot[2 * 3 + col], v);
+				v = XMVectorMultiplyAdd(o3, toRoot[3 * 3 + col], v);
+
+				finalLanes[row][col] = v;
+			}
+		}
+
+		// Row col of a transposed final matrix is column col of the final matrix,
+		// which a 4x4 transpose of the lanes hands out one instance per row.
+		for (UINT col = 0; col < 3; ++col)
+		{
+			const XMMATRIX columns = XMMatrixTranspose(XMMATRIX(
+				finalLanes[0][col], finalLanes[1][col], finalLanes[2][col], finalLanes[3][col]));
+
+			for (UINT lane = 0; lane < instanceCount; ++lane)
+			{
+				XMFLOAT4X4& out = mFinalTransforms[(size_t)(firstInstance + lane) * boneCount + bone];
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out.m[col]), columns.r[lane]);
+			}
+		}
+
+		// The last column of the offset passes through unchanged.
+		for (UINT lane = 0; lane < instanceCount; ++lane)
+		{
+			XMFLOAT4X4& out = mFinalTransforms[(size_t)(firstInstance + lane) * boneCount + bone];
+			out.m[3][0] = offset.m[0][3];
+			out.m[3][1] = offset.m[1][3];
+			out.m[3][2] = offset.m[2][3];
+			out.m[3][3] = offset.m[3][3];
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "SkinnedData.h"
+
+// Animates many characters that share one SkinnedData rig.
+//
+// The keyframes of every clip are flattened when the batch is created: key
+// times of a track in one array for the cursor search, key values packed next
+// to each other so a lookup touches one or two cache lines.  Instances are then
+// evaluated four at a time.  Every bone is sampled for all four into registers
+// that hold one component each (x of four translations, w of four rotations and
+// so on), blended, turned into a matrix and concatenated with its parent in the
+// same layout, so the per-bone math runs once per four characters.  Groups of
+// instances are spread over the job system.
+//
+// Rotations are blended with normalized lerp instead of slerp.  Keyframes are
+// close enough together that the difference does not show, and nlerp has no
+// trigonometry or branches, which is what makes it vectorize across instances.
+class SkinnedAnimationBatch
+{
+public:
+	explicit SkinnedAnimationBatch(const SkinnedData& skinnedInfo);
+	SkinnedAnimationBatch(const SkinnedAnimationBatch& rhs) = delete;
+	SkinnedAnimationBatch& operator=(const SkinnedAnimationBatch& rhs) = delete;
+
+	// Returns the index of the new instance.
+	UINT AddInstance(int clip, float timePos = 0.0f);
+	void SetInstance(UINT instance, int clip, float timePos);
+	void Clear();
+
+	UINT GetInstanceCount()const;
+	UINT GetBoneCount()const;
+
+	// Advances every instance by dt, starting over at the end of its clip, and
+	// evaluates all of them.
+	void Update(float dt);
+
+	// BoneCount() matrices, transposed for the shaders like the ones from
+	// SkinnedData::GetFinalTransforms.  Valid until the next Update.
+	const DirectX::XMFLOAT4X4* GetFinalTransforms(UINT instance)const;
+
+	// Wall-clock time the last Update took, for profiling.
+	double GetLastUpdateSeconds()const;
+
+private:
+	static constexpr UINT LaneCount = 4;
+
+	// Translation, rotation and scale of one key, in this order.
+	static constexpr UINT KeyComponentCount = 10;
+
+	struct Track
+	{
+		UINT FirstKey = 0;
+		UINT KeyCount = 0;
+	};
+
+	struct Clip
+	{
+		// One track per bone.
+		std::vector<Track> Tracks;
+		std::vector<float> KeyTimes;
+		std::vector<float> KeyValues;
+		float EndTime = 0.0f;
+	};
+
+	// Evaluates up to LaneCount instances starting at firstInstance.  toRootLanes
+	// is scratch for 12 vectors per bone: the affine part of each to-root matrix,
+	// one component of all lanes per vector.
+	void EvaluateGroup(UINT firstInstance, UINT instanceCount, DirectX::XMVECTOR* toRootLanes);
+
+	std::vector<Clip> mClips;
+
+	// Bones sorted so that every parent comes before its children.
+	std::vector<UINT> mBoneOrder;
+	std::vector<int> mBoneParents;
+	std::vector<DirectX::XMFLOAT4X4> mBoneOffsets;
+
+	std::vector<int> mInstanceClips;
+	std::vector<float> mInstanceTimePos;
+
+	// BoneCount() entries per instance.
+	std::vector<UINT> mKeyframeCursors;
+	std::vector<DirectX::XMFLOAT4X4> mFinalTransforms;
+
+	double mLastUpdateSeconds = 0.0;
+};
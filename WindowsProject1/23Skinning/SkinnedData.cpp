@@ -3,9 +3,16 @@
 //***************************************************************************************
 
 #include "SkinnedData.h"
+#include "../Common/JobSystem.h"
 
 using namespace DirectX;
 
+namespace
+{
+	// Bones per job when a skeleton is evaluated in parallel.
+	const int BoneGrainSize = 16;
+}
+
 Keyframe::Keyframe()
 	: TimePos(0.0f),
 	Translation(0.0f, 0.0f, 0.0f),
@@ -33,6 +40,12 @@ float BoneAnimation::GetEndTime()const
 }
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	UINT cursor = 0;
+	Interpolate(t, M, cursor);
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M, UINT& cursor)const
 {
 	if (t <= Keyframes.front().TimePos)
 	{
@@ -54,31 +67,33 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 	}
 	else
 	{
-		for (UINT i = 0; i < Keyframes.size() - 1; ++i)
-		{
-			if (t >= Keyframes[i].TimePos && t <= Keyframes[i + 1].TimePos)
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
+		// Search again from the start if time went backwards, e.g. when the clip
+		// looped; otherwise walk forward from the pair used last time.
+		const UINT lastPair = (UINT)Keyframes.size() - 2;
+		if (cursor > lastPair || t < Keyframes[cursor].TimePos)
+			cursor = 0;
+
+		while (cursor < lastPair && t > Keyframes[cursor + 1].TimePos)
+			++cursor;
 
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
+		const UINT i = cursor;
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+		XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+		XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
 
-				break;
-			}
-		}
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
 	}
 }
 
@@ -109,22 +124,68 @@ float AnimationClip::GetClipEndTime()const
 
 void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
 {
-	for (UINT i = 0; i < BoneAnimations.size(); ++i)
-	{
-		BoneAnimations[i].Interpolate(t, boneTransforms[i]);
-	}
+	// Each bone is interpolated independently of the others.
+	JobSystem::Default().ParallelFor(0, (int)BoneAnimations.size(), BoneGrainSize, [&](int i)
+		{
+			BoneAnimations[i].Interpolate(t, boneTransforms[i]);
+		});
+}
+
+void AnimationClip::Interpolate(float t, XMFLOAT4X4* boneTransforms, UINT* keyframeCursors)const
+{
+	JobSystem::Default().ParallelFor(0, (int)BoneAnimations.size(), BoneGrainSize, [&](int i)
+		{
+			BoneAnimations[i].Interpolate(t, boneTransforms[i], keyframeCursors[i]);
+		});
+}
+
+int SkinnedData::FindClip(const std::string& clipName)const
+{
+	auto clip = mClipIndices.find(clipName);
+	return clip != mClipIndices.end() ? clip->second : InvalidClip;
+}
+
+float SkinnedData::GetClipStartTime(int clip)const
+{
+	assert(clip >= 0 && clip < (int)mClips.size());
+	return mClipStartTimes[clip];
+}
+
+float SkinnedData::GetClipEndTime(int clip)const
+{
+	assert(clip >= 0 && clip < (int)mClips.size());
+	return mClipEndTimes[clip];
 }
 
 float SkinnedData::GetClipStartTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipStartTime();
+	return GetClipStartTime(FindClip(clipName));
 }
 
 float SkinnedData::GetClipEndTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipEndTime();
+	return GetClipEndTime(FindClip(clipName));
+}
+
+int SkinnedData::GetClipCount()const
+{
+	return (int)mClips.size();
+}
+
+const AnimationClip& SkinnedData::GetClip(int clip)const
+{
+	assert(clip >= 0 && clip < (int)mClips.size());
+	return mClips[clip];
+}
+
+const std::vector<int>& SkinnedData::GetBoneHierarchy()const
+{
+	return mBoneHierarchy;
+}
+
+const std::vector<XMFLOAT4X4>& SkinnedData::GetBoneOffsets()const
+{
+	return mBoneOffsets;
 }
 
 UINT SkinnedData::BoneCount()const
@@ -138,24 +199,54 @@ void SkinnedData::Set(std::vector<int>& boneHierarchy,
 {
 	mBoneHierarchy = boneHierarchy;
 	mBoneOffsets = boneOffsets;
-	mAnimations = animations;
+
+	mClips.clear();
+	mClipStartTimes.clear();
+	mClipEndTimes.clear();
+	mClipIndices.clear();
+
+	mClips.reserve(animations.size());
+	for (const auto& animation : animations)
+	{
+		mClipIndices[animation.first] = (int)mClips.size();
+		mClips.push_back(animation.second);
+		mClipStartTimes.push_back(animation.second.GetClipStartTime());
+		mClipEndTimes.push_back(animation.second.GetClipEndTime());
+	}
 }
 
-void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms)const
+void SkinnedData::GetFinalTransforms(int clip, float timePos, SkinnedAnimationState& state)const
 {
+	assert(clip >= 0 && clip < (int)mClips.size());
+
 	UINT numBones = mBoneOffsets.size();
 
-	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+	if (state.FinalTransforms.size() != numBones)
+	{
+		state.FinalTransforms.resize(numBones);
+		state.ToParentTransforms.resize(numBones);
+		state.ToRootTransforms.resize(numBones);
+		state.KeyframeCursors.resize(numBones);
+		state.CachedClip = InvalidClip;
+	}
+	else if (state.CachedClip == clip && state.CachedTimePos == timePos)
+	{
+		return;
+	}
+
+	// The cursors index the keyframes of the clip evaluated last.
+	if (state.CachedClip != clip)
+		std::fill(state.KeyframeCursors.begin(), state.KeyframeCursors.end(), 0);
 
 	// Interpolate all the bones of this clip at the given time instance.
-	auto clip = mAnimations.find(clipName);
-	clip->second.Interpolate(timePos, toParentTransforms);
+	mClips[clip].Interpolate(timePos, state.ToParentTransforms.data(), state.KeyframeCursors.data());
 
 	//
 	// Traverse the hierarchy and transform all the bones to the root space.
 	//
 
-	std::vector<XMFLOAT4X4> toRootTransforms(numBones);
+	const std::vector<XMFLOAT4X4>& toParentTransforms = state.ToParentTransforms;
+	std::vector<XMFLOAT4X4>& toRootTransforms = state.ToRootTransforms;
 
 	// The root bone has index 0.  The root bone has no parent, so its toRootTransform
 	// is just its local bone transform.
@@ -175,11 +266,23 @@ void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,
 	}
 
 	// Premultiply by the bone offset transform to get the final transform.
-	for (UINT i = 0; i < numBones; ++i)
-	{
-		XMMATRIX offset = XMLoadFloat4x4(&mBoneOffsets[i]);
-		XMMATRIX toRoot = XMLoadFloat4x4(&toRootTransforms[i]);
-		XMMATRIX finalTransform = XMMatrixMultiply(offset, toRoot);
-		XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(finalTransform));
-	}
-}
\ No newline at end of file
+	std::vector<XMFLOAT4X4>& finalTransforms = state.FinalTransforms;
+	JobSystem::Default().ParallelFor(0, (int)numBones, BoneGrainSize, [&](int i)
+		{
+			XMMATRIX offset = XMLoadFloat4x4(&mBoneOffsets[i]);
+			XMMATRIX toRoot = XMLoadFloat4x4(&toRootTransforms[i]);
+			XMMATRIX finalTransform = XMMatrixMultiply(offset, toRoot);
+			XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(finalTransform));
+		});
+
+	state.CachedClip = clip;
+	state.CachedTimePos = timePos;
+}
+
+void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	SkinnedAnimationState state;
+	GetFinalTransforms(FindClip(clipName), timePos, state);
+
+	finalTransforms.swap(state.FinalTransforms);
+}
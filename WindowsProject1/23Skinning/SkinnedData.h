@@ -20,6 +20,11 @@ struct BoneAnimation
 
 	void Interpolate(float t, DirectX::XMFLOAT4X4& M) const;
 
+	// Same as above, but starts the search for the bracketing keyframes at cursor
+	// and leaves it at the pair that was used.  Time usually moves forward a
+	// little between calls, so this is amortized constant time.
+	void Interpolate(float t, DirectX::XMFLOAT4X4& M, UINT& cursor) const;
+
 	std::vector<Keyframe> Keyframes;
 };
 
@@ -30,26 +35,62 @@ struct AnimationClip
 
 	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms)const;
 
+	// keyframeCursors holds one cursor per bone, see BoneAnimation::Interpolate.
+	void Interpolate(float t, DirectX::XMFLOAT4X4* boneTransforms, UINT* keyframeCursors)const;
+
 	std::vector<BoneAnimation> BoneAnimations;
 };
 
+// Everything one animated instance needs to evaluate a SkinnedData without
+// allocating: the result, the scratch matrices of the hierarchy pass, and a
+// keyframe cursor per bone.  The clip and time of the last evaluation are kept,
+// so asking for the same pose again costs nothing.
+struct SkinnedAnimationState
+{
+	std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
+
+	std::vector<DirectX::XMFLOAT4X4> ToParentTransforms;
+	std::vector<DirectX::XMFLOAT4X4> ToRootTransforms;
+	std::vector<UINT> KeyframeCursors;
+
+	int CachedClip = -1;
+	float CachedTimePos = 0.0f;
+};
+
 class SkinnedData
 {
 public:
 
+	static const int InvalidClip = -1;
+
 	UINT BoneCount()const;
 
+	// Clips are referred to by handle on the per-frame path, so the name lookup
+	// happens once.  Returns InvalidClip if there is no clip with that name.
+	int FindClip(const std::string& clipName)const;
+
+	float GetClipStartTime(int clip)const;
+	float GetClipEndTime(int clip)const;
 	float GetClipStartTime(const std::string& clipName)const;
 	float GetClipEndTime(const std::string& clipName)const;
 
+	int GetClipCount()const;
+	const AnimationClip& GetClip(int clip)const;
+	const std::vector<int>& GetBoneHierarchy()const;
+	const std::vector<DirectX::XMFLOAT4X4>& GetBoneOffsets()const;
+
 	void Set(
 		std::vector<int>& boneHierarchy,
 		std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
 		std::unordered_map<std::string, AnimationClip>& animations);
 
-	// In a real project, you'd want to cache the result if there was a chance
-	// that you were calling this several times with the same clipName at 
-	// the same timePos.
+	// Evaluates the clip at timePos into state.FinalTransforms.  Nothing is
+	// recomputed if state already holds that clip at that time, and nothing is
+	// allocated once state has been sized by a first call.
+	void GetFinalTransforms(int clip, float timePos, SkinnedAnimationState& state)const;
+
+	// Convenience version that looks the clip up by name and evaluates it with
+	// temporary state.
 	void GetFinalTransforms(const std::string& clipName, float timePos,
 		std::vector<DirectX::XMFLOAT4X4>& finalTransforms)const;
 
@@ -59,5 +100,9 @@ private:
 
 	std::vector<DirectX::XMFLOAT4X4> mBoneOffsets;
 
-	std::unordered_map<std::string, AnimationClip> mAnimations;
+	// Clips by handle, with their time ranges computed once in Set.
+	std::vector<AnimationClip> mClips;
+	std::vector<float> mClipStartTimes;
+	std::vector<float> mClipEndTimes;
+	std::unordered_map<std::string, int> mClipIndices;
 };
\ No newline at end of file
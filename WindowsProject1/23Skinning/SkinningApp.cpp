@@ -363,16 +363,20 @@ void SkinningApp::UpdateSkinnedCBs(const GameTimer& gt)
 {
 	auto currSkinnedCB = mCurrFrameResource->SkinnedCB.get();
 
-	// We only have one skinned model being animated.
-	mSkinnedModelInst->UpdateSkinnedAnimation(gt.DeltaTime());
+	// Every character is evaluated in one batch; instance i goes to SkinnedCB
+	// index i.
+	mSkinnedAnimations->Update(gt.DeltaTime());
 
-	SkinnedConstants skinnedConstants;
-	std::copy(
-		std::begin(mSkinnedModelInst->FinalTransforms),
-		std::end(mSkinnedModelInst->FinalTransforms),
-		&skinnedConstants.BoneTransforms[0]);
+	const UINT boneCount = mSkinnedAnimations->GetBoneCount();
+	for (UINT i = 0; i < mSkinnedAnimations->GetInstanceCount(); ++i)
+	{
+		const XMFLOAT4X4* finalTransforms = mSkinnedAnimations->GetFinalTransforms(i);
+
+		SkinnedConstants skinnedConstants;
+		std::copy(finalTransforms, finalTransforms + boneCount, &skinnedConstants.BoneTransforms[0]);
 
-	currSkinnedCB->CopyData(0, skinnedConstants);
+		currSkinnedCB->CopyData(i, skinnedConstants);
+	}
 }
 
 void SkinningApp::UpdateMaterialBuffer(const GameTimer& gt)
@@ -1051,13 +1055,35 @@ void SkinningApp::BuildShapeGeometry()
 
 
 void SkinningApp::BuildSkullGeometry()
+{
+	// The text model is only parsed when the binary cache is missing or older
+	// than it; every other run maps the cache and uploads it as is.
+	const std::wstring meshFilename = L"Models/skull.tangent.mesh";
+
+	MeshFile meshFile;
+	if (!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+	{
+		if (!ConvertSkullGeometry(meshFilename) ||
+			!meshFile.Open(meshFilename, L"Models/skull.txt", sizeof(Vertex)))
+		{
+			return;
+		}
+	}
+
+	auto geo = meshFile.CreateGeometry("skullGeo",
+		device->GetD3DDevice().Get(), device->GetCommandList().Get());
+
+	mGeometries[geo->Name] = std::move(geo);
+}
+
+bool SkinningApp::ConvertSkullGeometry(const std::wstring& meshFilename)
 {
 	std::ifstream fin("Models/skull.txt");
 
 	if (!fin)
 	{
 		MessageBox(0, L"Models / skull.txt not found.", 0, 0);
-		return;
+		return false;
 	}
 
 	UINT vcount = 0;
@@ -1123,43 +1149,23 @@ void SkinningApp::BuildSkullGeometry()
 
 	fin.close();
 
-	//
-	// Pack the indices of all the meshes into one index buffer.
-	//
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "skullGeo";
-
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
-
-	SubmeshGeometry submesh;
+	MeshFileSubmesh submesh;
+	submesh.SetName("skull");
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 	submesh.Bounds = bounds;
 
-	geo->DrawArgs["skull"] = submesh;
+	if (!MeshFile::Write(meshFilename, L"Models/skull.txt",
+		vertices.data(), sizeof(Vertex), (UINT)vertices.size(),
+		indices.data(), DXGI_FORMAT_R32_UINT, (UINT)indices.size(),
+		{ submesh }))
+	{
+		MessageBox(0, (L"Could not write " + meshFilename).c_str(), 0, 0);
+		return false;
+	}
 
-	mGeometries[geo->Name] = std::move(geo);
+	return true;
 }
 
 void SkinningApp::LoadSkinnedModel()
@@ -1168,14 +1174,12 @@ void SkinningApp::LoadSkinnedModel()
 	std::vector<std::uint16_t> indices;
 
 	M3DLoader m3dLoader;
+	m3dLoader.SetBinarySidecarEnabled(true);
 	m3dLoader.LoadM3d(mSkinnedModelFilename, vertices, indices,
 		mSkinnedSubsets, mSkinnedMats, mSkinnedInfo);
 
-	mSkinnedModelInst = std::make_unique<SkinnedModelInstance>();
-	mSkinnedModelInst->SkinnedInfo = &mSkinnedInfo;
-	mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
-	mSkinnedModelInst->ClipName = "Take1";
-	mSkinnedModelInst->TimePos = 0.0f;
+	mSkinnedAnimations = std::make_unique<SkinnedAnimationBatch>(mSkinnedInfo);
+	mSkinnedAnimations->AddInstance(mSkinnedInfo.FindClip("Take1"));
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(SkinnedVertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
@@ -1676,9 +1680,9 @@ void SkinningApp::BuildRenderItems()
 		ritem->BaseVertexLocation = ritem->Geo->DrawArgs[submeshName].BaseVertexLocation;
 
 		// All render items for this solider.m3d instance share
-		// the same skinned model instance.
+		// the same instance of the animation batch.
 		ritem->SkinnedCBIndex = 0;
-		ritem->SkinnedModelInst = mSkinnedModelInst.get();
+		ritem->SkinnedAnimations = mSkinnedAnimations.get();
 
 		mRitemLayer[(int)RenderLayer::SkinnedOpaque].push_back(ritem.get());
 		mAllRitems.push_back(std::move(ritem));
@@ -1706,7 +1710,7 @@ void SkinningApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std:
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-		if (ri->SkinnedModelInst != nullptr)
+		if (ri->SkinnedAnimations != nullptr)
 		{
 			D3D12_GPU_VIRTUAL_ADDRESS skinnedCBAddress = skinnedCB->GetGPUVirtualAddress() + ri->SkinnedCBIndex * skinnedCBByteSize;
 			cmdList->SetGraphicsRootConstantBufferView(1, skinnedCBAddress);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SkinnedData.h"
+#include "SkinnedAnimationBatch.h"
 #include "../Common/MainWindow.h"
 #include "../Common/MathHelper.h"
 #include "../Common/DxUtil.h"
@@ -9,34 +10,11 @@
 #include "M3dLoader.h"
 #include "ShadowMap.h"
 #include "../Common/Camera.h"
+#include "../Common/MeshFile.h"
 #include "Ssao.h"
 
 extern const int gNumFrameResources;
 
-struct SkinnedModelInstance
-{
-	SkinnedData* SkinnedInfo = nullptr;
-	std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
-	std::string ClipName;
-	float TimePos = 0.0f;
-
-	// Called every frame and increments the time position, interpolates the 
-	// animations for each bone based on the current animation clip, and 
-	// generates the final transforms which are ultimately set to the effect
-	// for processing in the vertex shader.
-	void UpdateSkinnedAnimation(float dt)
-	{
-		TimePos += dt;
-
-		// Loop animation
-		if (TimePos > SkinnedInfo->GetClipEndTime(ClipName))
-			TimePos = 0.0f;
-
-		// Compute the final transforms for this time position.
-		SkinnedInfo->GetFinalTransforms(ClipName, TimePos, FinalTransforms);
-	}
-};
-
 struct RenderItem
 {
 	RenderItem() = default;
@@ -67,11 +45,12 @@ struct RenderItem
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
 
-	// Only applicable to skinned render-items.
+	// Only applicable to skinned render-items: the instance in SkinnedAnimations,
+	// which is also its index into the skinned constant buffer.
 	UINT SkinnedCBIndex = -1;
 
 	// nullptr if this render-item is not animated by skinned mesh.
-	SkinnedModelInstance* SkinnedModelInst = nullptr;
+	SkinnedAnimationBatch* SkinnedAnimations = nullptr;
 };
 
 enum class RenderLayer : int
@@ -117,6 +96,7 @@ private:
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
 	void BuildSkullGeometry();
+	bool ConvertSkullGeometry(const std::wstring& meshFilename);
 	void LoadSkinnedModel();
 	void BuildPSOs();
 	void BuildFrameResources();
@@ -178,8 +158,8 @@ private:
 
 	UINT mSkinnedSrvHeapStart = 0;
 	std::string mSkinnedModelFilename = "Models\\soldier.m3d";
-	std::unique_ptr<SkinnedModelInstance> mSkinnedModelInst;
 	SkinnedData mSkinnedInfo;
+	std::unique_ptr<SkinnedAnimationBatch> mSkinnedAnimations;
 	std::vector<M3DLoader::Subset> mSkinnedSubsets;
 	std::vector<M3DLoader::M3dMaterial> mSkinnedMats;
 	std::vector<std::string> mSkinnedTextureNames;
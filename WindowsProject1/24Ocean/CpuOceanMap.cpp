@@ -0,0 +1,602 @@
+#include "CpuOceanMap.h"
+#include "../Common/JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_OCEAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// The shaders' constants.  OceanCompute.hlsl has its own, shorter PI for the
+	// twiddle factors, and using it here keeps the two transforms close.
+	const float Pi = 3.1415926536f;
+	const float FftPi = 3.141592f;
+	const float Epsilon = 0.0001f;
+	const float G = 9.81f;
+
+	// Rows of the displacement planes per transpose tile.
+	const int TileSize = 32;
+
+	// Floats of padding after each row of the first pass.  Without it the column
+	// reads of the transpose are a power of two apart and fall into the same few
+	// cache sets.
+	const int RowPassPadding = 16;
+
+	struct Complex
+	{
+		float Re;
+		float Im;
+	};
+
+	Complex ComplexMul(Complex c1, Complex c2)
+	{
+		return { c1.Re * c2.Re - c1.Im * c2.Im, c1.Re * c2.Im + c2.Re * c1.Im };
+	}
+
+	//
+	// OceanUtil.hlsl
+	//
+
+	float Dispersion(int n, int m, int res, float len)
+	{
+		float w = 2.0f * Pi / len;
+		float kx = Pi * (2 * n - res) / len;
+		float kz = Pi * (2 * m - res) / len;
+		return floorf(sqrtf(G * sqrtf(kx * kx + kz * kz)) / w) * w;
+	}
+
+	float Phillips(int n, int m, float amp, float windX, float windZ, int res, float len)
+	{
+		float kx = 2.0f * Pi * (n - 0.5f * res) / len;
+		float kz = 2.0f * Pi * (m - 0.5f * res) / len;
+
+		float kLen = sqrtf(kx * kx + kz * kz);
+		if (kLen < Epsilon)
+			return 0;
+
+		float kLen2 = kLen * kLen;
+		float kLen4 = kLen2 * kLen2;
+
+		float wlen = sqrtf(windX * windX + windZ * windZ);
+		float kDotW = (kx * windX + kz * windZ) / (kLen * wlen);
+		float kDotW2 = kDotW * kDotW;
+
+		float l = wlen * wlen / G;
+		float l2 = l * l;
+		float damping = 0.001f;
+		float L2 = l2 * damping * damping;
+
+		return amp * expf(-1 / (kLen2 * l2)) / kLen4 * kDotW2 * expf(-kLen2 * L2);
+	}
+
+	float Mod(float x, float y)
+	{
+		return x - y * floorf(x / y);
+	}
+
+	float Frac(float x)
+	{
+		return x - floorf(x);
+	}
+
+	float Rand(float u, float v, float randSeed)
+	{
+		float result = sinf(Mod(12345678.f, u * (12.9898f * 2.0f) + v * (78.233f * 2.0f))) * (43758.5453f + randSeed);
+		return Frac(result);
+	}
+
+	Complex RandNegative1ToPositive1(float u, float v, float randSeed)
+	{
+		// At (0, 0) the hash is NaN, which compares false like on the GPU.
+		float isNegative = Rand(u, v, randSeed);
+		Complex r = {
+			Rand(u + 31.2452f, v + 27.6354f, randSeed),
+			Rand(u + 11.67834f, v + 51.3214f, randSeed) };
+
+		if (isNegative > 0.5f)
+		{
+			r.Re = -r.Re;
+			r.Im = -r.Im;
+		}
+
+		return r;
+	}
+
+	Complex HTilde0(int n, int m, float amp, float windX, float windZ, int res, float len, float randSeed)
+	{
+		Complex r = RandNegative1ToPositive1((float)n, (float)m, randSeed);
+		float scale = sqrtf(Phillips(n, m, amp, windX, windZ, res, len) / 2.0f);
+		return { r.Re * scale, r.Im * scale };
+	}
+
+	//
+	// Butterflies.  Both paths take a radix-2 DIT row in bit-reversed order and
+	// merge two radix-2 stages into one radix-4 pass: with a = x0, b = W^2j x1,
+	// c = W^j x2 and d = W^3j x3 the outputs are
+	//
+	//   x0 = (a + b) + (c + d)     x1 = (a - b) - i(c - d)
+	//   x2 = (a + b) - (c + d)     x3 = (a - b) + i(c - d)
+	//
+	// W = e^(-2 pi i / 4h) is the sign the shader uses for its inverse transform.
+	//
+
+	struct TwiddleTables
+	{
+		const float* W1Re;
+		const float* W1Im;
+		const float* W2Re;
+		const float* W2Im;
+		const float* W3Re;
+		const float* W3Im;
+	};
+
+	void Radix2StageScalar(float* re, float* im, int size)
+	{
+		for (int i = 0; i < size; i += 2)
+		{
+			const float aRe = re[i];
+			const float aIm = im[i];
+			const float bRe = re[i + 1];
+			const float bIm = im[i + 1];
+
+			re[i] = aRe + bRe;
+			im[i] = aIm + bIm;
+			re[i + 1] = aRe - bRe;
+			im[i + 1] = aIm - bIm;
+		}
+	}
+
+	void Radix4ButterfliesScalar(float* re, float* im, int h, const TwiddleTables& w)
+	{
+		for (int j = 0; j < h; ++j)
+		{
+			const int i0 = j;
+			const int i1 = j + h;
+			const int i2 = j + 2 * h;
+			const int i3 = j + 3 * h;
+
+			const float aRe = re[i0];
+			const float aIm = im[i0];
+			const float bRe = re[i1] * w.W2Re[j] - im[i1] * w.W2Im[j];
+			const float bIm = re[i1] * w.W2Im[j] + im[i1] * w.W2Re[j];
+			const float cRe = re[i2] * w.W1Re[j] - im[i2] * w.W1Im[j];
+			const float cIm = re[i2] * w.W1Im[j] + im[i2] * w.W1Re[j];
+			const float dRe = re[i3] * w.W3Re[j] - im[i3] * w.W3Im[j];
+			const float dIm = re[i3] * w.W3Im[j] + im[i3] * w.W3Re[j];
+
+			const float t0Re = aRe + bRe;
+			const float t0Im = aIm + bIm;
+			const float t1Re = aRe - bRe;
+			const float t1Im = aIm - bIm;
+			const float t2Re = cRe + dRe;
+			const float t2Im = cIm + dIm;
+			const float t3Re = cRe - dRe;
+			const float t3Im = cIm - dIm;
+
+			re[i0] = t0Re + t2Re;
+			im[i0] = t0Im + t2Im;
+			re[i2] = t0Re - t2Re;
+			im[i2] = t0Im - t2Im;
+
+			// -i * t3 = (t3.Im, -t3.Re)
+			re[i1] = t1Re + t3Im;
+			im[i1] = t1Im - t3Re;
+			re[i3] = t1Re - t3Im;
+			im[i3] = t1Im + t3Re;
+		}
+	}
+
+#if defined(CPU_OCEAN_X86)
+	// Four butterflies per iteration; h must be a multiple of 4.
+	void Radix4ButterfliesSse(float* re, float* im, int h, const TwiddleTables& w)
+	{
+		for (int j = 0; j < h; j += 4)
+		{
+			float* re0 = re + j;
+			float* im0 = im + j;
+			float* re1 = re0 + h;
+			float* im1 = im0 + h;
+			float* re2 = re1 + h;
+			float* im2 = im1 + h;
+			float* re3 = re2 + h;
+			float* im3 = im2 + h;
+
+			const __m128 x1Re = _mm_loadu_ps(re1);
+			const __m128 x1Im = _mm_loadu_ps(im1);
+			const __m128 x2Re = _mm_loadu_ps(re2);
+			const __m128 x2Im = _mm_loadu_ps(im2);
+			const __m128 x3Re = _mm_loadu_ps(re3);
+			const __m128 x3Im = _mm_loadu_ps(im3);
+
+			const __m128 w1Re = _mm_loadu_ps(w.W1Re + j);
+			const __m128 w1Im = _mm_loadu_ps(w.W1Im + j);
+			const __m128 w2Re = _mm_loadu_ps(w.W2Re + j);
+			const __m128 w2Im = _mm_loadu_ps(w.W2Im + j);
+			const __m128 w3Re = _mm_loadu_ps(w.W3Re + j);
+			const __m128 w3Im = _mm_loadu_ps(w.W3Im + j);
+
+			const __m128 aRe = _mm_loadu_ps(re0);
+			const __m128 aIm = _mm_loadu_ps(im0);
+			const __m128 bRe = _mm_sub_ps(_mm_mul_ps(x1Re, w2Re), _mm_mul_ps(x1Im, w2Im));
+			const __m128 bIm = _mm_add_ps(_mm_mul_ps(x1Re, w2Im), _mm_mul_ps(x1Im, w2Re));
+			const __m128 cRe = _mm_sub_ps(_mm_mul_ps(x2Re, w1Re), _mm_mul_ps(x2Im, w1Im));
+			const __m128 cIm = _mm_add_ps(_mm_mul_ps(x2Re, w1Im), _mm_mul_ps(x2Im, w1Re));
+			const __m128 dRe = _mm_sub_ps(_mm_mul_ps(x3Re, w3Re), _mm_mul_ps(x3Im, w3Im));
+			const __m128 dIm = _mm_add_ps(_mm_mul_ps(x3Re, w3Im), _mm_mul_ps(x3Im, w3Re));
+
+			const __m128 t0Re = _mm_add_ps(aRe, bRe);
+			const __m128 t0Im = _mm_add_ps(aIm, bIm);
+			const __m128 t1Re = _mm_sub_ps(aRe, bRe);
+			const __m128 t1Im = _mm_sub_ps(aIm, bIm);
+			const __m128 t2Re = _mm_add_ps(cRe, dRe);
+			const __m128 t2Im = _mm_add_ps(cIm, dIm);
+			const __m128 t3Re = _mm_sub_ps(cRe, dRe);
+			const __m128 t3Im = _mm_sub_ps(cIm, dIm);
+
+			_mm_storeu_ps(re0, _mm_add_ps(t0Re, t2Re));
+			_mm_storeu_ps(im0, _mm_add_ps(t0Im, t2Im));
+			_mm_storeu_ps(re2, _mm_sub_ps(t0Re, t2Re));
+			_mm_storeu_ps(im2, _mm_sub_ps(t0Im, t2Im));
+			_mm_storeu_ps(re1, _mm_add_ps(t1Re, t3Im));
+			_mm_storeu_ps(im1, _mm_sub_ps(t1Im, t3Re));
+			_mm_storeu_ps(re3, _mm_sub_ps(t1Re, t3Im));
+			_mm_storeu_ps(im3, _mm_add_ps(t1Im, t3Re));
+		}
+	}
+#endif
+}
+
+CpuOceanMap::CpuOceanMap(int size)
+	: mSize(size)
+{
+	assert(size >= 4 && (size & (size - 1)) == 0);
+
+	while ((1 << mLog2Size) < size)
+		++mLog2Size;
+
+	mPlaneSize = (std::size_t)size * size;
+	mRowPassStride = size + RowPassPadding;
+	mRowPassPlaneSize = (std::size_t)mRowPassStride * size;
+
+	//
+	// Bit reversal with log2(size) bits, as in BitReversal of OceanCompute.hlsl.
+	//
+
+	mBitReverse.resize(size);
+	for (int x = 0; x < size; ++x)
+	{
+		int rev = 0;
+		for (int j = 1, target = x; j < size; j <<= 1, target >>= 1)
+			rev = (rev << 1) + (target & 1);
+
+		mBitReverse[x] = rev;
+	}
+
+	//
+	// Twiddle factors.  A radix-4 pass of half size h does the work of the
+	// shader's stages of length 2h and 4h, so its angles are taken from those.
+	//
+
+	for (int h = (mLog2Size % 2 == 1) ? 2 : 1; h < size; h *= 4)
+	{
+		Radix4Stage stage;
+		stage.Half = h;
+		stage.TwiddleOffset = mTwiddle1Re.size();
+		mRadix4Stages.push_back(stage);
+
+		for (int j = 0; j < h; ++j)
+		{
+			const double theta1 = -2.0 * FftPi * j / (4 * h);
+			const double theta2 = -2.0 * FftPi * j / (2 * h);
+			const double theta3 = -2.0 * FftPi * 3 * j / (4 * h);
+
+			mTwiddle1Re.push_back((float)std::cos(theta1));
+			mTwiddle1Im.push_back((float)std::sin(theta1));
+			mTwiddle2Re.push_back((float)std::cos(theta2));
+			mTwiddle2Im.push_back((float)std::sin(theta2));
+			mTwiddle3Re.push_back((float)std::cos(theta3));
+			mTwiddle3Im.push_back((float)std::sin(theta3));
+		}
+	}
+
+	mHTilde0Re.assign(NUM_OCEAN_BASIS * mPlaneSize, 0.0f);
+	mHTilde0Im.assign(NUM_OCEAN_BASIS * mPlaneSize, 0.0f);
+	mHTilde0ConjRe.assign(NUM_OCEAN_BASIS * mPlaneSize, 0.0f);
+	mHTilde0ConjIm.assign(NUM_OCEAN_BASIS * mPlaneSize, 0.0f);
+	mHTildeRe.assign(NUM_OCEAN_FREQUENCY * mPlaneSize, 0.0f);
+	mHTildeIm.assign(NUM_OCEAN_FREQUENCY * mPlaneSize, 0.0f);
+	mRowPassRe.assign(NUM_OCEAN_FREQUENCY * mRowPassPlaneSize, 0.0f);
+	mRowPassIm.assign(NUM_OCEAN_FREQUENCY * mRowPassPlaneSize, 0.0f);
+	mDisplacementRe.assign(NUM_OCEAN_FREQUENCY * mPlaneSize, 0.0f);
+	mDisplacementIm.assign(NUM_OCEAN_FREQUENCY * mPlaneSize, 0.0f);
+
+	SetFftPath(FftPath::Auto);
+}
+
+int CpuOceanMap::GetSize()const
+{
+	return mSize;
+}
+
+void CpuOceanMap::SetAmplitude(float amplitude)
+{
+	mAmplitude = amplitude;
+}
+
+void CpuOceanMap::SetWind(float windX, float windZ)
+{
+	mWindX = windX;
+	mWindZ = windZ;
+}
+
+void CpuOceanMap::SetWaveLength(float waveLength)
+{
+	mWaveLength = waveLength;
+}
+
+void CpuOceanMap::SetFftPath(FftPath path)
+{
+#if defined(CPU_OCEAN_X86)
+	if (path == FftPath::Auto)
+		path = FftPath::Sse;
+#else
+	path = FftPath::Scalar;
+#endif
+
+	mFftPath = path;
+}
+
+CpuOceanMap::FftPath CpuOceanMap::GetFftPath()const
+{
+	return mFftPath;
+}
+
+void CpuOceanMap::BuildOceanBasis()
+{
+	const int size = mSize;
+
+	JobSystem::Default().ParallelFor(0, NUM_OCEAN_BASIS * size, 0, [&](int sliceRow)
+		{
+			const int z = sliceRow / size;
+			const int y = sliceRow % size;
+			const float randSeed = 0.52743f * z;
+			const std::size_t rowStart = z * mPlaneSize + (std::size_t)y * size;
+
+			for (int x = 0; x < size; ++x)
+			{
+				const Complex h0 = HTilde0(x, y,
+					mAmplitude, mWindX, mWindZ, size, mWaveLength, randSeed);
+				const Complex beforeConj = HTilde0(size - x, size - y,
+					mAmplitude, mWindX, mWindZ, size, mWaveLength, randSeed);
+
+				mHTilde0Re[rowStart + x] = h0.Re;
+				mHTilde0Im[rowStart + x] = h0.Im;
+				mHTilde0ConjRe[rowStart + x] = beforeConj.Re;
+				mHTilde0ConjIm[rowStart + x] = beforeConj.Im;
+			}
+		});
+}
+
+void CpuOceanMap::SetOceanBasis(const float* hTilde0Texels, const float* hTilde0ConjTexels)
+{
+	for (std::size_t i = 0; i < NUM_OCEAN_BASIS * mPlaneSize; ++i)
+	{
+		mHTilde0Re[i] = hTilde0Texels[4 * i + 0];
+		mHTilde0Im[i] = hTilde0Texels[4 * i + 1];
+		mHTilde0ConjRe[i] = hTilde0ConjTexels[4 * i + 0];
+		mHTilde0ConjIm[i] = hTilde0ConjTexels[4 * i + 1];
+	}
+}
+
+void CpuOceanMap::ComputeOceanFrequency(float waveTime)
+{
+	const int size = mSize;
+
+	JobSystem::Default().ParallelFor(0, size, 0, [&](int y)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				const std::size_t texel = (std::size_t)y * size + x;
+
+				const float omegat = Dispersion(x, y, size, mWaveLength) * waveTime * 0.1f;
+				const Complex c0 = { cosf(omegat), sinf(omegat) };
+				const Complex c1 = { c0.Re, -c0.Im };
+
+				const float kx = Pi * (2.0f * x - size);
+				const float kz = Pi * (2.0f * y - size);
+
+				// The shader divides the integer thread id by the unsigned size, which
+				// truncates to zero, so its x is always (-0.5, -0.5).
+				const float kDotX = -0.5f * kx - 0.5f * kz;
+				const Complex kDotXComplex = { cosf(kDotX), sinf(kDotX) };
+
+				const float delta = 1.0f / size;
+				const float kDotDx = kx * delta;
+				const float kDotDz = kz * delta;
+				const Complex ikDx = { cosf(kDotDx), sinf(kDotDx) };
+				const Complex ikDz = { cosf(kDotDz), sinf(kDotDz) };
+
+				const float len = sqrtf(kx * kx + kz * kz);
+
+				for (int basis = 0; basis < NUM_OCEAN_BASIS; ++basis)
+				{
+					const std::size_t basisTexel = basis * mPlaneSize + texel;
+					const Complex h0 = { mHTilde0Re[basisTexel], mHTilde0Im[basisTexel] };
+					const Complex h0Conj = { mHTilde0ConjRe[basisTexel], mHTilde0ConjIm[basisTexel] };
+
+					const Complex a = ComplexMul(h0, c0);
+					const Complex b = ComplexMul(h0Conj, c1);
+					Complex res = ComplexMul({ a.Re + b.Re, a.Im + b.Im }, kDotXComplex);
+
+					// Horizontal displacements.
+					if (basis == 0 || basis == 2)
+					{
+						if (len < 0.00001f)
+							res = { 0.0f, 0.0f };
+						else
+							res = ComplexMul(res, { 0.0f, -(basis == 0 ? kx : kz) / len });
+					}
+
+					const Complex slopeX = ComplexMul(res, ikDx);
+					const Complex slopeZ = ComplexMul(res, ikDz);
+
+					const std::size_t slice0 = basis * mPlaneSize + texel;
+					const std::size_t slice1 = (NUM_OCEAN_BASIS + basis) * mPlaneSize + texel;
+					const std::size_t slice2 = (2 * NUM_OCEAN_BASIS + basis) * mPlaneSize + texel;
+
+					mHTildeRe[slice0] = res.Re;
+					mHTildeIm[slice0] = res.Im;
+					mHTildeRe[slice1] = slopeX.Re - res.Re;
+					mHTildeIm[slice1] = slopeX.Im - res.Im;
+					mHTildeRe[slice2] = slopeZ.Re - res.Re;
+					mHTildeIm[slice2] = slopeZ.Im - res.Im;
+				}
+			}
+		});
+}
+
+void CpuOceanMap::ComputeOceanDisplacement()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	const int size = mSize;
+	const int sizeHalf = size / 2;
+	const float scale = 1.0f / size;
+	JobSystem& jobSystem = JobSystem::Default();
+
+	//
+	// First pass: shift, bit-reverse and scale each row of h~(t), then transform it.
+	//
+
+	jobSystem.ParallelFor(0, NUM_OCEAN_FREQUENCY * size, 0, [&](int sliceRow)
+		{
+			const int z = sliceRow / size;
+			const int y = sliceRow % size;
+			const std::size_t srcRow = z * mPlaneSize + (std::size_t)((y + sizeHalf) % size) * size;
+			const std::size_t dstRow = z * mRowPassPlaneSize + (std::size_t)y * mRowPassStride;
+
+			const float* srcRe = &mHTildeRe[srcRow];
+			const float* srcIm = &mHTildeIm[srcRow];
+			float* dstRe = &mRowPassRe[dstRow];
+			float* dstIm = &mRowPassIm[dstRow];
+
+			for (int x = 0; x < size; ++x)
+			{
+				const int srcX = (x + sizeHalf) & (size - 1);
+				dstRe[mBitReverse[x]] = srcRe[srcX] * scale;
+				dstIm[mBitReverse[x]] = srcIm[srcX] * scale;
+			}
+
+			TransformRow(dstRe, dstIm);
+		});
+
+	//
+	// Second pass: transpose a band of rows in tiles, bit-reversing and scaling
+	// again, then transform the rows of the band.
+	//
+
+	const int bandCount = (size + TileSize - 1) / TileSize;
+	jobSystem.ParallelFor(0, NUM_OCEAN_FREQUENCY * bandCount, 1, [&](int sliceBand)
+		{
+			const int z = sliceBand / bandCount;
+			const int firstRow = (sliceBand % bandCount) * TileSize;
+			const int lastRow = std::min(firstRow + TileSize, size);
+			const std::size_t slice = z * mPlaneSize;
+			const std::size_t rowPassSlice = z * mRowPassPlaneSize;
+
+			for (int tileX = 0; tileX < size; tileX += TileSize)
+			{
+				const int lastX = std::min(tileX + TileSize, size);
+
+				for (int row = firstRow; row < lastRow; ++row)
+				{
+					float* dstRe = &mDisplacementRe[slice + (std::size_t)row * size];
+					float* dstIm = &mDisplacementIm[slice + (std::size_t)row * size];
+
+					for (int x = tileX; x < lastX; ++x)
+					{
+						const std::size_t src = rowPassSlice + (std::size_t)x * mRowPassStride + row;
+						dstRe[mBitReverse[x]] = mRowPassRe[src] * scale;
+						dstIm[mBitReverse[x]] = mRowPassIm[src] * scale;
+					}
+				}
+			}
+
+			for (int row = firstRow; row < lastRow; ++row)
+			{
+				TransformRow(&mDisplacementRe[slice + (std::size_t)row * size],
+					&mDisplacementIm[slice + (std::size_t)row * size]);
+			}
+		});
+
+	mLastFftSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CpuOceanMap::Update(float waveTime)
+{
+	ComputeOceanFrequency(waveTime);
+	ComputeOceanDisplacement();
+}
+
+CpuOceanMap::ComplexPlane CpuOceanMap::GetHTilde0(int slice)const
+{
+	assert(slice >= 0 && slice < NUM_OCEAN_BASIS);
+	return { &mHTilde0Re[slice * mPlaneSize], &mHTilde0Im[slice * mPlaneSize] };
+}
+
+CpuOceanMap::ComplexPlane CpuOceanMap::GetHTilde0Conj(int slice)const
+{
+	assert(slice >= 0 && slice < NUM_OCEAN_BASIS);
+	return { &mHTilde0ConjRe[slice * mPlaneSize], &mHTilde0ConjIm[slice * mPlaneSize] };
+}
+
+CpuOceanMap::ComplexPlane CpuOceanMap::GetHTilde(int slice)const
+{
+	assert(slice >= 0 && slice < NUM_OCEAN_FREQUENCY);
+	return { &mHTildeRe[slice * mPlaneSize], &mHTildeIm[slice * mPlaneSize] };
+}
+
+CpuOceanMap::ComplexPlane CpuOceanMap::GetDisplacement(int slice)const
+{
+	assert(slice >= 0 && slice < NUM_OCEAN_FREQUENCY);
+	return { &mDisplacementRe[slice * mPlaneSize], &mDisplacementIm[slice * mPlaneSize] };
+}
+
+double CpuOceanMap::GetLastFftSeconds()const
+{
+	return mLastFftSeconds;
+}
+
+void CpuOceanMap::TransformRow(float* re, float* im)const
+{
+	const int size = mSize;
+
+	if (mLog2Size % 2 == 1)
+		Radix2StageScalar(re, im, size);
+
+	for (const Radix4Stage& stage : mRadix4Stages)
+	{
+		const int h = stage.Half;
+		const TwiddleTables w = {
+			&mTwiddle1Re[stage.TwiddleOffset], &mTwiddle1Im[stage.TwiddleOffset],
+			&mTwiddle2Re[stage.TwiddleOffset], &mTwiddle2Im[stage.TwiddleOffset],
+			&mTwiddle3Re[stage.TwiddleOffset], &mTwiddle3Im[stage.TwiddleOffset] };
+
+		for (int block = 0; block < size; block += 4 * h)
+		{
+#if defined(CPU_OCEAN_X86)
+			if (mFftPath == FftPath::Sse && h % 4 == 0)
+			{
+				Radix4ButterfliesSse(re + block, im + block, h, w);
+				continue;
+			}
+#endif
+			Radix4ButterfliesScalar(re + block, im + block, h, w);
+		}
+	}
+}
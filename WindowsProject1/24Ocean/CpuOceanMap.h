@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// CPU version of the OceanMap compute chain.  BuildOceanBasis,
+// ComputeOceanFrequency and ComputeOceanDisplacement produce the planes that
+// OceanBasis.hlsl, OceanFrequency.hlsl and the Shift/BitReversal/Fft1d/Transpose
+// passes of OceanCompute.hlsl write, so it can check the shaders and stand in
+// for them where there is no GPU.  It only depends on the standard library and
+// the job system.
+//
+// Every plane is a size x size row-major float array, texel (x, y) at y * size + x.
+// The shaders keep complex values in the xy of a float4; here the real and
+// imaginary parts are separate planes.  Slices are numbered like the slices of
+// the texture arrays.
+//
+// The 2D transform is a row pass, a blocked transpose and a second row pass, as
+// on the GPU.  The shift, the bit reversal and the 1 / size scale are folded
+// into the copies that feed each row pass, and rows are transformed with
+// radix-4 butterflies (plus one radix-2 stage when log2(size) is odd) from
+// precomputed twiddle tables.  Rows are spread over the job system.
+class CpuOceanMap
+{
+public:
+	// Selects the butterfly kernels.  Auto picks SSE where the CPU has it; the
+	// explicit paths exist so the SIMD kernels can be validated against the scalar one.
+	enum class FftPath
+	{
+		Auto,
+		Scalar,
+		Sse
+	};
+
+	struct ComplexPlane
+	{
+		const float* Real = nullptr;
+		const float* Imag = nullptr;
+	};
+
+	// size must be a power of two, at least 4.
+	explicit CpuOceanMap(int size);
+	CpuOceanMap(const CpuOceanMap& rhs) = delete;
+	CpuOceanMap& operator=(const CpuOceanMap& rhs) = delete;
+	~CpuOceanMap() = default;
+
+	static constexpr int NUM_OCEAN_BASIS = 3; // x, y, z
+	static constexpr int NUM_OCEAN_FREQUENCY = 9; // x, y, z, slopex(x, y, z), slopez(x, y, z)
+
+	int GetSize()const;
+
+	// Defaults are the constants OceanMap passes to the shaders.
+	void SetAmplitude(float amplitude);
+	void SetWind(float windX, float windZ);
+	void SetWaveLength(float waveLength);
+
+	void SetFftPath(FftPath path);
+	FftPath GetFftPath()const;
+
+	// h~0 and the h~0 of the opposite wave vector, as OceanBasisCS computes them.
+	void BuildOceanBasis();
+
+	// Takes h~0 from a readback of OceanMap instead: NUM_OCEAN_BASIS slices of
+	// size x size float4 texels each.  The random phases of the shader come from
+	// a hash that amplifies last-bit differences of sin, so comparisons of the
+	// later stages should start from the GPU's basis.
+	void SetOceanBasis(const float* hTilde0Texels, const float* hTilde0ConjTexels);
+
+	// h~(t) of every slice, as HTildeCS computes them.
+	void ComputeOceanFrequency(float waveTime);
+
+	// Inverse transform of h~(t).  The result is laid out like displacement map 1
+	// of OceanMap, the one GetGpuDisplacementMapSrv returns and the ocean is drawn
+	// with, which holds the transform transposed.
+	void ComputeOceanDisplacement();
+
+	// ComputeOceanFrequency followed by ComputeOceanDisplacement.
+	void Update(float waveTime);
+
+	ComplexPlane GetHTilde0(int slice)const;
+	ComplexPlane GetHTilde0Conj(int slice)const;
+	ComplexPlane GetHTilde(int slice)const;
+	ComplexPlane GetDisplacement(int slice)const;
+
+	// Wall-clock time of the last ComputeOceanDisplacement, for profiling.
+	double GetLastFftSeconds()const;
+
+private:
+	struct Radix4Stage
+	{
+		int Half = 0;
+		std::size_t TwiddleOffset = 0;
+	};
+
+	void TransformRow(float* re, float* im)const;
+
+	int mSize = 0;
+	int mLog2Size = 0;
+	std::size_t mPlaneSize = 0;
+	int mRowPassStride = 0;
+	std::size_t mRowPassPlaneSize = 0;
+
+	float mAmplitude = 1.0f;
+	float mWindX = 1.0f;
+	float mWindZ = 0.5f;
+	float mWaveLength = 1.0f;
+
+	FftPath mFftPath = FftPath::Scalar;
+
+	std::vector<int> mBitReverse;
+
+	// W^j, W^2j and W^3j of every radix-4 stage, j < Half, one after another.
+	std::vector<Radix4Stage> mRadix4Stages;
+	std::vector<float> mTwiddle1Re;
+	std::vector<float> mTwiddle1Im;
+	std::vector<float> mTwiddle2Re;
+	std::vector<float> mTwiddle2Im;
+	std::vector<float> mTwiddle3Re;
+	std::vector<float> mTwiddle3Im;
+
+	std::vector<float> mHTilde0Re;
+	std::vector<float> mHTilde0Im;
+	std::vector<float> mHTilde0ConjRe;
+	std::vector<float> mHTilde0ConjIm;
+	std::vector<float> mHTildeRe;
+	std::vector<float> mHTildeIm;
+
+	// Rows after the first pass, mRowPassStride floats apart.
+	std::vector<float> mRowPassRe;
+	std::vector<float> mRowPassIm;
+
+	std::vector<float> mDisplacementRe;
+	std::vector<float> mDisplacementIm;
+
+	double mLastFftSeconds = 0.0;
+};
@@ -1,18 +1,21 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
         IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
-
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    SsaoCB = std::make_unique<UploadBuffer<SsaoConstants>>(device, 1, true);
-    MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, materialCount, false);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
 }
 
 FrameResource::~FrameResource()
 {
 
+}
+
+void FrameResource::AllocateBuffers(UploadRing& ring, UINT passCount, UINT objectCount, UINT materialCount)
+{
+    PassCB = ring.AllocateConstants<PassConstants>(passCount);
+    SsaoCB = ring.AllocateConstants<SsaoConstants>(1);
+    MaterialBuffer = ring.AllocateStructured<MaterialData>(materialCount);
+    ObjectCB = ring.AllocateConstants<ObjectConstants>(objectCount);
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "../Common/MathHelper.h"
-#include "../Common/UploadBuffer.h"
+#include "../Common/UploadRing.h"
 
 struct ObjectConstants
 {
@@ -83,7 +83,7 @@ struct Vertex
 // for a frame.  
 struct FrameResource
 {
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -92,13 +92,17 @@ struct FrameResource
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
+    // Takes this frame's cbuffers and material buffer from the upload ring.  The
+    // ring hands out fresh memory every frame, so all of them must be written.
+    void AllocateBuffers(UploadRing& ring, UINT passCount, UINT objectCount, UINT materialCount);
+
     // We cannot update a cbuffer until the GPU is done processing the commands
     // that reference it.  So each frame needs their own cbuffers.
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
-    std::unique_ptr<UploadBuffer<SsaoConstants>> SsaoCB = nullptr;
+    UploadRing::Allocation PassCB;
+    UploadRing::Allocation ObjectCB;
+    UploadRing::Allocation SsaoCB;
 
-    std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
+    UploadRing::Allocation MaterialBuffer;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
@@ -38,16 +38,24 @@ bool OceanApp::Initialize()
 
 	mCamera.SetPosition(0.0f, 2.0f, -15.0f);
 
+	mUploadBatcher = std::make_unique<UploadBatcher>(device->GetD3DDevice().Get());
+	mHeapAllocator = std::make_unique<GpuHeapAllocator>(device->GetD3DDevice().Get());
+	mDescriptorAllocator = std::make_unique<DescriptorAllocator>(device->GetD3DDevice().Get(),
+		PERSISTENT_DESCRIPTOR_COUNT, TRANSIENT_DESCRIPTOR_COUNT);
+
 	mShadowMap = std::make_unique<ShadowMap>(device->GetD3DDevice().Get(),
+		mHeapAllocator.get(),
 		2048, 2048);
 
 	mSsao = std::make_unique<Ssao>(
 		device->GetD3DDevice().Get(),
+		mHeapAllocator.get(),
 		commandList.Get(),
 		device->GetClientWidth(), device->GetClientHeight());
 
 	mOceanMap = std::make_unique<OceanMap>(
 		device->GetD3DDevice().Get(),
+		mHeapAllocator.get(),
 		512,
 		512
 		);
@@ -66,11 +74,12 @@ bool OceanApp::Initialize()
 	BuildRenderItems();
 	BuildFrameResources();
 	BuildPSOs();
+	BuildRenderGraph();
 
 	mSsao->SetPSOs(mPSOs["ssao"].Get(), mPSOs["ssaoBlur"].Get());
 
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mDescriptorAllocator->GetHeap() };
 	commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
 	mOceanMap->BuildOceanBasis(
@@ -79,6 +88,9 @@ bool OceanApp::Initialize()
 		mPSOs["oceanBasis"].Get()
 	);
 
+	// Copy the static geometry in one batch.
+	mUploadBatcher->RecordCopies(commandList.Get());
+
 	// Execute the initialization commands.
 	ThrowIfFailed(commandList->Close());
 	ID3D12CommandList* cmdsLists[] = { commandList.Get() };
@@ -87,6 +99,9 @@ bool OceanApp::Initialize()
 	// Wait until initialization is complete.
 	device->FlushCommandQueue();
 
+	mUploadBatcher->Retire(device->GetCurrentFence());
+	mUploadBatcher->ReleaseCompleted(device->GetFence()->GetCompletedValue());
+
 	return true;
 }
 
@@ -102,6 +117,8 @@ void OceanApp::OnResize()
 
 		// Resources changed, so need to rebuild descriptors.
 		mSsao->RebuildDescriptors(device->GetDepthStencilBuffer());
+		mDescriptorAllocator->MarkDirty(mSsaoSrvs);
+		mDescriptorAllocator->CommitPersistent();
 	}
 }
 
@@ -125,6 +142,14 @@ void OceanApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	// Whatever the GPU has finished with goes back to the upload ring before this
+	// frame takes its buffers from it.
+	mUploadRing->BeginFrame(fence->GetCompletedValue());
+	mDescriptorAllocator->BeginFrame(fence->GetCompletedValue());
+	mUploadBatcher->ReleaseCompleted(fence->GetCompletedValue());
+	mCurrFrameResource->AllocateBuffers(*mUploadRing,
+		2, static_cast<UINT>(mAllRitems.size()), static_cast<UINT>(mMaterials.size()));
+
 	mLightRotationAngle += 0.1f * gt.DeltaTime();
 
 	XMMATRIX R = XMMatrixRotationY(mLightRotationAngle);
@@ -156,150 +181,26 @@ void OceanApp::Draw(const GameTimer& gt)
 
 	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 	// Reusing the command list reuses memory.
-	ThrowIfFailed(commandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
-
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
-	mOceanMap->ComputeOceanFrequency(
-		commandList.Get(),
-		mOceanFrequencyRootSignature.Get(),
-		mPSOs["oceanFrequency"].Get(),
-		gt.TotalTime());
-
-	mOceanMap->ComputeOceanDisplacement(
-		commandList.Get(),
-		mOceanDisplacementRootSignature.Get(),
-		mPSOs["oceanShift"].Get(),
-		mPSOs["oceanBitReversal"].Get(),
-		mPSOs["oceanFft1d"].Get(),
-		mPSOs["oceanTranspose"].Get());
-
-	commandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	//
-	// Shadow map pass.
-	//
-
-	// Bind all the mMaterials used in this scene.  For structured buffers, we can bypass the heap and 
-	// set as a root descriptor.
-	auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-	commandList->SetGraphicsRootShaderResourceView(MAIN_ROOT_SLOT_MATERIAL_SRV, matBuffer->GetGPUVirtualAddress());
-
-	// Bind null SRV for shadow map pass.
-	commandList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_CUBE_SHADOW_SSAO_TABLE, mNullSrv);
-
-	// Bind all the mTextures used in this scene.  Observe
-	// that we only have to specify the first descriptor in the table.  
-	// The root signature knows how many descriptors are expected in the table.
-	commandList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_TEXTURE_TABLE, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-
-	DrawSceneToShadowMap();
-
-	//
-	// Normal/depth pass.
-	//
-
-	DrawNormalsAndDepth();
-
-	//
-	// Compute SSAO.
-	// 
-
-	commandList->SetGraphicsRootSignature(mSsaoRootSignature.Get());
-	mSsao->ComputeSsao(commandList.Get(), mCurrFrameResource, 3);
-
-
-	//
-	// Main rendering pass.
-	//
-
-	commandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	// Rebind state whenever graphics root signature changes.
+	ThrowIfFailed(commandList->Reset(cmdListAlloc.Get(), mDrawSubmitter.GetPipeline(mOpaquePipeline)));
 
-	// Bind all the mMaterials used in this scene.  For structured buffers, we can bypass the heap and 
-	// set as a root descriptor.
-	matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-	commandList->SetGraphicsRootShaderResourceView(MAIN_ROOT_SLOT_MATERIAL_SRV, matBuffer->GetGPUVirtualAddress());
-
-
-	commandList->RSSetViewports(1, &device->GetScreenViewport());
-	commandList->RSSetScissorRects(1, &device->GetScissorRect());
-
-	auto currentBackBuffer = device->CurrentBackBuffer();
-	auto currentBackBufferView = device->CurrentBackBufferView();
-	auto depthStencilView = device->DepthStencilView();
-
-	auto barrierReset = CD3DX12_RESOURCE_BARRIER::Transition(
-		currentBackBuffer,
-		D3D12_RESOURCE_STATE_PRESENT,
-		D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-	// Indicate a state transition on the resource usage.
-	commandList->ResourceBarrier(1, &barrierReset);
-
-	// Clear the back buffer and depth buffer.
-	commandList->ClearRenderTargetView(currentBackBufferView, DirectX::Colors::LightSteelBlue, 0, nullptr);
-	commandList->ClearDepthStencilView(depthStencilView, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-	// Specify the buffers we are going to render to.
-	commandList->OMSetRenderTargets(1, &currentBackBufferView, true, &depthStencilView);
-	
-	// Bind all the mTextures used in this scene.  Observe
-	// that we only have to specify the first descriptor in the table.  
-	// The root signature knows how many descriptors are expected in the table.
-	commandList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_TEXTURE_TABLE, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	commandList->SetGraphicsRootConstantBufferView(MAIN_ROOT_SLOT_PASS_CB, passCB->GetGPUVirtualAddress());
-
-	// Bind the sky cube map.  For our demos, we just use one "world" cube map representing the environment
-	// from far away, so all objects will use the same cube map and we only need to set it once per-frame.  
-	// If we wanted to use "local" cube maps, we would have to change them per-object, or dynamically
-	// index into an array of cube maps.
-
-	CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	skyTexDescriptor.Offset(mSkyTexHeapIndex, device->GetCbvSrvUavDescriptorSize());
-	commandList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_CUBE_SHADOW_SSAO_TABLE, skyTexDescriptor);
-
-	commandList->SetPipelineState(mPSOs["opaque"].Get());
-	DrawRenderItems(commandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
-
-	//commandList->SetPipelineState(mPSOs["debugSsao"].Get());
-	//DrawRenderItems(commandList.Get(), mRitemLayer[(int)RenderLayer::DebugSsao]);
-
-	commandList->SetPipelineState(mPSOs["sky"].Get());
-	DrawRenderItems(commandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
-
-	auto oceanDisplacementDescriptor = mOceanMap->GetGpuDisplacementMapSrv();
-	commandList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_OCEAN_TABLE, oceanDisplacementDescriptor);
-
-	if(mIsWireframe)
-	{
-		commandList->SetPipelineState(mPSOs["oceanWireframe"].Get());
-	}
-	else
-	{
-		commandList->SetPipelineState(mPSOs["ocean"].Get());
-	}
-
-	DrawRenderItems(commandList.Get(), mRitemLayer[(int)RenderLayer::Ocean]);
-
-	if (mIsDebugging)
-	{
-		DrawDebugThings(commandList.Get());
-	}
+	// Geometry created since the last frame is copied before anything draws it.
+	if (mUploadBatcher->HasPendingUploads())
+		mUploadBatcher->RecordCopies(commandList.Get());
 
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mDescriptorAllocator->GetHeap() };
+	commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	auto barrierDraw = CD3DX12_RESOURCE_BARRIER::Transition(
-		currentBackBuffer,
-		D3D12_RESOURCE_STATE_RENDER_TARGET,
-		D3D12_RESOURCE_STATE_PRESENT
-	);
+	// The back buffer changes every frame, and the SSAO maps on resize.
+	mRenderGraph->SetImportedResource(mBackBufferResource, device->CurrentBackBuffer());
+	mRenderGraph->SetImportedResource(mDepthStencilResource, device->GetDepthStencilBuffer());
+	mRenderGraph->SetImportedResource(mHTildeResource, mOceanMap->HTilde());
+	mRenderGraph->SetImportedResource(mDisplacementMapResource, mOceanMap->Output());
+	mRenderGraph->SetImportedResource(mDisplacementScratchResource, mOceanMap->Scratch());
+	mRenderGraph->SetImportedResource(mShadowMapResource, mShadowMap->Resource());
+	mRenderGraph->SetImportedResource(mNormalMapResource, mSsao->NormalMap());
+	mRenderGraph->SetImportedResource(mAmbientMapResource, mSsao->AmbientMap());
 
-	// Indicate a state transition on the resource usage.
-	commandList->ResourceBarrier(1, &barrierDraw);
+	mRenderGraph->Execute(commandList.Get());
 
 	// Done recording commands.
 	ThrowIfFailed(commandList->Close());
@@ -313,6 +214,9 @@ void OceanApp::Draw(const GameTimer& gt)
 
 	// Advance the fence value to mark commands up to this fence point.
 	mCurrFrameResource->Fence = device->IncreaseFence();
+	mUploadRing->EndFrame(mCurrFrameResource->Fence);
+	mDescriptorAllocator->EndFrame(mCurrFrameResource->Fence);
+	mUploadBatcher->Retire(mCurrFrameResource->Fence);
 
 	// Add an instruction to the command queue to set a new fence point. 
 	// Because we are on the GPU timeline, the new fence point won't be 
@@ -534,40 +438,31 @@ void OceanApp::AnimateMaterials(const GameTimer& gt)
 
 void OceanApp::UpdateObjectCBs(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	// The frame's object cbuffer is fresh ring memory, so every object is written.
+	auto currObjectCB = &mCurrFrameResource->ObjectCB;
 	for (auto& e : mAllRitems)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			objConstants.MaterialIndex = e->Mat->MatCBIndex;
+		XMMATRIX world = XMLoadFloat4x4(&e->World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+		ObjectConstants objConstants;
+		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		objConstants.MaterialIndex = e->Mat->MatCBIndex;
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
+		currObjectCB->CopyData(e->ObjCBIndex, objConstants);
 	}
 }
 
 void OceanApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
-	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
+	// Like the object cbuffer, the material buffer is written in full every frame.
+	auto currMaterialBuffer = &mCurrFrameResource->MaterialBuffer;
 
 	for (auto& each : mMaterials)
 	{
 		auto mat = each.second.get();
 
-		if (mat->NumFramesDirty <= 0)
-			continue;
-		
 		XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
 		MaterialData matData;
@@ -579,8 +474,6 @@ void OceanApp::UpdateMaterialBuffer(const GameTimer& gt)
 		matData.NormalMapIndex = mat->NormalSrvHeapIndex;
 
 		currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
-
-		mat->NumFramesDirty--;
 	}
 }
 
@@ -669,7 +562,7 @@ void OceanApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.Lights[2].Direction = mRotatedLightDirections[2];
 	mMainPassCB.Lights[2].Strength = { 0.0f, 0.0f, 0.0f };
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
+	auto currPassCB = &mCurrFrameResource->PassCB;
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
@@ -698,7 +591,7 @@ void OceanApp::UpdateShadowPassCB(const GameTimer& gt)
 	mShadowPassCB.NearZ = mLightNearZ;
 	mShadowPassCB.FarZ = mLightFarZ;
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
+	auto currPassCB = &mCurrFrameResource->PassCB;
 	currPassCB->CopyData(1, mShadowPassCB);
 }
 
@@ -734,7 +627,7 @@ void OceanApp::UpdateSsaoCB(const GameTimer& gt)
 	ssaoCB.OcclusionFadeEnd = 1.0f;
 	ssaoCB.SurfaceEpsilon = 0.05f;
 
-	auto currSsaoCB = mCurrFrameResource->SsaoCB.get();
+	auto currSsaoCB = &mCurrFrameResource->SsaoCB;
 	currSsaoCB->CopyData(0, ssaoCB);
 }
 
@@ -787,7 +680,7 @@ void OceanApp::BuildRootSignature()
 	oceanTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3, 0);
 
 	CD3DX12_DESCRIPTOR_RANGE texTable1;
-	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 4, 0);
+	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, TEXTURE_TABLE_SIZE, 4, 0);
 
 	// Root parameter can be a table, root descriptor or root constants.
 	CD3DX12_ROOT_PARAMETER slotRootParameter[6];
@@ -1082,20 +975,9 @@ void OceanApp::BuildOceanDebugRootSignature()
 void OceanApp::BuildDescriptorHeaps()
 {
 	//
-	// Create the SRV heap.
+	// Views are written into persistent ranges of the descriptor allocator and
+	// copied to the shader-visible heap in one go at the end.
 	//
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 27;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(device->GetD3DDevice()->CreateDescriptorHeap(
-		&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
-
-	//
-	// Fill out the heap with actual descriptors.
-	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
 	std::vector<ComPtr<ID3D12Resource>> tex2DList =
 	{
 		mTextures["bricksDiffuseMap"]->Resource,
@@ -1106,9 +988,17 @@ void OceanApp::BuildDescriptorHeaps()
 		mTextures["defaultNormalMap"]->Resource,
 		mTextures["waterDiffuseMap"]->Resource
 	};
+	assert(tex2DList.size() <= TEXTURE_TABLE_SIZE);
 
 	auto skyCubeMap = mTextures["skyCubeMap"]->Resource;
 
+	mTextureSrvs = mDescriptorAllocator->AllocatePersistent(TEXTURE_TABLE_SIZE);
+	mSkySrv = mDescriptorAllocator->AllocatePersistent(1);
+	mShadowMapSrv = mDescriptorAllocator->AllocatePersistent(1);
+	mSsaoSrvs = mDescriptorAllocator->AllocatePersistent(Ssao::GetNumDescriptors());
+	mOceanMapSrvs = mDescriptorAllocator->AllocatePersistent(OceanMap::GetNumDescriptors());
+	mNullSrvs = mDescriptorAllocator->AllocatePersistent(3);
+
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
@@ -1119,10 +1009,7 @@ void OceanApp::BuildDescriptorHeaps()
 	{
 		srvDesc.Format = tex2DList[i]->GetDesc().Format;
 		srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-		device->GetD3DDevice()->CreateShaderResourceView(tex2DList[i].Get(), &srvDesc, hDescriptor);
-
-		// next descriptor
-		hDescriptor.Offset(1, device->GetCbvSrvUavDescriptorSize());
+		device->GetD3DDevice()->CreateShaderResourceView(tex2DList[i].Get(), &srvDesc, mTextureSrvs.GetCpuHandle(i));
 	}
 
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
@@ -1130,52 +1017,42 @@ void OceanApp::BuildDescriptorHeaps()
 	srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
 	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
 	srvDesc.Format = skyCubeMap->GetDesc().Format;
-	device->GetD3DDevice()->CreateShaderResourceView(skyCubeMap.Get(), &srvDesc, hDescriptor);
-
-	mSkyTexHeapIndex = (UINT)tex2DList.size();
-	mSsaoAmbientMapIndex = mShadowMapHeapIndex = mSkyTexHeapIndex + 1;
-	mSsaoHeapIndexStart = mShadowMapHeapIndex + 1;
-
-	mOceanMapHeapIndex = mSsaoHeapIndexStart + 5;
+	device->GetD3DDevice()->CreateShaderResourceView(skyCubeMap.Get(), &srvDesc, mSkySrv.CpuHandle);
 
 	mShadowMap->BuildDescriptors(
-		GetCpuSrv(mShadowMapHeapIndex),
-		GetGpuSrv(mShadowMapHeapIndex),
+		mShadowMapSrv.GetCpuHandle(0),
+		mShadowMapSrv.GetGpuHandle(0),
 		GetDsv(1));
 
 	mSsao->BuildDescriptors(
 		device->GetDepthStencilBuffer(),
-		GetCpuSrv(mSsaoHeapIndexStart),
-		GetGpuSrv(mSsaoHeapIndexStart),
+		mSsaoSrvs.GetCpuHandle(0),
+		mSsaoSrvs.GetGpuHandle(0),
 		GetRtv(device->GetSwapChainBufferCount()),
 		device->GetCbvSrvUavDescriptorSize(),
 		device->GetRtvDescriptorSize());
 
 	mOceanMap->BuildDescriptors(
-		GetCpuSrv(mOceanMapHeapIndex),
-		GetGpuSrv(mOceanMapHeapIndex));
-
-	mNullCubeSrvIndex = mOceanMapHeapIndex + mOceanMap->GetNumDescriptors();
-	mNullTexSrvIndex1 = mNullCubeSrvIndex + 1;
-	mNullTexSrvIndex2 = mNullTexSrvIndex1 + 1;
-
-
-	auto nullSrv = GetCpuSrv(mNullCubeSrvIndex);
-	mNullSrv = GetGpuSrv(mNullCubeSrvIndex);
+		mOceanMapSrvs.GetCpuHandle(0),
+		mOceanMapSrvs.GetGpuHandle(0));
 
-	device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
-	nullSrv.Offset(1, device->GetCbvSrvUavDescriptorSize());
+	// Null cube and 2D views for the shadow pass, where the cube, shadow and
+	// SSAO table is not sampled.
+	device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, mNullSrvs.GetCpuHandle(0));
 
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
 	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
+	device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, mNullSrvs.GetCpuHandle(1));
+	device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, mNullSrvs.GetCpuHandle(2));
 
-	nullSrv.Offset(1, device->GetCbvSrvUavDescriptorSize());
-	device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
+	// The unused end of the texture table.
+	for (UINT i = (UINT)tex2DList.size(); i < TEXTURE_TABLE_SIZE; ++i)
+		device->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, mTextureSrvs.GetCpuHandle(i));
 
+	mDescriptorAllocator->CommitPersistent();
 }
 
 void OceanApp::BuildShadersAndInputLayout()
@@ -1378,11 +1255,8 @@ void OceanApp::BuildShapeGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device->GetD3DDevice().Get(),
-		device->GetCommandList().Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->VertexBufferGPU = mUploadBatcher->CreateDefaultBuffer(vertices.data(), vbByteSize);
+	geo->IndexBufferGPU = mUploadBatcher->CreateDefaultBuffer(indices.data(), ibByteSize);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -1698,15 +1572,192 @@ void OceanApp::BuildPSOs()
 	ThrowIfFailed(
 		device->GetD3DDevice()->CreateGraphicsPipelineState(
 			&wireframePsoDesc, IID_PPV_ARGS(&mPSOs["oceanWireframe"])));
+
+	// Draws refer to their pipelines by handle rather than by name.
+	mOpaquePipeline = mDrawSubmitter.AddPipeline(mPSOs["opaque"].Get());
+	mShadowPipeline = mDrawSubmitter.AddPipeline(mPSOs["shadow_opaque"].Get());
+	mDrawNormalsPipeline = mDrawSubmitter.AddPipeline(mPSOs["drawNormals"].Get());
+	mSkyPipeline = mDrawSubmitter.AddPipeline(mPSOs["sky"].Get());
+	mOceanPipeline = mDrawSubmitter.AddPipeline(mPSOs["ocean"].Get());
+	mOceanWireframePipeline = mDrawSubmitter.AddPipeline(mPSOs["oceanWireframe"].Get());
 }
 
 void OceanApp::BuildFrameResources()
 {
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
-		mFrameResources.push_back(std::make_unique<FrameResource>(device->GetD3DDevice().Get(),
-			2, static_cast<UINT>(mAllRitems.size()), static_cast<UINT>(mMaterials.size())));
+		mFrameResources.push_back(std::make_unique<FrameResource>(device->GetD3DDevice().Get()));
 	}
+
+	// Start with room for every frame in flight at the current object and material
+	// counts.  The ring grows by itself if the scene does.
+	const UINT64 frameByteSize =
+		2 * DxUtil::CalcConstantBufferByteSize(sizeof(PassConstants)) +
+		DxUtil::CalcConstantBufferByteSize(sizeof(SsaoConstants)) +
+		mAllRitems.size() * DxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants)) +
+		(mMaterials.size() + 1) * sizeof(MaterialData);
+	mUploadRing = std::make_unique<UploadRing>(device->GetD3DDevice().Get(), gNumFrameResources * frameByteSize);
+}
+
+void OceanApp::BuildRenderGraph()
+{
+	mRenderGraph = std::make_unique<RenderGraphExecutor>(device->GetD3DDevice().Get(), mHeapAllocator.get());
+
+	// Everything but the back buffer and the depth buffer rests in GENERIC_READ
+	// between frames, and the passes read it in that state.
+	mBackBufferResource = mRenderGraph->ImportResource("BackBuffer", D3D12_RESOURCE_STATE_PRESENT);
+	mDepthStencilResource = mRenderGraph->ImportResource("DepthStencil", D3D12_RESOURCE_STATE_DEPTH_WRITE);
+	mHTildeResource = mRenderGraph->ImportResource("HTilde", D3D12_RESOURCE_STATE_GENERIC_READ);
+	mDisplacementMapResource = mRenderGraph->ImportResource("DisplacementMap", D3D12_RESOURCE_STATE_GENERIC_READ);
+	mDisplacementScratchResource = mRenderGraph->ImportResource("DisplacementScratch", D3D12_RESOURCE_STATE_GENERIC_READ);
+	mShadowMapResource = mRenderGraph->ImportResource("ShadowMap", D3D12_RESOURCE_STATE_GENERIC_READ);
+	mNormalMapResource = mRenderGraph->ImportResource("NormalMap", D3D12_RESOURCE_STATE_GENERIC_READ);
+	mAmbientMapResource = mRenderGraph->ImportResource("AmbientMap", D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	const auto oceanFrequencyPass = mRenderGraph->AddPass("OceanFrequency",
+		[this, frequencyPso = mPSOs["oceanFrequency"].Get()](ID3D12GraphicsCommandList* cmdList)
+		{
+			mOceanMap->ComputeOceanFrequency(
+				cmdList,
+				mOceanFrequencyRootSignature.Get(),
+				frequencyPso,
+				timer.TotalTime());
+		});
+	mRenderGraph->Write(oceanFrequencyPass, mHTildeResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	const auto oceanDisplacementPass = mRenderGraph->AddPass("OceanDisplacement",
+		[this,
+		shiftPso = mPSOs["oceanShift"].Get(),
+		bitReversalPso = mPSOs["oceanBitReversal"].Get(),
+		fft1dPso = mPSOs["oceanFft1d"].Get(),
+		transposePso = mPSOs["oceanTranspose"].Get()](ID3D12GraphicsCommandList* cmdList)
+		{
+			mOceanMap->ComputeOceanDisplacement(
+				cmdList,
+				mOceanDisplacementRootSignature.Get(),
+				shiftPso,
+				bitReversalPso,
+				fft1dPso,
+				transposePso);
+		});
+	mRenderGraph->Read(oceanDisplacementPass, mHTildeResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	mRenderGraph->Write(oceanDisplacementPass, mDisplacementMapResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	mRenderGraph->Write(oceanDisplacementPass, mDisplacementScratchResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	const auto shadowPass = mRenderGraph->AddPass("ShadowMap",
+		[this](ID3D12GraphicsCommandList* cmdList)
+		{
+			cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+			// Bind all the mMaterials used in this scene.  For structured buffers, we can bypass the heap and 
+			// set as a root descriptor.
+			cmdList->SetGraphicsRootShaderResourceView(MAIN_ROOT_SLOT_MATERIAL_SRV, mCurrFrameResource->MaterialBuffer.GpuAddress);
+
+			// Bind null SRV for shadow map pass.
+			cmdList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_CUBE_SHADOW_SSAO_TABLE, mNullSrvs.GpuHandle);
+
+			// Bind all the mTextures used in this scene.  Observe
+			// that we only have to specify the first descriptor in the table.  
+			// The root signature knows how many descriptors are expected in the table.
+			cmdList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_TEXTURE_TABLE, mTextureSrvs.GpuHandle);
+
+			DrawSceneToShadowMap();
+		});
+	mRenderGraph->Write(shadowPass, mShadowMapResource, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	const auto normalsPass = mRenderGraph->AddPass("NormalsAndDepth",
+		[this](ID3D12GraphicsCommandList* cmdList)
+		{
+			DrawNormalsAndDepth();
+		});
+	mRenderGraph->Write(normalsPass, mNormalMapResource, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	mRenderGraph->Write(normalsPass, mDepthStencilResource, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	// The SSAO pass ping-pongs between its two ambient maps by itself and leaves
+	// them in GENERIC_READ.
+	const auto ssaoPass = mRenderGraph->AddPass("Ssao",
+		[this](ID3D12GraphicsCommandList* cmdList)
+		{
+			cmdList->SetGraphicsRootSignature(mSsaoRootSignature.Get());
+			mSsao->ComputeSsao(cmdList, mCurrFrameResource, 3);
+		});
+	mRenderGraph->Read(ssaoPass, mNormalMapResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+	mRenderGraph->Read(ssaoPass, mDepthStencilResource,
+		D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	mRenderGraph->Write(ssaoPass, mAmbientMapResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	const auto mainPass = mRenderGraph->AddPass("Main",
+		[this](ID3D12GraphicsCommandList* cmdList)
+		{
+			cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+			// Rebind state whenever graphics root signature changes.
+
+			// Bind all the mMaterials used in this scene.  For structured buffers, we can bypass the heap and 
+			// set as a root descriptor.
+			cmdList->SetGraphicsRootShaderResourceView(MAIN_ROOT_SLOT_MATERIAL_SRV, mCurrFrameResource->MaterialBuffer.GpuAddress);
+
+			cmdList->RSSetViewports(1, &device->GetScreenViewport());
+			cmdList->RSSetScissorRects(1, &device->GetScissorRect());
+
+			auto currentBackBufferView = device->CurrentBackBufferView();
+			auto depthStencilView = device->DepthStencilView();
+
+			// Clear the back buffer and depth buffer.
+			cmdList->ClearRenderTargetView(currentBackBufferView, DirectX::Colors::LightSteelBlue, 0, nullptr);
+			cmdList->ClearDepthStencilView(depthStencilView, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+
+			// Specify the buffers we are going to render to.
+			cmdList->OMSetRenderTargets(1, &currentBackBufferView, true, &depthStencilView);
+
+			// Bind all the mTextures used in this scene.  Observe
+			// that we only have to specify the first descriptor in the table.  
+			// The root signature knows how many descriptors are expected in the table.
+			cmdList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_TEXTURE_TABLE, mTextureSrvs.GpuHandle);
+
+			cmdList->SetGraphicsRootConstantBufferView(MAIN_ROOT_SLOT_PASS_CB, mCurrFrameResource->PassCB.GetGpuAddress(0));
+
+			// Bind the sky cube map.  For our demos, we just use one "world" cube map representing the environment
+			// from far away, so all objects will use the same cube map and we only need to set it once per-frame.  
+			// If we wanted to use "local" cube maps, we would have to change them per-object, or dynamically
+			// index into an array of cube maps.
+
+			// The table is put together for this frame from views that live in
+			// separate persistent ranges.
+			const D3D12_CPU_DESCRIPTOR_HANDLE cubeShadowSsao[] =
+			{
+				mSkySrv.CpuHandle,
+				mShadowMapSrv.CpuHandle,
+				mSsaoSrvs.CpuHandle
+			};
+			const auto cubeShadowSsaoTable = mDescriptorAllocator->CopyToTransient(cubeShadowSsao, _countof(cubeShadowSsao));
+			cmdList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_CUBE_SHADOW_SSAO_TABLE, cubeShadowSsaoTable.GpuHandle);
+
+			auto oceanDisplacementDescriptor = mOceanMap->GetGpuDisplacementMapSrv();
+			cmdList->SetGraphicsRootDescriptorTable(MAIN_ROOT_SLOT_OCEAN_TABLE, oceanDisplacementDescriptor);
+
+			// Opaque geometry, then the sky, then the ocean, each sorted by
+			// pipeline and geometry and front to back.
+			const XMMATRIX view = mCamera.GetView();
+			AddDrawPackets(RenderLayer::Opaque, mOpaquePipeline, view, mCamera.GetNearZ(), mCamera.GetFarZ());
+			AddDrawPackets(RenderLayer::Sky, mSkyPipeline, view, mCamera.GetNearZ(), mCamera.GetFarZ());
+			AddDrawPackets(RenderLayer::Ocean, mIsWireframe ? mOceanWireframePipeline : mOceanPipeline,
+				view, mCamera.GetNearZ(), mCamera.GetFarZ());
+			SubmitDrawPackets(cmdList);
+
+			if (mIsDebugging)
+			{
+				DrawDebugThings(cmdList);
+			}
+		});
+	mRenderGraph->Read(mainPass, mShadowMapResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+	mRenderGraph->Read(mainPass, mAmbientMapResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+	mRenderGraph->Read(mainPass, mDisplacementMapResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+	mRenderGraph->Read(mainPass, mHTildeResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+	mRenderGraph->Write(mainPass, mBackBufferResource, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	mRenderGraph->Write(mainPass, mDepthStencilResource, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+	mRenderGraph->Compile();
 }
 
 void OceanApp::BuildMaterials()
@@ -1882,30 +1933,46 @@ void OceanApp::BuildRenderItems()
 		mRitemLayer[(int)RenderLayer::Ocean].push_back(gridRitem.get());
 		mAllRitems.push_back(std::move(gridRitem));
 	}
+
+	for (auto& ri : mAllRitems)
+		ri->GeoHandle = mDrawSubmitter.AddGeometry(ri->Geo);
 }
 
 
-void OceanApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void OceanApp::AddDrawPackets(RenderLayer layer, DrawQueue::Handle pipeline, FXMMATRIX view, float nearZ, float farZ)
 {
-	UINT objCBByteSize = DxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-
-	// For each render item...
-	for (size_t i = 0; i < ritems.size(); ++i)
-	{
-		auto ri = ritems[i];
-
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+	auto& objectCB = mCurrFrameResource->ObjectCB;
+
+	for (const RenderItem* ri : mRitemLayer[(int)layer])
+	{
+		// Depth of the item's origin is close enough to order whole items.
+		const XMVECTOR origin = XMVectorSet(ri->World._41, ri->World._42, ri->World._43, 1.0f);
+		const float viewDepth = XMVectorGetZ(XMVector3TransformCoord(origin, view));
+
+		DrawQueue::Packet packet;
+		packet.Pipeline = pipeline;
+		packet.Geometry = ri->GeoHandle;
+		packet.Topology = ri->PrimitiveType;
+		packet.ObjectConstants = objectCB.GetGpuAddress(ri->ObjCBIndex);
+		packet.IndexCount = ri->IndexCount;
+		packet.StartIndexLocation = ri->StartIndexLocation;
+		packet.BaseVertexLocation = ri->BaseVertexLocation;
+		packet.SortKey = DrawQueue::MakeSortKey((uint32_t)layer, pipeline, ri->GeoHandle, ri->Mat->MatCBIndex,
+			DrawQueue::QuantizeDepth(viewDepth, nearZ, farZ));
+
+		mDrawQueue.Add(packet);
+	}
+}
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+void OceanApp::SubmitDrawPackets(ID3D12GraphicsCommandList* cmdList)
+{
+	mDrawQueue.Sort();
 
-		cmdList->SetGraphicsRootConstantBufferView(MAIN_ROOT_SLOT_OBJECT_CB, objCBAddress);
+	mDrawCommands.Clear();
+	mDrawQueue.Record(mDrawCommands);
+	mDrawSubmitter.Execute(cmdList, mDrawQueue, mDrawCommands, MAIN_ROOT_SLOT_OBJECT_CB);
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-	}
+	mDrawQueue.Clear();
 }
 
 void OceanApp::DrawOceanDebug(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -1930,10 +1997,6 @@ void OceanApp::DrawSceneToShadowMap()
 	commandList->RSSetViewports(1, &mShadowMap->Viewport());
 	commandList->RSSetScissorRects(1, &mShadowMap->ScissorRect());
 
-	// Change to DEPTH_WRITE.
-	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE));
-
 	// Clear the back buffer and depth buffer.
 	commandList->ClearDepthStencilView(mShadowMap->Dsv(),
 		D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
@@ -1942,18 +2005,11 @@ void OceanApp::DrawSceneToShadowMap()
 	commandList->OMSetRenderTargets(0, nullptr, false, &mShadowMap->Dsv());
 
 	// Bind the pass constant buffer for the shadow map pass.
-	UINT passCBByteSize = DxUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1 * passCBByteSize;
+	D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = mCurrFrameResource->PassCB.GetGpuAddress(1);
 	commandList->SetGraphicsRootConstantBufferView(MAIN_ROOT_SLOT_PASS_CB, passCBAddress);
 
-	commandList->SetPipelineState(mPSOs["shadow_opaque"].Get());
-
-	DrawRenderItems(commandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
-
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
-		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ));
+	AddDrawPackets(RenderLayer::Opaque, mShadowPipeline, XMLoadFloat4x4(&mLightView), mLightNearZ, mLightFarZ);
+	SubmitDrawPackets(commandList.Get());
 }
 
 void OceanApp::DrawNormalsAndDepth()
@@ -1962,13 +2018,8 @@ void OceanApp::DrawNormalsAndDepth()
 	commandList->RSSetViewports(1, &device->GetScreenViewport());
 	commandList->RSSetScissorRects(1, &device->GetScissorRect());
 
-	auto normalMap = mSsao->NormalMap();
 	auto normalMapRtv = mSsao->NormalMapRtv();
 
-	// Change to RENDER_TARGET.
-	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
 	// Clear the screen normal map and depth buffer.
 	float clearValue[] = { 0.0f, 0.0f, 1.0f, 0.0f };
 	commandList->ClearRenderTargetView(normalMapRtv, clearValue, 0, nullptr);
@@ -1978,33 +2029,13 @@ void OceanApp::DrawNormalsAndDepth()
 	commandList->OMSetRenderTargets(1, &normalMapRtv, true, &device->DepthStencilView());
 
 	// Bind the constant buffer for this pass.
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	commandList->SetGraphicsRootConstantBufferView(MAIN_ROOT_SLOT_PASS_CB, passCB->GetGPUVirtualAddress());
-
-	commandList->SetPipelineState(mPSOs["drawNormals"].Get());
+	commandList->SetGraphicsRootConstantBufferView(MAIN_ROOT_SLOT_PASS_CB, mCurrFrameResource->PassCB.GetGpuAddress(0));
 
-	DrawRenderItems(commandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
-
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
+	AddDrawPackets(RenderLayer::Opaque, mDrawNormalsPipeline, mCamera.GetView(), mCamera.GetNearZ(), mCamera.GetFarZ());
+	SubmitDrawPackets(commandList.Get());
 }
 
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE OceanApp::GetCpuSrv(int index)const
-{
-	auto srv = CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-	srv.Offset(index, device->GetCbvSrvUavDescriptorSize());
-	return srv;
-}
-
-CD3DX12_GPU_DESCRIPTOR_HANDLE OceanApp::GetGpuSrv(int index)const
-{
-	auto srv = CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	srv.Offset(index, device->GetCbvSrvUavDescriptorSize());
-	return srv;
-}
-
 CD3DX12_CPU_DESCRIPTOR_HANDLE OceanApp::GetDsv(int index)const
 {
 	auto dsv = CD3DX12_CPU_DESCRIPTOR_HANDLE(device->GetDsvHeap()->GetCPUDescriptorHandleForHeapStart());
@@ -8,6 +8,11 @@
 #include "OceanMap.h"
 #include "ShadowMap.h"
 #include "../Common/Camera.h"
+#include "../Common/UploadBatcher.h"
+#include "../Common/GpuHeapAllocator.h"
+#include "../Common/DescriptorAllocator.h"
+#include "../Common/RenderGraphExecutor.h"
+#include "../Common/DrawSubmitter.h"
 #include "Ssao.h"
 
 extern const int gNumFrameResources;
@@ -22,18 +27,15 @@ struct RenderItem
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
-
 	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
 	UINT ObjCBIndex = -1;
 
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
 
+	// Geo as the DrawSubmitter knows it.
+	DrawQueue::Handle GeoHandle = 0;
+
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -90,16 +92,16 @@ private:
 	void BuildShapeGeometry();
 	void BuildPSOs();
 	void BuildFrameResources();
+	void BuildRenderGraph();
 	void BuildMaterials();
 	void BuildRenderItems();
-	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void AddDrawPackets(RenderLayer layer, DrawQueue::Handle pipeline, DirectX::FXMMATRIX view, float nearZ, float farZ);
+	void SubmitDrawPackets(ID3D12GraphicsCommandList* cmdList);
 	void DrawOceanDebug(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 	void DrawSceneToShadowMap();
 	void DrawNormalsAndDepth();
 	void DrawDebugThings(ComPtr<ID3D12GraphicsCommandList> commandList);
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuSrv(int index)const;
-	CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuSrv(int index)const;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsv(int index)const;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtv(int index)const;
 
@@ -141,7 +143,44 @@ private:
 
 	static constexpr float DEBUG_SIZE_Y = 0.5f;
 
+	// Descriptors of the main root signature's texture table.
+	static constexpr UINT TEXTURE_TABLE_SIZE = 10;
+
+	static constexpr UINT PERSISTENT_DESCRIPTOR_COUNT = 256;
+	static constexpr UINT TRANSIENT_DESCRIPTOR_COUNT = 1024;
+
 	std::vector<std::unique_ptr<FrameResource>> mFrameResources;
+	std::unique_ptr<UploadRing> mUploadRing;
+	std::unique_ptr<UploadBatcher> mUploadBatcher;
+
+	// Declared ahead of the maps placed in it, so it outlives them.
+	std::unique_ptr<GpuHeapAllocator> mHeapAllocator;
+
+	// The shader-visible CBV/SRV/UAV heap.
+	std::unique_ptr<DescriptorAllocator> mDescriptorAllocator;
+
+	// Shadow map, normal/depth, SSAO and main passes, after the ocean FFT.
+	std::unique_ptr<RenderGraphExecutor> mRenderGraph;
+	RenderGraph::ResourceHandle mBackBufferResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mDepthStencilResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mHTildeResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mDisplacementMapResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mDisplacementScratchResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mShadowMapResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mNormalMapResource = RenderGraph::InvalidHandle;
+	RenderGraph::ResourceHandle mAmbientMapResource = RenderGraph::InvalidHandle;
+
+	// Render items are drawn through one queue that each pass fills, sorts and
+	// submits in turn.
+	DrawSubmitter mDrawSubmitter;
+	DrawQueue mDrawQueue;
+	DrawCommandStream mDrawCommands;
+	DrawQueue::Handle mOpaquePipeline = 0;
+	DrawQueue::Handle mShadowPipeline = 0;
+	DrawQueue::Handle mDrawNormalsPipeline = 0;
+	DrawQueue::Handle mSkyPipeline = 0;
+	DrawQueue::Handle mOceanPipeline = 0;
+	DrawQueue::Handle mOceanWireframePipeline = 0;
 	FrameResource* mCurrFrameResource = nullptr;
 	int mCurrFrameResourceIndex = 0;
 
@@ -152,8 +191,6 @@ private:
 	ComPtr<ID3D12RootSignature> mOceanDisplacementRootSignature = nullptr;
 	ComPtr<ID3D12RootSignature> mOceanDebugRootSignature = nullptr;
 
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
-
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
@@ -168,25 +205,21 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[static_cast<int>(RenderLayer::Count)];
 
-	UINT mSkyTexHeapIndex = 0;
-	UINT mShadowMapHeapIndex = 0;
-
-	UINT mSsaoHeapIndexStart = 0;
-	UINT mSsaoAmbientMapIndex = 0;
+	DescriptorAllocator::Range mTextureSrvs;
+	DescriptorAllocator::Range mSkySrv;
+	DescriptorAllocator::Range mShadowMapSrv;
+	DescriptorAllocator::Range mSsaoSrvs;
+	DescriptorAllocator::Range mOceanMapSrvs;
 
-	UINT mOceanMapHeapIndex;
-
-	UINT mNullCubeSrvIndex = 0;
-	UINT mNullTexSrvIndex1 = 0;
-	UINT mNullTexSrvIndex2 = 0;
+	// Null cube map and two null 2D textures, bound in place of the cube,
+	// shadow and SSAO table.
+	DescriptorAllocator::Range mNullSrvs;
 
 	bool mIsWireframe;
 	bool mIsDebugging;
 	float mWireframeChangedTime;
 	float mDebuggingChangedTime;
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv;
-
 	PassConstants mMainPassCB;  // index 0 of pass cbuffer.
 	PassConstants mShadowPassCB;// index 1 of pass cbuffer.
 
@@ -1,7 +1,8 @@
 #include "OceanMap.h"
 
-OceanMap::OceanMap(ID3D12Device* device, UINT width, UINT height)
+OceanMap::OceanMap(ID3D12Device* device, GpuHeapAllocator* heapAllocator, UINT width, UINT height)
 	: mD3dDevice{ device },
+	mHeapAllocator{ heapAllocator },
 	mViewport{},
 	mScissorRect{},
 	mWidth{ width },
@@ -15,11 +16,36 @@ OceanMap::OceanMap(ID3D12Device* device, UINT width, UINT height)
 	BuildResource();
 }
 
+OceanMap::~OceanMap()
+{
+	mHTilde0 = nullptr;
+	mHTilde0Conj = nullptr;
+	mHTilde = nullptr;
+	mDisplacementMap0 = nullptr;
+	mDisplacementMap1 = nullptr;
+
+	mHeapAllocator->Free(mHTilde0Memory);
+	mHeapAllocator->Free(mHTilde0ConjMemory);
+	mHeapAllocator->Free(mHTildeMemory);
+	mHeapAllocator->Free(mDisplacementMap0Memory);
+	mHeapAllocator->Free(mDisplacementMap1Memory);
+}
+
 ID3D12Resource* OceanMap::Output() const
 {
 	return mDisplacementMap0.Get();
 }
 
+ID3D12Resource* OceanMap::HTilde() const
+{
+	return mHTilde.Get();
+}
+
+ID3D12Resource* OceanMap::Scratch() const
+{
+	return mDisplacementMap1.Get();
+}
+
 void OceanMap::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuSrv, CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuSrv)
 {
 	const auto descriptorSize = mD3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
@@ -67,8 +93,8 @@ void OceanMap::BuildOceanBasis(ID3D12GraphicsCommandList* cmdList,
 		D3D12_RESOURCE_STATE_GENERIC_READ,
 		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
-	cmdList->ResourceBarrier(1, &barrierHTilde0ToUav);
-	cmdList->ResourceBarrier(1, &barrierHTilde0ConjToUav);
+	const D3D12_RESOURCE_BARRIER barriersToUav[] = { barrierHTilde0ToUav, barrierHTilde0ConjToUav };
+	cmdList->ResourceBarrier(_countof(barriersToUav), barriersToUav);
 
 	cmdList->SetPipelineState(oceanBasisPSO);
 
@@ -91,8 +117,8 @@ void OceanMap::BuildOceanBasis(ID3D12GraphicsCommandList* cmdList,
 		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
 		D3D12_RESOURCE_STATE_GENERIC_READ);
 
-	cmdList->ResourceBarrier(1, &barrierHTilde0ToSrv);
-	cmdList->ResourceBarrier(1, &barrierHTilde0ConjToSrv);
+	const D3D12_RESOURCE_BARRIER barriersToSrv[] = { barrierHTilde0ToSrv, barrierHTilde0ConjToSrv };
+	cmdList->ResourceBarrier(_countof(barriersToSrv), barriersToSrv);
 }
 
 void OceanMap::ComputeOceanFrequency(ID3D12GraphicsCommandList* cmdList,
@@ -105,13 +131,6 @@ void OceanMap::ComputeOceanFrequency(ID3D12GraphicsCommandList* cmdList,
 
 	cmdList->SetComputeRootSignature(rootSig);
 
-	const auto barrierHTildeToUav = CD3DX12_RESOURCE_BARRIER::Transition(
-		mHTilde.Get(),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	
-	cmdList->ResourceBarrier(1, &barrierHTildeToUav);
-
 	cmdList->SetPipelineState(oceanFrequencyPSO);
 
 	cmdList->SetComputeRoot32BitConstants(0, 3, &c, 0);
@@ -123,12 +142,6 @@ void OceanMap::ComputeOceanFrequency(ID3D12GraphicsCommandList* cmdList,
 	const auto numGroupsY = mHeight;
 	const UINT numGroupsZ = NUM_OCEAN_FREQUENCY;
 	cmdList->Dispatch(numGroupsX, numGroupsY, numGroupsZ);
-
-	const auto barrierHTildeToSrv = CD3DX12_RESOURCE_BARRIER::Transition(
-		mHTilde.Get(),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		D3D12_RESOURCE_STATE_GENERIC_READ);
-	cmdList->ResourceBarrier(1, &barrierHTildeToSrv);
 }
 
 void OceanMap::ComputeOceanDisplacement(ID3D12GraphicsCommandList* cmdList,
@@ -142,105 +155,48 @@ void OceanMap::ComputeOceanDisplacement(ID3D12GraphicsCommandList* cmdList,
 	FftConstants c = { mWidth, 1 };
 
 	cmdList->SetComputeRootSignature(rootSig);
-
-	{
-		const auto barrierHTilde0ToCopySrc = CD3DX12_RESOURCE_BARRIER::Transition(
-			mHTilde.Get(),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			D3D12_RESOURCE_STATE_COPY_SOURCE);
-
-		const auto barrierDisplacementMap0ToCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap0.Get(),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			D3D12_RESOURCE_STATE_COPY_DEST);
-
-		cmdList->ResourceBarrier(1, &barrierHTilde0ToCopySrc);
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap0ToCopyDest);
-		cmdList->CopyResource(mDisplacementMap0.Get(), mHTilde.Get());
-	}
-
-	{
-		const auto barrierHTilde0ToSrv = CD3DX12_RESOURCE_BARRIER::Transition(
-			mHTilde.Get(),
-			D3D12_RESOURCE_STATE_COPY_SOURCE,
-			D3D12_RESOURCE_STATE_GENERIC_READ);
-
-		const auto barrierDisplacementMap0ToUav = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap0.Get(),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-		const auto barrierDisplacementMap1ToUav = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap1.Get(),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-		cmdList->ResourceBarrier(1, &barrierHTilde0ToSrv);
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap0ToUav);
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap1ToUav);
-	}
-
 	cmdList->SetComputeRoot32BitConstants(0, 2, &c, 0);
-	cmdList->SetComputeRootDescriptorTable(1, mhGpuUavDisplacementMap0);
-	cmdList->SetComputeRootDescriptorTable(2, mhGpuUavDisplacementMap1);
 
+	// Shift reads gInput and writes gOutput, BitReversal and Fft1d work on gOutput
+	// in place, and Transpose writes gOutput transposed to gInput.  Rebinding the
+	// maps between the steps keeps every step reading where the last one wrote,
+	// instead of copying between the maps.  Each step depends on the one before,
+	// so a UAV barrier separates every pair of dispatches.
+
+	// Rows: HTilde -> DisplacementMap0, transposed into DisplacementMap1.
+	cmdList->SetComputeRootDescriptorTable(1, mhGpuUavHTilde);
+	cmdList->SetComputeRootDescriptorTable(2, mhGpuUavDisplacementMap0);
 	Shift(cmdList, shiftCsPso, c);
+	DisplacementMapUavBarrier(cmdList);
+
+	cmdList->SetComputeRootDescriptorTable(1, mhGpuUavDisplacementMap1);
 	BitReversal(cmdList, bitReversalCsPso, c);
+	DisplacementMapUavBarrier(cmdList);
 	Fft1d(cmdList, fft1dCsPso, c);
+	DisplacementMapUavBarrier(cmdList);
 	Transpose(cmdList, transposeCsPso, c);
+	DisplacementMapUavBarrier(cmdList);
 
-	// copy gInput to gOutput because BitReversal uses gOutput
-	// but transposed matrix are gInput.
-	{
-		const auto barrierDisplacementMap0ToSrc = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap0.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_COPY_SOURCE);
-
-		const auto barrierDisplacementMap1ToDest = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap1.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_COPY_DEST);
-		
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap0ToSrc);
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap1ToDest);
-
-		cmdList->CopyResource(mDisplacementMap1.Get(), mDisplacementMap0.Get());
-
-		const auto barrierDisplacementMap0ToUav = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap0.Get(),
-			D3D12_RESOURCE_STATE_COPY_SOURCE,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-		const auto barrierDisplacementMap1ToUav = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap1.Get(),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap0ToUav);
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap1ToUav);
-	}
-
+	// Columns: DisplacementMap1, transposed back into DisplacementMap0.
+	cmdList->SetComputeRootDescriptorTable(1, mhGpuUavDisplacementMap0);
+	cmdList->SetComputeRootDescriptorTable(2, mhGpuUavDisplacementMap1);
 	BitReversal(cmdList, bitReversalCsPso, c);
+	DisplacementMapUavBarrier(cmdList);
 	Fft1d(cmdList, fft1dCsPso, c);
+	DisplacementMapUavBarrier(cmdList);
 	Transpose(cmdList, transposeCsPso, c);
-	
-	{
-		const auto barrierDisplacementMap0ToSrv = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap0.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_GENERIC_READ);
-
-		const auto barrierDisplacementMap1ToSrv = CD3DX12_RESOURCE_BARRIER::Transition(
-			mDisplacementMap1.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_GENERIC_READ);
-		
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap0ToSrv);
-		cmdList->ResourceBarrier(1, &barrierDisplacementMap1ToSrv);
-	}
-
+}
 
+void OceanMap::DisplacementMapUavBarrier(ID3D12GraphicsCommandList* cmdList)
+{
+	// The transposes also write the map the step before them read, so both maps
+	// are waited on rather than just the one last written.
+	const D3D12_RESOURCE_BARRIER barriers[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::UAV(mDisplacementMap0.Get()),
+		CD3DX12_RESOURCE_BARRIER::UAV(mDisplacementMap1.Get())
+	};
+	cmdList->ResourceBarrier(_countof(barriers), barriers);
 }
 
 void OceanMap::Dispatch(ID3D12GraphicsCommandList* cmdList)
@@ -441,64 +397,47 @@ void OceanMap::BuildResource()
 	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
-	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-
-	ThrowIfFailed(
-		mD3dDevice->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&mDisplacementMap0)
-		)
+	mDisplacementMap0 = mHeapAllocator->CreateResource(
+		texDesc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		mDisplacementMap0Memory
 	);
 
-	ThrowIfFailed(
-		mD3dDevice->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&mDisplacementMap1)
-		)
+	mDisplacementMap1 = mHeapAllocator->CreateResource(
+		texDesc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		mDisplacementMap1Memory
 	);
 
-	ThrowIfFailed(
-		mD3dDevice->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&mHTilde)
-		)
+	mHTilde = mHeapAllocator->CreateResource(
+		texDesc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		mHTildeMemory
 	);
 	
 	texDesc.DepthOrArraySize = NUM_OCEAN_BASIS;
 
 	texDesc.Format = mBasisFormat;
-	ThrowIfFailed(
-		mD3dDevice->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&mHTilde0)
-		)
+	mHTilde0 = mHeapAllocator->CreateResource(
+		texDesc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		mHTilde0Memory
 	);
 
-	ThrowIfFailed(
-		mD3dDevice->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&mHTilde0Conj)
-		)
+	mHTilde0Conj = mHeapAllocator->CreateResource(
+		texDesc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		mHTilde0ConjMemory
 	);
 
 }
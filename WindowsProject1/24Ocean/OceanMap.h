@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Common/DxUtil.h"
+#include "../Common/GpuHeapAllocator.h"
 
 struct OceanBasisConstants
 {
@@ -27,19 +28,25 @@ class OceanMap
 {
 public:
 	OceanMap(ID3D12Device* device, 
+		GpuHeapAllocator* heapAllocator,
 		UINT width, 
 		UINT height);
 	OceanMap(const OceanMap& other) = delete;
-	OceanMap(OceanMap&& other) noexcept = default;
 	OceanMap& operator=(const OceanMap& other) = delete;
-	OceanMap& operator=(OceanMap&& other) noexcept = default;
-	~OceanMap() = default;
+	~OceanMap();
 
 	static constexpr UINT NUM_OCEAN_BASIS = 3; // x, y, z
 	static constexpr UINT NUM_OCEAN_FREQUENCY = 9; // x, y, z, slopex(x, y, z), slopez(x, y, z)
 
+	// The displacement map, in GENERIC_READ between frames.
 	ID3D12Resource* Output() const;
 
+	// Written by ComputeOceanFrequency and read by ComputeOceanDisplacement.
+	ID3D12Resource* HTilde() const;
+
+	// Holds the transposed rows during ComputeOceanDisplacement.
+	ID3D12Resource* Scratch() const;
+
 	void BuildDescriptors(
 		CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuSrv,
 		CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuSrv
@@ -47,9 +54,11 @@ public:
 	void BuildOceanBasis(
 		ID3D12GraphicsCommandList* cmdList, ID3D12RootSignature* rootSig, ID3D12PipelineState* oceanBasisPSO
 	);
+	// HTilde must be in UNORDERED_ACCESS.
 	void ComputeOceanFrequency(ID3D12GraphicsCommandList* cmdList, ID3D12RootSignature* rootSig,
 	                           ID3D12PipelineState* oceanFrequencyPSO, float waveTime);
 	
+	// HTilde, the output and the scratch map must be in UNORDERED_ACCESS.
 	void ComputeOceanDisplacement(ID3D12GraphicsCommandList* cmdList,
 	                              ID3D12RootSignature* rootSig,
 	                              ID3D12PipelineState* shiftCsPso,
@@ -97,8 +106,13 @@ private:
 	void BuildDescriptors();
 	void BuildResource();
 
+	// Makes the next dispatch wait for the UAV accesses of the last one to both
+	// displacement maps, in one barrier call.
+	void DisplacementMapUavBarrier(ID3D12GraphicsCommandList* cmdList);
+
 private:
 	ID3D12Device* mD3dDevice;
+	GpuHeapAllocator* mHeapAllocator;
 	D3D12_VIEWPORT mViewport;
 	D3D12_RECT mScissorRect;
 
@@ -138,4 +152,10 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> mHTilde;
 	Microsoft::WRL::ComPtr<ID3D12Resource> mDisplacementMap0;
 	Microsoft::WRL::ComPtr<ID3D12Resource> mDisplacementMap1;
+
+	GpuHeapAllocator::Allocation mHTilde0Memory;
+	GpuHeapAllocator::Allocation mHTilde0ConjMemory;
+	GpuHeapAllocator::Allocation mHTildeMemory;
+	GpuHeapAllocator::Allocation mDisplacementMap0Memory;
+	GpuHeapAllocator::Allocation mDisplacementMap1Memory;
 };
\ No newline at end of file
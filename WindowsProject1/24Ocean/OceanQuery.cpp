@@ -0,0 +1,301 @@
+#include "OceanQuery.h"
+#include "CpuOceanMap.h"
+#include "../Common/JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCEAN_QUERY_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// Points per job when a batch is split over the job system.  Smaller batches
+	// are answered on the calling thread.
+	const int PointGrainSize = 1024;
+
+	// Bilinear lookup of one point with wrap addressing, like gsamAnisotropicWrap
+	// at the top mip.  texels holds x, y, z, 0 per texel.
+	void SampleScalar(const float* texels, int size, float u, float v, float out[3])
+	{
+		const float fx = u * size - 0.5f;
+		const float fy = v * size - 0.5f;
+		const float floorX = floorf(fx);
+		const float floorY = floorf(fy);
+		const float tx = fx - floorX;
+		const float ty = fy - floorY;
+
+		const int mask = size - 1;
+		const int x0 = (int)floorX & mask;
+		const int y0 = (int)floorY & mask;
+		const int x1 = (x0 + 1) & mask;
+		const int y1 = (y0 + 1) & mask;
+
+		const float* c00 = texels + 4 * ((std::size_t)y0 * size + x0);
+		const float* c10 = texels + 4 * ((std::size_t)y0 * size + x1);
+		const float* c01 = texels + 4 * ((std::size_t)y1 * size + x0);
+		const float* c11 = texels + 4 * ((std::size_t)y1 * size + x1);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			const float top = c00[c] + (c10[c] - c00[c]) * tx;
+			const float bottom = c01[c] + (c11[c] - c01[c]) * tx;
+			out[c] = top + (bottom - top) * ty;
+		}
+	}
+
+#if defined(OCEAN_QUERY_X86)
+	__m128 FloorSse(__m128 x)
+	{
+		// Truncation rounds negative values up; take one off where it did.
+		const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+	}
+
+	// SampleScalar for four points.  Coordinates and weights are computed for
+	// all four at once; each texel is fetched as one vector, and the four results
+	// are transposed back into one vector per component.
+	void SampleSse(const float* texels, int size, __m128 u, __m128 v,
+		__m128& outX, __m128& outY, __m128& outZ)
+	{
+		const __m128 sizeF = _mm_set1_ps((float)size);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		const __m128 fx = _mm_sub_ps(_mm_mul_ps(u, sizeF), half);
+		const __m128 fy = _mm_sub_ps(_mm_mul_ps(v, sizeF), half);
+		const __m128 floorX = FloorSse(fx);
+		const __m128 floorY = FloorSse(fy);
+		const __m128 tx = _mm_sub_ps(fx, floorX);
+		const __m128 ty = _mm_sub_ps(fy, floorY);
+
+		const __m128i mask = _mm_set1_epi32(size - 1);
+		const __m128i x0 = _mm_and_si128(_mm_cvtps_epi32(floorX), mask);
+		const __m128i y0 = _mm_and_si128(_mm_cvtps_epi32(floorY), mask);
+		const __m128i x1 = _mm_and_si128(_mm_add_epi32(x0, _mm_set1_epi32(1)), mask);
+		const __m128i y1 = _mm_and_si128(_mm_add_epi32(y0, _mm_set1_epi32(1)), mask);
+
+		alignas(16) int x0s[4];
+		alignas(16) int x1s[4];
+		alignas(16) int y0s[4];
+		alignas(16) int y1s[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(x0s), x0);
+		_mm_store_si128(reinterpret_cast<__m128i*>(x1s), x1);
+		_mm_store_si128(reinterpret_cast<__m128i*>(y0s), y0);
+		_mm_store_si128(reinterpret_cast<__m128i*>(y1s), y1);
+
+		const __m128 sx = _mm_sub_ps(one, tx);
+		const __m128 sy = _mm_sub_ps(one, ty);
+		alignas(16) float w00[4];
+		alignas(16) float w10[4];
+		alignas(16) float w01[4];
+		alignas(16) float w11[4];
+		_mm_store_ps(w00, _mm_mul_ps(sx, sy));
+		_mm_store_ps(w10, _mm_mul_ps(tx, sy));
+		_mm_store_ps(w01, _mm_mul_ps(sx, ty));
+		_mm_store_ps(w11, _mm_mul_ps(tx, ty));
+
+		__m128 r[4];
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			const std::size_t row0 = (std::size_t)y0s[lane] * size;
+			const std::size_t row1 = (std::size_t)y1s[lane] * size;
+
+			const __m128 c00 = _mm_loadu_ps(texels + 4 * (row0 + x0s[lane]));
+			const __m128 c10 = _mm_loadu_ps(texels + 4 * (row0 + x1s[lane]));
+			const __m128 c01 = _mm_loadu_ps(texels + 4 * (row1 + x0s[lane]));
+			const __m128 c11 = _mm_loadu_ps(texels + 4 * (row1 + x1s[lane]));
+
+			__m128 sum = _mm_mul_ps(c00, _mm_set1_ps(w00[lane]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(c10, _mm_set1_ps(w10[lane])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(c01, _mm_set1_ps(w01[lane])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(c11, _mm_set1_ps(w11[lane])));
+			r[lane] = sum;
+		}
+
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+		outX = r[0];
+		outY = r[1];
+		outZ = r[2];
+	}
+#endif
+}
+
+OceanQuery::OceanQuery(int size)
+	: mSize(size)
+{
+	assert(size >= 1 && (size & (size - 1)) == 0);
+}
+
+void OceanQuery::SetMapping(const SurfaceMapping& mapping)
+{
+	std::lock_guard<std::mutex> lock(mPublishMutex);
+	mMapping = mapping;
+}
+
+void OceanQuery::Publish(const float* displacementX, const float* displacementY, const float* displacementZ,
+	float waveTime)
+{
+	std::lock_guard<std::mutex> lock(mPublishMutex);
+
+	std::shared_ptr<Snapshot> snapshot = GetFreeSnapshot();
+	snapshot->Mapping = mMapping;
+	snapshot->WaveTime = waveTime;
+
+	const float scale = mMapping.DisplacementScale;
+	const std::size_t texelCount = (std::size_t)mSize * mSize;
+	snapshot->Texels.resize(4 * texelCount);
+
+	float* texels = snapshot->Texels.data();
+	for (std::size_t i = 0; i < texelCount; ++i)
+	{
+		texels[4 * i + 0] = displacementX[i] * scale;
+		texels[4 * i + 1] = displacementY[i] * scale;
+		texels[4 * i + 2] = displacementZ[i] * scale;
+		texels[4 * i + 3] = 0.0f;
+	}
+
+	std::atomic_store(&mCurrent, std::shared_ptr<const Snapshot>(snapshot));
+}
+
+void OceanQuery::Publish(const CpuOceanMap& oceanMap, float waveTime)
+{
+	assert(oceanMap.GetSize() == mSize);
+
+	Publish(oceanMap.GetDisplacement(0).Real,
+		oceanMap.GetDisplacement(1).Real,
+		oceanMap.GetDisplacement(2).Real,
+		waveTime);
+}
+
+bool OceanQuery::HasData()const
+{
+	return AcquireSnapshot() != nullptr;
+}
+
+float OceanQuery::QueryHeights(const float* x, const float* z, std::size_t count, float* heights)const
+{
+	std::shared_ptr<const Snapshot> snapshot = AcquireSnapshot();
+	if (snapshot == nullptr)
+		return -1.0f;
+
+	Query(*snapshot, x, z, count, true, nullptr, heights, nullptr);
+	return snapshot->WaveTime;
+}
+
+float OceanQuery::QueryDisplacements(const float* x, const float* z, std::size_t count,
+	float* displacementX, float* displacementY, float* displacementZ)const
+{
+	std::shared_ptr<const Snapshot> snapshot = AcquireSnapshot();
+	if (snapshot == nullptr)
+		return -1.0f;
+
+	Query(*snapshot, x, z, count, false, displacementX, displacementY, displacementZ);
+	return snapshot->WaveTime;
+}
+
+std::shared_ptr<const OceanQuery::Snapshot> OceanQuery::AcquireSnapshot()const
+{
+	return std::atomic_load(&mCurrent);
+}
+
+std::shared_ptr<OceanQuery::Snapshot> OceanQuery::GetFreeSnapshot()
+{
+	// A snapshot nobody else refers to is neither current nor being read.
+	for (const auto& snapshot : mSnapshots)
+	{
+		if (snapshot.use_count() == 1)
+		{
+			// Pairs with the release of the last reader's reference.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return snapshot;
+		}
+	}
+
+	mSnapshots.push_back(std::make_shared<Snapshot>());
+	return mSnapshots.back();
+}
+
+void OceanQuery::Query(const Snapshot& snapshot, const float* x, const float* z, std::size_t count,
+	bool bInverse, float* outX, float* outY, float* outZ)const
+{
+	const SurfaceMapping& mapping = snapshot.Mapping;
+	const float* texels = snapshot.Texels.data();
+	const int size = mSize;
+	const int iterations = bInverse ? mapping.InverseIterations : 0;
+
+	auto queryRange = [&](int first, int last)
+		{
+			int i = first;
+
+#if defined(OCEAN_QUERY_X86)
+			const __m128 originX = _mm_set1_ps(mapping.OriginX);
+			const __m128 originZ = _mm_set1_ps(mapping.OriginZ);
+			const __m128 uPerX = _mm_set1_ps(mapping.UPerX);
+			const __m128 vPerZ = _mm_set1_ps(mapping.VPerZ);
+
+			for (; i + 4 <= last; i += 4)
+			{
+				const __m128 qx = _mm_loadu_ps(x + i);
+				const __m128 qz = _mm_loadu_ps(z + i);
+
+				__m128 px = qx;
+				__m128 pz = qz;
+				__m128 dx = _mm_setzero_ps();
+				__m128 dy = _mm_setzero_ps();
+				__m128 dz = _mm_setzero_ps();
+				for (int k = 0; k <= iterations; ++k)
+				{
+					const __m128 u = _mm_mul_ps(_mm_sub_ps(px, originX), uPerX);
+					const __m128 v = _mm_mul_ps(_mm_sub_ps(pz, originZ), vPerZ);
+					SampleSse(texels, size, u, v, dx, dy, dz);
+
+					// The grid point that the displacement there would carry onto q.
+					if (k < iterations)
+					{
+						px = _mm_sub_ps(qx, dx);
+						pz = _mm_sub_ps(qz, dz);
+					}
+				}
+
+				if (outX != nullptr)
+					_mm_storeu_ps(outX + i, dx);
+				if (outY != nullptr)
+					_mm_storeu_ps(outY + i, dy);
+				if (outZ != nullptr)
+					_mm_storeu_ps(outZ + i, dz);
+			}
+#endif
+
+			for (; i < last; ++i)
+			{
+				float px = x[i];
+				float pz = z[i];
+				float d[3] = { 0.0f, 0.0f, 0.0f };
+				for (int k = 0; k <= iterations; ++k)
+				{
+					SampleScalar(texels, size,
+						(px - mapping.OriginX) * mapping.UPerX,
+						(pz - mapping.OriginZ) * mapping.VPerZ, d);
+
+					if (k < iterations)
+					{
+						px = x[i] - d[0];
+						pz = z[i] - d[2];
+					}
+				}
+
+				if (outX != nullptr)
+					outX[i] = d[0];
+				if (outY != nullptr)
+					outY[i] = d[1];
+				if (outZ != nullptr)
+					outZ[i] = d[2];
+			}
+		};
+
+	JobSystem::Default().ParallelForRange(0, (int)count, PointGrainSize, queryRange);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CpuOceanMap;
+
+// Answers "where is the ocean surface at (x, z)" for batches of points without
+// touching the GPU.  The simulation publishes its displacement planes, and any
+// thread can query the latest published ones while the next update runs.
+//
+// Publishing copies the planes into a snapshot that is not being read and swaps
+// it in, so in the steady state two snapshots alternate.  A query holds on to
+// the snapshot it started with; if a slow query still has one when the next
+// publish comes around, the publisher takes a fresh snapshot instead of waiting.
+//
+// Positions are in the local space of the ocean surface, before its world
+// matrix.  Texture coordinates follow the ocean grids of OceanApp, and
+// displacements are scaled like Tessellation.hlsl does.
+class OceanQuery
+{
+public:
+	struct SurfaceMapping
+	{
+		// u = (x - OriginX) * UPerX, v = (z - OriginZ) * VPerZ.  The defaults are
+		// the 20 x 30 grid of OceanApp, whose v runs from +z to -z.
+		float OriginX = -10.0f;
+		float OriginZ = 15.0f;
+		float UPerX = 1.0f / 20.0f;
+		float VPerZ = -1.0f / 30.0f;
+
+		float DisplacementScale = 5000000.0f;
+
+		// Fixed-point iterations used to undo the horizontal displacement.
+		int InverseIterations = 4;
+	};
+
+	// size is the resolution of the published planes, a power of two.
+	explicit OceanQuery(int size);
+	OceanQuery(const OceanQuery& rhs) = delete;
+	OceanQuery& operator=(const OceanQuery& rhs) = delete;
+	~OceanQuery() = default;
+
+	// Takes effect with the next Publish.
+	void SetMapping(const SurfaceMapping& mapping);
+
+	// Publishes displacement planes laid out like OceanMap's displacement map 1,
+	// one float per texel.  waveTime is handed back to the queries that use them.
+	void Publish(const float* displacementX, const float* displacementY, const float* displacementZ,
+		float waveTime);
+
+	// Publishes the real parts of the first three displacement slices.
+	void Publish(const CpuOceanMap& oceanMap, float waveTime);
+
+	bool HasData()const;
+
+	// Surface height above each (x[i], z[i]).  The horizontal displacement moves
+	// surface points away from the grid point they belong to, so the grid point
+	// whose displaced position lands on (x, z) is found by fixed-point iteration
+	// first.  Returns the wave time of the planes that were used, or -1 if
+	// nothing has been published yet.
+	float QueryHeights(const float* x, const float* z, std::size_t count, float* heights)const;
+
+	// Displacement of the grid points (x[i], z[i]) themselves, for placing
+	// things that ride on the surface.  Any output may be null.
+	float QueryDisplacements(const float* x, const float* z, std::size_t count,
+		float* displacementX, float* displacementY, float* displacementZ)const;
+
+private:
+	struct Snapshot
+	{
+		// Scaled displacement of every texel as x, y, z, 0.
+		std::vector<float> Texels;
+		SurfaceMapping Mapping;
+		float WaveTime = 0.0f;
+	};
+
+	std::shared_ptr<const Snapshot> AcquireSnapshot()const;
+	std::shared_ptr<Snapshot> GetFreeSnapshot();
+
+	void Query(const Snapshot& snapshot, const float* x, const float* z, std::size_t count,
+		bool bInverse, float* outX, float* outY, float* outZ)const;
+
+	int mSize = 0;
+
+	// Guards mMapping and mSnapshots; only the publishing side takes it.
+	std::mutex mPublishMutex;
+	SurfaceMapping mMapping;
+	std::vector<std::shared_ptr<Snapshot>> mSnapshots;
+
+	// Read and replaced with std::atomic_load/atomic_store.
+	std::shared_ptr<const Snapshot> mCurrent;
+};
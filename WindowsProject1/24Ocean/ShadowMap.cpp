@@ -1,7 +1,8 @@
 #include "ShadowMap.h"
 
-ShadowMap::ShadowMap(ID3D12Device* device, UINT width, UINT height)
+ShadowMap::ShadowMap(ID3D12Device* device, GpuHeapAllocator* heapAllocator, UINT width, UINT height)
 	: md3dDevice{ device },
+	mHeapAllocator{ heapAllocator },
 	mViewport{},
 	mScissorRect{},
 	mWidth{ width },
@@ -10,7 +11,8 @@ ShadowMap::ShadowMap(ID3D12Device* device, UINT width, UINT height)
 	mhCpuSrv{},
 	mhGpuSrv{},
 	mhCpuDsv{},
-	mShadowMap{ nullptr }
+	mShadowMap{ nullptr },
+	mShadowMapMemory{}
 {
 	mViewport =
 	{
@@ -33,6 +35,12 @@ ShadowMap::ShadowMap(ID3D12Device* device, UINT width, UINT height)
 	BuildResource();
 }
 
+ShadowMap::~ShadowMap()
+{
+	mShadowMap = nullptr;
+	mHeapAllocator->Free(mShadowMapMemory);
+}
+
 UINT ShadowMap::Width() const
 {
 	return mWidth;
@@ -133,16 +141,15 @@ void ShadowMap::BuildResource()
 	optClear.DepthStencil.Depth = 1.0f;
 	optClear.DepthStencil.Stencil = 0;
 
-	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-
-	ThrowIfFailed(
-		md3dDevice->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			&optClear,
-			IID_PPV_ARGS(&mShadowMap)
-		)
+	// The old map, if any, is no longer in use by the time the map is resized.
+	mShadowMap = nullptr;
+	mHeapAllocator->Free(mShadowMapMemory);
+
+	mShadowMap = mHeapAllocator->CreateResource(
+		texDesc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		&optClear,
+		mShadowMapMemory
 	);
 }
@@ -1,16 +1,15 @@
 #pragma once
 
 #include "../Common/DxUtil.h"
+#include "../Common/GpuHeapAllocator.h"
 
 class ShadowMap
 {
 public:
-	ShadowMap(ID3D12Device* device, UINT width, UINT height);
+	ShadowMap(ID3D12Device* device, GpuHeapAllocator* heapAllocator, UINT width, UINT height);
 	ShadowMap(const ShadowMap& other) = delete;
-	ShadowMap(ShadowMap&& other) noexcept = default;
 	ShadowMap& operator=(const ShadowMap& other) = delete;
-	ShadowMap& operator=(ShadowMap&& other) noexcept = default;
-	~ShadowMap() = default;
+	~ShadowMap();
 
 	UINT Width() const;
 	UINT Height() const;
@@ -35,6 +34,7 @@ private:
 
 private:
 	ID3D12Device* md3dDevice;
+	GpuHeapAllocator* mHeapAllocator;
 	D3D12_VIEWPORT mViewport;
 	D3D12_RECT mScissorRect;
 
@@ -47,4 +47,5 @@ private:
 	CD3DX12_CPU_DESCRIPTOR_HANDLE mhCpuDsv;
 
 	Microsoft::WRL::ComPtr<ID3D12Resource> mShadowMap;
+	GpuHeapAllocator::Allocation mShadowMapMemory;
 };
\ No newline at end of file
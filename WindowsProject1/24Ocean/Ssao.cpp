@@ -11,11 +11,13 @@ using namespace Microsoft::WRL;
 
 Ssao::Ssao(
     ID3D12Device* device,
+    GpuHeapAllocator* heapAllocator,
     ID3D12GraphicsCommandList* cmdList,
     UINT width, UINT height)
 
 {
     md3dDevice = device;
+    mHeapAllocator = heapAllocator;
 
     OnResize(width, height);
 
@@ -23,6 +25,19 @@ Ssao::Ssao(
     BuildRandomVectorTexture(cmdList);
 }
 
+Ssao::~Ssao()
+{
+    mRandomVectorMap = nullptr;
+    mNormalMap = nullptr;
+    mAmbientMap0 = nullptr;
+    mAmbientMap1 = nullptr;
+
+    mHeapAllocator->Free(mRandomVectorMapMemory);
+    mHeapAllocator->Free(mNormalMapMemory);
+    mHeapAllocator->Free(mAmbientMap0Memory);
+    mHeapAllocator->Free(mAmbientMap1Memory);
+}
+
 UINT Ssao::SsaoMapWidth()const
 {
     return mRenderTargetWidth / 2;
@@ -96,6 +111,11 @@ CD3DX12_GPU_DESCRIPTOR_HANDLE Ssao::AmbientMapSrv()const
     return mhAmbientMap0GpuSrv;
 }
 
+UINT Ssao::GetNumDescriptors()
+{
+    return 5;
+}
+
 void Ssao::BuildDescriptors(
     ID3D12Resource* depthStencilBuffer,
     CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuSrv,
@@ -207,7 +227,7 @@ void Ssao::ComputeSsao(
     cmdList->OMSetRenderTargets(1, &mhAmbientMap0CpuRtv, true, nullptr);
 
     // Bind the constant buffer for this pass.
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
+    auto ssaoCBAddress = currFrame->SsaoCB.GpuAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
     cmdList->SetGraphicsRoot32BitConstant(1, 0, 0);
 
@@ -236,7 +256,7 @@ void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* cur
 {
     cmdList->SetPipelineState(mBlurPso);
 
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
+    auto ssaoCBAddress = currFrame->SsaoCB.GpuAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
 
     for (int i = 0; i < blurCount; ++i)
@@ -302,6 +322,9 @@ void Ssao::BuildResources()
     mNormalMap = nullptr;
     mAmbientMap0 = nullptr;
     mAmbientMap1 = nullptr;
+    mHeapAllocator->Free(mNormalMapMemory);
+    mHeapAllocator->Free(mAmbientMap0Memory);
+    mHeapAllocator->Free(mAmbientMap1Memory);
 
     D3D12_RESOURCE_DESC texDesc;
     ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
@@ -320,13 +343,12 @@ void Ssao::BuildResources()
 
     float normalClearColor[] = { 0.0f, 0.0f, 1.0f, 0.0f };
     CD3DX12_CLEAR_VALUE optClear(NormalMapFormat, normalClearColor);
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
+    mNormalMap = mHeapAllocator->CreateResource(
+        texDesc,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         &optClear,
-        IID_PPV_ARGS(&mNormalMap)));
+        mNormalMapMemory);
 
     // Ambient occlusion maps are at half resolution.
     texDesc.Width = mRenderTargetWidth / 2;
@@ -336,21 +358,19 @@ void Ssao::BuildResources()
     float ambientClearColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
     optClear = CD3DX12_CLEAR_VALUE(AmbientMapFormat, ambientClearColor);
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
+    mAmbientMap0 = mHeapAllocator->CreateResource(
+        texDesc,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         &optClear,
-        IID_PPV_ARGS(&mAmbientMap0)));
+        mAmbientMap0Memory);
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
+    mAmbientMap1 = mHeapAllocator->CreateResource(
+        texDesc,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         &optClear,
-        IID_PPV_ARGS(&mAmbientMap1)));
+        mAmbientMap1Memory);
 }
 
 void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
@@ -369,13 +389,12 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
     texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &texDesc,
+    mRandomVectorMap = mHeapAllocator->CreateResource(
+        texDesc,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
-        IID_PPV_ARGS(&mRandomVectorMap)));
+        mRandomVectorMapMemory);
 
     //
     // In order to copy CPU memory data into our default buffer, we need to create
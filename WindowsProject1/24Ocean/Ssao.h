@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Common/DxUtil.h"
+#include "../Common/GpuHeapAllocator.h"
 #include "FrameResource.h"
 
 
@@ -9,11 +10,12 @@ class Ssao
 public:
 
     Ssao(ID3D12Device* device,
+        GpuHeapAllocator* heapAllocator,
         ID3D12GraphicsCommandList* cmdList,
         UINT width, UINT height);
     Ssao(const Ssao& rhs) = delete;
     Ssao& operator=(const Ssao& rhs) = delete;
-    ~Ssao() = default;
+    ~Ssao();
 
     static const DXGI_FORMAT AmbientMapFormat = DXGI_FORMAT_R16_UNORM;
     static const DXGI_FORMAT NormalMapFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
@@ -34,6 +36,10 @@ public:
     CD3DX12_GPU_DESCRIPTOR_HANDLE NormalMapSrv()const;
     CD3DX12_GPU_DESCRIPTOR_HANDLE AmbientMapSrv()const;
 
+    // Shader resource views BuildDescriptors writes from hCpuSrv on: the two
+    // ambient maps, the normal map, the depth map and the random vector map.
+    static UINT GetNumDescriptors();
+
     void BuildDescriptors(
         ID3D12Resource* depthStencilBuffer,
         CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuSrv,
@@ -81,6 +87,7 @@ private:
 
 private:
     ID3D12Device* md3dDevice;
+    GpuHeapAllocator* mHeapAllocator = nullptr;
 
     Microsoft::WRL::ComPtr<ID3D12RootSignature> mSsaoRootSig;
 
@@ -93,6 +100,11 @@ private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mAmbientMap0;
     Microsoft::WRL::ComPtr<ID3D12Resource> mAmbientMap1;
 
+    GpuHeapAllocator::Allocation mRandomVectorMapMemory;
+    GpuHeapAllocator::Allocation mNormalMapMemory;
+    GpuHeapAllocator::Allocation mAmbientMap0Memory;
+    GpuHeapAllocator::Allocation mAmbientMap1Memory;
+
     CD3DX12_CPU_DESCRIPTOR_HANDLE mhNormalMapCpuSrv;
     CD3DX12_GPU_DESCRIPTOR_HANDLE mhNormalMapGpuSrv;
     CD3DX12_CPU_DESCRIPTOR_HANDLE mhNormalMapCpuRtv;
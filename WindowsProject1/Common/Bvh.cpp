@@ -0,0 +1,616 @@
+#include "Bvh.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr int SahBinCount = 12;
+
+	// Cost of visiting a node relative to testing one primitive.
+	constexpr float SahTraversalCost = 1.0f;
+
+	constexpr UINT TriangleLeafSize = 4;
+	constexpr UINT InstanceLeafSize = 1;
+
+	// Smallest ray direction component magnitude IntersectNode sees.  Its
+	// reciprocal is still finite, so slab distances are never NaN.
+	constexpr float MinDirectionComponent = 1e-30f;
+
+	BvhAabb EmptyAabb()
+	{
+		BvhAabb box;
+		box.Min = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		box.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		return box;
+	}
+
+	void Grow(BvhAabb& box, const BvhAabb& other)
+	{
+		box.Min.x = std::min(box.Min.x, other.Min.x);
+		box.Min.y = std::min(box.Min.y, other.Min.y);
+		box.Min.z = std::min(box.Min.z, other.Min.z);
+		box.Max.x = std::max(box.Max.x, other.Max.x);
+		box.Max.y = std::max(box.Max.y, other.Max.y);
+		box.Max.z = std::max(box.Max.z, other.Max.z);
+	}
+
+	void Grow(BvhAabb& box, const XMFLOAT3& point)
+	{
+		box.Min.x = std::min(box.Min.x, point.x);
+		box.Min.y = std::min(box.Min.y, point.y);
+		box.Min.z = std::min(box.Min.z, point.z);
+		box.Max.x = std::max(box.Max.x, point.x);
+		box.Max.y = std::max(box.Max.y, point.y);
+		box.Max.z = std::max(box.Max.z, point.z);
+	}
+
+	float SurfaceArea(const BvhAabb& box)
+	{
+		if (box.Min.x > box.Max.x)
+			return 0.0f;
+
+		const float dx = box.Max.x - box.Min.x;
+		const float dy = box.Max.y - box.Min.y;
+		const float dz = box.Max.z - box.Min.z;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	float Component(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	XMFLOAT3 Centroid(const BvhAabb& box)
+	{
+		return XMFLOAT3(
+			0.5f * (box.Min.x + box.Max.x),
+			0.5f * (box.Min.y + box.Max.y),
+			0.5f * (box.Min.z + box.Max.z));
+	}
+
+	void SetNodeBounds(BvhNode& node, const BvhAabb& box)
+	{
+		node.BoundsMin = box.Min;
+		node.BoundsMax = box.Max;
+	}
+
+	BvhAabb GetNodeBounds(const BvhNode& node)
+	{
+		BvhAabb box;
+		box.Min = node.BoundsMin;
+		box.Max = node.BoundsMax;
+		return box;
+	}
+
+	// Two-sided Moller-Trumbore.  Unlike TriangleTests::Intersects the direction does
+	// not have to be normalized, so t stays comparable across instances whose
+	// transforms scale the ray differently.
+	bool IntersectTriangle(FXMVECTOR origin, FXMVECTOR direction,
+		FXMVECTOR v0, GXMVECTOR v1, HXMVECTOR v2, float tMax, float& t)
+	{
+		const XMVECTOR e1 = XMVectorSubtract(v1, v0);
+		const XMVECTOR e2 = XMVectorSubtract(v2, v0);
+
+		const XMVECTOR p = XMVector3Cross(direction, e2);
+		const float det = XMVectorGetX(XMVector3Dot(e1, p));
+		if (det == 0.0f)
+			return false;
+
+		const float invDet = 1.0f / det;
+
+		const XMVECTOR s = XMVectorSubtract(origin, v0);
+		const float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		const XMVECTOR q = XMVector3Cross(s, e1);
+		const float v = XMVectorGetX(XMVector3Dot(direction, q)) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		const float hitT = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+		if (hitT < 0.0f || hitT >= tMax)
+			return false;
+
+		t = hitT;
+		return true;
+	}
+
+	BvhAabb TransformAabb(const BoundingBox& localBox, const XMFLOAT4X4& world)
+	{
+		BoundingBox worldBox;
+		localBox.Transform(worldBox, XMLoadFloat4x4(&world));
+
+		BvhAabb box;
+		box.Min = XMFLOAT3(
+			worldBox.Center.x - worldBox.Extents.x,
+			worldBox.Center.y - worldBox.Extents.y,
+			worldBox.Center.z - worldBox.Extents.z);
+		box.Max = XMFLOAT3(
+			worldBox.Center.x + worldBox.Extents.x,
+			worldBox.Center.y + worldBox.Extents.y,
+			worldBox.Center.z + worldBox.Extents.z);
+		return box;
+	}
+}
+
+void Bvh::Build(const BvhAabb* primitiveBounds, UINT primitiveCount, UINT maxLeafSize)
+{
+	assert(maxLeafSize > 0);
+
+	nodes.clear();
+	primitiveOrder.resize(primitiveCount);
+	for (UINT i = 0; i < primitiveCount; ++i)
+		primitiveOrder[i] = i;
+
+	if (primitiveCount == 0)
+	{
+		UpdateLinks();
+		return;
+	}
+
+	std::vector<XMFLOAT3> centroids(primitiveCount);
+	for (UINT i = 0; i < primitiveCount; ++i)
+		centroids[i] = Centroid(primitiveBounds[i]);
+
+	nodes.reserve(2 * primitiveCount - 1);
+	nodes.push_back(BvhNode{});
+	nodes[0].LeftFirst = 0;
+	nodes[0].Count = primitiveCount;
+
+	struct BuildTask
+	{
+		UINT Node;
+		UINT First;
+		UINT Count;
+	};
+
+	std::vector<BuildTask> tasks;
+	tasks.push_back(BuildTask{ 0, 0, primitiveCount });
+
+	struct Bin
+	{
+		BvhAabb Bounds;
+		UINT Count;
+	};
+
+	while (!tasks.empty())
+	{
+		const BuildTask task = tasks.back();
+		tasks.pop_back();
+
+		BvhAabb bounds = EmptyAabb();
+		BvhAabb centroidBounds = EmptyAabb();
+		for (UINT i = task.First; i < task.First + task.Count; ++i)
+		{
+			Grow(bounds, primitiveBounds[primitiveOrder[i]]);
+			Grow(centroidBounds, centroids[primitiveOrder[i]]);
+		}
+		SetNodeBounds(nodes[task.Node], bounds);
+
+		nodes[task.Node].LeftFirst = task.First;
+		nodes[task.Node].Count = task.Count;
+		if (task.Count <= maxLeafSize)
+			continue;
+
+		// Binned SAH: bucket the centroids along each axis and take the plane between
+		// buckets that minimizes area-weighted primitive counts.
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float lo = Component(centroidBounds.Min, axis);
+			const float hi = Component(centroidBounds.Max, axis);
+			if (hi <= lo)
+				continue;
+
+			Bin bins[SahBinCount];
+			for (Bin& bin : bins)
+			{
+				bin.Bounds = EmptyAabb();
+				bin.Count = 0;
+			}
+
+			const float scale = SahBinCount / (hi - lo);
+			for (UINT i = task.First; i < task.First + task.Count; ++i)
+			{
+				const UINT primitive = primitiveOrder[i];
+				const int b = std::min(SahBinCount - 1, (int)((Component(centroids[primitive], axis) - lo) * scale));
+				Grow(bins[b].Bounds, primitiveBounds[primitive]);
+				bins[b].Count++;
+			}
+
+			// Sweep from the right to get the cost of every right-hand side, then from
+			// the left to combine it with the left-hand side.
+			float rightArea[SahBinCount - 1];
+			UINT rightCount[SahBinCount - 1];
+			BvhAabb sweep = EmptyAabb();
+			UINT count = 0;
+			for (int b = SahBinCount - 1; b > 0; --b)
+			{
+				Grow(sweep, bins[b].Bounds);
+				count += bins[b].Count;
+				rightArea[b - 1] = SurfaceArea(sweep);
+				rightCount[b - 1] = count;
+			}
+
+			sweep = EmptyAabb();
+			count = 0;
+			for (int b = 0; b < SahBinCount - 1; ++b)
+			{
+				Grow(sweep, bins[b].Bounds);
+				count += bins[b].Count;
+
+				const float cost = count * SurfaceArea(sweep) + rightCount[b] * rightArea[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		// Make a leaf when splitting is not worth the extra traversal step.  When
+		// every centroid sits in one spot there is no plane to pick, so the range is
+		// just halved to keep the leaves small.
+		if (bestAxis >= 0)
+		{
+			const float leafCost = task.Count * SurfaceArea(bounds);
+			const float splitCost = SahTraversalCost * SurfaceArea(bounds) + bestCost;
+			if (splitCost >= leafCost && task.Count <= 4 * maxLeafSize)
+				continue;
+		}
+
+		UINT* first = primitiveOrder.data() + task.First;
+		UINT* last = first + task.Count;
+		UINT* middle = first + task.Count / 2;
+
+		if (bestAxis >= 0)
+		{
+			const float lo = Component(centroidBounds.Min, bestAxis);
+			const float scale = SahBinCount / (Component(centroidBounds.Max, bestAxis) - lo);
+			middle = std::partition(first, last, [&](UINT primitive)
+				{
+					const int b = std::min(SahBinCount - 1, (int)((Component(centroids[primitive], bestAxis) - lo) * scale));
+					return b <= bestSplit;
+				});
+		}
+
+		if (middle == first || middle == last)
+			middle = first + task.Count / 2;
+
+		const UINT leftCount = (UINT)(middle - first);
+		const UINT leftChild = (UINT)nodes.size();
+		nodes.push_back(BvhNode{});
+		nodes.push_back(BvhNode{});
+
+		nodes[task.Node].LeftFirst = leftChild;
+		nodes[task.Node].Count = 0;
+
+		tasks.push_back(BuildTask{ leftChild + 1, task.First + leftCount, task.Count - leftCount });
+		tasks.push_back(BuildTask{ leftChild, task.First, leftCount });
+	}
+
+	UpdateLinks();
+}
+
+void Bvh::Refit(const BvhAabb* primitiveBounds)
+{
+	// Children always come after their parent, so a reverse sweep sees both
+	// children of a node before the node itself.
+	nodeAreaSum = 0.0;
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		const BvhAabb bounds = ComputeNodeBounds(nodes[i], primitiveBounds);
+		SetNodeBounds(nodes[i], bounds);
+		nodeAreaSum += SurfaceArea(bounds);
+	}
+}
+
+void Bvh::RefitPrimitives(const BvhAabb* primitiveBounds, const UINT* primitives, UINT count)
+{
+	for (UINT i = 0; i < count; ++i)
+	{
+		assert(primitives[i] < leafOfPrimitive.size());
+
+		for (UINT index = leafOfPrimitive[primitives[i]]; index != UINT_MAX; index = parents[index])
+		{
+			BvhNode& node = nodes[index];
+			const BvhAabb oldBounds = GetNodeBounds(node);
+			const BvhAabb bounds = ComputeNodeBounds(node, primitiveBounds);
+
+			// Nothing above can change either.  Another moved primitive under the
+			// same node may still make it change on its own walk.
+			if (std::memcmp(&bounds, &oldBounds, sizeof(BvhAabb)) == 0)
+				break;
+
+			SetNodeBounds(node, bounds);
+			nodeAreaSum += SurfaceArea(bounds) - SurfaceArea(oldBounds);
+		}
+	}
+}
+
+float Bvh::GetSurfaceAreaCost() const noexcept
+{
+	if (nodes.empty())
+		return 0.0f;
+
+	const float rootArea = SurfaceArea(GetNodeBounds(nodes[0]));
+	return rootArea > 0.0f ? static_cast<float>(nodeAreaSum / rootArea) : 0.0f;
+}
+
+void Bvh::GetSubtreeRange(UINT node, UINT& first, UINT& count) const
+{
+	// Leftmost and rightmost leaves bound the run, as every split partitions its
+	// parent's run into a left and a right part.
+	UINT left = node;
+	while (!nodes[left].IsLeaf())
+		left = nodes[left].LeftFirst;
+
+	UINT right = node;
+	while (!nodes[right].IsLeaf())
+		right = nodes[right].LeftFirst + 1;
+
+	first = nodes[left].LeftFirst;
+	count = nodes[right].LeftFirst + nodes[right].Count - first;
+}
+
+void Bvh::UpdateLinks()
+{
+	parents.assign(nodes.size(), UINT_MAX);
+	leafOfPrimitive.resize(primitiveOrder.size());
+	nodeAreaSum = 0.0;
+
+	for (UINT i = 0; i < (UINT)nodes.size(); ++i)
+	{
+		const BvhNode& node = nodes[i];
+		if (node.IsLeaf())
+		{
+			for (UINT k = node.LeftFirst; k < node.LeftFirst + node.Count; ++k)
+				leafOfPrimitive[primitiveOrder[k]] = i;
+		}
+		else
+		{
+			parents[node.LeftFirst] = i;
+			parents[node.LeftFirst + 1] = i;
+		}
+
+		nodeAreaSum += SurfaceArea(GetNodeBounds(node));
+	}
+}
+
+BvhAabb Bvh::ComputeNodeBounds(const BvhNode& node, const BvhAabb* primitiveBounds) const
+{
+	BvhAabb bounds = EmptyAabb();
+
+	if (node.IsLeaf())
+	{
+		for (UINT k = node.LeftFirst; k < node.LeftFirst + node.Count; ++k)
+			Grow(bounds, primitiveBounds[primitiveOrder[k]]);
+	}
+	else
+	{
+		Grow(bounds, GetNodeBounds(nodes[node.LeftFirst]));
+		Grow(bounds, GetNodeBounds(nodes[node.LeftFirst + 1]));
+	}
+
+	return bounds;
+}
+
+XMVECTOR Bvh::GetInverseDirection(FXMVECTOR direction)
+{
+	XMFLOAT4 d;
+	XMStoreFloat4(&d, direction);
+
+	float* components[4] = { &d.x, &d.y, &d.z, &d.w };
+	for (float* c : components)
+	{
+		if (std::fabs(*c) < MinDirectionComponent)
+			*c = std::copysign(MinDirectionComponent, *c);
+	}
+
+	return XMVectorReciprocal(XMLoadFloat4(&d));
+}
+
+bool Bvh::IntersectNode(const BvhNode& node, FXMVECTOR origin, FXMVECTOR invDirection,
+	float tMax, float& tEntry)
+{
+	// All three slabs at once.  Along an axis the ray does not move on, the
+	// nudged reciprocal turns the slab distances into huge values of either
+	// sign, or 0 when the origin is on the plane, so none of them is NaN and the
+	// min/max below do not depend on operand order.
+	const XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.BoundsMin), origin), invDirection);
+	const XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.BoundsMax), origin), invDirection);
+
+	const XMVECTOR tNear = XMVectorMin(t0, t1);
+	const XMVECTOR tFar = XMVectorMax(t0, t1);
+
+	XMVECTOR enter = XMVectorMax(tNear, XMVectorSwizzle<1, 2, 0, 3>(tNear));
+	enter = XMVectorMax(enter, XMVectorSwizzle<2, 0, 1, 3>(tNear));
+	XMVECTOR exit = XMVectorMin(tFar, XMVectorSwizzle<1, 2, 0, 3>(tFar));
+	exit = XMVectorMin(exit, XMVectorSwizzle<2, 0, 1, 3>(tFar));
+
+	const float tEnter = std::max(XMVectorGetX(enter), 0.0f);
+	const float tExit = std::min(XMVectorGetX(exit), tMax);
+	if (tEnter > tExit)
+		return false;
+
+	tEntry = tEnter;
+	return true;
+}
+
+void TriangleBvh::Build(const MeshGeometry& geometry, const SubmeshGeometry& submesh)
+{
+	assert(geometry.VertexBufferCPU != nullptr);
+	assert(geometry.IndexBufferCPU != nullptr);
+
+	Build(
+		geometry.VertexBufferCPU->GetBufferPointer(), geometry.VertexByteStride,
+		geometry.IndexBufferCPU->GetBufferPointer(), geometry.IndexFormat,
+		submesh.IndexCount, submesh.StartIndexLocation, submesh.BaseVertexLocation);
+}
+
+void TriangleBvh::Build(
+	const void* vertexData, UINT vertexByteStride,
+	const void* indexData, DXGI_FORMAT indexFormat,
+	UINT indexCount, UINT startIndexLocation, int baseVertexLocation)
+{
+	assert(indexFormat == DXGI_FORMAT_R16_UINT || indexFormat == DXGI_FORMAT_R32_UINT);
+
+	const auto vertexBytes = static_cast<const unsigned char*>(vertexData);
+	auto readIndex = [&](UINT i) -> UINT
+		{
+			if (indexFormat == DXGI_FORMAT_R16_UINT)
+				return static_cast<const std::uint16_t*>(indexData)[startIndexLocation + i];
+			return static_cast<const std::uint32_t*>(indexData)[startIndexLocation + i];
+		};
+	auto readPosition = [&](UINT index) -> XMFLOAT3
+		{
+			XMFLOAT3 position;
+			std::memcpy(&position, vertexBytes + (size_t)((int)index + baseVertexLocation) * vertexByteStride, sizeof(XMFLOAT3));
+			return position;
+		};
+
+	const UINT triangleCount = indexCount / 3;
+
+	std::vector<Triangle> sourceTriangles(triangleCount);
+	std::vector<BvhAabb> bounds(triangleCount);
+	for (UINT i = 0; i < triangleCount; ++i)
+	{
+		Triangle& tri = sourceTriangles[i];
+		tri.V0 = readPosition(readIndex(3 * i + 0));
+		tri.V1 = readPosition(readIndex(3 * i + 1));
+		tri.V2 = readPosition(readIndex(3 * i + 2));
+		tri.Index = i;
+
+		bounds[i] = EmptyAabb();
+		Grow(bounds[i], tri.V0);
+		Grow(bounds[i], tri.V1);
+		Grow(bounds[i], tri.V2);
+	}
+
+	bvh.Build(bounds.data(), triangleCount, TriangleLeafSize);
+
+	// Store the triangles in leaf order so a leaf's triangles are contiguous.
+	const std::vector<UINT>& order = bvh.GetPrimitiveOrder();
+	triangles.resize(triangleCount);
+	for (UINT i = 0; i < triangleCount; ++i)
+		triangles[i] = sourceTriangles[order[i]];
+}
+
+bool TriangleBvh::Intersect(FXMVECTOR origin, FXMVECTOR direction, BvhHit& hit) const
+{
+	bool bHit = false;
+	float tMax = hit.T;
+
+	bvh.TraverseRay(origin, direction, tMax, [&](UINT first, UINT count, float& leafTMax)
+		{
+			for (UINT i = first; i < first + count; ++i)
+			{
+				const Triangle& tri = triangles[i];
+
+				float t = 0.0f;
+				if (!IntersectTriangle(origin, direction,
+					XMLoadFloat3(&tri.V0), XMLoadFloat3(&tri.V1), XMLoadFloat3(&tri.V2), leafTMax, t))
+					continue;
+
+				leafTMax = t;
+				hit.T = t;
+				hit.TriangleIndex = tri.Index;
+				bHit = true;
+			}
+		});
+
+	return bHit;
+}
+
+BoundingBox TriangleBvh::GetBounds() const
+{
+	BoundingBox box;
+	if (bvh.IsEmpty())
+		return box;
+
+	const BvhNode& root = bvh.GetNodes()[0];
+	BoundingBox::CreateFromPoints(box, XMLoadFloat3(&root.BoundsMin), XMLoadFloat3(&root.BoundsMax));
+	return box;
+}
+
+void InstanceBvh::Build(const std::vector<Instance>& newInstances)
+{
+	const UINT count = (UINT)newInstances.size();
+	instances.resize(count);
+	worldBounds.resize(count);
+
+	for (UINT i = 0; i < count; ++i)
+	{
+		assert(newInstances[i].Mesh != nullptr);
+		instances[i].Mesh = newInstances[i].Mesh;
+		UpdateInstance(i, newInstances[i].World);
+	}
+
+	bvh.Build(worldBounds.data(), count, InstanceLeafSize);
+}
+
+void InstanceBvh::SetInstanceWorld(UINT index, const XMFLOAT4X4& world)
+{
+	assert(index < instances.size());
+	UpdateInstance(index, world);
+}
+
+void InstanceBvh::Refit()
+{
+	bvh.Refit(worldBounds.data());
+}
+
+void InstanceBvh::UpdateInstance(UINT index, const XMFLOAT4X4& world)
+{
+	InstanceEntry& entry = instances[index];
+
+	XMMATRIX W = XMLoadFloat4x4(&world);
+	XMVECTOR determinant = XMMatrixDeterminant(W);
+	XMStoreFloat4x4(&entry.InvWorld, XMMatrixInverse(&determinant, W));
+
+	worldBounds[index] = TransformAabb(entry.Mesh->GetBounds(), world);
+}
+
+bool InstanceBvh::Intersect(FXMVECTOR origin, FXMVECTOR direction, BvhHit& hit) const
+{
+	bool bHit = false;
+	float tMax = hit.T;
+
+	const std::vector<UINT>& order = bvh.GetPrimitiveOrder();
+	bvh.TraverseRay(origin, direction, tMax, [&](UINT first, UINT count, float& leafTMax)
+		{
+			for (UINT i = first; i < first + count; ++i)
+			{
+				const UINT instanceIndex = order[i];
+				const InstanceEntry& entry = instances[instanceIndex];
+
+				// The direction is not renormalized, so a local hit distance is also the
+				// world hit distance and hits of differently scaled instances compare.
+				XMMATRIX invWorld = XMLoadFloat4x4(&entry.InvWorld);
+				XMVECTOR localOrigin = XMVector3TransformCoord(origin, invWorld);
+				XMVECTOR localDirection = XMVector3TransformNormal(direction, invWorld);
+
+				BvhHit localHit;
+				localHit.T = leafTMax;
+				if (!entry.Mesh->Intersect(localOrigin, localDirection, localHit))
+					continue;
+
+				leafTMax = localHit.T;
+				hit.T = localHit.T;
+				hit.TriangleIndex = localHit.TriangleIndex;
+				hit.InstanceIndex = instanceIndex;
+				bHit = true;
+			}
+		});
+
+	return bHit;
+}
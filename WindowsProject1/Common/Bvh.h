@@ -0,0 +1,294 @@
+#pragma once
+
+#include "DxUtil.h"
+
+#include <vector>
+
+// Node of a flattened bounding volume hierarchy.  The two children of an interior
+// node are stored next to each other with the left one at LeftFirst, and always
+// after their parent.  A leaf covers Count primitives starting at LeftFirst in the
+// hierarchy's primitive order.
+struct BvhNode
+{
+	DirectX::XMFLOAT3 BoundsMin;
+	UINT LeftFirst;
+	DirectX::XMFLOAT3 BoundsMax;
+	UINT Count;
+
+	bool IsLeaf() const noexcept { return Count != 0; }
+};
+
+struct BvhAabb
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+};
+
+// How a node's bounds relate to the region of an overlap query.  Everything
+// under an Inside node is in the region, so it needs no further tests.
+enum class BvhOverlap
+{
+	Outside,
+	Partial,
+	Inside
+};
+
+// Closest hit found by a ray query.  T is in units of the query direction.
+struct BvhHit
+{
+	float T = MathHelper::Infinity;
+	UINT InstanceIndex = UINT_MAX;
+	UINT TriangleIndex = UINT_MAX;
+
+	bool IsHit() const noexcept { return TriangleIndex != UINT_MAX; }
+};
+
+// Binned-SAH hierarchy over arbitrary primitive bounds.  TriangleBvh and
+// InstanceBvh put their own primitives on top of it.
+class Bvh
+{
+public:
+	void Build(const BvhAabb* primitiveBounds, UINT primitiveCount, UINT maxLeafSize);
+
+	// Recomputes every node's bounds after primitives moved, keeping the topology.
+	void Refit(const BvhAabb* primitiveBounds);
+
+	// Recomputes only the leaves holding the given primitives and the nodes above
+	// them, stopping on each path at the first node whose bounds did not change.
+	void RefitPrimitives(const BvhAabb* primitiveBounds, const UINT* primitives, UINT count);
+
+	// Sum of the surface areas of all nodes divided by the root's, which is what
+	// the SAH cost of a query comes down to.  Refits that let nodes grow and
+	// overlap raise it; a rebuild brings it back down.
+	float GetSurfaceAreaCost() const noexcept;
+
+	// The primitives under a node are a contiguous run of GetPrimitiveOrder().
+	void GetSubtreeRange(UINT node, UINT& first, UINT& count) const;
+
+	const std::vector<BvhNode>& GetNodes() const noexcept { return nodes; }
+	const std::vector<UINT>& GetPrimitiveOrder() const noexcept { return primitiveOrder; }
+	bool IsEmpty() const noexcept { return nodes.empty(); }
+
+	// Per-component reciprocal of a ray direction, for IntersectNode.  Zero
+	// components are first nudged to a tiny value of the same sign, so an origin
+	// lying exactly on a slab plane gives 0 instead of 0 * inf = NaN.
+	static DirectX::XMVECTOR GetInverseDirection(DirectX::FXMVECTOR direction);
+
+	// Slab test of a ray against a node.  invDirection comes from
+	// GetInverseDirection.  On a hit returns the entry distance.
+	static bool IntersectNode(const BvhNode& node, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR invDirection,
+		float tMax, float& tEntry);
+
+	// Visits, nearest first, every leaf the ray reaches before tMax.  The visitor is
+	// called as visitLeaf(firstPrimitive, primitiveCount, tMax) where the range
+	// indexes GetPrimitiveOrder(), and may lower tMax to prune the rest of the walk.
+	template<typename LeafVisitor>
+	void TraverseRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float& tMax, LeafVisitor&& visitLeaf) const
+	{
+		if (nodes.empty())
+			return;
+
+		const DirectX::XMVECTOR invDirection = GetInverseDirection(direction);
+
+		float tEntry = 0.0f;
+		if (!IntersectNode(nodes[0], origin, invDirection, tMax, tEntry))
+			return;
+
+		TraversalStack stack;
+		stack.Push(0);
+
+		while (!stack.IsEmpty())
+		{
+			const BvhNode& node = nodes[stack.Pop()];
+
+			if (node.IsLeaf())
+			{
+				visitLeaf(node.LeftFirst, node.Count, tMax);
+				continue;
+			}
+
+			float tLeft = 0.0f;
+			float tRight = 0.0f;
+			const bool bHitLeft = IntersectNode(nodes[node.LeftFirst], origin, invDirection, tMax, tLeft);
+			const bool bHitRight = IntersectNode(nodes[node.LeftFirst + 1], origin, invDirection, tMax, tRight);
+
+			// Push the far child first so the near one is visited first.
+			if (bHitLeft && bHitRight)
+			{
+				const bool bLeftFirst = tLeft <= tRight;
+				stack.Push(node.LeftFirst + (bLeftFirst ? 1 : 0));
+				stack.Push(node.LeftFirst + (bLeftFirst ? 0 : 1));
+			}
+			else if (bHitLeft)
+			{
+				stack.Push(node.LeftFirst);
+			}
+			else if (bHitRight)
+			{
+				stack.Push(node.LeftFirst + 1);
+			}
+		}
+	}
+
+	// Visits the primitives of every node testNode does not put Outside.  testNode
+	// is called as testNode(node) and returns a BvhOverlap; visitRange is called as
+	// visitRange(first, count, bInside) with a run of GetPrimitiveOrder().  An
+	// Inside node is visited as a whole with bInside set and its subtree is not
+	// tested; a Partial leaf is visited with bInside clear, so the caller tests
+	// its primitives itself.
+	template<typename NodeTest, typename RangeVisitor>
+	void TraverseOverlap(NodeTest&& testNode, RangeVisitor&& visitRange) const
+	{
+		if (nodes.empty())
+			return;
+
+		TraversalStack stack;
+		stack.Push(0);
+
+		while (!stack.IsEmpty())
+		{
+			const UINT index = stack.Pop();
+			const BvhNode& node = nodes[index];
+
+			const BvhOverlap overlap = testNode(node);
+			if (overlap == BvhOverlap::Outside)
+				continue;
+
+			if (node.IsLeaf() || overlap == BvhOverlap::Inside)
+			{
+				UINT first = 0;
+				UINT count = 0;
+				GetSubtreeRange(index, first, count);
+				visitRange(first, count, overlap == BvhOverlap::Inside);
+				continue;
+			}
+
+			stack.Push(node.LeftFirst + 1);
+			stack.Push(node.LeftFirst);
+		}
+	}
+
+private:
+	// Nodes still to visit in a traversal.  SAH splits can leave a tree far deeper
+	// than a balanced one, so entries past the inline ones spill to the heap
+	// instead of running off the end.
+	class TraversalStack
+	{
+	public:
+		void Push(UINT node)
+		{
+			if (size < InlineCapacity)
+				inlineNodes[size] = node;
+			else
+				spilledNodes.push_back(node);
+			++size;
+		}
+
+		UINT Pop()
+		{
+			--size;
+			if (size < InlineCapacity)
+				return inlineNodes[size];
+
+			const UINT node = spilledNodes.back();
+			spilledNodes.pop_back();
+			return node;
+		}
+
+		bool IsEmpty() const noexcept { return size == 0; }
+
+	private:
+		static constexpr UINT InlineCapacity = 64;
+
+		UINT inlineNodes[InlineCapacity];
+		UINT size = 0;
+		std::vector<UINT> spilledNodes;
+	};
+
+	void UpdateLinks();
+	BvhAabb ComputeNodeBounds(const BvhNode& node, const BvhAabb* primitiveBounds) const;
+
+	std::vector<BvhNode> nodes;
+	std::vector<UINT> primitiveOrder;
+
+	// Parent of every node, UINT_MAX for the root, and the leaf of every primitive,
+	// for refitting just the paths above moved primitives.
+	std::vector<UINT> parents;
+	std::vector<UINT> leafOfPrimitive;
+
+	double nodeAreaSum = 0.0;
+};
+
+// Bottom-level hierarchy over the triangles of one submesh.  The triangles are
+// copied out of the CPU vertex/index buffers in leaf order, so a query never
+// touches the original buffers.
+class TriangleBvh
+{
+public:
+	// Positions are read from offset 0 of each vertex, as in every vertex format
+	// of the framework.
+	void Build(const MeshGeometry& geometry, const SubmeshGeometry& submesh);
+
+	void Build(
+		const void* vertexData, UINT vertexByteStride,
+		const void* indexData, DXGI_FORMAT indexFormat,
+		UINT indexCount, UINT startIndexLocation, int baseVertexLocation);
+
+	// Closest triangle hit by the ray before hit.T, in the submesh's local space.
+	// The direction does not need to be normalized.  TriangleIndex is relative to
+	// the submesh's StartIndexLocation.
+	bool Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, BvhHit& hit) const;
+
+	DirectX::BoundingBox GetBounds() const;
+	UINT GetTriangleCount() const noexcept { return (UINT)triangles.size(); }
+
+private:
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 V0;
+		DirectX::XMFLOAT3 V1;
+		DirectX::XMFLOAT3 V2;
+		UINT Index;
+	};
+
+	Bvh bvh;
+	std::vector<Triangle> triangles;
+};
+
+// Top-level hierarchy over placed instances of TriangleBvhs.  A ray query walks
+// this tree in world space and only descends into the meshes of the instances
+// whose world bounds it reaches.
+class InstanceBvh
+{
+public:
+	struct Instance
+	{
+		const TriangleBvh* Mesh = nullptr;
+		DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+	};
+
+	void Build(const std::vector<Instance>& newInstances);
+
+	// Moves an instance.  Call Refit once after moving a batch of instances.
+	void SetInstanceWorld(UINT index, const DirectX::XMFLOAT4X4& world);
+	void Refit();
+
+	// Closest triangle hit by the world-space ray before hit.T.  InstanceIndex is
+	// the instance's position in the vector passed to Build.
+	bool Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, BvhHit& hit) const;
+
+	UINT GetInstanceCount() const noexcept { return (UINT)instances.size(); }
+
+private:
+	struct InstanceEntry
+	{
+		const TriangleBvh* Mesh;
+		DirectX::XMFLOAT4X4 InvWorld;
+	};
+
+	void UpdateInstance(UINT index, const DirectX::XMFLOAT4X4& world);
+
+	Bvh bvh;
+	std::vector<InstanceEntry> instances;
+	std::vector<BvhAabb> worldBounds;
+};
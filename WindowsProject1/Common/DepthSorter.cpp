@@ -0,0 +1,108 @@
+#include "DepthSorter.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr uint32_t KeyBits = 16;
+	constexpr uint32_t MaxKey = (1u << KeyBits) - 1;
+
+	// Moves the insertion sort may make per item before it gives up on the
+	// previous order and leaves the rest to the radix sort.  This alone tells a
+	// coherent order from one that is not: many items each a step or two out of
+	// place sort in a few moves, while a shuffled order runs out of moves early.
+	constexpr size_t InsertionMovesPerItem = 4;
+	constexpr size_t MinInsertionMoves = 256;
+}
+
+void DepthSorter::SortBackToFront(const float* viewDepths, uint32_t count)
+{
+	if (order.size() != count)
+	{
+		order.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+			order[i] = i;
+	}
+
+	if (count == 0)
+	{
+		lastPath = SortPath::AlreadySorted;
+		return;
+	}
+
+	float nearest = viewDepths[0];
+	float farthest = viewDepths[0];
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		nearest = std::min(nearest, viewDepths[i]);
+		farthest = std::max(farthest, viewDepths[i]);
+	}
+
+	// Keys grow towards the viewer, so an ascending sort is back to front.
+	const float range = farthest - nearest;
+	const float scale = range > 0.0f ? static_cast<float>(MaxKey) / range : 0.0f;
+
+	entries.resize(count);
+	bool bSorted = true;
+	uint32_t previousKey = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t item = order[i];
+		const float t = (farthest - viewDepths[item]) * scale;
+		const uint32_t key = std::min(static_cast<uint32_t>(t), MaxKey);
+
+		entries[i].Key = key;
+		entries[i].Item = item;
+
+		bSorted = bSorted && key >= previousKey;
+		previousKey = key;
+	}
+
+	if (bSorted)
+	{
+		lastPath = SortPath::AlreadySorted;
+		return;
+	}
+
+	if (InsertionSort(std::max(MinInsertionMoves, InsertionMovesPerItem * count)))
+	{
+		lastPath = SortPath::Insertion;
+	}
+	else
+	{
+		RadixSortByKey<KeyBits>(entries, scratch);
+		lastPath = SortPath::Radix;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+		order[i] = entries[i].Item;
+}
+
+void DepthSorter::Reset()
+{
+	order.clear();
+	lastPath = SortPath::AlreadySorted;
+}
+
+bool DepthSorter::InsertionSort(size_t maxMoveCount)
+{
+	// Stops once it has moved too much; what it leaves behind is still a
+	// permutation in which equal keys keep their order, so the radix sort can
+	// carry on from there.
+	size_t moveCount = 0;
+	for (size_t i = 1; i < entries.size(); ++i)
+	{
+		const SortEntry entry = entries[i];
+		size_t j = i;
+		for (; j > 0 && entries[j - 1].Key > entry.Key; --j)
+			entries[j] = entries[j - 1];
+		entries[j] = entry;
+
+		moveCount += i - j;
+		if (moveCount > maxMoveCount)
+			return false;
+	}
+
+	return true;
+}
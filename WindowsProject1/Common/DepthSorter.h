@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Orders blended items, whole render items or single billboards, back to front
+// by view depth.  Depths are quantized to 16 bits over the range they span in
+// the call, and sorted with a two-pass LSD radix sort.
+//
+// The order of the previous call is the starting point of the next: keys are
+// gathered in that order, and when it is still sorted, or so nearly that an
+// insertion sort gets it right within a few moves per item, no radix pass runs
+// at all.  A camera that moves smoothly leaves last frame's order almost sorted,
+// so most frames cost a pass over the depths and one over the keys.
+//
+// Nothing here knows about D3D; the apps copy the order into an index buffer or
+// reorder a render layer with it.
+class DepthSorter
+{
+public:
+	enum class SortPath
+	{
+		AlreadySorted,
+		Insertion,
+		Radix
+	};
+
+	// Sorts items 0 to count - 1, farthest first.  Items whose keys are equal keep
+	// their previous order, so they do not swap places from frame to frame.  A
+	// change of count starts over from the identity order.
+	void SortBackToFront(const float* viewDepths, uint32_t count);
+
+	// Indices into the depths of the last call, farthest first.
+	const std::vector<uint32_t>& GetOrder() const noexcept { return order; }
+
+	SortPath GetLastPath() const noexcept { return lastPath; }
+
+	// Forgets the previous order.
+	void Reset();
+
+private:
+	struct SortEntry
+	{
+		uint32_t Key = 0;
+		uint32_t Item = 0;
+	};
+
+	bool InsertionSort(size_t maxMoveCount);
+
+	std::vector<uint32_t> order;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	SortPath lastPath = SortPath::AlreadySorted;
+};
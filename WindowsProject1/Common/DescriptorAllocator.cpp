@@ -0,0 +1,215 @@
+#include "DescriptorAllocator.h"
+
+#include <cassert>
+
+DescriptorAllocator::DescriptorAllocator(ID3D12Device* device, UINT persistentCount, UINT transientCount)
+	: device(device),
+	descriptorSize(device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)),
+	persistentCount(persistentCount),
+	transientCount(transientCount),
+	transientRing(transientCount)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = persistentCount + transientCount;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())));
+
+	heapDesc.NumDescriptors = persistentCount;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(stagingHeap.GetAddressOf())));
+
+	FreeRange all;
+	all.Offset = 0;
+	all.Count = persistentCount;
+	freeRanges.push_back(all);
+}
+
+void DescriptorAllocator::BeginFrame(UINT64 completedFenceValue)
+{
+	transientRing.Reclaim(completedFenceValue);
+	ReleaseCompleted(completedFenceValue);
+}
+
+void DescriptorAllocator::EndFrame(UINT64 fenceValue)
+{
+	transientRing.FinishFrame(fenceValue);
+}
+
+DescriptorAllocator::Range DescriptorAllocator::AllocatePersistent(UINT count)
+{
+	assert(count > 0);
+
+	auto it = std::find_if(freeRanges.begin(), freeRanges.end(),
+		[count](const FreeRange& range) { return range.Count >= count; });
+
+	if (it == freeRanges.end())
+	{
+		throw DxException(E_OUTOFMEMORY, L"DescriptorAllocator::AllocatePersistent",
+			AnsiToWString(__FILE__), __LINE__);
+	}
+
+	const UINT offset = it->Offset;
+	it->Offset += count;
+	it->Count -= count;
+	if (it->Count == 0)
+		freeRanges.erase(it);
+
+	persistentUsedCount += count;
+
+	const Range range = MakeRange(offset, count, true);
+	MarkDirty(range);
+	return range;
+}
+
+void DescriptorAllocator::FreePersistent(Range& range, UINT64 fenceValue)
+{
+	if (!range.IsValid())
+		return;
+
+	assert(pendingFrees.empty() || pendingFrees.back().FenceValue <= fenceValue);
+
+	PendingFree pending;
+	pending.FenceValue = fenceValue;
+	pending.Range.Offset = range.Offset;
+	pending.Range.Count = range.Count;
+	pendingFrees.push_back(pending);
+
+	range = Range();
+}
+
+void DescriptorAllocator::MarkDirty(const Range& range)
+{
+	assert(range.Offset + range.Count <= persistentCount);
+
+	FreeRange dirty;
+	dirty.Offset = range.Offset;
+	dirty.Count = range.Count;
+	dirtyRanges.push_back(dirty);
+}
+
+void DescriptorAllocator::CommitPersistent()
+{
+	if (dirtyRanges.empty())
+		return;
+
+	// Overlapping and touching ranges become one, so each descriptor is copied
+	// once and the copy has as few ranges as possible.
+	std::sort(dirtyRanges.begin(), dirtyRanges.end(),
+		[](const FreeRange& a, const FreeRange& b) { return a.Offset < b.Offset; });
+
+	copyDestStarts.clear();
+	copySourceStarts.clear();
+	copySizes.clear();
+
+	UINT begin = dirtyRanges.front().Offset;
+	UINT end = begin;
+	for (size_t i = 0; i <= dirtyRanges.size(); ++i)
+	{
+		if (i < dirtyRanges.size() && dirtyRanges[i].Offset <= end)
+		{
+			end = std::max(end, dirtyRanges[i].Offset + dirtyRanges[i].Count);
+			continue;
+		}
+
+		copyDestStarts.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(
+			heap->GetCPUDescriptorHandleForHeapStart(), begin, descriptorSize));
+		copySourceStarts.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(
+			stagingHeap->GetCPUDescriptorHandleForHeapStart(), begin, descriptorSize));
+		copySizes.push_back(end - begin);
+
+		if (i < dirtyRanges.size())
+		{
+			begin = dirtyRanges[i].Offset;
+			end = begin + dirtyRanges[i].Count;
+		}
+	}
+
+	device->CopyDescriptors(
+		static_cast<UINT>(copyDestStarts.size()), copyDestStarts.data(), copySizes.data(),
+		static_cast<UINT>(copySourceStarts.size()), copySourceStarts.data(), copySizes.data(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	dirtyRanges.clear();
+}
+
+DescriptorAllocator::Range DescriptorAllocator::AllocateTransient(UINT count)
+{
+	assert(count > 0);
+
+	const uint64_t offset = transientRing.Allocate(count, 1);
+	if (offset == RingAllocator::InvalidOffset)
+	{
+		throw DxException(E_OUTOFMEMORY, L"DescriptorAllocator::AllocateTransient",
+			AnsiToWString(__FILE__), __LINE__);
+	}
+
+	return MakeRange(persistentCount + static_cast<UINT>(offset), count, false);
+}
+
+DescriptorAllocator::Range DescriptorAllocator::CopyToTransient(const D3D12_CPU_DESCRIPTOR_HANDLE* sources, UINT count)
+{
+	const Range range = AllocateTransient(count);
+
+	// Without source range sizes every source is one descriptor.
+	const D3D12_CPU_DESCRIPTOR_HANDLE destStart = range.CpuHandle;
+	device->CopyDescriptors(1, &destStart, &count, count, sources, nullptr,
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	return range;
+}
+
+DescriptorAllocator::Range DescriptorAllocator::MakeRange(UINT offset, UINT count, bool bStaging) const
+{
+	Range range;
+	range.Offset = offset;
+	range.Count = count;
+	range.CpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
+		bStaging ? stagingHeap->GetCPUDescriptorHandleForHeapStart() : heap->GetCPUDescriptorHandleForHeapStart(),
+		offset, descriptorSize);
+	range.GpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(heap->GetGPUDescriptorHandleForHeapStart(), offset, descriptorSize);
+	range.DescriptorSize = descriptorSize;
+	return range;
+}
+
+void DescriptorAllocator::ReleaseCompleted(UINT64 completedFenceValue)
+{
+	while (!pendingFrees.empty() && pendingFrees.front().FenceValue <= completedFenceValue)
+	{
+		ReturnRange(pendingFrees.front().Range);
+		pendingFrees.pop_front();
+	}
+}
+
+void DescriptorAllocator::ReturnRange(FreeRange range)
+{
+	persistentUsedCount -= range.Count;
+
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), range,
+		[](const FreeRange& a, const FreeRange& b) { return a.Offset < b.Offset; });
+
+	// Merge with the free range in front and the one behind.
+	if (next != freeRanges.begin())
+	{
+		auto prev = next - 1;
+		if (prev->Offset + prev->Count == range.Offset)
+		{
+			prev->Count += range.Count;
+			if (next != freeRanges.end() && prev->Offset + prev->Count == next->Offset)
+			{
+				prev->Count += next->Count;
+				freeRanges.erase(next);
+			}
+			return;
+		}
+	}
+
+	if (next != freeRanges.end() && range.Offset + range.Count == next->Offset)
+	{
+		next->Offset = range.Offset;
+		next->Count += range.Count;
+		return;
+	}
+
+	freeRanges.insert(next, range);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "DxUtil.h"
+#include "RingAllocator.h"
+
+#include <deque>
+#include <vector>
+
+// The shader-visible CBV/SRV/UAV heap, shared by everything that binds
+// descriptor tables.  It is split in two:
+//
+// - persistent ranges, for views that live as long as their resources.  They
+//   come from a free list, first fit, and are merged with their neighbours when
+//   freed.  Views are created in a staging heap that shaders cannot see, at the
+//   same index, and CommitPersistent copies every range written since the last
+//   commit to the shader-visible heap in one CopyDescriptors call;
+// - a ring of transient descriptors, for tables put together while recording a
+//   frame.  They are handed out linearly and come back once the fence the frame
+//   was finished with has passed.
+//
+// A freed persistent range is held back until the fence given to FreePersistent
+// has passed, as frames in flight may still read it.  Like UploadRing, call
+// BeginFrame with the completed fence value before recording and EndFrame with
+// the fence value the frame is signaled with.
+class DescriptorAllocator
+{
+public:
+	// Count descriptors in a row.  For a persistent range CpuHandle is in the
+	// staging heap, where views are written; for a transient range it is in the
+	// shader-visible heap.  GpuHandle is what descriptor tables are set to.
+	struct Range
+	{
+		UINT Offset = 0;
+		UINT Count = 0;
+		D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle = {};
+		D3D12_GPU_DESCRIPTOR_HANDLE GpuHandle = {};
+		UINT DescriptorSize = 0;
+
+		bool IsValid() const noexcept { return Count > 0; }
+
+		CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(UINT index) const
+		{
+			return CD3DX12_CPU_DESCRIPTOR_HANDLE(CpuHandle, index, DescriptorSize);
+		}
+
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(UINT index) const
+		{
+			return CD3DX12_GPU_DESCRIPTOR_HANDLE(GpuHandle, index, DescriptorSize);
+		}
+	};
+
+	DescriptorAllocator(ID3D12Device* device, UINT persistentCount, UINT transientCount);
+	DescriptorAllocator(const DescriptorAllocator& rhs) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator& rhs) = delete;
+
+	ID3D12DescriptorHeap* GetHeap() const noexcept { return heap.Get(); }
+
+	void BeginFrame(UINT64 completedFenceValue);
+	void EndFrame(UINT64 fenceValue);
+
+	// Throws when the persistent part has no free range of count descriptors.
+	// The range is committed with the next CommitPersistent.
+	Range AllocatePersistent(UINT count);
+
+	// The range goes back to the free list once the GPU has passed fenceValue.
+	void FreePersistent(Range& range, UINT64 fenceValue);
+
+	// Views of the range were written again, e.g. after its resources were
+	// recreated.
+	void MarkDirty(const Range& range);
+
+	// Copies the ranges allocated or marked dirty since the last call to the
+	// shader-visible heap.  The GPU must not be reading them.
+	void CommitPersistent();
+
+	// Throws when the ring is full; that takes more than its size in one frame or
+	// a GPU that is far behind.
+	Range AllocateTransient(UINT count);
+
+	// A transient table of the given descriptors, in order, copied from
+	// non-shader-visible heaps such as the staging heap.
+	Range CopyToTransient(const D3D12_CPU_DESCRIPTOR_HANDLE* sources, UINT count);
+
+	UINT GetPersistentCapacity() const noexcept { return persistentCount; }
+	UINT GetPersistentUsedCount() const noexcept { return persistentUsedCount; }
+	UINT GetTransientCapacity() const noexcept { return transientCount; }
+	UINT GetTransientUsedCount() const noexcept { return static_cast<UINT>(transientRing.GetUsedByteSize()); }
+
+private:
+	struct FreeRange
+	{
+		UINT Offset = 0;
+		UINT Count = 0;
+	};
+
+	struct PendingFree
+	{
+		UINT64 FenceValue = 0;
+		FreeRange Range;
+	};
+
+	Range MakeRange(UINT offset, UINT count, bool bStaging) const;
+	void ReleaseCompleted(UINT64 completedFenceValue);
+	void ReturnRange(FreeRange range);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> stagingHeap;
+	UINT descriptorSize = 0;
+
+	UINT persistentCount = 0;
+	UINT persistentUsedCount = 0;
+
+	// Sorted by offset, never adjacent.
+	std::vector<FreeRange> freeRanges;
+	std::deque<PendingFree> pendingFrees;
+	std::vector<FreeRange> dirtyRanges;
+
+	// Counts descriptors past the persistent part.
+	UINT transientCount = 0;
+	RingAllocator transientRing;
+
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> copyDestStarts;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> copySourceStarts;
+	std::vector<UINT> copySizes;
+};
@@ -0,0 +1,116 @@
+#include "DrawQueue.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Below this many packets an insertion sort beats eight counting passes.
+	constexpr size_t InsertionSortThreshold = 64;
+
+	uint64_t Field(uint32_t value, uint32_t bits) noexcept
+	{
+		return static_cast<uint64_t>(value) & ((1ull << bits) - 1);
+	}
+}
+
+void DrawCommandStream::Clear()
+{
+	Commands.clear();
+	std::fill(std::begin(Counts), std::end(Counts), size_t(0));
+	NaiveSetCount = 0;
+}
+
+uint64_t DrawQueue::MakeSortKey(uint32_t layer, Handle pipeline, Handle geometry, uint32_t material, uint32_t depth) noexcept
+{
+	uint64_t key = Field(layer, LayerBits);
+	key = (key << PipelineBits) | Field(pipeline, PipelineBits);
+	key = (key << GeometryBits) | Field(geometry, GeometryBits);
+	key = (key << MaterialBits) | Field(material, MaterialBits);
+	key = (key << DepthBits) | Field(depth, DepthBits);
+	return key;
+}
+
+uint32_t DrawQueue::QuantizeDepth(float viewDepth, float nearZ, float farZ, bool bBackToFront) noexcept
+{
+	float t = farZ > nearZ ? (viewDepth - nearZ) / (farZ - nearZ) : 0.0f;
+	t = std::min(std::max(t, 0.0f), 1.0f);
+
+	const uint32_t maxDepth = (1u << DepthBits) - 1;
+
+	// In double, as a float cannot hold every 24-bit value plus a half.
+	const uint32_t depth = static_cast<uint32_t>(static_cast<double>(t) * maxDepth + 0.5);
+	return bBackToFront ? maxDepth - depth : depth;
+}
+
+void DrawQueue::Clear()
+{
+	packets.clear();
+	entries.clear();
+}
+
+void DrawQueue::Add(const Packet& packet)
+{
+	SortEntry entry;
+	entry.Key = packet.SortKey;
+	entry.Packet = static_cast<uint32_t>(packets.size());
+	entries.push_back(entry);
+
+	packets.push_back(packet);
+}
+
+void DrawQueue::Sort()
+{
+	const size_t count = entries.size();
+
+	if (count < InsertionSortThreshold)
+	{
+		for (size_t i = 1; i < count; ++i)
+		{
+			const SortEntry entry = entries[i];
+			size_t j = i;
+			for (; j > 0 && entries[j - 1].Key > entry.Key; --j)
+				entries[j] = entries[j - 1];
+			entries[j] = entry;
+		}
+		return;
+	}
+
+	RadixSortByKey<64>(entries, scratch);
+}
+
+void DrawQueue::Record(DrawCommandStream& stream) const
+{
+	bool bFirst = true;
+	Packet current;
+
+	auto append = [&stream](DrawCommandType type, uint32_t packet)
+	{
+		DrawCommand command;
+		command.Type = type;
+		command.Packet = packet;
+		stream.Commands.push_back(command);
+		++stream.Counts[static_cast<size_t>(type)];
+	};
+
+	for (const SortEntry& entry : entries)
+	{
+		const Packet& packet = packets[entry.Packet];
+
+		if (bFirst || packet.Pipeline != current.Pipeline)
+			append(DrawCommandType::SetPipeline, entry.Packet);
+		if (bFirst || packet.Geometry != current.Geometry)
+			append(DrawCommandType::SetGeometry, entry.Packet);
+		if (bFirst || packet.Topology != current.Topology)
+			append(DrawCommandType::SetTopology, entry.Packet);
+		if (bFirst || packet.ObjectConstants != current.ObjectConstants)
+			append(DrawCommandType::SetObjectConstants, entry.Packet);
+
+		append(DrawCommandType::DrawIndexed, entry.Packet);
+
+		current = packet;
+		bFirst = false;
+	}
+
+	stream.NaiveSetCount += 4 * entries.size();
+}
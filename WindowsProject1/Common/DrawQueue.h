@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What changes between two draws: every command but DrawIndexed sets one piece
+// of state, and is only recorded when the packet drawn next needs a different
+// value than the one already set.
+enum class DrawCommandType : uint8_t
+{
+	SetPipeline,
+	SetGeometry,
+	SetTopology,
+	SetObjectConstants,
+	DrawIndexed,
+	Count
+};
+
+struct DrawCommand
+{
+	DrawCommandType Type = DrawCommandType::DrawIndexed;
+
+	// The packet whose value the command sets or draws.
+	uint32_t Packet = 0;
+};
+
+// The commands DrawQueue::Record writes, with how many there are of each type.
+// A DrawSubmitter replays them on a command list; a test can just count them.
+struct DrawCommandStream
+{
+	std::vector<DrawCommand> Commands;
+	size_t Counts[static_cast<size_t>(DrawCommandType::Count)] = {};
+
+	// Set calls a queue in insertion order without redundancy checks would have
+	// made, which is four per packet.
+	size_t NaiveSetCount = 0;
+
+	size_t GetCount(DrawCommandType type) const noexcept { return Counts[static_cast<size_t>(type)]; }
+	size_t GetSetCount() const noexcept { return Commands.size() - GetCount(DrawCommandType::DrawIndexed); }
+
+	void Clear();
+};
+
+// The draws of one pass for one frame.  Each is a packet with a 64-bit sort key
+// made of, from the most significant bits down, the layer, the pipeline, the
+// geometry, the material and the quantized depth.  Sort orders the packets by
+// key with an LSD radix sort, so draws that share a pipeline and geometry end up
+// next to each other and go front to back within them, and Record writes them
+// out skipping every set call that would not change anything.  Geometry ranks
+// above material because changing it costs vertex and index buffer binds, while
+// materials are looked up by index in the shaders and cost no set call.
+//
+// Pipelines and geometry are small handles handed out by whoever executes the
+// stream, so the queue knows nothing about D3D and can be driven without a GPU.
+class DrawQueue
+{
+public:
+	using Handle = uint32_t;
+
+	static constexpr uint32_t LayerBits = 4;
+	static constexpr uint32_t PipelineBits = 10;
+	static constexpr uint32_t GeometryBits = 14;
+	static constexpr uint32_t MaterialBits = 12;
+	static constexpr uint32_t DepthBits = 24;
+
+	struct Packet
+	{
+		uint64_t SortKey = 0;
+
+		Handle Pipeline = 0;
+		Handle Geometry = 0;
+		uint32_t Topology = 0;
+
+		// Address of the per-object constants, bound as a root CBV.
+		uint64_t ObjectConstants = 0;
+
+		uint32_t IndexCount = 0;
+		uint32_t StartIndexLocation = 0;
+		int32_t BaseVertexLocation = 0;
+	};
+
+	// Each field is truncated to its number of bits.  Layers draw in increasing
+	// order whatever else is in the key, so they stand for the order a pass
+	// must draw in, such as opaque geometry before the sky.
+	static uint64_t MakeSortKey(uint32_t layer, Handle pipeline, Handle geometry, uint32_t material, uint32_t depth) noexcept;
+
+	// View depth mapped to DepthBits, increasing with distance, or decreasing for
+	// back to front.  Depths outside [nearZ, farZ] are clamped.
+	static uint32_t QuantizeDepth(float viewDepth, float nearZ, float farZ, bool bBackToFront = false) noexcept;
+
+	void Clear();
+	void Add(const Packet& packet);
+
+	// Stable, so packets with equal keys draw in the order they were added.
+	void Sort();
+
+	// Appends the commands that draw the packets in sorted order.  Nothing is
+	// taken to be set when the stream starts.
+	void Record(DrawCommandStream& stream) const;
+
+	const Packet& GetPacket(uint32_t index) const noexcept { return packets[index]; }
+	size_t GetPacketCount() const noexcept { return packets.size(); }
+
+private:
+	struct SortEntry
+	{
+		uint64_t Key = 0;
+		uint32_t Packet = 0;
+	};
+
+	std::vector<Packet> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+};
@@ -0,0 +1,75 @@
+#include "DrawSubmitter.h"
+
+#include <cassert>
+
+namespace
+{
+	template<typename T>
+	DrawQueue::Handle FindOrAdd(std::vector<T>& items, T item)
+	{
+		auto it = std::find(items.begin(), items.end(), item);
+		if (it != items.end())
+			return static_cast<DrawQueue::Handle>(it - items.begin());
+
+		items.push_back(item);
+		return static_cast<DrawQueue::Handle>(items.size() - 1);
+	}
+}
+
+DrawQueue::Handle DrawSubmitter::AddPipeline(ID3D12PipelineState* pipelineState)
+{
+	const DrawQueue::Handle handle = FindOrAdd(pipelines, pipelineState);
+	assert(handle < (1u << DrawQueue::PipelineBits));
+	return handle;
+}
+
+DrawQueue::Handle DrawSubmitter::AddGeometry(const MeshGeometry* geometry)
+{
+	const DrawQueue::Handle handle = FindOrAdd(geometries, geometry);
+	assert(handle < (1u << DrawQueue::GeometryBits));
+	return handle;
+}
+
+void DrawSubmitter::Execute(ID3D12GraphicsCommandList* cmdList, const DrawQueue& queue, const DrawCommandStream& stream,
+	UINT objectConstantsRootParameter) const
+{
+	for (const DrawCommand& command : stream.Commands)
+	{
+		const DrawQueue::Packet& packet = queue.GetPacket(command.Packet);
+
+		switch (command.Type)
+		{
+		case DrawCommandType::SetPipeline:
+			cmdList->SetPipelineState(pipelines[packet.Pipeline]);
+			break;
+
+		case DrawCommandType::SetGeometry:
+		{
+			// Views are made here rather than kept, as a geometry may get new
+			// buffers.
+			const MeshGeometry* geometry = geometries[packet.Geometry];
+			const D3D12_VERTEX_BUFFER_VIEW vertexBufferView = geometry->VertexBufferView();
+			const D3D12_INDEX_BUFFER_VIEW indexBufferView = geometry->IndexBufferView();
+			cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+			cmdList->IASetIndexBuffer(&indexBufferView);
+			break;
+		}
+
+		case DrawCommandType::SetTopology:
+			cmdList->IASetPrimitiveTopology(static_cast<D3D12_PRIMITIVE_TOPOLOGY>(packet.Topology));
+			break;
+
+		case DrawCommandType::SetObjectConstants:
+			cmdList->SetGraphicsRootConstantBufferView(objectConstantsRootParameter, packet.ObjectConstants);
+			break;
+
+		case DrawCommandType::DrawIndexed:
+			cmdList->DrawIndexedInstanced(packet.IndexCount, 1, packet.StartIndexLocation, packet.BaseVertexLocation, 0);
+			break;
+
+		default:
+			assert(false);
+			break;
+		}
+	}
+}
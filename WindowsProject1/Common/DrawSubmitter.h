@@ -0,0 +1,29 @@
+#pragma once
+
+#include "DxUtil.h"
+#include "DrawQueue.h"
+
+#include <vector>
+
+// Hands out the pipeline and geometry handles DrawQueue packets refer to, and
+// replays a DrawCommandStream on a command list.  The root signature, pass
+// constants and descriptor tables are the caller's; the stream only sets the
+// pipeline state, vertex and index buffers, topology and the per-object root
+// CBV.
+class DrawSubmitter
+{
+public:
+	// Pipelines and geometry are not owned.  Adding one that is already there
+	// returns its handle.
+	DrawQueue::Handle AddPipeline(ID3D12PipelineState* pipelineState);
+	DrawQueue::Handle AddGeometry(const MeshGeometry* geometry);
+
+	ID3D12PipelineState* GetPipeline(DrawQueue::Handle pipeline) const noexcept { return pipelines[pipeline]; }
+
+	void Execute(ID3D12GraphicsCommandList* cmdList, const DrawQueue& queue, const DrawCommandStream& stream,
+		UINT objectConstantsRootParameter) const;
+
+private:
+	std::vector<ID3D12PipelineState*> pipelines;
+	std::vector<const MeshGeometry*> geometries;
+};
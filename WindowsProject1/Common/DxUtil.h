@@ -155,9 +155,16 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
 
+	// Optional second vertex stream, bound to input slot 1.  It keeps attributes that
+	// never change out of a vertex buffer that is rewritten every frame.
+	Microsoft::WRL::ComPtr<ID3D12Resource> StaticVertexBufferGPU = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> StaticVertexBufferUploader = nullptr;
+
     // Data about the buffers.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
+	UINT StaticVertexByteStride = 0;
+	UINT StaticVertexBufferByteSize = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 	UINT IndexBufferByteSize = 0;
 
@@ -176,6 +183,16 @@ struct MeshGeometry
 		return vbv;
 	}
 
+	D3D12_VERTEX_BUFFER_VIEW StaticVertexBufferView()const
+	{
+		D3D12_VERTEX_BUFFER_VIEW vbv;
+		vbv.BufferLocation = StaticVertexBufferGPU->GetGPUVirtualAddress();
+		vbv.StrideInBytes = StaticVertexByteStride;
+		vbv.SizeInBytes = StaticVertexBufferByteSize;
+
+		return vbv;
+	}
+
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv;
@@ -191,6 +208,7 @@ struct MeshGeometry
 	{
 		VertexBufferUploader = nullptr;
 		IndexBufferUploader = nullptr;
+		StaticVertexBufferUploader = nullptr;
 	}
 };
 
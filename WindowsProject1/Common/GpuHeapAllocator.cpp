@@ -0,0 +1,245 @@
+#include "GpuHeapAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// Textures of 64KB or less can be placed at 4KB boundaries.
+	const UINT64 BlockGranularity = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	D3D12_HEAP_FLAGS GetHeapFlags(GpuResourceCategory category)
+	{
+		switch (category)
+		{
+		case GpuResourceCategory::Buffer:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+		case GpuResourceCategory::RenderTarget:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		default:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+		}
+	}
+
+	// Render targets may be multisampled, and those need 4MB aligned heaps.
+	UINT64 GetHeapAlignment(GpuResourceCategory category)
+	{
+		return category == GpuResourceCategory::RenderTarget
+			? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+			: D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	}
+}
+
+GpuHeapAllocator::GpuHeapAllocator(ID3D12Device* device, UINT64 heapByteSize)
+	: device(device),
+	heapByteSize(heapByteSize)
+{
+	const D3D12_HEAP_TYPE heapTypes[HeapTypeCount] =
+	{
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_HEAP_TYPE_UPLOAD,
+		D3D12_HEAP_TYPE_READBACK
+	};
+
+	for (UINT i = 0; i < HeapTypeCount; ++i)
+	{
+		for (UINT category = 0; category < static_cast<UINT>(GpuResourceCategory::Count); ++category)
+		{
+			Pool& pool = pools[GetPoolIndex(heapTypes[i], static_cast<GpuResourceCategory>(category))];
+			pool.HeapType = heapTypes[i];
+			pool.Category = static_cast<GpuResourceCategory>(category);
+		}
+	}
+}
+
+GpuResourceCategory GpuHeapAllocator::GetCategory(const D3D12_RESOURCE_DESC& desc) noexcept
+{
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		return GpuResourceCategory::Buffer;
+
+	if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		return GpuResourceCategory::RenderTarget;
+
+	return GpuResourceCategory::Texture;
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO GpuHeapAllocator::GetAllocationInfo(const D3D12_RESOURCE_DESC* descs, UINT count) const
+{
+	return device->GetResourceAllocationInfo(0, count, descs);
+}
+
+GpuHeapAllocator::Allocation GpuHeapAllocator::Allocate(D3D12_HEAP_TYPE heapType, GpuResourceCategory category,
+	const D3D12_RESOURCE_ALLOCATION_INFO& info)
+{
+	assert(info.Alignment <= GetHeapAlignment(category));
+
+	const UINT poolIndex = GetPoolIndex(heapType, category);
+	Pool& pool = pools[poolIndex];
+
+	UINT blockIndex = 0;
+	TlsfAllocator::Handle handle = TlsfAllocator::InvalidHandle;
+	for (; blockIndex < pool.Blocks.size(); ++blockIndex)
+	{
+		if (pool.Blocks[blockIndex].Heap == nullptr)
+			continue;
+
+		handle = pool.Blocks[blockIndex].Allocator.Allocate(info.SizeInBytes, info.Alignment);
+		if (handle != TlsfAllocator::InvalidHandle)
+			break;
+	}
+
+	if (handle == TlsfAllocator::InvalidHandle)
+	{
+		blockIndex = CreateBlock(pool, info.SizeInBytes);
+		handle = pool.Blocks[blockIndex].Allocator.Allocate(info.SizeInBytes, info.Alignment);
+		assert(handle != TlsfAllocator::InvalidHandle);
+	}
+
+	Block& block = pool.Blocks[blockIndex];
+
+	Allocation allocation;
+	allocation.Heap = block.Heap.Get();
+	allocation.Offset = block.Allocator.GetOffset(handle);
+	allocation.ByteSize = block.Allocator.GetByteSize(handle);
+	allocation.PoolIndex = poolIndex;
+	allocation.BlockIndex = blockIndex;
+	allocation.Handle = handle;
+
+	pool.UsedByteSize += allocation.ByteSize;
+	pool.PeakUsedByteSize = std::max(pool.PeakUsedByteSize, pool.UsedByteSize);
+
+	return allocation;
+}
+
+void GpuHeapAllocator::Free(Allocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	Pool& pool = pools[allocation.PoolIndex];
+	Block& block = pool.Blocks[allocation.BlockIndex];
+
+	block.Allocator.Free(allocation.Handle);
+	pool.UsedByteSize -= allocation.ByteSize;
+
+	// The first block is kept around so that a pool which is emptied and filled
+	// again does not create a heap each time, unless it was made for one large
+	// resource.
+	if (block.Allocator.IsEmpty() &&
+		(allocation.BlockIndex != 0 || block.Allocator.GetCapacity() > heapByteSize))
+	{
+		block.Heap = nullptr;
+		block.Allocator.Reset(0);
+	}
+
+	allocation = Allocation();
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuHeapAllocator::CreatePlacedResource(
+	const Allocation& allocation,
+	const D3D12_RESOURCE_DESC& desc,
+	D3D12_RESOURCE_STATES initialState,
+	const D3D12_CLEAR_VALUE* optimizedClearValue)
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+
+	ThrowIfFailed(device->CreatePlacedResource(
+		allocation.Heap,
+		allocation.Offset,
+		&desc,
+		initialState,
+		optimizedClearValue,
+		IID_PPV_ARGS(resource.GetAddressOf())));
+
+	return resource;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuHeapAllocator::CreateResource(
+	const D3D12_RESOURCE_DESC& desc,
+	D3D12_HEAP_TYPE heapType,
+	D3D12_RESOURCE_STATES initialState,
+	const D3D12_CLEAR_VALUE* optimizedClearValue,
+	Allocation& allocation)
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO info = GetAllocationInfo(&desc, 1);
+	allocation = Allocate(heapType, GetCategory(desc), info);
+
+	return CreatePlacedResource(allocation, desc, initialState, optimizedClearValue);
+}
+
+GpuHeapAllocator::CategoryStats GpuHeapAllocator::GetStats(GpuResourceCategory category) const
+{
+	CategoryStats stats;
+
+	UINT64 freeByteSize = 0;
+	UINT64 largestFreeByteSizeSum = 0;
+	for (const auto& pool : pools)
+	{
+		if (pool.Category != category)
+			continue;
+
+		stats.UsedByteSize += pool.UsedByteSize;
+		stats.PeakUsedByteSize += pool.PeakUsedByteSize;
+
+		for (const auto& block : pool.Blocks)
+		{
+			if (block.Heap == nullptr)
+				continue;
+
+			const TlsfAllocator::Stats blockStats = block.Allocator.GetStats();
+			++stats.HeapCount;
+			stats.AllocationCount += blockStats.AllocationCount;
+			stats.HeapByteSize += blockStats.Capacity;
+			stats.FreeBlockCount += blockStats.FreeBlockCount;
+			stats.LargestFreeBlockByteSize = std::max(stats.LargestFreeBlockByteSize, blockStats.LargestFreeBlockByteSize);
+
+			freeByteSize += blockStats.Capacity - blockStats.UsedByteSize;
+			largestFreeByteSizeSum += blockStats.LargestFreeBlockByteSize;
+		}
+	}
+
+	// Free memory cannot be in one piece across heaps, so count the largest free
+	// block of every heap as whole.
+	if (freeByteSize > 0)
+		stats.Fragmentation = 1.0f - static_cast<float>(largestFreeByteSizeSum) / static_cast<float>(freeByteSize);
+
+	return stats;
+}
+
+UINT GpuHeapAllocator::GetPoolIndex(D3D12_HEAP_TYPE heapType, GpuResourceCategory category) noexcept
+{
+	assert(heapType >= D3D12_HEAP_TYPE_DEFAULT && heapType <= D3D12_HEAP_TYPE_READBACK);
+
+	return (heapType - D3D12_HEAP_TYPE_DEFAULT) * static_cast<UINT>(GpuResourceCategory::Count) +
+		static_cast<UINT>(category);
+}
+
+UINT GpuHeapAllocator::CreateBlock(Pool& pool, UINT64 minimumByteSize)
+{
+	const UINT64 alignment = GetHeapAlignment(pool.Category);
+	const UINT64 byteSize = AlignUp(std::max(heapByteSize, minimumByteSize), alignment);
+
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.SizeInBytes = byteSize;
+	heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(pool.HeapType);
+	heapDesc.Alignment = alignment;
+	heapDesc.Flags = GetHeapFlags(pool.Category);
+
+	auto unused = std::find_if(pool.Blocks.begin(), pool.Blocks.end(),
+		[](const Block& block) { return block.Heap == nullptr; });
+	if (unused == pool.Blocks.end())
+	{
+		pool.Blocks.emplace_back();
+		unused = pool.Blocks.end() - 1;
+	}
+
+	ThrowIfFailed(device->CreateHeap(&heapDesc, IID_PPV_ARGS(unused->Heap.GetAddressOf())));
+	unused->Allocator = TlsfAllocator(byteSize, BlockGranularity);
+
+	return static_cast<UINT>(unused - pool.Blocks.begin());
+}
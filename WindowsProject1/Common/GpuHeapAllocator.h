@@ -0,0 +1,131 @@
+#pragma once
+
+#include "DxUtil.h"
+#include "TlsfAllocator.h"
+
+#include <vector>
+
+// Which heaps a resource can be placed in.  Resource heap tier 1 hardware keeps
+// buffers, render target and depth textures, and other textures apart, so each
+// gets its own pool.
+enum class GpuResourceCategory
+{
+	Buffer,
+	RenderTarget,
+	Texture,
+	Count
+};
+
+// Places resources in large ID3D12Heap blocks instead of giving each its own
+// committed heap.  Every heap type and resource category has a pool of blocks,
+// each managed by a TlsfAllocator; a block is added when a pool runs out, and a
+// resource larger than a block gets a block of its own.  Blocks other than a
+// pool's first are released as soon as they are empty.
+//
+// Transient targets that are never used at the same time can alias: allocate
+// memory once for the largest of them, from GetAllocationInfo over all their
+// descriptions, and create each of them on it with CreatePlacedResource.  The
+// caller then issues the aliasing barriers.
+//
+// Memory is given back with Free, after the GPU is done with the resources on
+// it and they are released.
+class GpuHeapAllocator
+{
+public:
+	struct Allocation
+	{
+		ID3D12Heap* Heap = nullptr;
+		UINT64 Offset = 0;
+		UINT64 ByteSize = 0;
+
+		bool IsValid() const noexcept { return Heap != nullptr; }
+
+	private:
+		friend class GpuHeapAllocator;
+
+		UINT PoolIndex = 0;
+		UINT BlockIndex = 0;
+		TlsfAllocator::Handle Handle = TlsfAllocator::InvalidHandle;
+	};
+
+	struct CategoryStats
+	{
+		UINT HeapCount = 0;
+		UINT AllocationCount = 0;
+
+		// Size of the heaps created for the category.
+		UINT64 HeapByteSize = 0;
+		UINT64 UsedByteSize = 0;
+		UINT64 PeakUsedByteSize = 0;
+
+		UINT FreeBlockCount = 0;
+		UINT64 LargestFreeBlockByteSize = 0;
+
+		// 0 when the free memory of each heap is in one piece, approaching 1 as it
+		// is scattered over many small ones.
+		float Fragmentation = 0.0f;
+	};
+
+	explicit GpuHeapAllocator(ID3D12Device* device, UINT64 heapByteSize = 64 * 1024 * 1024);
+	GpuHeapAllocator(const GpuHeapAllocator& rhs) = delete;
+	GpuHeapAllocator& operator=(const GpuHeapAllocator& rhs) = delete;
+
+	static GpuResourceCategory GetCategory(const D3D12_RESOURCE_DESC& desc) noexcept;
+
+	// Size and alignment that fit every one of the descriptions, for aliasing.
+	D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(const D3D12_RESOURCE_DESC* descs, UINT count) const;
+
+	Allocation Allocate(D3D12_HEAP_TYPE heapType, GpuResourceCategory category,
+		const D3D12_RESOURCE_ALLOCATION_INFO& info);
+	void Free(Allocation& allocation);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreatePlacedResource(
+		const Allocation& allocation,
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* optimizedClearValue);
+
+	// Allocates memory for one resource and creates the resource on it.  The
+	// memory is written to allocation, which must be given back with Free once the
+	// resource is released.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateResource(
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_HEAP_TYPE heapType,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* optimizedClearValue,
+		Allocation& allocation);
+
+	// Summed over the heap types.
+	CategoryStats GetStats(GpuResourceCategory category) const;
+
+private:
+	// Default, upload and readback heaps.
+	static constexpr UINT HeapTypeCount = 3;
+
+	struct Block
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		TlsfAllocator Allocator;
+	};
+
+	struct Pool
+	{
+		D3D12_HEAP_TYPE HeapType = D3D12_HEAP_TYPE_DEFAULT;
+		GpuResourceCategory Category = GpuResourceCategory::Buffer;
+
+		// Released blocks stay in the vector with no heap, so indices are stable.
+		std::vector<Block> Blocks;
+
+		UINT64 UsedByteSize = 0;
+		UINT64 PeakUsedByteSize = 0;
+	};
+
+	static UINT GetPoolIndex(D3D12_HEAP_TYPE heapType, GpuResourceCategory category) noexcept;
+
+	UINT CreateBlock(Pool& pool, UINT64 minimumByteSize);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	UINT64 heapByteSize = 0;
+
+	Pool pools[HeapTypeCount * static_cast<UINT>(GpuResourceCategory::Count)];
+};
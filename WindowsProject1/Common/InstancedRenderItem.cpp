@@ -1,4 +1,89 @@
 #include "InstancedRenderItem.h"
+#include "JobSystem.h"
+
+#include <climits>
+
+namespace
+{
+	// Instances per job of the upload and culling loops.  Must be a multiple of
+	// four.
+	const int UploadChunkSize = 1024;
+
+	// The six world-space frustum planes, each component splatted across a vector
+	// so one plane can be tested against four boxes at once.
+	struct SplatFrustum
+	{
+		DirectX::XMVECTOR NormalX[6];
+		DirectX::XMVECTOR NormalY[6];
+		DirectX::XMVECTOR NormalZ[6];
+		DirectX::XMVECTOR AbsNormalX[6];
+		DirectX::XMVECTOR AbsNormalY[6];
+		DirectX::XMVECTOR AbsNormalZ[6];
+		DirectX::XMVECTOR Distance[6];
+	};
+
+	SplatFrustum BuildSplatFrustum(const SpatialIndex::Frustum& planes)
+	{
+		using namespace DirectX;
+
+		SplatFrustum frustum;
+		for (int p = 0; p < 6; ++p)
+		{
+			const XMVECTOR plane = XMLoadFloat4(&planes.Planes[p]);
+			frustum.NormalX[p] = XMVectorSplatX(plane);
+			frustum.NormalY[p] = XMVectorSplatY(plane);
+			frustum.NormalZ[p] = XMVectorSplatZ(plane);
+			frustum.AbsNormalX[p] = XMVectorAbs(frustum.NormalX[p]);
+			frustum.AbsNormalY[p] = XMVectorAbs(frustum.NormalY[p]);
+			frustum.AbsNormalZ[p] = XMVectorAbs(frustum.NormalZ[p]);
+			frustum.Distance[p] = XMVectorSplatW(plane);
+		}
+
+		return frustum;
+	}
+
+	// Returns a 4-bit mask of which of the four boxes intersect the frustum.  The
+	// boxes are gathered from their min/max corners into one vector per axis.  A
+	// box is outside when it lies entirely behind one of the planes, i.e.
+	// dot(n, c) + d < -dot(|n|, e).
+	unsigned CullFourBoxes(const SplatFrustum& frustum, const BvhAabb* const boxes[4])
+	{
+		using namespace DirectX;
+
+		const XMMATRIX mins = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat3(&boxes[0]->Min), XMLoadFloat3(&boxes[1]->Min),
+			XMLoadFloat3(&boxes[2]->Min), XMLoadFloat3(&boxes[3]->Min)));
+		const XMMATRIX maxs = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat3(&boxes[0]->Max), XMLoadFloat3(&boxes[1]->Max),
+			XMLoadFloat3(&boxes[2]->Max), XMLoadFloat3(&boxes[3]->Max)));
+
+		const XMVECTOR cx = XMVectorScale(XMVectorAdd(maxs.r[0], mins.r[0]), 0.5f);
+		const XMVECTOR cy = XMVectorScale(XMVectorAdd(maxs.r[1], mins.r[1]), 0.5f);
+		const XMVECTOR cz = XMVectorScale(XMVectorAdd(maxs.r[2], mins.r[2]), 0.5f);
+		const XMVECTOR ex = XMVectorScale(XMVectorSubtract(maxs.r[0], mins.r[0]), 0.5f);
+		const XMVECTOR ey = XMVectorScale(XMVectorSubtract(maxs.r[1], mins.r[1]), 0.5f);
+		const XMVECTOR ez = XMVectorScale(XMVectorSubtract(maxs.r[2], mins.r[2]), 0.5f);
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; ++p)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(cx, frustum.NormalX[p], frustum.Distance[p]);
+			distance = XMVectorMultiplyAdd(cy, frustum.NormalY[p], distance);
+			distance = XMVectorMultiplyAdd(cz, frustum.NormalZ[p], distance);
+
+			XMVECTOR radius = XMVectorMultiply(ex, frustum.AbsNormalX[p]);
+			radius = XMVectorMultiplyAdd(ey, frustum.AbsNormalY[p], radius);
+			radius = XMVectorMultiplyAdd(ez, frustum.AbsNormalZ[p], radius);
+
+			outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, radius), XMVectorZero()));
+		}
+
+		XMUINT4 mask;
+		XMStoreUInt4(&mask, outside);
+
+		return (mask.x ? 0u : 1u) | (mask.y ? 0u : 2u) | (mask.z ? 0u : 4u) | (mask.w ? 0u : 8u);
+	}
+}
 
 InstancedRenderItem::InstancedRenderItem(
 	MeshGeometry* geometry,
@@ -16,14 +101,14 @@ InstancedRenderItem::InstancedRenderItem(
 	boundingBox(boundingBox),
 	uploadedInstanceCount(0),
 	bVisible(true),
-	instances()
+	gpuInstances()
 {
 
 }
 
 UINT InstancedRenderItem::GetInstanceCount() const noexcept
 {
-	return instances.size();
+	return (UINT)gpuInstances.size();
 }
 
 UINT InstancedRenderItem::GetIndexCountOfInstance() const noexcept
@@ -41,53 +126,196 @@ void InstancedRenderItem::SetVisibility(const bool newVisibility) noexcept
 	bVisible = newVisibility;
 }
 
-void InstancedRenderItem::AddInstance(const InstanceData& data)
+int InstancedRenderItem::AddInstance(const InstanceData& data, Mobility mobility)
 {
-	instances.push_back(data);
+	// Transpose once here instead of on every upload.
+	InstanceData gpuData = data;
+	XMStoreFloat4x4(&gpuData.World, XMMatrixTranspose(XMLoadFloat4x4(&data.World)));
+	XMStoreFloat4x4(&gpuData.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&data.TexTransform)));
+
+	gpuInstances.push_back(gpuData);
+	mobilities.push_back(mobility);
+	versions.push_back(1);
+
+	const int index = (int)gpuInstances.size() - 1;
+
+	DirectX::BoundingBox worldBox;
+	boundingBox.Transform(worldBox, XMLoadFloat4x4(&data.World));
+
+	const SpatialIndex::Handle handle = instanceIndex.Insert(worldBox);
+	assert(handle == (SpatialIndex::Handle)index);
+
+	return index;
 }
 
-UINT InstancedRenderItem::UploadWithFrustumCulling(const Camera& camera, UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset)
+void InstancedRenderItem::SetWorldOfInstanceAt(const DirectX::XMFLOAT4X4& newWorld, int index)
 {
-	if (!bVisible)
-		return 0;
+	SetWorldOfInstanceAt(XMLoadFloat4x4(&newWorld), index);
+}
+
+void InstancedRenderItem::SetWorldOfInstanceAt(DirectX::FXMMATRIX newWorld, int index)
+{
+	assert(mobilities[index] == Mobility::Dynamic);
+
+	DirectX::XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, newWorld);
+	XMStoreFloat4x4(&gpuInstances[index].World, XMMatrixTranspose(newWorld));
+
+	UpdateWorldBoundsOfInstanceAt(index, world);
+	versions[index]++;
+}
 
-	DirectX::XMMATRIX view = camera.GetView();
-	auto viewDeterminant = XMMatrixDeterminant(view);
-	DirectX::XMMATRIX invView = XMMatrixInverse(&viewDeterminant, view);
+void InstancedRenderItem::SetTexTransformOfInstanceAt(const DirectX::XMFLOAT4X4& newTexTransform, int index)
+{
+	SetTexTransformOfInstanceAt(XMLoadFloat4x4(&newTexTransform), index);
+}
+
+void InstancedRenderItem::SetTexTransformOfInstanceAt(DirectX::FXMMATRIX newTexTransform, int index)
+{
+	assert(mobilities[index] == Mobility::Dynamic);
+
+	XMStoreFloat4x4(&gpuInstances[index].TexTransform, XMMatrixTranspose(newTexTransform));
+	versions[index]++;
+}
 
-	int visibleInstanceCount = 0;
+void InstancedRenderItem::SetMaterialIndexOfInstanceAt(UINT newMaterialIndex, int index)
+{
+	assert(mobilities[index] == Mobility::Dynamic);
+
+	gpuInstances[index].MaterialIndex = newMaterialIndex;
+	versions[index]++;
+}
+
+void InstancedRenderItem::UpdateWorldBoundsOfInstanceAt(int index, const DirectX::XMFLOAT4X4& world)
+{
+	// The bounds only depend on the world matrix, so compute them when it changes
+	// rather than inverting the world matrix for every instance every frame.
+	DirectX::BoundingBox worldBox;
+	boundingBox.Transform(worldBox, XMLoadFloat4x4(&world));
 
-	DirectX::BoundingFrustum camFrustum;
-	DirectX::BoundingFrustum::CreateFromMatrix(camFrustum, camera.GetProj());
-	for (UINT i = 0; i < (UINT)instances.size(); ++i)
+	instanceIndex.Move(index, worldBox);
+}
+
+void InstancedRenderItem::AddOccluders(OcclusionCuller& occlusionCuller, UINT gridResolution) const
+{
+	assert(geometry->VertexBufferCPU != nullptr && geometry->IndexBufferCPU != nullptr);
+
+	OccluderMesh mesh = OccluderMesh::Simplify(
+		geometry->VertexBufferCPU->GetBufferPointer(), geometry->VertexByteStride,
+		geometry->IndexBufferCPU->GetBufferPointer(), geometry->IndexFormat == DXGI_FORMAT_R32_UINT ? 4 : 2,
+		indexCount, startIndexLocation, baseVertexLocation,
+		gridResolution);
+	const OcclusionCuller::MeshId meshId = occlusionCuller.AddMesh(std::move(mesh));
+
+	for (size_t i = 0; i < gpuInstances.size(); ++i)
 	{
-		DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&instances[i].World);
-		DirectX::XMMATRIX texTransform = DirectX::XMLoadFloat4x4(&instances[i].TexTransform);
+		if (mobilities[i] != Mobility::Static)
+			continue;
 
-		auto worldDeterminant = XMMatrixDeterminant(world);
-		DirectX::XMMATRIX invWorld = XMMatrixInverse(&worldDeterminant, world);
+		// The stored world matrix is transposed for the shaders.
+		DirectX::XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixTranspose(XMLoadFloat4x4(&gpuInstances[i].World)));
+		occlusionCuller.AddOccluder(meshId, world);
+	}
+}
 
-		// View space to the object's local space.
-		DirectX::XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+template<typename ChunkFilter>
+void InstancedRenderItem::KeepInstancesInParallel(std::vector<UINT>& instanceIndices, ChunkFilter&& filterChunk)
+{
+	JobSystem& jobs = JobSystem::Default();
+	const int instanceCount = (int)instanceIndices.size();
+	const int chunkCount = (instanceCount + UploadChunkSize - 1) / UploadChunkSize;
 
-		// Transform the camera frustum from view space to the object's local space.
-		DirectX::BoundingFrustum localSpaceFrustum;
-		camFrustum.Transform(localSpaceFrustum, viewToLocal);
+	chunkVisibleCounts.assign(chunkCount, 0);
 
-		// Perform the box/frustum intersection test in local space.
-		if (localSpaceFrustum.Contains(boundingBox) != DirectX::DISJOINT)
+	// Filter the chunks in parallel.  Each chunk keeps its survivors at the front
+	// of its own slice of instanceIndices.
+	jobs.ParallelFor(0, chunkCount, 1, [&](int chunk)
 		{
-			InstanceData data;
-			XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-			data.MaterialIndex = instances[i].MaterialIndex;
-
-			// Write the instance data to structured buffer for the visible objects.
-			int elementIndex = bufferOffset + visibleInstanceCount++;
-			instanceBuffer.CopyData(elementIndex, data);
+			const int first = chunk * UploadChunkSize;
+			const int last = std::min(first + UploadChunkSize, instanceCount);
+			chunkVisibleCounts[chunk] = filterChunk(instanceIndices.data() + first, (UINT)(last - first));
+		});
+
+	// Pack the survivors of every chunk behind those of the chunks before it.
+	UINT keptCount = 0;
+	for (int chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		const int first = chunk * UploadChunkSize;
+		const UINT count = chunkVisibleCounts[chunk];
+		if (first != (int)keptCount)
+		{
+			std::copy(
+				instanceIndices.begin() + first,
+				instanceIndices.begin() + first + count,
+				instanceIndices.begin() + keptCount);
 		}
+
+		keptCount += count;
 	}
 
+	instanceIndices.resize(keptCount);
+}
+
+UINT InstancedRenderItem::UploadWithFrustumCulling(const Camera& camera, UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset,
+	int frameResourceIndex, const OcclusionCuller* occlusionCuller)
+{
+	if (!bVisible)
+		return 0;
+
+	// Refit the tree above the instances that moved, then walk it: subtrees
+	// entirely outside the frustum are skipped, and those entirely inside are
+	// taken without testing their instances.  The tree order only changes on a
+	// rebuild, so the slots of unchanged instances mostly stay where they were.
+	instanceIndex.Update();
+
+	const SpatialIndex::Frustum frustum =
+		SpatialIndex::Frustum::FromViewProj(XMMatrixMultiply(camera.GetView(), camera.GetProj()));
+
+	visibleInstanceIndices.clear();
+	candidateInstanceIndices.clear();
+	instanceIndex.QueryFrustumCandidates(frustum, visibleInstanceIndices, candidateInstanceIndices);
+
+	// The instances of leaves the frustum only partly covers are tested four at a
+	// time, in parallel chunks, and the survivors follow the whole subtrees.
+	const SplatFrustum splatFrustum = BuildSplatFrustum(frustum);
+	KeepInstancesInParallel(candidateInstanceIndices, [&](UINT* indices, UINT count)
+		{
+			UINT visibleCount = 0;
+			for (UINT k = 0; k < count; k += 4)
+			{
+				// Repeat the last instance in the lanes past the end, then mask
+				// them off.
+				const UINT laneCount = std::min(count - k, 4u);
+				UINT lanes[4];
+				const BvhAabb* boxes[4];
+				for (UINT lane = 0; lane < 4; ++lane)
+				{
+					lanes[lane] = indices[k + std::min(lane, laneCount - 1)];
+					boxes[lane] = &instanceIndex.GetBounds(lanes[lane]);
+				}
+
+				unsigned mask = CullFourBoxes(splatFrustum, boxes) & ((1u << laneCount) - 1);
+				for (UINT lane = 0; mask != 0; ++lane, mask >>= 1)
+				{
+					if (mask & 1u)
+						indices[visibleCount++] = lanes[lane];
+				}
+			}
+			return visibleCount;
+		});
+
+	visibleInstanceIndices.insert(visibleInstanceIndices.end(),
+		candidateInstanceIndices.begin(), candidateInstanceIndices.end());
+
+	if (occlusionCuller != nullptr)
+		RemoveOccludedInstances(*occlusionCuller);
+
+	const UINT visibleInstanceCount = (UINT)visibleInstanceIndices.size();
+
+	// Write the instance data to structured buffer for the visible objects.
+	UploadSlots(instanceBuffer, bufferOffset, frameResourceIndex, visibleInstanceIndices.data(), visibleInstanceCount);
+
 	instanceBufferOffset = bufferOffset * instanceBuffer.GetElementByteSize();
 	uploadedInstanceCount = visibleInstanceCount;
 	bUploadedWithFrustumCulling = true;
@@ -95,37 +323,85 @@ UINT InstancedRenderItem::UploadWithFrustumCulling(const Camera& camera, UploadB
 	return uploadedInstanceCount;
 }
 
-UINT InstancedRenderItem::UploadWithoutFrustumCulling(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset)
+void InstancedRenderItem::RemoveOccludedInstances(const OcclusionCuller& occlusionCuller)
+{
+	KeepInstancesInParallel(visibleInstanceIndices, [&](UINT* indices, UINT count)
+		{
+			UINT visibleCount = 0;
+			for (UINT k = 0; k < count; ++k)
+			{
+				const BvhAabb& bounds = instanceIndex.GetBounds(indices[k]);
+				if (occlusionCuller.IsVisible(bounds.Min, bounds.Max))
+					indices[visibleCount++] = indices[k];
+			}
+			return visibleCount;
+		});
+}
+
+UINT InstancedRenderItem::UploadWithoutFrustumCulling(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset, int frameResourceIndex)
 {
 	if (!bVisible)
 		return 0;
 
-	int uploaded = 0;
-	
-	for (UINT i = 0; i < (UINT)instances.size(); ++i)
-	{
-		DirectX::XMMATRIX world = 
-			DirectX::XMLoadFloat4x4(&instances[i].World);
-		DirectX::XMMATRIX texTransform = 
-			DirectX::XMLoadFloat4x4(&instances[i].TexTransform);
-
-		InstanceData data;
-		XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-		data.MaterialIndex = instances[i].MaterialIndex;
-
-		// Write the instance data to structured buffer for the visible objects.
-		int elementIndex = bufferOffset + uploaded++;
-		instanceBuffer.CopyData(elementIndex, data);
-	}
+	const UINT instanceCount = (UINT)gpuInstances.size();
+
+	// Write the instance data to structured buffer for all the objects.
+	UploadSlots(instanceBuffer, bufferOffset, frameResourceIndex, nullptr, instanceCount);
 
 	instanceBufferOffset = bufferOffset * instanceBuffer.GetElementByteSize();
-	uploadedInstanceCount = uploaded;
+	uploadedInstanceCount = instanceCount;
 	bUploadedWithFrustumCulling = false;
 
 	return uploadedInstanceCount;
 }
 
+InstancedRenderItem::UploadRecord& InstancedRenderItem::GetUploadRecord(
+	UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset, int frameResourceIndex, UINT slotCount)
+{
+	assert(frameResourceIndex >= 0);
+
+	if (frameResourceIndex >= (int)uploadRecords.size())
+		uploadRecords.resize(frameResourceIndex + 1);
+
+	UploadRecord& record = uploadRecords[frameResourceIndex];
+	const UINT64 bufferId = instanceBuffer.GetUniqueId();
+
+	// The frame resource was rebuilt with a new buffer, or our range of it moved,
+	// so nothing in it is ours anymore.
+	if (record.BufferId != bufferId || record.BufferOffset != bufferOffset)
+	{
+		record.BufferId = bufferId;
+		record.BufferOffset = bufferOffset;
+		record.SlotInstance.clear();
+		record.SlotVersion.clear();
+	}
+
+	record.SlotInstance.resize(slotCount, UINT_MAX);
+	record.SlotVersion.resize(slotCount, 0);
+
+	return record;
+}
+
+void InstancedRenderItem::UploadSlots(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset, int frameResourceIndex,
+	const UINT* instanceIndices, UINT slotCount)
+{
+	UploadRecord& record = GetUploadRecord(instanceBuffer, bufferOffset, frameResourceIndex, slotCount);
+
+	// Only touch the slots whose instance or its version differ from what this
+	// buffer already holds.  For mostly static scenes that is almost none of them,
+	// which saves both the copies and the write-combined memory traffic.
+	JobSystem::Default().ParallelFor(0, (int)slotCount, UploadChunkSize, [&](int slot)
+		{
+			const UINT i = instanceIndices ? instanceIndices[slot] : (UINT)slot;
+			if (record.SlotInstance[slot] == i && record.SlotVersion[slot] == versions[i])
+				return;
+
+			instanceBuffer.CopyData(bufferOffset + slot, gpuInstances[i]);
+			record.SlotInstance[slot] = i;
+			record.SlotVersion[slot] = versions[i];
+		});
+}
+
 void InstancedRenderItem::BeforeDraw(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* instanceBuffer, UINT ibSlotOfRootSignature) const
 {
 	auto vertexBufferView = geometry->VertexBufferView();
@@ -169,7 +445,7 @@ void InstancedRenderItem::DrawAllInstances(ID3D12GraphicsCommandList* cmdList, I
 
 	cmdList->DrawIndexedInstanced(
 		indexCount, 
-		instances.size(),
+		(UINT)gpuInstances.size(),
 		startIndexLocation, 
 		baseVertexLocation, 
 		0
@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "Camera.h"
+#include "OcclusionCuller.h"
+#include "SpatialIndex.h"
 #include "UploadBuffer.h"
 
 struct InstanceData
@@ -36,16 +38,37 @@ public:
 
 	void SetVisibility(const bool newVisibility) noexcept;
 
-	//void SetWorldOfInstanceAt(DirectX::XMFLOAT4X4& newWorld, int index);
-	//void SetWorldOfInstanceAt(DirectX::XMMATRIX& newWorld, int index);
-	//void SetTexTransformOfInstanceAt(DirectX::XMFLOAT4X4& newTexTransform, int index);
-	//void SetTexTransformOfInstanceAt(DirectX::XMMATRIX& newTexTransform, int index);
-	//void SetMaterialIndexOfInstanceAt(int newMaterialIndex, int index);
+	// Static instances never change after they are added.  Dynamic instances can be
+	// changed through the setters below; only the instances that changed since a
+	// buffer was last written are copied into it again.
+	enum class Mobility
+	{
+		Static,
+		Dynamic
+	};
 
-	void AddInstance(const InstanceData& data);
+	void SetWorldOfInstanceAt(const DirectX::XMFLOAT4X4& newWorld, int index);
+	void SetWorldOfInstanceAt(DirectX::FXMMATRIX newWorld, int index);
+	void SetTexTransformOfInstanceAt(const DirectX::XMFLOAT4X4& newTexTransform, int index);
+	void SetTexTransformOfInstanceAt(DirectX::FXMMATRIX newTexTransform, int index);
+	void SetMaterialIndexOfInstanceAt(UINT newMaterialIndex, int index);
 
-	UINT UploadWithFrustumCulling(const Camera& camera, UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset);
-	UINT UploadWithoutFrustumCulling(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset);
+	// Returns the index of the new instance.
+	int AddInstance(const InstanceData& data, Mobility mobility = Mobility::Static);
+
+	// Registers the static instances as occluders, drawn with a copy of the mesh
+	// simplified on a grid of gridResolution cells per axis.  Reads the geometry's
+	// CPU buffers.
+	void AddOccluders(OcclusionCuller& occlusionCuller, UINT gridResolution = 8) const;
+
+	// frameResourceIndex names the frame resource that owns instanceBuffer; what
+	// was last written there is remembered per frame resource, so unchanged
+	// instances are not copied again.  With an occlusion culler, the instances
+	// that pass the frustum test are also tested against the occluders it last
+	// rendered.
+	UINT UploadWithFrustumCulling(const Camera& camera, UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset,
+		int frameResourceIndex, const OcclusionCuller* occlusionCuller = nullptr);
+	UINT UploadWithoutFrustumCulling(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset, int frameResourceIndex);
 	void BeforeDraw(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* instanceBuffer,
 	                UINT ibSlotOfRootSignature) const;
 	void DrawFrustumCullednstances(
@@ -59,11 +82,55 @@ public:
 	
 
 private:
+	// What was last written to the slots of a frame resource's upload buffer, so
+	// slots whose instance and version have not changed can be skipped.
+	struct UploadRecord
+	{
+		UINT64 BufferId = 0;
+		int BufferOffset = -1;
+		std::vector<UINT> SlotInstance;
+		std::vector<UINT> SlotVersion;
+	};
+
+	void UpdateWorldBoundsOfInstanceAt(int index, const DirectX::XMFLOAT4X4& world);
+	void RemoveOccludedInstances(const OcclusionCuller& occlusionCuller);
+
+	// Runs filterChunk(indices, count) over chunks of instanceIndices on the job
+	// system; it moves the indices it keeps to the front of its chunk and returns
+	// how many.  The kept indices are then packed in their original order.
+	template<typename ChunkFilter>
+	void KeepInstancesInParallel(std::vector<UINT>& instanceIndices, ChunkFilter&& filterChunk);
+	UploadRecord& GetUploadRecord(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset, int frameResourceIndex,
+		UINT slotCount);
+	void UploadSlots(UploadBuffer<InstanceData>& instanceBuffer, int bufferOffset, int frameResourceIndex,
+		const UINT* instanceIndices, UINT slotCount);
+
 	MeshGeometry* geometry;
 	D3D12_PRIMITIVE_TOPOLOGY primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
 	DirectX::BoundingBox boundingBox;
-	std::vector<InstanceData> instances;
+
+	// Instance data as the shaders read it, with World and TexTransform already
+	// transposed.
+	std::vector<InstanceData> gpuInstances;
+	std::vector<Mobility> mobilities;
+
+	// Bumped whenever an instance changes.
+	std::vector<UINT> versions;
+
+	// World-space AABBs of the instances, with each instance's index as its
+	// handle.  Instances are never removed, so the handles stay in step.
+	SpatialIndex instanceIndex;
+
+	// One record per frame resource, indexed by frameResourceIndex.  A record is
+	// reset when its frame resource hands in a different buffer.
+	std::vector<UploadRecord> uploadRecords;
+
+	// Scratch of the culling pass, kept between frames to avoid reallocating.
+	std::vector<UINT> visibleInstanceIndices;
+	std::vector<UINT> candidateInstanceIndices;
+	std::vector<UINT> chunkVisibleCounts;
+
 	int instanceBufferOffset;
 	
 	UINT uploadedInstanceCount;
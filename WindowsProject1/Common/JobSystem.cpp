@@ -0,0 +1,330 @@
+#include "JobSystem.h"
+
+#include <cassert>
+#include <cstdint>
+
+namespace
+{
+	// Worker identity of the current thread, so jobs that submit more jobs push
+	// to their own queue.
+	thread_local const JobSystem* tlsJobSystem = nullptr;
+	thread_local int tlsWorkerIndex = -1;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+ScratchArena::ScratchArena(size_t blockByteSize)
+	: blockByteSize(blockByteSize)
+{
+}
+
+void* ScratchArena::Allocate(size_t byteSize, size_t alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	while (currentBlock < blocks.size())
+	{
+		Block& block = blocks[currentBlock];
+		const uintptr_t base = reinterpret_cast<uintptr_t>(block.Memory.get());
+		const size_t offset = AlignUp(base + currentOffset, alignment) - base;
+		if (offset + byteSize <= block.ByteSize)
+		{
+			currentOffset = offset + byteSize;
+			return block.Memory.get() + offset;
+		}
+
+		++currentBlock;
+		currentOffset = 0;
+	}
+
+	// No retained block can hold the allocation, so start a new one.
+	Block block;
+	block.ByteSize = std::max(blockByteSize, byteSize + alignment);
+	block.Memory.reset(new unsigned char[block.ByteSize]);
+	blocks.push_back(std::move(block));
+
+	currentBlock = blocks.size() - 1;
+	currentOffset = 0;
+	return Allocate(byteSize, alignment);
+}
+
+ScratchArena::Marker ScratchArena::GetMarker() const noexcept
+{
+	Marker marker;
+	marker.Block = currentBlock;
+	marker.Offset = currentOffset;
+	return marker;
+}
+
+void ScratchArena::Rewind(const Marker& marker) noexcept
+{
+	currentBlock = marker.Block;
+	currentOffset = marker.Offset;
+}
+
+void ScratchArena::Reset() noexcept
+{
+	currentBlock = 0;
+	currentOffset = 0;
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+	if (workerCount == 0)
+	{
+		const unsigned hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	for (unsigned i = 0; i < workerCount; ++i)
+		workers.push_back(std::make_unique<Worker>());
+
+	// Start the threads only once every queue exists, since they steal from all of them.
+	for (unsigned i = 0; i < workerCount; ++i)
+		workers[i]->Thread = std::thread(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		bQuit = true;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers)
+		worker->Thread.join();
+}
+
+JobSystem& JobSystem::Default()
+{
+	static JobSystem jobSystem;
+	return jobSystem;
+}
+
+unsigned JobSystem::GetWorkerCount() const noexcept
+{
+	return static_cast<unsigned>(workers.size());
+}
+
+unsigned JobSystem::GetConcurrency() const noexcept
+{
+	return GetWorkerCount() + 1;
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter* counter)
+{
+	if (workers.empty())
+	{
+		job();
+		return;
+	}
+
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	const int self = GetCurrentWorkerIndex();
+	const unsigned queueIndex = self >= 0
+		? static_cast<unsigned>(self)
+		: nextQueue.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+	Worker& worker = *workers[queueIndex];
+	{
+		std::lock_guard<std::mutex> lock(worker.Mutex);
+		worker.Jobs.push_back(Job{ std::move(job), counter });
+	}
+
+	// Publish the job before taking the sleep lock so a worker that is about to
+	// sleep either sees it or gets the notification.
+	queuedJobCount.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wakeCondition.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.IsDone())
+	{
+		if (!TryRunOne())
+			std::this_thread::yield();
+	}
+}
+
+ScratchArena& JobSystem::GetScratch()
+{
+	const int self = GetCurrentWorkerIndex();
+	if (self >= 0)
+		return workers[self]->Scratch;
+
+	thread_local ScratchArena callerScratch;
+	return callerScratch;
+}
+
+int JobSystem::GetCurrentWorkerIndex() const noexcept
+{
+	return tlsJobSystem == this ? tlsWorkerIndex : -1;
+}
+
+int JobSystem::GetGrainSize(int count, int grainSize) const noexcept
+{
+	if (grainSize > 0)
+		return grainSize;
+
+	// About four chunks per thread keeps the load balanced without drowning
+	// small loops in scheduling overhead.
+	const int chunkCount = static_cast<int>(GetConcurrency()) * 4;
+	return std::max(1, (count + chunkCount - 1) / chunkCount);
+}
+
+bool JobSystem::TryPop(Job& job)
+{
+	if (queuedJobCount.load(std::memory_order_acquire) <= 0)
+		return false;
+
+	const int self = GetCurrentWorkerIndex();
+	if (self >= 0)
+	{
+		Worker& worker = *workers[self];
+		std::lock_guard<std::mutex> lock(worker.Mutex);
+		if (!worker.Jobs.empty())
+		{
+			job = std::move(worker.Jobs.back());
+			worker.Jobs.pop_back();
+			queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Steal the oldest job of someone else's queue; those tend to be the largest.
+	const unsigned count = static_cast<unsigned>(workers.size());
+	const unsigned start = self >= 0 ? static_cast<unsigned>(self) + 1 : nextQueue.load(std::memory_order_relaxed);
+	for (unsigned k = 0; k < count; ++k)
+	{
+		const unsigned victim = (start + k) % count;
+		if (static_cast<int>(victim) == self)
+			continue;
+
+		Worker& worker = *workers[victim];
+		std::lock_guard<std::mutex> lock(worker.Mutex);
+		if (!worker.Jobs.empty())
+		{
+			job = std::move(worker.Jobs.front());
+			worker.Jobs.pop_front();
+			queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool JobSystem::TryRunOne()
+{
+	Job job;
+	if (!TryPop(job))
+		return false;
+
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	job.Fn();
+
+	if (job.Counter)
+		job.Counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+	tlsJobSystem = this;
+	tlsWorkerIndex = static_cast<int>(index);
+
+	while (!bQuit.load(std::memory_order_acquire))
+	{
+		if (TryRunOne())
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this]()
+			{
+				return bQuit.load(std::memory_order_acquire) ||
+					queuedJobCount.load(std::memory_order_acquire) > 0;
+			});
+	}
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(std::function<void()> fn)
+{
+	auto node = std::make_unique<Node>();
+	node->Fn = std::move(fn);
+	nodes.push_back(std::move(node));
+
+	return static_cast<TaskId>(nodes.size() - 1);
+}
+
+void TaskGraph::AddDependency(TaskId before, TaskId after)
+{
+	assert(before >= 0 && before < static_cast<TaskId>(nodes.size()));
+	assert(after >= 0 && after < static_cast<TaskId>(nodes.size()));
+	assert(before != after);
+
+	nodes[before]->Successors.push_back(after);
+	nodes[after]->DependencyCount++;
+}
+
+void TaskGraph::Run(JobSystem& jobSystem)
+{
+	for (auto& node : nodes)
+		node->PendingDependencies.store(node->DependencyCount, std::memory_order_relaxed);
+
+	// A task only finishes after it has scheduled its successors, so the counter
+	// cannot reach zero while parts of the graph are still waiting to start.
+	JobCounter counter;
+	bool bHasRoot = false;
+	for (TaskId id = 0; id < static_cast<TaskId>(nodes.size()); ++id)
+	{
+		if (nodes[id]->DependencyCount == 0)
+		{
+			bHasRoot = true;
+			Schedule(jobSystem, id, counter);
+		}
+	}
+
+	// A non-empty graph without a root is a cycle and would never finish.
+	assert(bHasRoot || nodes.empty());
+	(void)bHasRoot;
+
+	jobSystem.Wait(counter);
+}
+
+void TaskGraph::Clear()
+{
+	nodes.clear();
+}
+
+size_t TaskGraph::GetTaskCount() const noexcept
+{
+	return nodes.size();
+}
+
+void TaskGraph::Schedule(JobSystem& jobSystem, TaskId id, JobCounter& counter)
+{
+	jobSystem.Run([this, &jobSystem, &counter, id]()
+		{
+			Node& node = *nodes[id];
+			node.Fn();
+
+			for (TaskId successor : node.Successors)
+			{
+				if (nodes[successor]->PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					Schedule(jobSystem, successor, counter);
+			}
+		}, &counter);
+}
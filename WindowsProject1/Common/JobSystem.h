@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Linear allocator for memory that only lives as long as one job.  Every worker
+// thread owns one, so jobs can grab temporaries without touching the heap.
+// Blocks are kept after Rewind/Reset and reused by later allocations.
+class ScratchArena
+{
+public:
+	struct Marker
+	{
+		size_t Block = 0;
+		size_t Offset = 0;
+	};
+
+	explicit ScratchArena(size_t blockByteSize = 256 * 1024);
+	ScratchArena(const ScratchArena& rhs) = delete;
+	ScratchArena& operator=(const ScratchArena& rhs) = delete;
+
+	void* Allocate(size_t byteSize, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	Marker GetMarker() const noexcept;
+	void Rewind(const Marker& marker) noexcept;
+	void Reset() noexcept;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> Memory;
+		size_t ByteSize = 0;
+	};
+
+	std::vector<Block> blocks;
+	size_t blockByteSize;
+	size_t currentBlock = 0;
+	size_t currentOffset = 0;
+};
+
+// Rewinds an arena to where it was when the scope was entered.
+class ScratchScope
+{
+public:
+	explicit ScratchScope(ScratchArena& arena)
+		: arena(arena),
+		marker(arena.GetMarker())
+	{
+	}
+	~ScratchScope() { arena.Rewind(marker); }
+
+	ScratchScope(const ScratchScope& rhs) = delete;
+	ScratchScope& operator=(const ScratchScope& rhs) = delete;
+
+private:
+	ScratchArena& arena;
+	ScratchArena::Marker marker;
+};
+
+// Number of jobs of a submission that have not finished yet.
+class JobCounter
+{
+public:
+	bool IsDone() const noexcept { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending{ 0 };
+};
+
+// Work-stealing scheduler on plain std::thread.  Each worker pushes and pops its own
+// queue from the back and steals from the front of the others.  A thread that waits
+// on a JobCounter runs queued jobs until the counter drops to zero, so waiting from
+// inside a job (nested ParallelFor) cannot deadlock.  Jobs must not throw.
+class JobSystem
+{
+public:
+	// workerCount == 0 picks one worker per hardware thread besides the caller's.
+	explicit JobSystem(unsigned workerCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+
+	// Shared instance used by the framework.
+	static JobSystem& Default();
+
+	unsigned GetWorkerCount() const noexcept;
+
+	// Number of threads that may run jobs at once: the workers plus the waiting caller.
+	unsigned GetConcurrency() const noexcept;
+
+	void Run(std::function<void()> job, JobCounter* counter = nullptr);
+	void Wait(JobCounter& counter);
+
+	// Calls fn(first, last) over chunks of [begin, end) of at most grainSize items
+	// and returns once all of them are done.  grainSize <= 0 picks a chunk size
+	// that gives every thread a few chunks.
+	template<typename Fn>
+	void ParallelForRange(int begin, int end, int grainSize, Fn&& fn)
+	{
+		if (end <= begin)
+			return;
+
+		grainSize = GetGrainSize(end - begin, grainSize);
+		if (workers.empty() || end - begin <= grainSize)
+		{
+			// Still chunked, since callers may size their scratch by grainSize.
+			for (int first = begin; first < end; first += grainSize)
+				fn(first, std::min(first + grainSize, end));
+			return;
+		}
+
+		// The calling thread takes the first chunk itself.
+		JobCounter counter;
+		for (int first = begin + grainSize; first < end; first += grainSize)
+		{
+			const int last = std::min(first + grainSize, end);
+			Run([&fn, first, last]() { fn(first, last); }, &counter);
+		}
+
+		fn(begin, begin + grainSize);
+		Wait(counter);
+	}
+
+	// Calls fn(i) for every i in [begin, end).
+	template<typename Fn>
+	void ParallelFor(int begin, int end, int grainSize, Fn&& fn)
+	{
+		ParallelForRange(begin, end, grainSize, [&fn](int first, int last)
+			{
+				for (int i = first; i < last; ++i)
+					fn(i);
+			});
+	}
+
+	// Scratch arena of the calling thread.  Threads that are not workers get a
+	// thread-local arena of their own.
+	ScratchArena& GetScratch();
+
+	// Index of the calling thread among this system's workers, or -1.
+	int GetCurrentWorkerIndex() const noexcept;
+
+private:
+	struct Job
+	{
+		std::function<void()> Fn;
+		JobCounter* Counter = nullptr;
+	};
+
+	struct Worker
+	{
+		std::mutex Mutex;
+		std::deque<Job> Jobs;
+		ScratchArena Scratch;
+		std::thread Thread;
+	};
+
+	int GetGrainSize(int count, int grainSize) const noexcept;
+	bool TryPop(Job& job);
+	bool TryRunOne();
+	void Execute(Job& job);
+	void WorkerLoop(unsigned index);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::atomic<int> queuedJobCount{ 0 };
+	std::atomic<unsigned> nextQueue{ 0 };
+	std::atomic<bool> bQuit{ false };
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+};
+
+// A set of jobs with ordering constraints.  Run schedules every task whose
+// dependencies are done and returns when the whole graph has executed.  A graph
+// can be run again once Run returns.
+class TaskGraph
+{
+public:
+	typedef int TaskId;
+
+	TaskGraph() = default;
+	TaskGraph(const TaskGraph& rhs) = delete;
+	TaskGraph& operator=(const TaskGraph& rhs) = delete;
+
+	TaskId AddTask(std::function<void()> fn);
+
+	// after will not start before before has finished.
+	void AddDependency(TaskId before, TaskId after);
+
+	void Run(JobSystem& jobSystem);
+	void Clear();
+
+	size_t GetTaskCount() const noexcept;
+
+private:
+	struct Node
+	{
+		std::function<void()> Fn;
+		std::vector<TaskId> Successors;
+		int DependencyCount = 0;
+		std::atomic<int> PendingDependencies{ 0 };
+	};
+
+	void Schedule(JobSystem& jobSystem, TaskId id, JobCounter& counter);
+
+	std::vector<std::unique_ptr<Node>> nodes;
+};
@@ -0,0 +1,74 @@
+#include "MappedFile.h"
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Mapping an empty file fails, and there is nothing to read anyway.
+	if (size == 0)
+		return true;
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (view != nullptr)
+		UnmapViewOfFile(view);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+	view = nullptr;
+	size = 0;
+}
+
+bool MappedFile::GetFileStamp(const std::wstring& filename, UINT64& byteSize, UINT64& writeTime)
+{
+	byteSize = 0;
+	writeTime = 0;
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+
+	byteSize = (UINT64)attributes.nFileSizeHigh << 32 | attributes.nFileSizeLow;
+	writeTime = (UINT64)attributes.ftLastWriteTime.dwHighDateTime << 32 | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <windows.h>
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file.  The view stays valid until the
+// file is closed, so loaders can hand pointers into it straight to the GPU
+// upload code instead of copying through a stream.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+
+	// Returns false if the file does not exist or cannot be mapped.  An empty
+	// file opens with a null view and size 0.
+	bool Open(const std::wstring& filename);
+	void Close();
+
+	// Size and last write time of a file, for telling whether something derived
+	// from it is stale.  Returns false and zeros if the file does not exist.
+	static bool GetFileStamp(const std::wstring& filename, UINT64& byteSize, UINT64& writeTime);
+
+	bool IsOpen() const noexcept { return file != INVALID_HANDLE_VALUE; }
+	const unsigned char* GetData() const noexcept { return static_cast<const unsigned char*>(view); }
+	size_t GetSize() const noexcept { return size; }
+
+private:
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	const void* view = nullptr;
+	size_t size = 0;
+};
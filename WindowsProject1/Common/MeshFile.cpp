@@ -0,0 +1,281 @@
+#include "MeshFile.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+struct MeshFile::Header
+{
+	UINT Magic;
+	UINT Version;
+
+	UINT64 SourceByteSize;
+	UINT64 SourceWriteTime;
+
+	UINT VertexByteStride;
+	UINT VertexCount;
+	UINT IndexFormat;
+	UINT IndexCount;
+	UINT SubmeshCount;
+	UINT Reserved;
+
+	UINT64 SubmeshOffset;
+	UINT64 VertexOffset;
+	UINT64 IndexOffset;
+};
+
+namespace
+{
+	constexpr UINT MeshFileMagic = 'H' << 24 | 'S' << 16 | 'E' << 8 | 'M';
+
+	// Blobs start on a 16-byte boundary so the mapped vertices can be read with
+	// aligned loads.
+	constexpr UINT64 BlobAlignment = 16;
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	UINT GetIndexByteSize(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	}
+}
+
+void MeshFileSubmesh::SetName(const std::string& name)
+{
+	std::memset(Name, 0, sizeof(Name));
+	std::memcpy(Name, name.data(), std::min(name.size(), sizeof(Name) - 1));
+}
+
+bool MeshFile::Write(
+	const std::wstring& filename,
+	const std::wstring& sourceFilename,
+	const void* vertexData, UINT vertexByteStride, UINT vertexCount,
+	const void* indexData, DXGI_FORMAT indexFormat, UINT indexCount,
+	const std::vector<MeshFileSubmesh>& submeshes)
+{
+	assert(indexFormat == DXGI_FORMAT_R16_UINT || indexFormat == DXGI_FORMAT_R32_UINT);
+
+	Header fileHeader = {};
+	fileHeader.Magic = MeshFileMagic;
+	fileHeader.Version = Version;
+	MappedFile::GetFileStamp(sourceFilename, fileHeader.SourceByteSize, fileHeader.SourceWriteTime);
+	fileHeader.VertexByteStride = vertexByteStride;
+	fileHeader.VertexCount = vertexCount;
+	fileHeader.IndexFormat = (UINT)indexFormat;
+	fileHeader.IndexCount = indexCount;
+	fileHeader.SubmeshCount = (UINT)submeshes.size();
+
+	const UINT64 vertexByteSize = (UINT64)vertexByteStride * vertexCount;
+	const UINT64 indexByteSize = (UINT64)GetIndexByteSize(indexFormat) * indexCount;
+
+	fileHeader.SubmeshOffset = AlignUp(sizeof(Header), BlobAlignment);
+	fileHeader.VertexOffset = AlignUp(fileHeader.SubmeshOffset + sizeof(MeshFileSubmesh) * submeshes.size(), BlobAlignment);
+	fileHeader.IndexOffset = AlignUp(fileHeader.VertexOffset + vertexByteSize, BlobAlignment);
+
+	std::vector<char> bytes((size_t)(fileHeader.IndexOffset + indexByteSize), 0);
+	std::memcpy(bytes.data(), &fileHeader, sizeof(Header));
+	if (!submeshes.empty())
+		std::memcpy(bytes.data() + fileHeader.SubmeshOffset, submeshes.data(), sizeof(MeshFileSubmesh) * submeshes.size());
+	std::memcpy(bytes.data() + fileHeader.VertexOffset, vertexData, (size_t)vertexByteSize);
+	std::memcpy(bytes.data() + fileHeader.IndexOffset, indexData, (size_t)indexByteSize);
+
+	// Write next to the target and swap it in, so an interrupted conversion never
+	// leaves a truncated file behind that a later run would try to map.
+	const std::wstring tempFilename = filename + L".tmp";
+	{
+		std::ofstream fout(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!fout)
+			return false;
+
+		fout.write(bytes.data(), (std::streamsize)bytes.size());
+		if (!fout)
+			return false;
+	}
+
+	return MoveFileExW(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+bool MeshFile::Open(const std::wstring& filename, const std::wstring& sourceFilename, UINT vertexByteStride)
+{
+	Close();
+
+	if (!file.Open(filename) || file.GetSize() < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const auto fileHeader = reinterpret_cast<const Header*>(file.GetData());
+	const UINT64 fileSize = file.GetSize();
+
+	bool bValid =
+		fileHeader->Magic == MeshFileMagic &&
+		fileHeader->Version == Version &&
+		fileHeader->VertexByteStride == vertexByteStride &&
+		(fileHeader->IndexFormat == DXGI_FORMAT_R16_UINT || fileHeader->IndexFormat == DXGI_FORMAT_R32_UINT);
+
+	if (bValid)
+	{
+		const UINT64 indexByteSize = (UINT64)GetIndexByteSize((DXGI_FORMAT)fileHeader->IndexFormat) * fileHeader->IndexCount;
+		bValid =
+			fileHeader->SubmeshOffset + sizeof(MeshFileSubmesh) * (UINT64)fileHeader->SubmeshCount <= fileSize &&
+			fileHeader->VertexOffset + (UINT64)fileHeader->VertexByteStride * fileHeader->VertexCount <= fileSize &&
+			fileHeader->IndexOffset + indexByteSize <= fileSize;
+	}
+
+	if (bValid)
+	{
+		UINT64 sourceByteSize = 0;
+		UINT64 sourceWriteTime = 0;
+		if (MappedFile::GetFileStamp(sourceFilename, sourceByteSize, sourceWriteTime))
+		{
+			bValid =
+				fileHeader->SourceByteSize == sourceByteSize &&
+				fileHeader->SourceWriteTime == sourceWriteTime;
+		}
+	}
+
+	if (!bValid)
+	{
+		Close();
+		return false;
+	}
+
+	header = fileHeader;
+	submeshes = reinterpret_cast<const MeshFileSubmesh*>(file.GetData() + header->SubmeshOffset);
+	return true;
+}
+
+void MeshFile::Close()
+{
+	file.Close();
+	header = nullptr;
+	submeshes = nullptr;
+}
+
+const void* MeshFile::GetVertexData() const noexcept
+{
+	assert(IsOpen());
+	return file.GetData() + header->VertexOffset;
+}
+
+UINT MeshFile::GetVertexByteStride() const noexcept
+{
+	assert(IsOpen());
+	return header->VertexByteStride;
+}
+
+UINT MeshFile::GetVertexCount() const noexcept
+{
+	assert(IsOpen());
+	return header->VertexCount;
+}
+
+UINT MeshFile::GetVertexBufferByteSize() const noexcept
+{
+	assert(IsOpen());
+	return header->VertexByteStride * header->VertexCount;
+}
+
+const void* MeshFile::GetIndexData() const noexcept
+{
+	assert(IsOpen());
+	return file.GetData() + header->IndexOffset;
+}
+
+DXGI_FORMAT MeshFile::GetIndexFormat() const noexcept
+{
+	assert(IsOpen());
+	return (DXGI_FORMAT)header->IndexFormat;
+}
+
+UINT MeshFile::GetIndexCount() const noexcept
+{
+	assert(IsOpen());
+	return header->IndexCount;
+}
+
+UINT MeshFile::GetIndexBufferByteSize() const noexcept
+{
+	assert(IsOpen());
+	return GetIndexByteSize((DXGI_FORMAT)header->IndexFormat) * header->IndexCount;
+}
+
+UINT MeshFile::GetSubmeshCount() const noexcept
+{
+	assert(IsOpen());
+	return header->SubmeshCount;
+}
+
+const MeshFileSubmesh& MeshFile::GetSubmesh(UINT index) const noexcept
+{
+	assert(IsOpen() && index < header->SubmeshCount);
+	return submeshes[index];
+}
+
+std::unique_ptr<MeshGeometry> MeshFile::CreateGeometry(
+	const std::string& name,
+	ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList) const
+{
+	auto geo = CreateGeometryWithoutBuffers(name);
+
+	geo->VertexBufferGPU = DxUtil::CreateDefaultBuffer(device, cmdList,
+		GetVertexData(), geo->VertexBufferByteSize, geo->VertexBufferUploader);
+
+	geo->IndexBufferGPU = DxUtil::CreateDefaultBuffer(device, cmdList,
+		GetIndexData(), geo->IndexBufferByteSize, geo->IndexBufferUploader);
+
+	return geo;
+}
+
+std::unique_ptr<MeshGeometry> MeshFile::CreateGeometry(const std::string& name, UploadBatcher& uploader) const
+{
+	auto geo = CreateGeometryWithoutBuffers(name);
+
+	geo->VertexBufferGPU = uploader.CreateDefaultBuffer(GetVertexData(), geo->VertexBufferByteSize);
+	geo->IndexBufferGPU = uploader.CreateDefaultBuffer(GetIndexData(), geo->IndexBufferByteSize);
+
+	return geo;
+}
+
+std::unique_ptr<MeshGeometry> MeshFile::CreateGeometryWithoutBuffers(const std::string& name) const
+{
+	assert(IsOpen());
+
+	const UINT vbByteSize = GetVertexBufferByteSize();
+	const UINT ibByteSize = GetIndexBufferByteSize();
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), GetVertexData(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), GetIndexData(), ibByteSize);
+
+	geo->VertexByteStride = GetVertexByteStride();
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = GetIndexFormat();
+	geo->IndexBufferByteSize = ibByteSize;
+
+	for (UINT i = 0; i < GetSubmeshCount(); ++i)
+	{
+		const MeshFileSubmesh& fileSubmesh = GetSubmesh(i);
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = fileSubmesh.IndexCount;
+		submesh.StartIndexLocation = fileSubmesh.StartIndexLocation;
+		submesh.BaseVertexLocation = fileSubmesh.BaseVertexLocation;
+		submesh.Bounds = fileSubmesh.Bounds;
+
+		// Names are stored zero-padded but not necessarily zero-terminated.
+		geo->DrawArgs[std::string(fileSubmesh.Name, strnlen(fileSubmesh.Name, sizeof(fileSubmesh.Name)))] = submesh;
+	}
+
+	return geo;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "DxUtil.h"
+#include "MappedFile.h"
+#include "UploadBatcher.h"
+
+// Entry of a mesh file's submesh table.
+struct MeshFileSubmesh
+{
+	char Name[32] = {};
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	INT BaseVertexLocation = 0;
+	DirectX::BoundingBox Bounds;
+
+	// Truncates names that do not fit.
+	void SetName(const std::string& name);
+};
+
+// Binary cache of a fully built mesh: a versioned header, the submesh table, and
+// the vertex and index data exactly as they go into the GPU buffers.  Models in
+// the book's text format are converted into one the first time they are loaded;
+// later runs map the file and skip parsing, texture coordinate and bounds
+// generation entirely.
+//
+// The file does not describe the vertex layout beyond its stride, so each layout
+// built from the same model needs a file of its own.  A file also records the
+// size and write time of the model it was converted from and is treated as
+// stale once the model changes.
+class MeshFile
+{
+public:
+	static constexpr UINT Version = 1;
+
+	MeshFile() = default;
+	MeshFile(const MeshFile& rhs) = delete;
+	MeshFile& operator=(const MeshFile& rhs) = delete;
+
+	static bool Write(
+		const std::wstring& filename,
+		const std::wstring& sourceFilename,
+		const void* vertexData, UINT vertexByteStride, UINT vertexCount,
+		const void* indexData, DXGI_FORMAT indexFormat, UINT indexCount,
+		const std::vector<MeshFileSubmesh>& submeshes);
+
+	// Fails if the file is missing, malformed, of another version or vertex stride,
+	// or older than sourceFilename.  A missing source does not make the file stale.
+	bool Open(const std::wstring& filename, const std::wstring& sourceFilename, UINT vertexByteStride);
+	void Close();
+
+	bool IsOpen() const noexcept { return header != nullptr; }
+
+	const void* GetVertexData() const noexcept;
+	UINT GetVertexByteStride() const noexcept;
+	UINT GetVertexCount() const noexcept;
+	UINT GetVertexBufferByteSize() const noexcept;
+
+	const void* GetIndexData() const noexcept;
+	DXGI_FORMAT GetIndexFormat() const noexcept;
+	UINT GetIndexCount() const noexcept;
+	UINT GetIndexBufferByteSize() const noexcept;
+
+	UINT GetSubmeshCount() const noexcept;
+	const MeshFileSubmesh& GetSubmesh(UINT index) const noexcept;
+
+	// Builds a MeshGeometry with CPU copies, GPU buffers uploaded straight from the
+	// mapped file, and one DrawArgs entry per submesh.  The upload buffers are
+	// recorded on cmdList, so the file may be closed as soon as this returns.
+	std::unique_ptr<MeshGeometry> CreateGeometry(
+		const std::string& name,
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList) const;
+
+	// Same, but the GPU buffers are staged on uploader and filled when its next
+	// batch is recorded.  The file may be closed as soon as this returns.
+	std::unique_ptr<MeshGeometry> CreateGeometry(const std::string& name, UploadBatcher& uploader) const;
+
+private:
+	struct Header;
+
+	// Everything but the GPU buffers.
+	std::unique_ptr<MeshGeometry> CreateGeometryWithoutBuffers(const std::string& name) const;
+
+	MappedFile file;
+	const Header* header = nullptr;
+	const MeshFileSubmesh* submeshes = nullptr;
+};
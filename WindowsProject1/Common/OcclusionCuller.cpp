@@ -0,0 +1,509 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	// Binning jobs per thread; a few more than one evens out occluders of
+	// different sizes.
+	constexpr uint32_t BinsPerThread = 2;
+
+	uint32_t ReadIndex(const void* indexData, uint32_t indexByteSize, uint32_t i)
+	{
+		if (indexByteSize == 2)
+			return static_cast<const uint16_t*>(indexData)[i];
+		return static_cast<const uint32_t*>(indexData)[i];
+	}
+
+	XMFLOAT4 LerpClip(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+	{
+		XMFLOAT4 r;
+		XMStoreFloat4(&r, XMVectorLerp(XMLoadFloat4(&a), XMLoadFloat4(&b), t));
+		return r;
+	}
+
+	bool AnyTrue(FXMVECTOR mask)
+	{
+		return !XMVector4EqualInt(mask, XMVectorFalseInt());
+	}
+}
+
+OccluderMesh OccluderMesh::Simplify(
+	const void* vertexData, uint32_t vertexByteStride,
+	const void* indexData, uint32_t indexByteSize,
+	uint32_t indexCount, uint32_t startIndexLocation, int baseVertexLocation,
+	uint32_t gridResolution)
+{
+	assert(indexByteSize == 2 || indexByteSize == 4);
+	assert(gridResolution > 0);
+
+	const unsigned char* vertices = static_cast<const unsigned char*>(vertexData);
+	auto readPosition = [&](uint32_t index)
+	{
+		XMFLOAT3 p;
+		std::memcpy(&p, vertices + (size_t)((int)index + baseVertexLocation) * vertexByteStride, sizeof(XMFLOAT3));
+		return p;
+	};
+
+	XMVECTOR boundsMin = XMVectorReplicate(+FLT_MAX);
+	XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		const XMFLOAT3 p = readPosition(ReadIndex(indexData, indexByteSize, startIndexLocation + i));
+		boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&p));
+		boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&p));
+	}
+
+	// A flat axis has a single cell.
+	const XMVECTOR extent = XMVectorSubtract(boundsMax, boundsMin);
+	const XMVECTOR cellSize = XMVectorSelect(
+		XMVectorScale(extent, 1.0f / gridResolution), XMVectorReplicate(1.0f), XMVectorLessOrEqual(extent, XMVectorZero()));
+	const XMVECTOR invCellSize = XMVectorReciprocal(cellSize);
+
+	OccluderMesh mesh;
+	std::vector<XMFLOAT4> clusterSums;
+	std::unordered_map<uint64_t, uint32_t> clusterOfCell;
+	std::unordered_map<uint32_t, uint32_t> clusterOfVertex;
+
+	auto getCluster = [&](uint32_t index)
+	{
+		auto vertex = clusterOfVertex.find(index);
+		if (vertex != clusterOfVertex.end())
+			return vertex->second;
+
+		const XMFLOAT3 p = readPosition(index);
+		XMFLOAT3 cell;
+		XMStoreFloat3(&cell, XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&p), boundsMin), invCellSize));
+
+		const uint64_t maxCell = gridResolution - 1;
+		const uint64_t cx = std::min(maxCell, (uint64_t)std::max(cell.x, 0.0f));
+		const uint64_t cy = std::min(maxCell, (uint64_t)std::max(cell.y, 0.0f));
+		const uint64_t cz = std::min(maxCell, (uint64_t)std::max(cell.z, 0.0f));
+		const uint64_t key = cx + gridResolution * (cy + gridResolution * cz);
+
+		auto found = clusterOfCell.emplace(key, (uint32_t)clusterSums.size());
+		if (found.second)
+			clusterSums.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+
+		XMFLOAT4& sum = clusterSums[found.first->second];
+		sum.x += p.x;
+		sum.y += p.y;
+		sum.z += p.z;
+		sum.w += 1.0f;
+
+		clusterOfVertex.emplace(index, found.first->second);
+		return found.first->second;
+	};
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const uint32_t c0 = getCluster(ReadIndex(indexData, indexByteSize, startIndexLocation + i));
+		const uint32_t c1 = getCluster(ReadIndex(indexData, indexByteSize, startIndexLocation + i + 1));
+		const uint32_t c2 = getCluster(ReadIndex(indexData, indexByteSize, startIndexLocation + i + 2));
+		if (c0 == c1 || c1 == c2 || c2 == c0)
+			continue;
+
+		mesh.Indices.push_back(c0);
+		mesh.Indices.push_back(c1);
+		mesh.Indices.push_back(c2);
+	}
+
+	// Each cluster keeps the one of its own vertices nearest their average.  The
+	// average itself can leave the surface, say at the inside corner of an L;
+	// a vertex of the submesh never does.  Ties go to the lowest index so the
+	// result does not depend on the map's order.
+	std::vector<float> nearestDistanceSq(clusterSums.size(), FLT_MAX);
+	std::vector<uint32_t> nearestVertex(clusterSums.size(), 0);
+	for (const auto& vertex : clusterOfVertex)
+	{
+		const uint32_t c = vertex.second;
+		const XMFLOAT4& sum = clusterSums[c];
+		const XMFLOAT3 p = readPosition(vertex.first);
+		const XMVECTOR average = XMVectorScale(XMVectorSet(sum.x, sum.y, sum.z, 0.0f), 1.0f / sum.w);
+		const float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&p), average)));
+
+		if (distanceSq < nearestDistanceSq[c] || (distanceSq == nearestDistanceSq[c] && vertex.first < nearestVertex[c]))
+		{
+			nearestDistanceSq[c] = distanceSq;
+			nearestVertex[c] = vertex.first;
+		}
+	}
+
+	mesh.Positions.resize(clusterSums.size());
+	for (size_t c = 0; c < clusterSums.size(); ++c)
+		mesh.Positions[c] = readPosition(nearestVertex[c]);
+
+	return mesh;
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+{
+	SetResolution(width, height);
+}
+
+void OcclusionCuller::SetResolution(uint32_t newWidth, uint32_t newHeight)
+{
+	tileCountX = std::max(1u, (newWidth + TileWidth - 1) / TileWidth);
+	tileCountY = std::max(1u, (newHeight + TileHeight - 1) / TileHeight);
+	width = tileCountX * TileWidth;
+	height = tileCountY * TileHeight;
+
+	depth.assign((size_t)width * height, 1.0f);
+	tileMaxDepths.assign((size_t)tileCountX * tileCountY, 1.0f);
+	bRendered = false;
+}
+
+OcclusionCuller::MeshId OcclusionCuller::AddMesh(OccluderMesh mesh)
+{
+	meshes.push_back(std::move(mesh));
+	return (MeshId)meshes.size() - 1;
+}
+
+OcclusionCuller::OccluderId OcclusionCuller::AddOccluder(MeshId mesh, const XMFLOAT4X4& world)
+{
+	assert(mesh < meshes.size());
+
+	occluders.push_back(Occluder{ mesh, world });
+	return (OccluderId)occluders.size() - 1;
+}
+
+void OcclusionCuller::SetOccluderWorld(OccluderId occluder, const XMFLOAT4X4& world)
+{
+	occluders[occluder].World = world;
+}
+
+void OcclusionCuller::RenderOccluders(FXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&renderedViewProj, viewProj);
+
+	JobSystem& jobs = JobSystem::Default();
+	const uint32_t tileCount = tileCountX * tileCountY;
+	const uint32_t occluderCount = (uint32_t)occluders.size();
+	const uint32_t binCount = std::max(1u, std::min(occluderCount, jobs.GetConcurrency() * BinsPerThread));
+
+	bins.resize(binCount);
+
+	// Each job bins a contiguous run of occluders into a bin of its own, so no
+	// job writes where another one does.
+	jobs.ParallelFor(0, (int)binCount, 1, [&](int b)
+		{
+			Bin& bin = bins[b];
+			bin.Triangles.clear();
+			bin.TileTriangles.resize(tileCount);
+			for (auto& triangles : bin.TileTriangles)
+				triangles.clear();
+
+			const uint32_t first = (uint32_t)((uint64_t)occluderCount * b / binCount);
+			const uint32_t last = (uint32_t)((uint64_t)occluderCount * (b + 1) / binCount);
+			for (uint32_t i = first; i < last; ++i)
+				BinOccluder(occluders[i], viewProj, bin);
+		});
+
+	rasterizedTriangleCount = 0;
+	for (uint32_t b = 0; b < binCount; ++b)
+		rasterizedTriangleCount += (uint32_t)bins[b].Triangles.size();
+
+	// Every tile is cleared and drawn by one job, so the tiles need no locking.
+	jobs.ParallelFor(0, (int)tileCount, 1, [this](int tile) { RasterizeTile((uint32_t)tile); });
+
+	bRendered = true;
+}
+
+void OcclusionCuller::BinOccluder(const Occluder& occluder, FXMMATRIX viewProj, Bin& bin) const
+{
+	const OccluderMesh& mesh = meshes[occluder.Mesh];
+	const XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&occluder.World), viewProj);
+
+	bin.ClipPositions.resize(mesh.Positions.size());
+	for (size_t v = 0; v < mesh.Positions.size(); ++v)
+	{
+		const XMVECTOR position = XMVectorSetW(XMLoadFloat3(&mesh.Positions[v]), 1.0f);
+		XMStoreFloat4(&bin.ClipPositions[v], XMVector4Transform(position, worldViewProj));
+	}
+
+	for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+	{
+		XMFLOAT4 clip[3] =
+		{
+			bin.ClipPositions[mesh.Indices[i]],
+			bin.ClipPositions[mesh.Indices[i + 1]],
+			bin.ClipPositions[mesh.Indices[i + 2]]
+		};
+
+		// Entirely beyond one side of the view.
+		if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+			(clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+			(clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+			(clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w))
+		{
+			continue;
+		}
+
+		const int behindCount = (clip[0].z < 0.0f) + (clip[1].z < 0.0f) + (clip[2].z < 0.0f);
+		if (behindCount == 3)
+			continue;
+
+		if (behindCount == 0)
+		{
+			SetupTriangle(clip, bin);
+			continue;
+		}
+
+		// Clip against the near plane, z = 0, into a polygon of three or four
+		// vertices and draw it as a fan.
+		XMFLOAT4 polygon[4];
+		int polygonSize = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			const XMFLOAT4& a = clip[k];
+			const XMFLOAT4& b = clip[(k + 1) % 3];
+
+			if (a.z >= 0.0f)
+				polygon[polygonSize++] = a;
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+				polygon[polygonSize++] = LerpClip(a, b, a.z / (a.z - b.z));
+		}
+
+		for (int k = 1; k + 1 < polygonSize; ++k)
+		{
+			const XMFLOAT4 fan[3] = { polygon[0], polygon[k], polygon[k + 1] };
+			SetupTriangle(fan, bin);
+		}
+	}
+}
+
+void OcclusionCuller::SetupTriangle(const XMFLOAT4* clip, Bin& bin) const
+{
+	float x[3];
+	float y[3];
+	float z[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		const float invW = 1.0f / clip[k].w;
+		x[k] = (clip[k].x * invW * 0.5f + 0.5f) * width;
+		y[k] = (0.5f - clip[k].y * invW * 0.5f) * height;
+		z[k] = clip[k].z * invW;
+	}
+
+	// With y pointing down, clockwise triangles, the front faces, have a positive
+	// area.
+	const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f))
+		return;
+
+	const float minX = std::max(std::min({ x[0], x[1], x[2] }), 0.0f);
+	const float maxX = std::min(std::max({ x[0], x[1], x[2] }), (float)width - 1.0f);
+	const float minY = std::max(std::min({ y[0], y[1], y[2] }), 0.0f);
+	const float maxY = std::min(std::max({ y[0], y[1], y[2] }), (float)height - 1.0f);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// Each edge is set up from its endpoints in a fixed order, so the two
+	// triangles sharing it get exactly opposite equations and every pixel center
+	// on it lands in one of them.
+	Triangle triangle;
+	for (int k = 0; k < 3; ++k)
+	{
+		const int j = (k + 1) % 3;
+		const bool bSwap = x[k] > x[j] || (x[k] == x[j] && y[k] > y[j]);
+		const int from = bSwap ? j : k;
+		const int to = bSwap ? k : j;
+		const float sign = bSwap ? -1.0f : 1.0f;
+
+		const float a = y[from] - y[to];
+		const float b = x[to] - x[from];
+		const float c = -(a * x[from] + b * y[from]);
+		triangle.EdgeA[k] = sign * a;
+		triangle.EdgeB[k] = sign * b;
+		triangle.EdgeC[k] = sign * c;
+	}
+
+	const float invArea = 1.0f / area;
+	triangle.DepthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * invArea;
+	triangle.DepthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * invArea;
+	triangle.DepthC = z[0] - triangle.DepthA * x[0] - triangle.DepthB * y[0];
+
+	triangle.MinX = (int)minX;
+	triangle.MinY = (int)minY;
+	triangle.MaxX = (int)maxX;
+	triangle.MaxY = (int)maxY;
+
+	const uint32_t index = (uint32_t)bin.Triangles.size();
+	bin.Triangles.push_back(triangle);
+
+	for (int tileY = triangle.MinY / (int)TileHeight; tileY <= triangle.MaxY / (int)TileHeight; ++tileY)
+	{
+		for (int tileX = triangle.MinX / (int)TileWidth; tileX <= triangle.MaxX / (int)TileWidth; ++tileX)
+			bin.TileTriangles[tileY * tileCountX + tileX].push_back(index);
+	}
+}
+
+void OcclusionCuller::RasterizeTile(uint32_t tile)
+{
+	const int tileMinX = (int)(tile % tileCountX * TileWidth);
+	const int tileMinY = (int)(tile / tileCountX * TileHeight);
+	const int tileMaxX = tileMinX + (int)TileWidth - 1;
+	const int tileMaxY = tileMinY + (int)TileHeight - 1;
+
+	for (int y = tileMinY; y <= tileMaxY; ++y)
+		std::fill_n(&depth[(size_t)y * width + tileMinX], TileWidth, 1.0f);
+
+	const XMVECTOR laneCenters = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+
+	for (const Bin& bin : bins)
+	{
+		for (uint32_t index : bin.TileTriangles[tile])
+		{
+			const Triangle& triangle = bin.Triangles[index];
+
+			// Whole groups of four pixels; the tile width is a multiple of four.
+			const int minX = std::max(triangle.MinX, tileMinX) & ~3;
+			const int maxX = std::min(triangle.MaxX, tileMaxX);
+			const int minY = std::max(triangle.MinY, tileMinY);
+			const int maxY = std::min(triangle.MaxY, tileMaxY);
+
+			const XMVECTOR edgeA0 = XMVectorReplicate(triangle.EdgeA[0]);
+			const XMVECTOR edgeA1 = XMVectorReplicate(triangle.EdgeA[1]);
+			const XMVECTOR edgeA2 = XMVectorReplicate(triangle.EdgeA[2]);
+			const XMVECTOR depthA = XMVectorReplicate(triangle.DepthA);
+			const XMVECTOR stepX = XMVectorReplicate(4.0f);
+
+			for (int y = minY; y <= maxY; ++y)
+			{
+				const float centerY = y + 0.5f;
+				const XMVECTOR rowEdge0 = XMVectorReplicate(triangle.EdgeB[0] * centerY + triangle.EdgeC[0]);
+				const XMVECTOR rowEdge1 = XMVectorReplicate(triangle.EdgeB[1] * centerY + triangle.EdgeC[1]);
+				const XMVECTOR rowEdge2 = XMVectorReplicate(triangle.EdgeB[2] * centerY + triangle.EdgeC[2]);
+				const XMVECTOR rowDepth = XMVectorReplicate(triangle.DepthB * centerY + triangle.DepthC);
+
+				float* row = &depth[(size_t)y * width];
+				XMVECTOR centerX = XMVectorAdd(XMVectorReplicate((float)minX), laneCenters);
+				for (int x = minX; x <= maxX; x += 4, centerX = XMVectorAdd(centerX, stepX))
+				{
+					const XMVECTOR edge0 = XMVectorMultiplyAdd(edgeA0, centerX, rowEdge0);
+					const XMVECTOR edge1 = XMVectorMultiplyAdd(edgeA1, centerX, rowEdge1);
+					const XMVECTOR edge2 = XMVectorMultiplyAdd(edgeA2, centerX, rowEdge2);
+
+					const XMVECTOR inside = XMVectorAndInt(
+						XMVectorAndInt(XMVectorGreaterOrEqual(edge0, zero), XMVectorGreaterOrEqual(edge1, zero)),
+						XMVectorGreaterOrEqual(edge2, zero));
+					if (!AnyTrue(inside))
+						continue;
+
+					XMFLOAT4* pixels = reinterpret_cast<XMFLOAT4*>(row + x);
+					const XMVECTOR oldDepth = XMLoadFloat4(pixels);
+					const XMVECTOR newDepth = XMVectorMin(oldDepth, XMVectorMultiplyAdd(depthA, centerX, rowDepth));
+					XMStoreFloat4(pixels, XMVectorSelect(oldDepth, newDepth, inside));
+				}
+			}
+		}
+	}
+
+	XMVECTOR maxDepth = zero;
+	for (int y = tileMinY; y <= tileMaxY; ++y)
+	{
+		const float* row = &depth[(size_t)y * width];
+		for (int x = tileMinX; x <= tileMaxX; x += 4)
+			maxDepth = XMVectorMax(maxDepth, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x)));
+	}
+
+	XMFLOAT4 lanes;
+	XMStoreFloat4(&lanes, maxDepth);
+	tileMaxDepths[tile] = std::max(std::max(lanes.x, lanes.y), std::max(lanes.z, lanes.w));
+}
+
+bool OcclusionCuller::IsVisible(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax) const
+{
+	if (!bRendered)
+		return true;
+
+	const XMMATRIX viewProj = XMLoadFloat4x4(&renderedViewProj);
+
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	float minDepth = FLT_MAX;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const XMVECTOR position = XMVectorSet(
+			corner & 1 ? boxMax.x : boxMin.x,
+			corner & 2 ? boxMax.y : boxMin.y,
+			corner & 4 ? boxMax.z : boxMin.z,
+			1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(position, viewProj));
+
+		// Reaches in front of the near plane; the rectangle would be unbounded.
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return true;
+
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		const float y = (0.5f - clip.y * invW * 0.5f) * height;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, clip.z * invW);
+	}
+
+	// Every pixel the rectangle overlaps, not only those whose centers it covers.
+	const int rectMinX = (int)std::floor(std::max(minX, 0.0f));
+	const int rectMaxX = (int)std::ceil(std::min(maxX, (float)width)) - 1;
+	const int rectMinY = (int)std::floor(std::max(minY, 0.0f));
+	const int rectMaxY = (int)std::ceil(std::min(maxY, (float)height)) - 1;
+
+	// Off screen or past the far plane is for the frustum culler to decide.
+	if (rectMinX > rectMaxX || rectMinY > rectMaxY || minDepth > 1.0f)
+		return true;
+
+	const XMVECTOR boxDepth = XMVectorReplicate(minDepth);
+	const XMVECTOR laneOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+	const XMVECTOR rectFirst = XMVectorReplicate((float)rectMinX);
+	const XMVECTOR rectLast = XMVectorReplicate((float)rectMaxX);
+
+	for (int tileY = rectMinY / (int)TileHeight; tileY <= rectMaxY / (int)TileHeight; ++tileY)
+	{
+		for (int tileX = rectMinX / (int)TileWidth; tileX <= rectMaxX / (int)TileWidth; ++tileX)
+		{
+			// Everything in this tile is nearer than the box.
+			if (tileMaxDepths[tileY * tileCountX + tileX] < minDepth)
+				continue;
+
+			const int spanMinX = std::max(rectMinX, tileX * (int)TileWidth) & ~3;
+			const int spanMaxX = std::min(rectMaxX, (tileX + 1) * (int)TileWidth - 1);
+			const int spanMinY = std::max(rectMinY, tileY * (int)TileHeight);
+			const int spanMaxY = std::min(rectMaxY, (tileY + 1) * (int)TileHeight - 1);
+
+			for (int y = spanMinY; y <= spanMaxY; ++y)
+			{
+				const float* row = &depth[(size_t)y * width];
+				for (int x = spanMinX; x <= spanMaxX; x += 4)
+				{
+					// Lanes left or right of the rectangle do not count.
+					const XMVECTOR lanes = XMVectorAdd(XMVectorReplicate((float)x), laneOffsets);
+					const XMVECTOR inRect = XMVectorAndInt(
+						XMVectorGreaterOrEqual(lanes, rectFirst), XMVectorLessOrEqual(lanes, rectLast));
+
+					const XMVECTOR pixels = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+					if (AnyTrue(XMVectorAndInt(XMVectorGreaterOrEqual(pixels, boxDepth), inRect)))
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
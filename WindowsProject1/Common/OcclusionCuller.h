@@ -0,0 +1,134 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// Triangles of an occluder in its local space, usually a coarse copy of a render
+// mesh.
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<uint32_t> Indices;
+
+	// Simplifies a submesh by vertex clustering: the vertices are snapped to a
+	// grid of gridResolution cells along each axis of the submesh's bounds, every
+	// cell keeps the one of its vertices nearest their average, and triangles
+	// that collapse are dropped.  Positions are read from offset 0 of each
+	// vertex; indices are 2 or 4 bytes.  Every position kept is one of the
+	// submesh's own, so the result lies inside the original's convex hull and
+	// never reaches past the silhouette of a convex occluder such as a box or a
+	// column; it only shrinks towards the inside.
+	static OccluderMesh Simplify(
+		const void* vertexData, uint32_t vertexByteStride,
+		const void* indexData, uint32_t indexByteSize,
+		uint32_t indexCount, uint32_t startIndexLocation, int baseVertexLocation,
+		uint32_t gridResolution);
+};
+
+// Software occlusion culling against a small CPU depth buffer.
+//
+// RenderOccluders transforms the occluder triangles, clips them to the near
+// plane, drops back faces and bins the rest into screen tiles; the tiles are then
+// rasterized in parallel, four pixels at a time, each keeping the nearest depth
+// per pixel and the farthest depth of the whole tile.  IsVisible projects a world
+// box to a screen rectangle and its nearest depth and reports it hidden when every
+// pixel under the rectangle holds something nearer.  Tiles whose farthest depth is
+// already nearer than the box are settled without reading their pixels.
+//
+// Only pixels whose centers a triangle covers are written, and a box counts as
+// visible as soon as it touches the near plane, so errors lean towards drawing
+// too much.  Nothing here touches the GPU.
+class OcclusionCuller
+{
+public:
+	using MeshId = uint32_t;
+	using OccluderId = uint32_t;
+
+	// Tile size in pixels.  The buffer size is rounded up to whole tiles.
+	static constexpr uint32_t TileWidth = 32;
+	static constexpr uint32_t TileHeight = 16;
+
+	explicit OcclusionCuller(uint32_t width = 320, uint32_t height = 192);
+	OcclusionCuller(const OcclusionCuller& rhs) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller& rhs) = delete;
+
+	void SetResolution(uint32_t newWidth, uint32_t newHeight);
+
+	MeshId AddMesh(OccluderMesh mesh);
+	OccluderId AddOccluder(MeshId mesh, const DirectX::XMFLOAT4X4& world);
+	void SetOccluderWorld(OccluderId occluder, const DirectX::XMFLOAT4X4& world);
+
+	// Rasterizes every occluder as seen through viewProj, a row-vector
+	// view-projection matrix with 0 <= z <= w in clip space.
+	void RenderOccluders(DirectX::FXMMATRIX viewProj);
+
+	// False when the world-space box is hidden behind the occluders of the last
+	// RenderOccluders.  Safe to call from several threads at once.
+	bool IsVisible(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax) const;
+
+	uint32_t GetWidth() const noexcept { return width; }
+	uint32_t GetHeight() const noexcept { return height; }
+
+	// Nearest depth per pixel, row by row from the top, 1 where nothing was drawn.
+	const std::vector<float>& GetDepth() const noexcept { return depth; }
+
+	// Triangles that survived clipping and culling in the last RenderOccluders.
+	uint32_t GetRasterizedTriangleCount() const noexcept { return rasterizedTriangleCount; }
+
+private:
+	// A screen-space triangle ready for rasterization.  A pixel center (x, y) is
+	// inside when all three EdgeA * x + EdgeB * y + EdgeC are non-negative, and its
+	// depth is DepthA * x + DepthB * y + DepthC.
+	struct Triangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float DepthA;
+		float DepthB;
+		float DepthC;
+		int MinX;
+		int MinY;
+		int MaxX;
+		int MaxY;
+	};
+
+	// Triangles set up by one binning job, and for every tile the ones touching it.
+	struct Bin
+	{
+		std::vector<Triangle> Triangles;
+		std::vector<std::vector<uint32_t>> TileTriangles;
+		std::vector<DirectX::XMFLOAT4> ClipPositions;
+	};
+
+	struct Occluder
+	{
+		MeshId Mesh;
+		DirectX::XMFLOAT4X4 World;
+	};
+
+	void BinOccluder(const Occluder& occluder, DirectX::FXMMATRIX viewProj, Bin& bin) const;
+	void SetupTriangle(const DirectX::XMFLOAT4* clip, Bin& bin) const;
+	void RasterizeTile(uint32_t tile);
+
+	std::vector<OccluderMesh> meshes;
+	std::vector<Occluder> occluders;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t tileCountX = 0;
+	uint32_t tileCountY = 0;
+
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepths;
+
+	// Kept between frames to avoid reallocating.
+	std::vector<Bin> bins;
+
+	// Of the last RenderOccluders, for IsVisible.
+	DirectX::XMFLOAT4X4 renderedViewProj;
+	bool bRendered = false;
+	uint32_t rasterizedTriangleCount = 0;
+};
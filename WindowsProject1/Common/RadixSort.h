@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Stable LSD radix sort of entries by the low KeyBits bits of their Key member,
+// eight bits per pass.  One pass over the keys counts the digits of every pass,
+// and a pass whose digit every key shares is skipped, so keys that differ in a
+// few fields only cost a few passes.  scratch is working memory the caller keeps
+// between calls; entries may come back swapped with it.
+template<uint32_t KeyBits, typename Entry>
+void RadixSortByKey(std::vector<Entry>& entries, std::vector<Entry>& scratch)
+{
+	constexpr uint32_t RadixBits = 8;
+	constexpr uint32_t RadixCount = 1 << RadixBits;
+	constexpr uint32_t RadixPassCount = (KeyBits + RadixBits - 1) / RadixBits;
+
+	auto digitOf = [](const Entry& entry, uint32_t pass)
+	{
+		return static_cast<uint32_t>(entry.Key >> (pass * RadixBits)) & (RadixCount - 1);
+	};
+
+	const size_t count = entries.size();
+	if (count == 0)
+		return;
+
+	uint32_t histograms[RadixPassCount][RadixCount];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (const Entry& entry : entries)
+	{
+		for (uint32_t pass = 0; pass < RadixPassCount; ++pass)
+			++histograms[pass][digitOf(entry, pass)];
+	}
+
+	scratch.resize(count);
+	for (uint32_t pass = 0; pass < RadixPassCount; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+
+		const uint32_t firstDigit = digitOf(entries[0], pass);
+		if (histogram[firstDigit] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < RadixCount; ++digit)
+		{
+			const uint32_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (const Entry& entry : entries)
+			scratch[histogram[digitOf(entry, pass)]++] = entry;
+
+		entries.swap(scratch);
+	}
+}
@@ -0,0 +1,430 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace
+{
+	std::string FormatState(uint32_t state)
+	{
+		char text[16];
+		std::snprintf(text, sizeof(text), "0x%x", state);
+		return text;
+	}
+}
+
+RenderGraph::RenderGraph(uint32_t unorderedAccessState)
+	: unorderedAccessState(unorderedAccessState)
+{
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportResource(const std::string& name, uint32_t initialState, uint32_t finalState)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.bImported = true;
+	resource.InitialState = initialState;
+	resource.FinalState = finalState;
+	resources.push_back(resource);
+
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransient(const std::string& name, uint64_t byteSize, uint64_t alignment,
+	uint32_t memoryClass)
+{
+	assert(byteSize > 0 && alignment > 0);
+
+	Resource resource;
+	resource.Name = name;
+	resource.ByteSize = byteSize;
+	resource.Alignment = alignment;
+	resource.MemoryClass = memoryClass;
+	resources.push_back(resource);
+
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const std::string& name, bool bHasSideEffects)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.bHasSideEffects = bHasSideEffects;
+	passes.push_back(pass);
+
+	return static_cast<PassHandle>(passes.size() - 1);
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource, uint32_t state)
+{
+	AddAccess(pass, resource, state, false);
+}
+
+void RenderGraph::Write(PassHandle pass, ResourceHandle resource, uint32_t state)
+{
+	AddAccess(pass, resource, state, true);
+}
+
+void RenderGraph::Compile()
+{
+	schedule.clear();
+	finalTransitions.clear();
+	memorySlots.clear();
+
+	for (auto& resource : resources)
+	{
+		resource.FirstUse = InvalidHandle;
+		resource.LastUse = InvalidHandle;
+		resource.MemorySlot = InvalidHandle;
+	}
+
+	CullPasses();
+	ScheduleBarriers();
+	AssignMemorySlots();
+}
+
+void RenderGraph::Clear()
+{
+	resources.clear();
+	passes.clear();
+	schedule.clear();
+	finalTransitions.clear();
+	memorySlots.clear();
+}
+
+uint64_t RenderGraph::GetTransientByteSize() const noexcept
+{
+	uint64_t byteSize = 0;
+	for (const auto& resource : resources)
+	{
+		if (resource.MemorySlot != InvalidHandle)
+			byteSize += resource.ByteSize;
+	}
+	return byteSize;
+}
+
+uint64_t RenderGraph::GetAliasedByteSize() const noexcept
+{
+	uint64_t byteSize = 0;
+	for (const auto& slot : memorySlots)
+		byteSize += slot.ByteSize;
+	return byteSize;
+}
+
+size_t RenderGraph::GetBarrierBatchCount() const noexcept
+{
+	size_t count = finalTransitions.empty() ? 0 : 1;
+	for (const auto& scheduled : schedule)
+	{
+		if (!scheduled.Aliasings.empty() || !scheduled.Transitions.empty())
+			++count;
+	}
+	return count;
+}
+
+size_t RenderGraph::GetBarrierCount() const noexcept
+{
+	size_t count = finalTransitions.size();
+	for (const auto& scheduled : schedule)
+		count += scheduled.Aliasings.size() + scheduled.Transitions.size();
+	return count;
+}
+
+std::string RenderGraph::Dump() const
+{
+	std::string text = "Render graph: " + std::to_string(schedule.size()) + " of " +
+		std::to_string(passes.size()) + " passes, " + std::to_string(GetBarrierCount()) + " barriers in " +
+		std::to_string(GetBarrierBatchCount()) + " batches\n";
+
+	for (size_t i = 0; i < schedule.size(); ++i)
+	{
+		const ScheduledPass& scheduled = schedule[i];
+
+		for (const auto& aliasing : scheduled.Aliasings)
+		{
+			text += "    alias " + resources[aliasing.ResourceBefore].Name + " -> " +
+				resources[aliasing.ResourceAfter].Name + "\n";
+		}
+
+		for (const auto& transition : scheduled.Transitions)
+			text += "    " + FormatTransition(transition) + "\n";
+
+		for (ResourceHandle resource : scheduled.Activations)
+			text += "    activate " + resources[resource].Name + "\n";
+
+		text += "  " + std::to_string(i) + ": " + passes[scheduled.Pass].Name + "\n";
+	}
+
+	for (const auto& transition : finalTransitions)
+		text += "    " + FormatTransition(transition) + "\n";
+
+	for (const auto& pass : passes)
+	{
+		if (pass.bCulled)
+			text += "  culled: " + pass.Name + "\n";
+	}
+
+	for (const auto& resource : resources)
+	{
+		if (resource.bImported)
+			continue;
+
+		if (resource.MemorySlot == InvalidHandle)
+		{
+			text += "  transient " + resource.Name + ": unused\n";
+			continue;
+		}
+
+		text += "  transient " + resource.Name + ": " + std::to_string(resource.ByteSize) + " bytes, passes " +
+			std::to_string(resource.FirstUse) + "-" + std::to_string(resource.LastUse) + ", slot " +
+			std::to_string(resource.MemorySlot) + "\n";
+	}
+
+	if (!memorySlots.empty())
+	{
+		text += "  transient memory: " + std::to_string(GetAliasedByteSize()) + " bytes in " +
+			std::to_string(memorySlots.size()) + " slots, " + std::to_string(GetTransientByteSize()) +
+			" bytes without aliasing\n";
+	}
+
+	return text;
+}
+
+void RenderGraph::AddAccess(PassHandle pass, ResourceHandle resource, uint32_t state, bool bWrite)
+{
+	assert(pass < passes.size() && resource < resources.size());
+
+	// A resource used more than once by a pass is used in all the states at once.
+	for (auto& access : passes[pass].Accesses)
+	{
+		if (access.Resource == resource)
+		{
+			access.State |= state;
+			access.bWrite = access.bWrite || bWrite;
+			return;
+		}
+	}
+
+	Access access;
+	access.Resource = resource;
+	access.State = state;
+	access.bWrite = bWrite;
+	passes[pass].Accesses.push_back(access);
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk back from the end of the frame, where only the imported resources are
+	// still looked at.  A pass is needed if it writes something a later needed
+	// pass uses, and then everything it uses is needed too.
+	std::vector<bool> bNeeded(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i)
+		bNeeded[i] = resources[i].bImported;
+
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		Pass& pass = passes[i];
+
+		pass.bCulled = !pass.bHasSideEffects;
+		for (const auto& access : pass.Accesses)
+		{
+			if (access.bWrite && bNeeded[access.Resource])
+				pass.bCulled = false;
+		}
+
+		if (pass.bCulled)
+			continue;
+
+		for (const auto& access : pass.Accesses)
+			bNeeded[access.Resource] = true;
+	}
+}
+
+void RenderGraph::ScheduleBarriers()
+{
+	std::vector<uint32_t> states(resources.size());
+	std::vector<bool> bUsed(resources.size());
+
+	// What happened outside the graph is unknown, so imported resources count as
+	// just written.
+	std::vector<bool> bLastWritten(resources.size());
+
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		states[i] = resources[i].InitialState;
+		bUsed[i] = resources[i].bImported;
+		bLastWritten[i] = resources[i].bImported;
+	}
+
+	for (size_t i = 0; i < passes.size(); ++i)
+	{
+		if (passes[i].bCulled)
+			continue;
+
+		const uint32_t scheduleIndex = static_cast<uint32_t>(schedule.size());
+
+		ScheduledPass scheduled;
+		scheduled.Pass = static_cast<PassHandle>(i);
+
+		for (const auto& access : passes[i].Accesses)
+		{
+			Resource& resource = resources[access.Resource];
+			if (resource.FirstUse == InvalidHandle)
+				resource.FirstUse = scheduleIndex;
+			resource.LastUse = scheduleIndex;
+
+			const uint32_t state = states[access.Resource];
+
+			if (!bUsed[access.Resource])
+			{
+				// The transition into the first use state is added below, once the
+				// state the frame ends in is known.
+				resource.FirstUseState = access.State;
+				states[access.Resource] = access.State;
+				scheduled.Activations.push_back(access.Resource);
+			}
+			else if (state == access.State)
+			{
+				// Unordered accesses need a barrier between them if either writes.
+				if (state == unorderedAccessState && (access.bWrite || bLastWritten[access.Resource]))
+				{
+					Transition transition;
+					transition.Resource = access.Resource;
+					transition.StateBefore = state;
+					transition.StateAfter = state;
+					transition.bUnorderedAccess = true;
+					scheduled.Transitions.push_back(transition);
+				}
+			}
+			else if (!access.bWrite && !bLastWritten[access.Resource] &&
+				access.State != 0 && (access.State & ~state) == 0)
+			{
+				// Already in a read state that includes this one.
+			}
+			else
+			{
+				Transition transition;
+				transition.Resource = access.Resource;
+				transition.StateBefore = state;
+				transition.StateAfter = access.State;
+				scheduled.Transitions.push_back(transition);
+
+				states[access.Resource] = access.State;
+			}
+
+			bUsed[access.Resource] = true;
+			bLastWritten[access.Resource] = access.bWrite;
+		}
+
+		schedule.push_back(scheduled);
+	}
+
+	// A transient starts each frame in the state the last one left it in, which
+	// is also the state it is created in, so every frame runs the same barriers.
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		Resource& resource = resources[i];
+		if (resource.bImported || resource.FirstUse == InvalidHandle)
+			continue;
+
+		resource.InitialState = states[i];
+		resource.FinalState = states[i];
+		if (states[i] == resource.FirstUseState)
+			continue;
+
+		Transition transition;
+		transition.Resource = static_cast<ResourceHandle>(i);
+		transition.StateBefore = states[i];
+		transition.StateAfter = resource.FirstUseState;
+		schedule[resource.FirstUse].Transitions.push_back(transition);
+	}
+
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		if (!resources[i].bImported || states[i] == resources[i].FinalState)
+			continue;
+
+		Transition transition;
+		transition.Resource = static_cast<ResourceHandle>(i);
+		transition.StateBefore = states[i];
+		transition.StateAfter = resources[i].FinalState;
+		finalTransitions.push_back(transition);
+	}
+}
+
+void RenderGraph::AssignMemorySlots()
+{
+	std::vector<ResourceHandle> transients;
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		if (!resources[i].bImported && resources[i].FirstUse != InvalidHandle)
+			transients.push_back(static_cast<ResourceHandle>(i));
+	}
+
+	std::stable_sort(transients.begin(), transients.end(),
+		[this](ResourceHandle a, ResourceHandle b) { return resources[a].FirstUse < resources[b].FirstUse; });
+
+	// Greedy interval packing: each transient goes into the smallest slot of its
+	// memory class that is free by its first use and large enough, or else grows
+	// the largest free one, or else gets a new slot.
+	std::vector<std::vector<ResourceHandle>> occupants;
+	for (ResourceHandle handle : transients)
+	{
+		Resource& resource = resources[handle];
+
+		uint32_t bestFit = InvalidHandle;
+		uint32_t largest = InvalidHandle;
+		for (uint32_t slot = 0; slot < memorySlots.size(); ++slot)
+		{
+			if (memorySlots[slot].MemoryClass != resource.MemoryClass ||
+				resources[occupants[slot].back()].LastUse >= resource.FirstUse)
+				continue;
+
+			const uint64_t byteSize = memorySlots[slot].ByteSize;
+			if (byteSize >= resource.ByteSize && (bestFit == InvalidHandle || byteSize < memorySlots[bestFit].ByteSize))
+				bestFit = slot;
+			if (largest == InvalidHandle || byteSize > memorySlots[largest].ByteSize)
+				largest = slot;
+		}
+
+		uint32_t slot = bestFit != InvalidHandle ? bestFit : largest;
+		if (slot == InvalidHandle)
+		{
+			slot = static_cast<uint32_t>(memorySlots.size());
+			memorySlots.emplace_back();
+			memorySlots.back().MemoryClass = resource.MemoryClass;
+			occupants.emplace_back();
+		}
+
+		memorySlots[slot].ByteSize = std::max(memorySlots[slot].ByteSize, resource.ByteSize);
+		memorySlots[slot].Alignment = std::max(memorySlots[slot].Alignment, resource.Alignment);
+		occupants[slot].push_back(handle);
+		resource.MemorySlot = slot;
+	}
+
+	// A shared slot changes hands at the first use of each occupant, including
+	// the first one, which takes over from the last one of the previous frame.
+	for (const auto& slotOccupants : occupants)
+	{
+		if (slotOccupants.size() < 2)
+			continue;
+
+		for (size_t i = 0; i < slotOccupants.size(); ++i)
+		{
+			Aliasing aliasing;
+			aliasing.ResourceBefore = slotOccupants[(i + slotOccupants.size() - 1) % slotOccupants.size()];
+			aliasing.ResourceAfter = slotOccupants[i];
+			schedule[resources[aliasing.ResourceAfter].FirstUse].Aliasings.push_back(aliasing);
+		}
+	}
+}
+
+std::string RenderGraph::FormatTransition(const Transition& transition) const
+{
+	const std::string& name = resources[transition.Resource].Name;
+	if (transition.bUnorderedAccess)
+		return "uav " + name;
+
+	return name + " " + FormatState(transition.StateBefore) + " -> " + FormatState(transition.StateAfter);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Declares the passes of a frame and the resources they read and write, and
+// compiles them into a schedule:
+//
+// - passes whose results nothing uses are culled;
+// - the state transitions each pass needs are gathered into one batch that is
+//   submitted before it, and imported resources are put back into their final
+//   state in one batch at the end;
+// - transient resources whose lifetimes do not overlap are given the same memory
+//   slot, with an aliasing barrier where a slot changes hands;
+// - transients start each frame in the state they ended the last one in, and
+//   are transitioned from there to the state of their first use.
+//
+// States are plain bit masks the graph does not interpret, besides knowing which
+// one means unordered access; RenderGraphExecutor passes D3D12_RESOURCE_STATES
+// and records the schedule on a command list.  A graph with made-up states
+// compiles without a GPU.
+class RenderGraph
+{
+public:
+	using ResourceHandle = uint32_t;
+	using PassHandle = uint32_t;
+	static constexpr uint32_t InvalidHandle = UINT32_MAX;
+
+	struct Transition
+	{
+		ResourceHandle Resource = InvalidHandle;
+		uint32_t StateBefore = 0;
+		uint32_t StateAfter = 0;
+
+		// An unordered access barrier rather than a transition; both states are
+		// the unordered access state.
+		bool bUnorderedAccess = false;
+	};
+
+	// The memory of ResourceAfter was last used by ResourceBefore.  For the first
+	// resource of a slot that is the last one, from the previous frame.
+	struct Aliasing
+	{
+		ResourceHandle ResourceBefore = InvalidHandle;
+		ResourceHandle ResourceAfter = InvalidHandle;
+	};
+
+	// A pass that survived culling, with the barriers to submit before it.
+	// Activations are the transients it uses first: their contents are undefined
+	// after the barriers, so render targets and depth buffers among them must be
+	// discarded or cleared before the pass draws into them.
+	struct ScheduledPass
+	{
+		PassHandle Pass = InvalidHandle;
+		std::vector<Aliasing> Aliasings;
+		std::vector<Transition> Transitions;
+		std::vector<ResourceHandle> Activations;
+	};
+
+	struct MemorySlot
+	{
+		uint64_t ByteSize = 0;
+		uint64_t Alignment = 0;
+		uint32_t MemoryClass = 0;
+	};
+
+	explicit RenderGraph(uint32_t unorderedAccessState);
+
+	// A resource that lives outside the graph.  It is in initialState when the
+	// graph starts and is returned to finalState at the end.
+	ResourceHandle ImportResource(const std::string& name, uint32_t initialState, uint32_t finalState);
+
+	// A resource that only lives within the graph.  Its contents are undefined
+	// before its first pass, which must overwrite it fully.  It is in the same
+	// state at the start and at the end of the graph, so frames chain without
+	// extra barriers.  Only transients of the same memory class share memory.
+	ResourceHandle CreateTransient(const std::string& name, uint64_t byteSize, uint64_t alignment,
+		uint32_t memoryClass = 0);
+
+	// Passes run in the order they are added.  A pass with side effects is never
+	// culled, nor is one that writes an imported resource.
+	PassHandle AddPass(const std::string& name, bool bHasSideEffects = false);
+
+	// The pass uses the resource in state.  Using a resource in more than one
+	// state in a pass combines the states.  Writes are taken to keep what they do
+	// not overwrite, so they depend on earlier writes as well.
+	void Read(PassHandle pass, ResourceHandle resource, uint32_t state);
+	void Write(PassHandle pass, ResourceHandle resource, uint32_t state);
+
+	void Compile();
+
+	// Forgets every pass and resource.
+	void Clear();
+
+	const std::vector<ScheduledPass>& GetSchedule() const noexcept { return schedule; }
+	const std::vector<Transition>& GetFinalTransitions() const noexcept { return finalTransitions; }
+
+	const std::vector<MemorySlot>& GetMemorySlots() const noexcept { return memorySlots; }
+
+	// InvalidHandle for imported resources and for transients no pass uses.
+	uint32_t GetMemorySlot(ResourceHandle resource) const noexcept { return resources[resource].MemorySlot; }
+
+	// State the resource is in when the graph starts.  For a transient that is
+	// the state it is left in at the end, which it should be created in.
+	uint32_t GetInitialState(ResourceHandle resource) const noexcept { return resources[resource].InitialState; }
+
+	// State a transient is used in by its first pass.
+	uint32_t GetFirstUseState(ResourceHandle resource) const noexcept { return resources[resource].FirstUseState; }
+
+	bool IsImported(ResourceHandle resource) const noexcept { return resources[resource].bImported; }
+	bool IsCulled(PassHandle pass) const noexcept { return passes[pass].bCulled; }
+
+	size_t GetResourceCount() const noexcept { return resources.size(); }
+	size_t GetPassCount() const noexcept { return passes.size(); }
+	const std::string& GetResourceName(ResourceHandle resource) const noexcept { return resources[resource].Name; }
+	const std::string& GetPassName(PassHandle pass) const noexcept { return passes[pass].Name; }
+
+	// Bytes the transients would take each in its own memory, and what the memory
+	// slots take.
+	uint64_t GetTransientByteSize() const noexcept;
+	uint64_t GetAliasedByteSize() const noexcept;
+
+	// Number of barrier submissions and of barriers in the schedule.
+	size_t GetBarrierBatchCount() const noexcept;
+	size_t GetBarrierCount() const noexcept;
+
+	// Human readable schedule: the passes in order with their barriers, the
+	// culled passes, and the transients with their lifetimes and memory slots.
+	std::string Dump() const;
+
+private:
+	struct Resource
+	{
+		std::string Name;
+		bool bImported = false;
+		uint32_t InitialState = 0;
+		uint32_t FinalState = 0;
+		uint32_t FirstUseState = 0;
+		uint64_t ByteSize = 0;
+		uint64_t Alignment = 0;
+		uint32_t MemoryClass = 0;
+
+		// Live passes, in schedule order, that use the resource first and last.
+		uint32_t FirstUse = InvalidHandle;
+		uint32_t LastUse = InvalidHandle;
+		uint32_t MemorySlot = InvalidHandle;
+	};
+
+	struct Access
+	{
+		ResourceHandle Resource = InvalidHandle;
+		uint32_t State = 0;
+		bool bWrite = false;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		bool bHasSideEffects = false;
+		bool bCulled = false;
+		std::vector<Access> Accesses;
+	};
+
+	void AddAccess(PassHandle pass, ResourceHandle resource, uint32_t state, bool bWrite);
+
+	void CullPasses();
+	void ScheduleBarriers();
+	void AssignMemorySlots();
+
+	std::string FormatTransition(const Transition& transition) const;
+
+	uint32_t unorderedAccessState = 0;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+
+	std::vector<ScheduledPass> schedule;
+	std::vector<Transition> finalTransitions;
+	std::vector<MemorySlot> memorySlots;
+};
@@ -0,0 +1,197 @@
+#include "RenderGraphExecutor.h"
+
+#include <cassert>
+
+namespace
+{
+	// Render targets and depth buffers on shared memory must be initialized once
+	// they take over the memory.  A discard does that without writing anything,
+	// but only in the state the pass draws or writes in; a pass using one first
+	// in another state must overwrite it fully, by a copy for example.
+	bool CanDiscard(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES state)
+	{
+		if ((desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) == 0)
+			return false;
+
+		return state == D3D12_RESOURCE_STATE_RENDER_TARGET ||
+			state == D3D12_RESOURCE_STATE_DEPTH_WRITE ||
+			(state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS &&
+				(desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS) != 0);
+	}
+}
+
+RenderGraphExecutor::RenderGraphExecutor(ID3D12Device* device, GpuHeapAllocator* heapAllocator)
+	: device(device),
+	heapAllocator(heapAllocator),
+	graph(D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+{
+}
+
+RenderGraphExecutor::~RenderGraphExecutor()
+{
+	ReleaseTransients();
+}
+
+RenderGraph::ResourceHandle RenderGraphExecutor::ImportResource(const std::string& name,
+	D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState)
+{
+	const RenderGraph::ResourceHandle handle = graph.ImportResource(name, initialState, finalState);
+
+	transientDescs.emplace_back();
+	transients.emplace_back();
+	d3dResources.push_back(nullptr);
+
+	return handle;
+}
+
+RenderGraph::ResourceHandle RenderGraphExecutor::CreateTransient(const std::string& name,
+	const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* optimizedClearValue)
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO info = heapAllocator->GetAllocationInfo(&desc, 1);
+	const RenderGraph::ResourceHandle handle = graph.CreateTransient(name, info.SizeInBytes, info.Alignment,
+		static_cast<uint32_t>(GpuHeapAllocator::GetCategory(desc)));
+
+	TransientDesc transientDesc;
+	transientDesc.Desc = desc;
+	if (optimizedClearValue != nullptr)
+	{
+		transientDesc.ClearValue = *optimizedClearValue;
+		transientDesc.bHasClearValue = true;
+	}
+
+	transientDescs.push_back(transientDesc);
+	transients.emplace_back();
+	d3dResources.push_back(nullptr);
+
+	return handle;
+}
+
+RenderGraph::PassHandle RenderGraphExecutor::AddPass(const std::string& name, PassCallback callback, bool bHasSideEffects)
+{
+	callbacks.push_back(std::move(callback));
+	return graph.AddPass(name, bHasSideEffects);
+}
+
+void RenderGraphExecutor::Compile()
+{
+	ReleaseTransients();
+
+	graph.Compile();
+
+	for (const auto& slot : graph.GetMemorySlots())
+	{
+		D3D12_RESOURCE_ALLOCATION_INFO info;
+		info.SizeInBytes = slot.ByteSize;
+		info.Alignment = slot.Alignment;
+
+		slotMemory.push_back(heapAllocator->Allocate(D3D12_HEAP_TYPE_DEFAULT,
+			static_cast<GpuResourceCategory>(slot.MemoryClass), info));
+	}
+
+	for (RenderGraph::ResourceHandle handle = 0; handle < graph.GetResourceCount(); ++handle)
+	{
+		const uint32_t slot = graph.GetMemorySlot(handle);
+		if (slot == RenderGraph::InvalidHandle)
+			continue;
+
+		const TransientDesc& transientDesc = transientDescs[handle];
+		transients[handle] = heapAllocator->CreatePlacedResource(
+			slotMemory[slot],
+			transientDesc.Desc,
+			static_cast<D3D12_RESOURCE_STATES>(graph.GetInitialState(handle)),
+			transientDesc.bHasClearValue ? &transientDesc.ClearValue : nullptr);
+
+		d3dResources[handle] = transients[handle].Get();
+	}
+}
+
+void RenderGraphExecutor::Clear()
+{
+	ReleaseTransients();
+
+	graph.Clear();
+	callbacks.clear();
+	transientDescs.clear();
+	transients.clear();
+	d3dResources.clear();
+}
+
+void RenderGraphExecutor::SetImportedResource(RenderGraph::ResourceHandle resource, ID3D12Resource* d3dResource)
+{
+	assert(graph.IsImported(resource));
+	d3dResources[resource] = d3dResource;
+}
+
+ID3D12Resource* RenderGraphExecutor::GetResource(RenderGraph::ResourceHandle resource) const
+{
+	return d3dResources[resource];
+}
+
+void RenderGraphExecutor::Execute(ID3D12GraphicsCommandList* cmdList)
+{
+	for (const auto& scheduled : graph.GetSchedule())
+	{
+		barriers.clear();
+
+		for (const auto& aliasing : scheduled.Aliasings)
+		{
+			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(
+				d3dResources[aliasing.ResourceBefore],
+				d3dResources[aliasing.ResourceAfter]));
+		}
+
+		for (const auto& transition : scheduled.Transitions)
+			AppendTransition(transition);
+
+		if (!barriers.empty())
+			cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+		for (RenderGraph::ResourceHandle handle : scheduled.Activations)
+		{
+			if (CanDiscard(transientDescs[handle].Desc,
+				static_cast<D3D12_RESOURCE_STATES>(graph.GetFirstUseState(handle))))
+				cmdList->DiscardResource(d3dResources[handle], nullptr);
+		}
+
+		callbacks[scheduled.Pass](cmdList);
+	}
+
+	barriers.clear();
+	for (const auto& transition : graph.GetFinalTransitions())
+		AppendTransition(transition);
+
+	if (!barriers.empty())
+		cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+}
+
+void RenderGraphExecutor::ReleaseTransients()
+{
+	for (RenderGraph::ResourceHandle handle = 0; handle < transients.size(); ++handle)
+	{
+		if (transients[handle] == nullptr)
+			continue;
+
+		transients[handle] = nullptr;
+		d3dResources[handle] = nullptr;
+	}
+
+	for (auto& memory : slotMemory)
+		heapAllocator->Free(memory);
+	slotMemory.clear();
+}
+
+void RenderGraphExecutor::AppendTransition(const RenderGraph::Transition& transition)
+{
+	ID3D12Resource* resource = d3dResources[transition.Resource];
+
+	if (transition.bUnorderedAccess)
+	{
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+		return;
+	}
+
+	barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+		resource,
+		static_cast<D3D12_RESOURCE_STATES>(transition.StateBefore),
+		static_cast<D3D12_RESOURCE_STATES>(transition.StateAfter)));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "DxUtil.h"
+#include "GpuHeapAllocator.h"
+#include "RenderGraph.h"
+
+#include <functional>
+#include <vector>
+
+// Runs a RenderGraph on a D3D12 command list.  States are D3D12_RESOURCE_STATES.
+// Transients are placed resources: Compile allocates one piece of memory per
+// memory slot of the graph from the GpuHeapAllocator and creates every transient
+// of the slot on it, so they exist, with their descriptors, for as long as the
+// graph is not compiled again.  Imported resources are looked up anew each frame
+// with SetImportedResource, since the back buffer changes.
+//
+// Execute submits the barriers of each pass as one ResourceBarrier call,
+// discards the render targets and depth buffers the pass uses first, and then
+// calls the pass.  Passes must leave the resources they use in the states they
+// declared.
+class RenderGraphExecutor
+{
+public:
+	using PassCallback = std::function<void(ID3D12GraphicsCommandList* cmdList)>;
+
+	RenderGraphExecutor(ID3D12Device* device, GpuHeapAllocator* heapAllocator);
+	~RenderGraphExecutor();
+	RenderGraphExecutor(const RenderGraphExecutor& rhs) = delete;
+	RenderGraphExecutor& operator=(const RenderGraphExecutor& rhs) = delete;
+
+	RenderGraph::ResourceHandle ImportResource(const std::string& name,
+		D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState);
+	RenderGraph::ResourceHandle ImportResource(const std::string& name, D3D12_RESOURCE_STATES state)
+	{
+		return ImportResource(name, state, state);
+	}
+
+	RenderGraph::ResourceHandle CreateTransient(const std::string& name,
+		const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* optimizedClearValue);
+
+	RenderGraph::PassHandle AddPass(const std::string& name, PassCallback callback, bool bHasSideEffects = false);
+
+	void Read(RenderGraph::PassHandle pass, RenderGraph::ResourceHandle resource, D3D12_RESOURCE_STATES state)
+	{
+		graph.Read(pass, resource, state);
+	}
+
+	void Write(RenderGraph::PassHandle pass, RenderGraph::ResourceHandle resource, D3D12_RESOURCE_STATES state)
+	{
+		graph.Write(pass, resource, state);
+	}
+
+	// Compiles the graph and creates its transients.
+	void Compile();
+
+	// Drops the passes, the resources and the memory of the transients.  The GPU
+	// must be done with them.
+	void Clear();
+
+	void SetImportedResource(RenderGraph::ResourceHandle resource, ID3D12Resource* d3dResource);
+
+	// Transients exist once the graph is compiled; imported resources are what
+	// was last set.
+	ID3D12Resource* GetResource(RenderGraph::ResourceHandle resource) const;
+
+	void Execute(ID3D12GraphicsCommandList* cmdList);
+
+	const RenderGraph& GetGraph() const noexcept { return graph; }
+
+private:
+	struct TransientDesc
+	{
+		D3D12_RESOURCE_DESC Desc = {};
+		D3D12_CLEAR_VALUE ClearValue = {};
+		bool bHasClearValue = false;
+	};
+
+	void ReleaseTransients();
+	void AppendTransition(const RenderGraph::Transition& transition);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	GpuHeapAllocator* heapAllocator = nullptr;
+
+	RenderGraph graph;
+	std::vector<PassCallback> callbacks;
+
+	// Indexed by resource handle.  Imported resources are not owned.
+	std::vector<TransientDesc> transientDescs;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> transients;
+	std::vector<ID3D12Resource*> d3dResources;
+
+	// One per memory slot.
+	std::vector<GpuHeapAllocator::Allocation> slotMemory;
+
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+};
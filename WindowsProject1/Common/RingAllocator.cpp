@@ -0,0 +1,87 @@
+#include "RingAllocator.h"
+
+#include <cassert>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+RingAllocator::RingAllocator(uint64_t capacity)
+	: capacity(capacity)
+{
+}
+
+uint64_t RingAllocator::Allocate(uint64_t byteSize, uint64_t alignment)
+{
+	assert(byteSize > 0 && alignment > 0);
+
+	if (byteSize > capacity || usedByteSize == capacity)
+		return InvalidOffset;
+
+	// An empty ring starts over at the beginning, where the most room is.
+	if (usedByteSize == 0)
+		head = tail = 0;
+
+	const uint64_t aligned = AlignUp(head, alignment);
+	uint64_t offset = InvalidOffset;
+	if (tail <= head)
+	{
+		// Free space runs from head to the end and from the start to tail.
+		if (aligned + byteSize <= capacity)
+			offset = aligned;
+		else if (byteSize <= tail)
+			offset = 0;
+	}
+	else if (aligned + byteSize <= tail)
+	{
+		offset = aligned;
+	}
+
+	if (offset == InvalidOffset)
+		return InvalidOffset;
+
+	// Padding, and the tail end skipped when wrapping, stay with this frame.
+	const uint64_t consumed = offset >= head ? offset + byteSize - head : capacity - head + byteSize;
+	head = offset + byteSize;
+	usedByteSize += consumed;
+	frameByteSize += consumed;
+
+	return offset;
+}
+
+void RingAllocator::FinishFrame(uint64_t fenceValue)
+{
+	assert(frames.empty() || frames.back().FenceValue <= fenceValue);
+
+	Frame frame;
+	frame.FenceValue = fenceValue;
+	frame.ByteSize = frameByteSize;
+	frames.push_back(frame);
+
+	frameByteSize = 0;
+}
+
+void RingAllocator::Reclaim(uint64_t completedFenceValue)
+{
+	while (!frames.empty() && frames.front().FenceValue <= completedFenceValue)
+	{
+		const uint64_t byteSize = frames.front().ByteSize;
+		tail = capacity > 0 ? (tail + byteSize) % capacity : 0;
+		usedByteSize -= byteSize;
+		frames.pop_front();
+	}
+}
+
+void RingAllocator::Reset(uint64_t capacity)
+{
+	this->capacity = capacity;
+	head = 0;
+	tail = 0;
+	usedByteSize = 0;
+	frameByteSize = 0;
+	frames.clear();
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Offset bookkeeping for a ring of transient GPU memory.  Allocations are carved
+// off linearly and wrap around at the end; everything allocated between two
+// FinishFrame calls belongs to that frame and is reclaimed at once when the
+// GPU has passed the frame's fence.
+//
+// It knows nothing about D3D: fences are plain increasing values, and Reclaim is
+// given the last completed one.  UploadRing puts it on top of a mapped upload
+// buffer, and a fake fence can drive it without a GPU.
+class RingAllocator
+{
+public:
+	static constexpr uint64_t InvalidOffset = UINT64_MAX;
+
+	explicit RingAllocator(uint64_t capacity = 0);
+
+	// Returns the offset of byteSize bytes aligned to alignment, which need not be
+	// a power of two, or InvalidOffset if the ring has no room for them until
+	// more frames are reclaimed.  An allocation never straddles the end of the
+	// ring; the tail end it skips counts as used until its frame is reclaimed.
+	uint64_t Allocate(uint64_t byteSize, uint64_t alignment);
+
+	// Closes the current frame: its allocations stay in use until a Reclaim with
+	// a completed value of at least fenceValue.
+	void FinishFrame(uint64_t fenceValue);
+
+	// Frees the finished frames whose fence value is at most completedFenceValue.
+	void Reclaim(uint64_t completedFenceValue);
+
+	// Forgets every allocation and starts over with the given capacity.  Only for
+	// when the memory behind the ring is replaced.
+	void Reset(uint64_t capacity);
+
+	uint64_t GetCapacity() const noexcept { return capacity; }
+	uint64_t GetUsedByteSize() const noexcept { return usedByteSize; }
+
+	// Bytes allocated since the last FinishFrame, alignment padding included.
+	uint64_t GetFrameByteSize() const noexcept { return frameByteSize; }
+
+	// Frames finished but not reclaimed yet.
+	size_t GetPendingFrameCount() const noexcept { return frames.size(); }
+
+private:
+	// Frames sit back to back in the ring, so a frame is reclaimed by moving tail
+	// past its bytes.
+	struct Frame
+	{
+		uint64_t FenceValue = 0;
+		uint64_t ByteSize = 0;
+	};
+
+	uint64_t capacity = 0;
+
+	// Allocations go at head; tail is where the oldest frame still in use starts.
+	uint64_t head = 0;
+	uint64_t tail = 0;
+	uint64_t usedByteSize = 0;
+	uint64_t frameByteSize = 0;
+
+	std::deque<Frame> frames;
+};
+
+// A RingAllocator over a block of memory that is replaced by a bigger one when a
+// frame runs out of room.  Block is whatever owns the memory: a mapped upload
+// buffer in UploadRing, plain memory in the tests.
+//
+// Allocations made before a grow still point into the old block, and frames in
+// flight, the current one included, may still read them.  The old block is only
+// destroyed once the fence of the frame that last used it has completed.
+template<typename Block>
+class GrowableRing
+{
+public:
+	using CreateBlockFn = std::function<std::unique_ptr<Block>(uint64_t byteSize)>;
+
+	struct Allocation
+	{
+		Block* OwnerBlock = nullptr;
+		uint64_t Offset = 0;
+	};
+
+	// Block sizes are rounded up to multiples of granularity.
+	GrowableRing(uint64_t byteSize, uint64_t granularity, CreateBlockFn createBlock)
+		: granularity(granularity),
+		createBlock(std::move(createBlock))
+	{
+		CreateBlock(std::max<uint64_t>(byteSize, 1));
+	}
+
+	GrowableRing(const GrowableRing& rhs) = delete;
+	GrowableRing& operator=(const GrowableRing& rhs) = delete;
+
+	// Grows to at least twice the capacity when the current block has no room.
+	Allocation Allocate(uint64_t byteSize, uint64_t alignment)
+	{
+		uint64_t offset = allocator.Allocate(byteSize, alignment);
+		if (offset == RingAllocator::InvalidOffset)
+		{
+			Grow(byteSize + alignment);
+			offset = allocator.Allocate(byteSize, alignment);
+		}
+
+		Allocation allocation;
+		allocation.OwnerBlock = block.get();
+		allocation.Offset = offset;
+		return allocation;
+	}
+
+	void FinishFrame(uint64_t fenceValue)
+	{
+		allocator.FinishFrame(fenceValue);
+
+		for (RetiredBlock& retired : retiredBlocks)
+		{
+			if (retired.FenceValue == 0)
+				retired.FenceValue = fenceValue;
+		}
+	}
+
+	void Reclaim(uint64_t completedFenceValue)
+	{
+		allocator.Reclaim(completedFenceValue);
+
+		retiredBlocks.erase(
+			std::remove_if(retiredBlocks.begin(), retiredBlocks.end(),
+				[completedFenceValue](const RetiredBlock& retired)
+				{
+					return retired.FenceValue != 0 && retired.FenceValue <= completedFenceValue;
+				}),
+			retiredBlocks.end());
+	}
+
+	Block& GetBlock() const noexcept { return *block; }
+	uint64_t GetCapacity() const noexcept { return allocator.GetCapacity(); }
+	uint64_t GetUsedByteSize() const noexcept { return allocator.GetUsedByteSize(); }
+
+	// Number of times the ring moved to a bigger block.
+	uint32_t GetGrowCount() const noexcept { return growCount; }
+
+	// Replaced blocks that frames in flight may still use.
+	size_t GetRetiredBlockCount() const noexcept { return retiredBlocks.size(); }
+
+private:
+	struct RetiredBlock
+	{
+		std::unique_ptr<Block> OwnerBlock;
+
+		// 0 until the frame that last used the block is finished.
+		uint64_t FenceValue = 0;
+	};
+
+	void CreateBlock(uint64_t byteSize)
+	{
+		byteSize = (byteSize + granularity - 1) / granularity * granularity;
+		block = createBlock(byteSize);
+		allocator.Reset(byteSize);
+	}
+
+	void Grow(uint64_t minimumByteSize)
+	{
+		RetiredBlock retired;
+		retired.OwnerBlock = std::move(block);
+		retiredBlocks.push_back(std::move(retired));
+
+		CreateBlock(std::max(2 * allocator.GetCapacity(), minimumByteSize));
+		++growCount;
+	}
+
+	uint64_t granularity;
+	CreateBlockFn createBlock;
+
+	std::unique_ptr<Block> block;
+	RingAllocator allocator;
+	std::vector<RetiredBlock> retiredBlocks;
+	uint32_t growCount = 0;
+};
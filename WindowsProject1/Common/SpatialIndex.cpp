@@ -0,0 +1,295 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace
+{
+	// Small leaves keep the tree shallow; a partially covered leaf costs a few
+	// box tests.
+	constexpr UINT LeafSize = 4;
+
+	// Inserted objects are tested one by one until there are more than this many,
+	// or more than one per this many objects in the tree, whichever is larger.
+	constexpr UINT MinRebuildPendingCount = 256;
+	constexpr UINT TreeEntriesPerPending = 64;
+
+	// Rebuild once refits have raised the surface area cost by this factor.
+	constexpr float MaxCostGrowth = 1.5f;
+
+	BvhAabb MakeAabb(const BoundingBox& box)
+	{
+		BvhAabb aabb;
+		aabb.Min = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+		aabb.Max = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+		return aabb;
+	}
+
+	BvhAabb EmptyAabb()
+	{
+		BvhAabb box;
+		box.Min = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		box.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		return box;
+	}
+
+	bool IsEmpty(const BvhAabb& box)
+	{
+		return box.Min.x > box.Max.x;
+	}
+
+	BvhOverlap TestFrustum(const SpatialIndex::Frustum& frustum, const BvhAabb& box)
+	{
+		const XMVECTOR boxMin = XMLoadFloat3(&box.Min);
+		const XMVECTOR boxMax = XMLoadFloat3(&box.Max);
+		const XMVECTOR center = XMVectorScale(XMVectorAdd(boxMin, boxMax), 0.5f);
+		const XMVECTOR extent = XMVectorScale(XMVectorSubtract(boxMax, boxMin), 0.5f);
+
+		// Outside when the box is entirely behind one plane, inside when it is
+		// entirely in front of all of them.
+		bool bInside = true;
+		for (const XMFLOAT4& p : frustum.Planes)
+		{
+			const XMVECTOR plane = XMLoadFloat4(&p);
+			const float distance = XMVectorGetX(XMVector3Dot(plane, center)) + p.w;
+			const float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), extent));
+
+			if (distance + radius < 0.0f)
+				return BvhOverlap::Outside;
+			if (distance - radius < 0.0f)
+				bInside = false;
+		}
+
+		return bInside ? BvhOverlap::Inside : BvhOverlap::Partial;
+	}
+
+	BvhOverlap TestBox(const BvhAabb& region, const BvhAabb& box)
+	{
+		if (box.Min.x > region.Max.x || box.Max.x < region.Min.x ||
+			box.Min.y > region.Max.y || box.Max.y < region.Min.y ||
+			box.Min.z > region.Max.z || box.Max.z < region.Min.z)
+		{
+			return BvhOverlap::Outside;
+		}
+
+		const bool bInside =
+			box.Min.x >= region.Min.x && box.Max.x <= region.Max.x &&
+			box.Min.y >= region.Min.y && box.Max.y <= region.Max.y &&
+			box.Min.z >= region.Min.z && box.Max.z <= region.Max.z;
+		return bInside ? BvhOverlap::Inside : BvhOverlap::Partial;
+	}
+
+	BvhOverlap TestSphere(FXMVECTOR center, float radius, const BvhAabb& box)
+	{
+		const XMVECTOR boxMin = XMLoadFloat3(&box.Min);
+		const XMVECTOR boxMax = XMLoadFloat3(&box.Max);
+		const float radiusSq = radius * radius;
+
+		// Nearest point of the box to the center, and the corner farthest from it.
+		const XMVECTOR nearest = XMVectorClamp(center, boxMin, boxMax);
+		if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(nearest, center))) > radiusSq)
+			return BvhOverlap::Outside;
+
+		const XMVECTOR farthest = XMVectorMax(
+			XMVectorAbs(XMVectorSubtract(boxMin, center)), XMVectorAbs(XMVectorSubtract(boxMax, center)));
+		if (XMVectorGetX(XMVector3LengthSq(farthest)) <= radiusSq)
+			return BvhOverlap::Inside;
+
+		return BvhOverlap::Partial;
+	}
+}
+
+SpatialIndex::Frustum SpatialIndex::Frustum::FromViewProj(FXMMATRIX viewProj)
+{
+	// Gribb/Hartmann plane extraction from the columns of the view-projection
+	// matrix.  DirectX clip space has 0 <= z <= w.
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, viewProj);
+
+	const XMVECTOR col0 = XMVectorSet(m._11, m._21, m._31, m._41);
+	const XMVECTOR col1 = XMVectorSet(m._12, m._22, m._32, m._42);
+	const XMVECTOR col2 = XMVectorSet(m._13, m._23, m._33, m._43);
+	const XMVECTOR col3 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	const XMVECTOR planes[6] =
+	{
+		XMVectorAdd(col3, col0),		// left
+		XMVectorSubtract(col3, col0),	// right
+		XMVectorAdd(col3, col1),		// bottom
+		XMVectorSubtract(col3, col1),	// top
+		col2,							// near
+		XMVectorSubtract(col3, col2)	// far
+	};
+
+	Frustum frustum;
+	for (int p = 0; p < 6; ++p)
+		XMStoreFloat4(&frustum.Planes[p], XMPlaneNormalize(planes[p]));
+
+	return frustum;
+}
+
+SpatialIndex::Handle SpatialIndex::Insert(const BoundingBox& worldBounds)
+{
+	if (freeHandles.empty())
+	{
+		bounds.push_back(MakeAabb(worldBounds));
+		bRemoved.push_back(0);
+		bMoved.push_back(0);
+		return (Handle)bounds.size() - 1;
+	}
+
+	// A handle that is still in the tree just moves back into place.
+	const Handle handle = freeHandles.back();
+	freeHandles.pop_back();
+
+	bRemoved[handle] = 0;
+	Move(handle, worldBounds);
+	return handle;
+}
+
+void SpatialIndex::Move(Handle handle, const BoundingBox& worldBounds)
+{
+	assert(handle < bounds.size() && !bRemoved[handle]);
+
+	bounds[handle] = MakeAabb(worldBounds);
+
+	if (handle < treeEntryCount && !bMoved[handle])
+	{
+		bMoved[handle] = 1;
+		movedHandles.push_back(handle);
+	}
+}
+
+void SpatialIndex::Remove(Handle handle)
+{
+	assert(handle < bounds.size() && !bRemoved[handle]);
+
+	bounds[handle] = EmptyAabb();
+	bRemoved[handle] = 1;
+	freeHandles.push_back(handle);
+
+	if (handle < treeEntryCount && !bMoved[handle])
+	{
+		bMoved[handle] = 1;
+		movedHandles.push_back(handle);
+	}
+}
+
+void SpatialIndex::Update()
+{
+	const UINT pendingCount = (UINT)bounds.size() - treeEntryCount;
+	if (pendingCount > std::max(MinRebuildPendingCount, treeEntryCount / TreeEntriesPerPending))
+	{
+		Rebuild();
+		return;
+	}
+
+	if (!movedHandles.empty())
+	{
+		bvh.RefitPrimitives(bounds.data(), movedHandles.data(), (UINT)movedHandles.size());
+
+		for (Handle handle : movedHandles)
+			bMoved[handle] = 0;
+		movedHandles.clear();
+	}
+
+	if (bvh.GetSurfaceAreaCost() > builtCost * MaxCostGrowth)
+		Rebuild();
+}
+
+void SpatialIndex::Rebuild()
+{
+	treeEntryCount = (UINT)bounds.size();
+	bvh.Build(bounds.data(), treeEntryCount, LeafSize);
+	builtCost = bvh.GetSurfaceAreaCost();
+
+	for (Handle handle : movedHandles)
+		bMoved[handle] = 0;
+	movedHandles.clear();
+}
+
+template<typename BoxTest>
+void SpatialIndex::Query(BoxTest&& testBox, std::vector<Handle>& results) const
+{
+	// Removed objects only need looking out for inside whole subtrees; their empty
+	// boxes fail every test otherwise.
+	const bool bAnyRemoved = !freeHandles.empty();
+	const std::vector<UINT>& order = bvh.GetPrimitiveOrder();
+
+	bvh.TraverseOverlap(
+		[&](const BvhNode& node)
+		{
+			BvhAabb box;
+			box.Min = node.BoundsMin;
+			box.Max = node.BoundsMax;
+			return IsEmpty(box) ? BvhOverlap::Outside : testBox(box);
+		},
+		[&](UINT first, UINT count, bool bInside)
+		{
+			for (UINT i = first; i < first + count; ++i)
+			{
+				const Handle handle = order[i];
+				if (bInside ? !(bAnyRemoved && bRemoved[handle])
+					: !IsEmpty(bounds[handle]) && testBox(bounds[handle]) != BvhOverlap::Outside)
+				{
+					results.push_back(handle);
+				}
+			}
+		});
+
+	for (Handle handle = treeEntryCount; handle < (Handle)bounds.size(); ++handle)
+	{
+		if (!IsEmpty(bounds[handle]) && testBox(bounds[handle]) != BvhOverlap::Outside)
+			results.push_back(handle);
+	}
+}
+
+void SpatialIndex::QueryFrustum(const Frustum& frustum, std::vector<Handle>& results) const
+{
+	Query([&frustum](const BvhAabb& box) { return TestFrustum(frustum, box); }, results);
+}
+
+void SpatialIndex::QueryFrustumCandidates(const Frustum& frustum, std::vector<Handle>& results,
+	std::vector<Handle>& candidates) const
+{
+	const std::vector<UINT>& order = bvh.GetPrimitiveOrder();
+
+	bvh.TraverseOverlap(
+		[&](const BvhNode& node)
+		{
+			BvhAabb box;
+			box.Min = node.BoundsMin;
+			box.Max = node.BoundsMax;
+			return IsEmpty(box) ? BvhOverlap::Outside : TestFrustum(frustum, box);
+		},
+		[&](UINT first, UINT count, bool bInside)
+		{
+			std::vector<Handle>& out = bInside ? results : candidates;
+			for (UINT i = first; i < first + count; ++i)
+			{
+				if (!bRemoved[order[i]])
+					out.push_back(order[i]);
+			}
+		});
+
+	for (Handle handle = treeEntryCount; handle < (Handle)bounds.size(); ++handle)
+	{
+		if (!bRemoved[handle])
+			candidates.push_back(handle);
+	}
+}
+
+void SpatialIndex::QueryBox(const BoundingBox& box, std::vector<Handle>& results) const
+{
+	const BvhAabb region = MakeAabb(box);
+	Query([&region](const BvhAabb& other) { return TestBox(region, other); }, results);
+}
+
+void SpatialIndex::QuerySphere(const BoundingSphere& sphere, std::vector<Handle>& results) const
+{
+	const XMVECTOR center = XMLoadFloat3(&sphere.Center);
+	const float radius = sphere.Radius;
+	Query([center, radius](const BvhAabb& box) { return TestSphere(center, radius, box); }, results);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Bvh.h"
+
+#include <vector>
+
+// Dynamic bounding volume hierarchy over the world bounds of scene objects, for
+// frustum culling, picking and proximity queries without visiting every object.
+//
+// Objects are handles that stay valid until they are removed.  A move only
+// changes the object's box; the next Update refits the nodes above the moved
+// objects and leaves the rest of the tree alone, so a mostly static scene pays
+// for what moved and not for its size.  Inserted objects are kept in a short
+// list queries test one by one until it is long enough to be worth a rebuild.
+// A rebuild also happens when refits have made the tree clearly worse than a
+// fresh one would be.
+class SpatialIndex
+{
+public:
+	using Handle = UINT;
+	static constexpr Handle InvalidHandle = UINT_MAX;
+
+	// World-space planes with the inner side where dot(n, p) + d >= 0.
+	struct Frustum
+	{
+		DirectX::XMFLOAT4 Planes[6];
+
+		static Frustum FromViewProj(DirectX::FXMMATRIX viewProj);
+	};
+
+	Handle Insert(const DirectX::BoundingBox& worldBounds);
+	void Move(Handle handle, const DirectX::BoundingBox& worldBounds);
+	void Remove(Handle handle);
+
+	// Applies the moves, inserts and removals made since the last call.
+	void Update();
+
+	// Builds the tree over every object from scratch.
+	void Rebuild();
+
+	// Queries reflect the tree as of the last Update, plus anything inserted
+	// since.  Results are appended, objects in one subtree next to each other.
+	void QueryFrustum(const Frustum& frustum, std::vector<Handle>& results) const;
+	void QueryBox(const DirectX::BoundingBox& box, std::vector<Handle>& results) const;
+	void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<Handle>& results) const;
+
+	// The tree walk of QueryFrustum without the per-object tests: objects under
+	// subtrees entirely inside go to results, and those of leaves the frustum
+	// only partly covers, along with the objects inserted since the last build,
+	// go to candidates for the caller to test in bulk.
+	void QueryFrustumCandidates(const Frustum& frustum, std::vector<Handle>& results,
+		std::vector<Handle>& candidates) const;
+
+	// Calls visit(handle, tMax) for every object whose box the ray enters before
+	// tMax, roughly nearest first.  The visitor runs the exact test and may lower
+	// tMax, which prunes the rest of the walk.
+	template<typename Visitor>
+	void QueryRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float& tMax, Visitor&& visit) const
+	{
+		const std::vector<UINT>& order = bvh.GetPrimitiveOrder();
+		bvh.TraverseRay(origin, direction, tMax, [&](UINT first, UINT count, float& leafTMax)
+			{
+				for (UINT i = first; i < first + count; ++i)
+				{
+					if (!bRemoved[order[i]])
+						visit(order[i], leafTMax);
+				}
+			});
+
+		const DirectX::XMVECTOR invDirection = Bvh::GetInverseDirection(direction);
+		for (Handle handle = treeEntryCount; handle < (Handle)bounds.size(); ++handle)
+		{
+			BvhNode box = {};
+			box.BoundsMin = bounds[handle].Min;
+			box.BoundsMax = bounds[handle].Max;
+
+			float tEntry = 0.0f;
+			if (!bRemoved[handle] && Bvh::IntersectNode(box, origin, invDirection, tMax, tEntry))
+				visit(handle, tMax);
+		}
+	}
+
+	const BvhAabb& GetBounds(Handle handle) const noexcept { return bounds[handle]; }
+	UINT GetObjectCount() const noexcept { return (UINT)bounds.size() - (UINT)freeHandles.size(); }
+
+private:
+	template<typename BoxTest>
+	void Query(BoxTest&& testBox, std::vector<Handle>& results) const;
+
+	Bvh bvh;
+
+	// By handle.  Handles from treeEntryCount on were inserted after the last
+	// build and are not in the tree yet.  A removed object keeps an empty box,
+	// which no query region overlaps, until its handle is reused.
+	std::vector<BvhAabb> bounds;
+	std::vector<unsigned char> bRemoved;
+	std::vector<unsigned char> bMoved;
+	UINT treeEntryCount = 0;
+
+	std::vector<Handle> movedHandles;
+	std::vector<Handle> freeHandles;
+
+	// Surface area cost of the tree right after it was built.
+	float builtCost = 0.0f;
+};
@@ -0,0 +1,325 @@
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Index of the lowest set bit; value must not be 0.
+	uint32_t LowestBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	// Index of the highest set bit; value must not be 0.
+	uint32_t HighestBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+	}
+}
+
+float TlsfAllocator::Stats::GetFragmentation() const noexcept
+{
+	const uint64_t freeByteSize = Capacity - UsedByteSize;
+	if (freeByteSize == 0)
+		return 0.0f;
+
+	return 1.0f - static_cast<float>(LargestFreeBlockByteSize) / static_cast<float>(freeByteSize);
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity, uint64_t granularity)
+	: granularity(granularity)
+{
+	// A granularity of at least 2 keeps the largest possible size class within
+	// FirstLevelCount.
+	assert(granularity >= 2 && (granularity & (granularity - 1)) == 0);
+	granularityLog2 = HighestBit(granularity);
+
+	Reset(capacity);
+}
+
+TlsfAllocator::Handle TlsfAllocator::Allocate(uint64_t byteSize, uint64_t alignment)
+{
+	assert(byteSize > 0 && alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	const uint64_t blockByteSize = AlignUp(byteSize, granularity);
+	if (blockByteSize > capacity)
+		return InvalidHandle;
+
+	// Offsets are multiples of the granularity, so a larger alignment needs at
+	// most alignment - granularity bytes in front.
+	const uint64_t searchByteSize = alignment > granularity
+		? blockByteSize + alignment - granularity
+		: blockByteSize;
+
+	uint32_t index = FindFreeBlock(searchByteSize);
+	if (index == InvalidHandle)
+		return InvalidHandle;
+
+	RemoveFree(index);
+
+	if (alignment > granularity)
+	{
+		const uint64_t padding = AlignUp(nodes[index].Offset, alignment) - nodes[index].Offset;
+		if (padding > 0)
+		{
+			// The block was free, so whatever comes before it is in use and the
+			// padding cannot be merged with anything.
+			const uint32_t rest = Split(index, padding);
+			InsertFree(index);
+			index = rest;
+		}
+	}
+
+	if (nodes[index].ByteSize > blockByteSize)
+		InsertFree(Split(index, blockByteSize));
+
+	usedByteSize += nodes[index].ByteSize;
+	peakUsedByteSize = std::max(peakUsedByteSize, usedByteSize);
+	++allocationCount;
+
+	return index;
+}
+
+void TlsfAllocator::Free(Handle handle)
+{
+	assert(handle < nodes.size() && !nodes[handle].bFree);
+
+	usedByteSize -= nodes[handle].ByteSize;
+	--allocationCount;
+
+	uint32_t index = handle;
+
+	const uint32_t prev = nodes[index].PrevPhysical;
+	if (prev != InvalidHandle && nodes[prev].bFree)
+	{
+		RemoveFree(prev);
+		Absorb(prev);
+		index = prev;
+	}
+
+	const uint32_t next = nodes[index].NextPhysical;
+	if (next != InvalidHandle && nodes[next].bFree)
+	{
+		RemoveFree(next);
+		Absorb(index);
+	}
+
+	InsertFree(index);
+}
+
+void TlsfAllocator::Reset(uint64_t capacity)
+{
+	this->capacity = capacity / granularity * granularity;
+
+	nodes.clear();
+	unusedNodes.clear();
+
+	firstLevelBitmap = 0;
+	std::fill(std::begin(secondLevelBitmaps), std::end(secondLevelBitmaps), 0u);
+	std::fill(&freeHeads[0][0], &freeHeads[0][0] + FirstLevelCount * SecondLevelCount, InvalidHandle);
+
+	usedByteSize = 0;
+	peakUsedByteSize = 0;
+	allocationCount = 0;
+	freeBlockCount = 0;
+
+	if (this->capacity > 0)
+	{
+		const uint32_t index = NewNode();
+		nodes[index].Offset = 0;
+		nodes[index].ByteSize = this->capacity;
+		InsertFree(index);
+	}
+}
+
+TlsfAllocator::Stats TlsfAllocator::GetStats() const
+{
+	Stats stats;
+	stats.Capacity = capacity;
+	stats.UsedByteSize = usedByteSize;
+	stats.PeakUsedByteSize = peakUsedByteSize;
+	stats.AllocationCount = allocationCount;
+	stats.FreeBlockCount = freeBlockCount;
+
+	// The largest free block is in the highest non-empty list, though not
+	// necessarily at its head.
+	if (firstLevelBitmap != 0)
+	{
+		const uint32_t firstLevel = HighestBit(firstLevelBitmap);
+		const uint32_t secondLevel = HighestBit(secondLevelBitmaps[firstLevel]);
+		for (uint32_t index = freeHeads[firstLevel][secondLevel]; index != InvalidHandle; index = nodes[index].NextFree)
+			stats.LargestFreeBlockByteSize = std::max(stats.LargestFreeBlockByteSize, nodes[index].ByteSize);
+	}
+
+	return stats;
+}
+
+void TlsfAllocator::MapSize(uint64_t byteSize, uint32_t& firstLevel, uint32_t& secondLevel) const noexcept
+{
+	const uint64_t units = byteSize >> granularityLog2;
+	if (units < SecondLevelCount)
+	{
+		firstLevel = 0;
+		secondLevel = static_cast<uint32_t>(units);
+		return;
+	}
+
+	const uint32_t highestBit = HighestBit(units);
+	firstLevel = highestBit - SecondLevelLog2 + 1;
+	secondLevel = static_cast<uint32_t>(units >> (highestBit - SecondLevelLog2)) - SecondLevelCount;
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint64_t byteSize) const noexcept
+{
+	// Round the size up to the next size class, so that every block of the
+	// class found is large enough.
+	uint64_t units = AlignUp(byteSize, granularity) >> granularityLog2;
+	if (units >= SecondLevelCount)
+		units += (1ull << (HighestBit(units) - SecondLevelLog2)) - 1;
+
+	uint32_t firstLevel;
+	uint32_t secondLevel;
+	MapSize(units << granularityLog2, firstLevel, secondLevel);
+	if (firstLevel >= FirstLevelCount)
+		return InvalidHandle;
+
+	uint32_t secondLevelBitmap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondLevelBitmap == 0)
+	{
+		if (firstLevel + 1 >= FirstLevelCount)
+			return InvalidHandle;
+
+		const uint64_t firstLevelBitmapAbove = firstLevelBitmap & (~0ull << (firstLevel + 1));
+		if (firstLevelBitmapAbove == 0)
+			return InvalidHandle;
+
+		firstLevel = LowestBit(firstLevelBitmapAbove);
+		secondLevelBitmap = secondLevelBitmaps[firstLevel];
+	}
+
+	return freeHeads[firstLevel][LowestBit(secondLevelBitmap)];
+}
+
+void TlsfAllocator::InsertFree(uint32_t index)
+{
+	uint32_t firstLevel;
+	uint32_t secondLevel;
+	MapSize(nodes[index].ByteSize, firstLevel, secondLevel);
+
+	Node& node = nodes[index];
+	node.bFree = true;
+	node.PrevFree = InvalidHandle;
+	node.NextFree = freeHeads[firstLevel][secondLevel];
+	if (node.NextFree != InvalidHandle)
+		nodes[node.NextFree].PrevFree = index;
+
+	freeHeads[firstLevel][secondLevel] = index;
+	firstLevelBitmap |= 1ull << firstLevel;
+	secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+	++freeBlockCount;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t index)
+{
+	uint32_t firstLevel;
+	uint32_t secondLevel;
+	MapSize(nodes[index].ByteSize, firstLevel, secondLevel);
+
+	Node& node = nodes[index];
+	if (node.PrevFree != InvalidHandle)
+		nodes[node.PrevFree].NextFree = node.NextFree;
+	if (node.NextFree != InvalidHandle)
+		nodes[node.NextFree].PrevFree = node.PrevFree;
+
+	if (freeHeads[firstLevel][secondLevel] == index)
+	{
+		freeHeads[firstLevel][secondLevel] = node.NextFree;
+		if (node.NextFree == InvalidHandle)
+		{
+			secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (secondLevelBitmaps[firstLevel] == 0)
+				firstLevelBitmap &= ~(1ull << firstLevel);
+		}
+	}
+
+	node.bFree = false;
+	node.PrevFree = InvalidHandle;
+	node.NextFree = InvalidHandle;
+	--freeBlockCount;
+}
+
+uint32_t TlsfAllocator::Split(uint32_t index, uint64_t byteSize)
+{
+	assert(byteSize < nodes[index].ByteSize);
+
+	// NewNode may move the nodes; take references only after it.
+	const uint32_t restIndex = NewNode();
+	Node& node = nodes[index];
+	Node& rest = nodes[restIndex];
+
+	rest.Offset = node.Offset + byteSize;
+	rest.ByteSize = node.ByteSize - byteSize;
+	rest.PrevPhysical = index;
+	rest.NextPhysical = node.NextPhysical;
+	if (rest.NextPhysical != InvalidHandle)
+		nodes[rest.NextPhysical].PrevPhysical = restIndex;
+
+	node.ByteSize = byteSize;
+	node.NextPhysical = restIndex;
+
+	return restIndex;
+}
+
+void TlsfAllocator::Absorb(uint32_t index)
+{
+	Node& node = nodes[index];
+	const uint32_t next = node.NextPhysical;
+
+	node.ByteSize += nodes[next].ByteSize;
+	node.NextPhysical = nodes[next].NextPhysical;
+	if (node.NextPhysical != InvalidHandle)
+		nodes[node.NextPhysical].PrevPhysical = index;
+
+	DeleteNode(next);
+}
+
+uint32_t TlsfAllocator::NewNode()
+{
+	if (!unusedNodes.empty())
+	{
+		const uint32_t index = unusedNodes.back();
+		unusedNodes.pop_back();
+		nodes[index] = Node();
+		return index;
+	}
+
+	nodes.emplace_back();
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void TlsfAllocator::DeleteNode(uint32_t index)
+{
+	unusedNodes.push_back(index);
+}
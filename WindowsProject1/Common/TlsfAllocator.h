@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit bookkeeping for a block of memory that lives
+// somewhere else.  Free blocks are kept in lists by size class, a power of two
+// split into 16 steps, and two levels of bitmaps find the first non-empty list
+// that is large enough, so Allocate and Free run in constant time whatever the
+// number of blocks.  Neighbouring free blocks are merged on Free.
+//
+// Like RingAllocator it knows nothing about D3D and hands out offsets only;
+// GpuHeapAllocator puts one on each ID3D12Heap.
+class TlsfAllocator
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle InvalidHandle = UINT32_MAX;
+
+	struct Stats
+	{
+		uint64_t Capacity = 0;
+		uint64_t UsedByteSize = 0;
+		uint64_t PeakUsedByteSize = 0;
+		uint64_t LargestFreeBlockByteSize = 0;
+		uint32_t AllocationCount = 0;
+		uint32_t FreeBlockCount = 0;
+
+		// 0 when all free memory is one block, approaching 1 as it is scattered
+		// over many small ones.
+		float GetFragmentation() const noexcept;
+	};
+
+	// Every block is a multiple of granularity, which must be a power of two.
+	explicit TlsfAllocator(uint64_t capacity = 0, uint64_t granularity = 256);
+
+	// Returns a handle to byteSize bytes at an offset aligned to alignment, or
+	// InvalidHandle if no free block can hold them.  Alignments up to the
+	// granularity cost nothing; larger ones are searched for with the worst case
+	// padding and the padding is given back as a free block.
+	Handle Allocate(uint64_t byteSize, uint64_t alignment);
+	void Free(Handle handle);
+
+	uint64_t GetOffset(Handle handle) const noexcept { return nodes[handle].Offset; }
+
+	// Size of the block, byteSize rounded up to the granularity.
+	uint64_t GetByteSize(Handle handle) const noexcept { return nodes[handle].ByteSize; }
+
+	// Forgets every allocation and starts over with the given capacity.
+	void Reset(uint64_t capacity);
+
+	uint64_t GetCapacity() const noexcept { return capacity; }
+	uint64_t GetUsedByteSize() const noexcept { return usedByteSize; }
+	uint32_t GetAllocationCount() const noexcept { return allocationCount; }
+	bool IsEmpty() const noexcept { return allocationCount == 0; }
+
+	Stats GetStats() const;
+
+private:
+	static constexpr uint32_t SecondLevelLog2 = 4;
+	static constexpr uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+	static constexpr uint32_t FirstLevelCount = 64 - SecondLevelLog2;
+
+	// Blocks sit in two lists at once: every block in address order, and free
+	// blocks in the list of their size class.
+	struct Node
+	{
+		uint64_t Offset = 0;
+		uint64_t ByteSize = 0;
+		uint32_t PrevPhysical = InvalidHandle;
+		uint32_t NextPhysical = InvalidHandle;
+		uint32_t PrevFree = InvalidHandle;
+		uint32_t NextFree = InvalidHandle;
+		bool bFree = false;
+	};
+
+	void MapSize(uint64_t byteSize, uint32_t& firstLevel, uint32_t& secondLevel) const noexcept;
+	uint32_t FindFreeBlock(uint64_t byteSize) const noexcept;
+
+	void InsertFree(uint32_t index);
+	void RemoveFree(uint32_t index);
+
+	// Cuts the block into one of byteSize and one of the rest, and returns the
+	// index of the rest.
+	uint32_t Split(uint32_t index, uint64_t byteSize);
+
+	// Merges the physical successor of the block into it.
+	void Absorb(uint32_t index);
+
+	uint32_t NewNode();
+	void DeleteNode(uint32_t index);
+
+	uint64_t capacity = 0;
+	uint64_t granularity = 0;
+	uint32_t granularityLog2 = 0;
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unusedNodes;
+
+	uint64_t firstLevelBitmap = 0;
+	uint32_t secondLevelBitmaps[FirstLevelCount] = {};
+	uint32_t freeHeads[FirstLevelCount][SecondLevelCount];
+
+	uint64_t usedByteSize = 0;
+	uint64_t peakUsedByteSize = 0;
+	uint32_t allocationCount = 0;
+	uint32_t freeBlockCount = 0;
+};
@@ -0,0 +1,273 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace DirectX;
+
+namespace
+{
+	const XMFLOAT3 UnitScale(1.0f, 1.0f, 1.0f);
+	const XMFLOAT4 IdentityRotation(0.0f, 0.0f, 0.0f, 1.0f);
+	const XMFLOAT3 ZeroTranslation(0.0f, 0.0f, 0.0f);
+	const XMFLOAT4X4 IdentityWorld(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Reorders per-slot values into the slots the new order gives their nodes.
+	template<typename T>
+	void Gather(std::vector<T>& values, const std::vector<TransformHierarchy::Node>& order,
+		const std::vector<uint32_t>& oldSlotOfNode)
+	{
+		std::vector<T> gathered(values.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			gathered[i] = values[oldSlotOfNode[order[i]]];
+		values.swap(gathered);
+	}
+}
+
+void TransformHierarchy::Reserve(size_t nodeCount)
+{
+	scales.reserve(nodeCount);
+	rotations.reserve(nodeCount);
+	translations.reserve(nodeCount);
+	worlds.reserve(nodeCount);
+	parentSlots.reserve(nodeCount);
+	nodeOfSlot.reserve(nodeCount);
+	childBegins.reserve(nodeCount);
+	childEnds.reserve(nodeCount);
+	slotOfNode.reserve(nodeCount);
+	parentNodes.reserve(nodeCount);
+	bQueued.reserve(nodeCount);
+	worldTransformOfNode.reserve(nodeCount);
+}
+
+TransformHierarchy::Node TransformHierarchy::AddNode(Node parent)
+{
+	return AddNode(parent, UnitScale, IdentityRotation, ZeroTranslation);
+}
+
+TransformHierarchy::Node TransformHierarchy::AddNode(Node parent, const XMFLOAT3& scale, const XMFLOAT4& rotation,
+	const XMFLOAT3& translation)
+{
+	assert(parent == InvalidNode || parent < parentNodes.size());
+
+	const Node node = static_cast<Node>(parentNodes.size());
+	const uint32_t slot = static_cast<uint32_t>(nodeOfSlot.size());
+
+	scales.push_back(scale);
+	rotations.push_back(rotation);
+	translations.push_back(translation);
+	worlds.push_back(IdentityWorld);
+	parentSlots.push_back(parent != InvalidNode ? slotOfNode[parent] : parent);
+	nodeOfSlot.push_back(node);
+	childBegins.push_back(slot);
+	childEnds.push_back(slot);
+
+	slotOfNode.push_back(slot);
+	parentNodes.push_back(parent);
+	bQueued.push_back(0);
+	worldTransformOfNode.push_back(InvalidNode);
+
+	bOrderDirty = true;
+	MarkDirty(node);
+	return node;
+}
+
+TransformHierarchy::Node TransformHierarchy::AddWorldSpaceNode(Node source, const XMFLOAT4X4& worldTransform)
+{
+	assert(source < parentNodes.size());
+
+	const Node node = AddNode(source);
+	worldTransformOfNode[node] = static_cast<uint32_t>(worldTransforms.size());
+	worldTransforms.push_back(worldTransform);
+	return node;
+}
+
+void TransformHierarchy::SetWorldTransform(Node node, const XMFLOAT4X4& worldTransform)
+{
+	assert(worldTransformOfNode[node] != InvalidNode);
+
+	worldTransforms[worldTransformOfNode[node]] = worldTransform;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetScale(Node node, const XMFLOAT3& scale)
+{
+	scales[slotOfNode[node]] = scale;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetRotation(Node node, const XMFLOAT4& rotation)
+{
+	rotations[slotOfNode[node]] = rotation;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetTranslation(Node node, const XMFLOAT3& translation)
+{
+	translations[slotOfNode[node]] = translation;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetLocal(Node node, const XMFLOAT3& scale, const XMFLOAT4& rotation,
+	const XMFLOAT3& translation)
+{
+	const uint32_t slot = slotOfNode[node];
+	scales[slot] = scale;
+	rotations[slot] = rotation;
+	translations[slot] = translation;
+	MarkDirty(node);
+}
+
+const std::vector<TransformHierarchy::Node>& TransformHierarchy::Update()
+{
+	updatedNodes.clear();
+
+	if (bOrderDirty)
+		RebuildOrder();
+
+	if (dirtyNodes.empty())
+		return updatedNodes;
+
+	// One run per level of every dirty subtree.  A node under another dirty node
+	// is left to that node's subtree, so no slot is in two runs.
+	dirtyRuns.clear();
+	for (Node node : dirtyNodes)
+	{
+		bool bCovered = false;
+		for (Node ancestor = parentNodes[node]; ancestor != InvalidNode; ancestor = parentNodes[ancestor])
+		{
+			if (bQueued[ancestor])
+			{
+				bCovered = true;
+				break;
+			}
+		}
+		if (bCovered)
+			continue;
+
+		uint32_t begin = slotOfNode[node];
+		uint32_t end = begin + 1;
+		while (begin < end)
+		{
+			dirtyRuns.emplace_back(begin, end);
+
+			const uint32_t nextBegin = childBegins[begin];
+			end = childEnds[end - 1];
+			begin = nextBegin;
+		}
+	}
+
+	for (Node node : dirtyNodes)
+		bQueued[node] = 0;
+	dirtyNodes.clear();
+
+	// In slot order every parent comes before its children, whichever run either
+	// is in.
+	std::sort(dirtyRuns.begin(), dirtyRuns.end());
+
+	for (const auto& run : dirtyRuns)
+	{
+		for (uint32_t slot = run.first; slot < run.second; ++slot)
+		{
+			ComputeWorld(slot);
+			updatedNodes.push_back(nodeOfSlot[slot]);
+		}
+	}
+
+	return updatedNodes;
+}
+
+void TransformHierarchy::MarkDirty(Node node)
+{
+	if (bQueued[node])
+		return;
+
+	bQueued[node] = 1;
+	dirtyNodes.push_back(node);
+}
+
+void TransformHierarchy::RebuildOrder()
+{
+	const uint32_t count = static_cast<uint32_t>(parentNodes.size());
+
+	// Children bucketed by parent, in the order they were added: after the prefix
+	// sum and the scatter, the children of node n are the entries from
+	// childOffsets[n] to childOffsets[n + 1].
+	childOffsets.assign(count + 2, 0);
+	for (Node node = 0; node < count; ++node)
+	{
+		if (parentNodes[node] != InvalidNode)
+			++childOffsets[parentNodes[node] + 2];
+	}
+	for (uint32_t i = 2; i < count + 2; ++i)
+		childOffsets[i] += childOffsets[i - 1];
+
+	children.resize(childOffsets[count + 1]);
+	for (Node node = 0; node < count; ++node)
+	{
+		if (parentNodes[node] != InvalidNode)
+			children[childOffsets[parentNodes[node] + 1]++] = node;
+	}
+
+	// Breadth first from the roots.
+	order.clear();
+	for (Node node = 0; node < count; ++node)
+	{
+		if (parentNodes[node] == InvalidNode)
+			order.push_back(node);
+	}
+
+	childBegins.resize(count);
+	childEnds.resize(count);
+	for (uint32_t slot = 0; slot < order.size(); ++slot)
+	{
+		const Node node = order[slot];
+
+		childBegins[slot] = static_cast<uint32_t>(order.size());
+		order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+		childEnds[slot] = static_cast<uint32_t>(order.size());
+	}
+	assert(order.size() == count);
+
+	Gather(scales, order, slotOfNode);
+	Gather(rotations, order, slotOfNode);
+	Gather(translations, order, slotOfNode);
+	Gather(worlds, order, slotOfNode);
+
+	nodeOfSlot = order;
+	for (uint32_t slot = 0; slot < count; ++slot)
+		slotOfNode[order[slot]] = slot;
+	for (uint32_t slot = 0; slot < count; ++slot)
+	{
+		const Node parent = parentNodes[order[slot]];
+		parentSlots[slot] = parent != InvalidNode ? slotOfNode[parent] : parent;
+	}
+
+	bOrderDirty = false;
+}
+
+void TransformHierarchy::ComputeWorld(uint32_t slot)
+{
+	// Scale * rotation * translation, built straight into the rows rather than
+	// through two matrix products.
+	const XMVECTOR scale = XMLoadFloat3(&scales[slot]);
+	XMMATRIX local = XMMatrixRotationQuaternion(XMLoadFloat4(&rotations[slot]));
+	local.r[0] = XMVectorMultiply(local.r[0], XMVectorSplatX(scale));
+	local.r[1] = XMVectorMultiply(local.r[1], XMVectorSplatY(scale));
+	local.r[2] = XMVectorMultiply(local.r[2], XMVectorSplatZ(scale));
+	local.r[3] = XMVectorSelect(g_XMIdentityR3, XMLoadFloat3(&translations[slot]), g_XMSelect1110);
+
+	const uint32_t parentSlot = parentSlots[slot];
+	if (parentSlot != InvalidNode)
+		local = XMMatrixMultiply(local, XMLoadFloat4x4(&worlds[parentSlot]));
+
+	const uint32_t worldTransform = worldTransformOfNode[nodeOfSlot[slot]];
+	if (worldTransform != InvalidNode)
+		local = XMMatrixMultiply(local, XMLoadFloat4x4(&worldTransforms[worldTransform]));
+
+	XMStoreFloat4x4(&worlds[slot], local);
+}
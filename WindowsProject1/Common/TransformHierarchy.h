@@ -0,0 +1,112 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Parent/child transforms of a scene.  Every node has a local scale, rotation
+// quaternion and translation, and Update composes them into world matrices,
+// world = local * parent world, for the nodes that changed since the last call.
+//
+// The local transforms and world matrices live in separate arrays ordered breadth
+// first, so each level of the hierarchy is one run of slots and the children of a
+// node are a run in the next level.  The part of a subtree that lies in one level
+// is then a single run as well, and propagating a change is a walk over a few runs
+// in slot order with every parent computed before its children.  Nodes nobody
+// touched are not visited at all; a hierarchy in which nothing changed costs
+// nothing to update.
+//
+// A world-space node follows another node through a matrix applied after that
+// node's world, world = local * source world * world transform, for copies of an
+// object such as its reflection in a mirror or its planar shadow, which scale,
+// rotation and translation cannot express.  It sits below its source, so it is
+// updated whenever the source moves.
+//
+// Nodes are handles that stay valid when slots are reordered.  Adding nodes only
+// appends them; the breadth-first order is rebuilt on the next Update.
+class TransformHierarchy
+{
+public:
+	using Node = uint32_t;
+	static constexpr Node InvalidNode = UINT32_MAX;
+
+	void Reserve(size_t nodeCount);
+
+	// The parent must already exist.  A new node is updated by the next Update.
+	Node AddNode(Node parent = InvalidNode);
+	Node AddNode(Node parent, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rotation,
+		const DirectX::XMFLOAT3& translation);
+
+	// A node whose world is the source's world times worldTransform.
+	Node AddWorldSpaceNode(Node source, const DirectX::XMFLOAT4X4& worldTransform);
+	void SetWorldTransform(Node node, const DirectX::XMFLOAT4X4& worldTransform);
+
+	void SetScale(Node node, const DirectX::XMFLOAT3& scale);
+	void SetRotation(Node node, const DirectX::XMFLOAT4& rotation);
+	void SetTranslation(Node node, const DirectX::XMFLOAT3& translation);
+	void SetLocal(Node node, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rotation,
+		const DirectX::XMFLOAT3& translation);
+
+	const DirectX::XMFLOAT3& GetScale(Node node) const noexcept { return scales[slotOfNode[node]]; }
+	const DirectX::XMFLOAT4& GetRotation(Node node) const noexcept { return rotations[slotOfNode[node]]; }
+	const DirectX::XMFLOAT3& GetTranslation(Node node) const noexcept { return translations[slotOfNode[node]]; }
+
+	// As of the last Update.
+	const DirectX::XMFLOAT4X4& GetWorld(Node node) const noexcept { return worlds[slotOfNode[node]]; }
+
+	Node GetParent(Node node) const noexcept { return parentNodes[node]; }
+	size_t GetNodeCount() const noexcept { return parentNodes.size(); }
+
+	// Recomputes the world matrices of the nodes changed since the last call and
+	// of everything below them.  Returns those nodes, parents before children, so
+	// the caller can copy just them into object constants or instance data.
+	const std::vector<Node>& Update();
+
+	// The nodes the last Update recomputed.
+	const std::vector<Node>& GetUpdatedNodes() const noexcept { return updatedNodes; }
+
+private:
+	void MarkDirty(Node node);
+	void RebuildOrder();
+	void ComputeWorld(uint32_t slot);
+
+	// By slot, breadth first.
+	std::vector<DirectX::XMFLOAT3> scales;
+	std::vector<DirectX::XMFLOAT4> rotations;
+	std::vector<DirectX::XMFLOAT3> translations;
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+	std::vector<uint32_t> parentSlots;
+	std::vector<Node> nodeOfSlot;
+
+	// The children of a slot are the slots from childBegins to childEnds.  A leaf
+	// has an empty run where its children would go, so the slots below a run of
+	// one level are the run from the first one's begin to the last one's end.
+	std::vector<uint32_t> childBegins;
+	std::vector<uint32_t> childEnds;
+
+	// By node.
+	std::vector<uint32_t> slotOfNode;
+	std::vector<Node> parentNodes;
+	std::vector<uint8_t> bQueued;
+
+	// Index into worldTransforms of a world-space node, or InvalidNode.
+	std::vector<uint32_t> worldTransformOfNode;
+	std::vector<DirectX::XMFLOAT4X4> worldTransforms;
+
+	// Nodes whose local transform changed, each at most once.
+	std::vector<Node> dirtyNodes;
+
+	// Nodes added since the order was last rebuilt; they sit after every ordered slot.
+	bool bOrderDirty = false;
+
+	// Scratch of Update and RebuildOrder, kept to avoid reallocating.
+	std::vector<std::pair<uint32_t, uint32_t>> dirtyRuns;
+	std::vector<uint32_t> childOffsets;
+	std::vector<Node> children;
+	std::vector<Node> order;
+
+	std::vector<Node> updatedNodes;
+};
@@ -0,0 +1,157 @@
+#include "UploadBatcher.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Uploads start on texture placement boundaries, so the arena could hold
+	// texture subresources as well as buffers.
+	const UINT64 StagingAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+UploadBatcher::UploadBatcher(ID3D12Device* device, UINT64 stagingBlockByteSize)
+	: device(device),
+	stagingBlockByteSize(stagingBlockByteSize)
+{
+}
+
+UploadBatcher::~UploadBatcher()
+{
+	for (auto& staging : stagingBuffers)
+		staging.Resource->Unmap(0, nullptr);
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> UploadBatcher::CreateDefaultBuffer(const void* initData, UINT64 byteSize)
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer;
+
+	auto heapPropertiesDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+
+	// Buffers start out in COMMON whatever is asked for; the copy promotes them to
+	// COPY_DEST.
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapPropertiesDefault,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+
+	StagingBuffer& staging = GetStagingBuffer(byteSize);
+
+	PendingUpload upload;
+	upload.Destination = defaultBuffer;
+	upload.Source = staging.Resource.Get();
+	upload.SourceOffset = staging.UsedByteSize;
+	upload.ByteSize = byteSize;
+
+	memcpy(staging.MappedData + upload.SourceOffset, initData, byteSize);
+	staging.UsedByteSize = AlignUp(upload.SourceOffset + byteSize, StagingAlignment);
+
+	pendingUploads.push_back(upload);
+
+	return defaultBuffer;
+}
+
+UploadBatcher::BatchStats UploadBatcher::RecordCopies(ID3D12GraphicsCommandList* cmdList)
+{
+	BatchStats stats;
+
+	barriers.clear();
+	for (const auto& upload : pendingUploads)
+	{
+		cmdList->CopyBufferRegion(upload.Destination.Get(), 0, upload.Source, upload.SourceOffset, upload.ByteSize);
+
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+			upload.Destination.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_GENERIC_READ));
+
+		++stats.UploadCount;
+		stats.ByteSize += upload.ByteSize;
+	}
+
+	if (!barriers.empty())
+		cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+	for (auto& staging : stagingBuffers)
+	{
+		if (staging.bRecorded)
+			continue;
+
+		staging.bRecorded = true;
+		++stats.StagingBufferCount;
+		stats.StagingByteSize += staging.ByteSize;
+	}
+
+	pendingUploads.clear();
+	lastBatchStats = stats;
+	return stats;
+}
+
+void UploadBatcher::Retire(UINT64 fenceValue)
+{
+	for (auto& staging : stagingBuffers)
+	{
+		if (staging.bRecorded && staging.FenceValue == 0)
+			staging.FenceValue = fenceValue;
+	}
+}
+
+void UploadBatcher::ReleaseCompleted(UINT64 completedFenceValue)
+{
+	auto firstReleased = std::stable_partition(stagingBuffers.begin(), stagingBuffers.end(),
+		[completedFenceValue](const StagingBuffer& staging)
+		{
+			return staging.FenceValue == 0 || staging.FenceValue > completedFenceValue;
+		});
+
+	for (auto it = firstReleased; it != stagingBuffers.end(); ++it)
+		it->Resource->Unmap(0, nullptr);
+
+	stagingBuffers.erase(firstReleased, stagingBuffers.end());
+}
+
+UINT64 UploadBatcher::GetStagingByteSize() const noexcept
+{
+	UINT64 byteSize = 0;
+	for (const auto& staging : stagingBuffers)
+		byteSize += staging.ByteSize;
+	return byteSize;
+}
+
+UploadBatcher::StagingBuffer& UploadBatcher::GetStagingBuffer(UINT64 byteSize)
+{
+	// First fit among the staging buffers of the current batch.  There are only a
+	// few, since they are large.
+	for (auto& staging : stagingBuffers)
+	{
+		if (!staging.bRecorded && staging.UsedByteSize + byteSize <= staging.ByteSize)
+			return staging;
+	}
+
+	StagingBuffer staging;
+	staging.ByteSize = std::max(stagingBlockByteSize, AlignUp(byteSize, StagingAlignment));
+
+	auto heapPropertiesUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(staging.ByteSize);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapPropertiesUpload,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(staging.Resource.GetAddressOf())));
+
+	ThrowIfFailed(staging.Resource->Map(0, nullptr, reinterpret_cast<void**>(&staging.MappedData)));
+
+	stagingBuffers.push_back(staging);
+	return stagingBuffers.back();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "DxUtil.h"
+
+#include <vector>
+
+// Creates static default heap buffers and fills them with their initial data in
+// batches.  The data of every buffer created since the last batch is packed into
+// a few large staging buffers as it comes in, and RecordCopies turns the batch
+// into one copy per buffer followed by a single barrier.  The staging buffers
+// are released by themselves once the fence the batch was retired with passes,
+// so nothing has to keep per-mesh upload buffers alive the way
+// DxUtil::CreateDefaultBuffer requires.
+//
+// A batch is recorded with RecordCopies, retired with the fence value its
+// command list is signaled with, and released by ReleaseCompleted.
+class UploadBatcher
+{
+public:
+	struct BatchStats
+	{
+		UINT UploadCount = 0;
+
+		// Bytes of initial data copied.
+		UINT64 ByteSize = 0;
+
+		UINT StagingBufferCount = 0;
+		UINT64 StagingByteSize = 0;
+	};
+
+	// Staging buffers are stagingBlockByteSize large, or as large as the one
+	// upload that does not fit in that.
+	explicit UploadBatcher(ID3D12Device* device, UINT64 stagingBlockByteSize = 4 * 1024 * 1024);
+	~UploadBatcher();
+	UploadBatcher(const UploadBatcher& rhs) = delete;
+	UploadBatcher& operator=(const UploadBatcher& rhs) = delete;
+
+	// Creates a buffer of byteSize in the default heap and stages initData for it.
+	// The data is copied out before this returns.  The buffer must not be used
+	// before the command list the batch is recorded on has run.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(const void* initData, UINT64 byteSize);
+
+	bool HasPendingUploads() const noexcept { return !pendingUploads.empty(); }
+
+	// Records the copies of everything staged since the last call and leaves the
+	// buffers in GENERIC_READ.  Returns what the batch held.
+	BatchStats RecordCopies(ID3D12GraphicsCommandList* cmdList);
+
+	// Recorded batches not retired yet belong to the command list signaled with
+	// fenceValue.
+	void Retire(UINT64 fenceValue);
+
+	// Releases the staging buffers of the batches whose fence has completed.
+	void ReleaseCompleted(UINT64 completedFenceValue);
+
+	const BatchStats& GetLastBatchStats() const noexcept { return lastBatchStats; }
+
+	// Staging memory currently held, pending and in flight.
+	UINT64 GetStagingByteSize() const noexcept;
+
+private:
+	struct StagingBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		BYTE* MappedData = nullptr;
+		UINT64 ByteSize = 0;
+		UINT64 UsedByteSize = 0;
+
+		bool bRecorded = false;
+
+		// 0 until the batch is retired.
+		UINT64 FenceValue = 0;
+	};
+
+	struct PendingUpload
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Destination;
+		ID3D12Resource* Source = nullptr;
+		UINT64 SourceOffset = 0;
+		UINT64 ByteSize = 0;
+	};
+
+	StagingBuffer& GetStagingBuffer(UINT64 byteSize);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	UINT64 stagingBlockByteSize = 0;
+
+	std::vector<StagingBuffer> stagingBuffers;
+	std::vector<PendingUpload> pendingUploads;
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+	BatchStats lastBatchStats;
+};
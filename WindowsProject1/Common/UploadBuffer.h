@@ -2,13 +2,15 @@
 
 #include "DxUtil.h"
 
+#include <atomic>
 
 template<typename T>
 class UploadBuffer
 {
 public:
     UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) : 
-        mIsConstantBuffer(isConstantBuffer)
+        mIsConstantBuffer(isConstantBuffer),
+        mUniqueId(NextUniqueId())
     {
         mElementByteSize = sizeof(T);
 
@@ -59,15 +61,37 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Mapped memory starting at element elementIndex, for writers that produce the
+    // elements in place.  Upload heap memory is write-combined, so write it front
+    // to back and never read it.
+    BYTE* GetMappedData(int elementIndex)
+    {
+        return &mMappedData[elementIndex*mElementByteSize];
+    }
+
     UINT GetElementByteSize()
     {
         return mElementByteSize;
     }
 
+    // Identifies this buffer for the lifetime of the process.  Unlike its address,
+    // the id is never reused after the buffer is destroyed.
+    UINT64 GetUniqueId()const
+    {
+        return mUniqueId;
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
     bool mIsConstantBuffer = false;
+    UINT64 mUniqueId = 0;
+
+    static UINT64 NextUniqueId()
+    {
+        static std::atomic<UINT64> nextId{ 1 };
+        return nextId.fetch_add(1);
+    }
 };
\ No newline at end of file
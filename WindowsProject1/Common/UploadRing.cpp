@@ -0,0 +1,70 @@
+#include "UploadRing.h"
+
+namespace
+{
+	// Buffers are placed in 64KB pages anyway.
+	const UINT64 BufferGranularity = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+}
+
+UploadRing::MappedBuffer::~MappedBuffer()
+{
+	if (Resource != nullptr)
+		Resource->Unmap(0, nullptr);
+}
+
+UploadRing::UploadRing(ID3D12Device* device, UINT64 byteSize)
+	: device(device),
+	ring(byteSize, BufferGranularity, [this](uint64_t blockByteSize) { return CreateBuffer(blockByteSize); })
+{
+}
+
+UploadRing::~UploadRing()
+{
+}
+
+void UploadRing::BeginFrame(UINT64 completedFenceValue)
+{
+	ring.Reclaim(completedFenceValue);
+}
+
+void UploadRing::EndFrame(UINT64 fenceValue)
+{
+	ring.FinishFrame(fenceValue);
+}
+
+UploadRing::Allocation UploadRing::Allocate(UINT64 byteSize, UINT64 alignment, UINT elementByteSize)
+{
+	const GrowableRing<MappedBuffer>::Allocation range = ring.Allocate(byteSize, alignment);
+	const MappedBuffer& buffer = *range.OwnerBlock;
+
+	Allocation allocation;
+	allocation.Resource = buffer.Resource.Get();
+	allocation.Offset = range.Offset;
+	allocation.ByteSize = byteSize;
+	allocation.CpuAddress = buffer.MappedData + range.Offset;
+	allocation.GpuAddress = buffer.GpuAddress + range.Offset;
+	allocation.ElementByteSize = elementByteSize;
+	return allocation;
+}
+
+std::unique_ptr<UploadRing::MappedBuffer> UploadRing::CreateBuffer(UINT64 byteSize)
+{
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+
+	auto buffer = std::make_unique<MappedBuffer>();
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer->Resource)));
+
+	// Stays mapped for the lifetime of the buffer; the fences keep the CPU off
+	// the ranges the GPU may still read.
+	ThrowIfFailed(buffer->Resource->Map(0, nullptr, reinterpret_cast<void**>(&buffer->MappedData)));
+	buffer->GpuAddress = buffer->Resource->GetGPUVirtualAddress();
+
+	return buffer;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "DxUtil.h"
+#include "RingAllocator.h"
+
+#include <vector>
+
+// One persistently mapped upload buffer that the per-frame constants, structured
+// buffers and dynamic vertices of every frame in flight are sub-allocated from.
+// Memory is handed out linearly each frame and comes back once the fence the
+// frame was finished with has passed, so nothing needs to be sized per frame
+// resource up front.
+//
+// Call BeginFrame with the completed fence value after waiting for the frame
+// resource, allocate while recording, and EndFrame with the fence value the frame
+// is signaled with.  When a frame needs more than the ring has free, the ring
+// moves to a buffer twice the size.  The old one stays mapped, so allocations
+// made from it earlier in the frame can still be written, and is released once
+// the frames that used it are done, so growing never stalls.
+class UploadRing
+{
+public:
+	// A range of the ring, valid for the frame it was allocated in.
+	struct Allocation
+	{
+		ID3D12Resource* Resource = nullptr;
+		UINT64 Offset = 0;
+		UINT64 ByteSize = 0;
+		BYTE* CpuAddress = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+
+		// Distance between consecutive elements of a typed allocation.
+		UINT ElementByteSize = 0;
+
+		template<typename T>
+		void CopyData(int elementIndex, const T& data)
+		{
+			memcpy(CpuAddress + elementIndex * ElementByteSize, &data, sizeof(T));
+		}
+
+		// Upload heap memory is write-combined: write it front to back and never read it.
+		BYTE* GetMappedData(int elementIndex) const noexcept
+		{
+			return CpuAddress + elementIndex * ElementByteSize;
+		}
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress(int elementIndex) const noexcept
+		{
+			return GpuAddress + elementIndex * ElementByteSize;
+		}
+	};
+
+	// Placement alignment of constant buffer views.
+	static constexpr UINT64 ConstantBufferAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+	UploadRing(ID3D12Device* device, UINT64 byteSize);
+	~UploadRing();
+	UploadRing(const UploadRing& rhs) = delete;
+	UploadRing& operator=(const UploadRing& rhs) = delete;
+
+	void BeginFrame(UINT64 completedFenceValue);
+	void EndFrame(UINT64 fenceValue);
+
+	Allocation Allocate(UINT64 byteSize, UINT64 alignment, UINT elementByteSize = 0);
+
+	// count constant buffers of type T, each padded to 256 bytes so that every
+	// element can be bound as a root CBV.
+	template<typename T>
+	Allocation AllocateConstants(UINT count = 1)
+	{
+		const UINT elementByteSize = DxUtil::CalcConstantBufferByteSize(sizeof(T));
+		return Allocate(static_cast<UINT64>(elementByteSize) * count, ConstantBufferAlignment, elementByteSize);
+	}
+
+	// count elements of type T, tightly packed.  The range starts at a multiple of
+	// sizeof(T), so an SRV over the whole ring can reach it with FirstElement =
+	// Offset / sizeof(T), and it can be bound as a root SRV or vertex buffer.
+	template<typename T>
+	Allocation AllocateStructured(UINT count)
+	{
+		return Allocate(static_cast<UINT64>(sizeof(T)) * count, sizeof(T), sizeof(T));
+	}
+
+	UINT64 GetCapacity() const noexcept { return ring.GetCapacity(); }
+	UINT64 GetUsedByteSize() const noexcept { return ring.GetUsedByteSize(); }
+
+	// Number of times the ring moved to a bigger buffer.
+	UINT GetGrowCount() const noexcept { return ring.GetGrowCount(); }
+
+private:
+	// An upload buffer that stays mapped until it is destroyed, which the ring
+	// only does once no frame in flight uses it.
+	struct MappedBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		BYTE* MappedData = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+
+		~MappedBuffer();
+	};
+
+	std::unique_ptr<MappedBuffer> CreateBuffer(UINT64 byteSize);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	GrowableRing<MappedBuffer> ring;
+};
@@ -0,0 +1,86 @@
+// Runs CpuOceanMap's frequency pass and displacement transform for growing map
+// sizes on each butterfly path, and reports the time per frame of both.
+//
+//   CpuOceanMapBenchmark [maxSize]
+
+#include "CpuOceanMap.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Frames per map size are chosen so every size touches about this many texels.
+	const long long TexelBudget = 1LL << 24;
+	const int MinFrames = 4;
+
+	const char* GetFftPathName(CpuOceanMap::FftPath path)
+	{
+		switch (path)
+		{
+		case CpuOceanMap::FftPath::Scalar: return "scalar";
+		case CpuOceanMap::FftPath::Sse: return "sse";
+		default: return "auto";
+		}
+	}
+
+	double MillisecondsSince(Clock::time_point start, int rounds)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / rounds;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int maxSize = argc > 1 ? std::atoi(argv[1]) : 1024;
+	const float frameTime = 1.0f / 60.0f;
+
+	std::printf("%u threads\n", JobSystem::Default().GetConcurrency());
+	std::printf("%6s %8s %8s %14s %14s\n", "size", "path", "frames", "frequency ms", "fft ms");
+
+	for (int size = 64; size <= maxSize; size *= 2)
+	{
+		const int frames = (int)std::max<long long>(MinFrames, TexelBudget / ((long long)size * size));
+
+		for (CpuOceanMap::FftPath path : { CpuOceanMap::FftPath::Scalar, CpuOceanMap::FftPath::Sse })
+		{
+			CpuOceanMap oceanMap(size);
+			oceanMap.SetFftPath(path);
+
+			// Paths the CPU does not have fall back to scalar; skip the repeat.
+			if (path != CpuOceanMap::FftPath::Scalar && oceanMap.GetFftPath() == CpuOceanMap::FftPath::Scalar)
+				continue;
+
+			oceanMap.BuildOceanBasis();
+
+			// One frame to warm the caches and the job system.
+			oceanMap.Update(0.0f);
+
+			float waveTime = 0.0f;
+			double frequencyMilliseconds = 0.0;
+			double fftMilliseconds = 0.0;
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				waveTime += frameTime;
+
+				Clock::time_point start = Clock::now();
+				oceanMap.ComputeOceanFrequency(waveTime);
+				frequencyMilliseconds += MillisecondsSince(start, frames);
+
+				start = Clock::now();
+				oceanMap.ComputeOceanDisplacement();
+				fftMilliseconds += MillisecondsSince(start, frames);
+			}
+
+			std::printf("%6d %8s %8d %14.3f %14.3f\n",
+				size, GetFftPathName(oceanMap.GetFftPath()), frames, frequencyMilliseconds, fftMilliseconds);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+// CpuOceanMap's shift, bit reversal, row transforms and transpose against a
+// direct DFT in double precision, on both butterfly paths and on sizes with an
+// odd and an even number of radix-2 stages.
+
+#include "CpuOceanMap.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace
+{
+	using ComplexD = std::complex<double>;
+
+	// Relative to the largest displacement of a slice.  The float transform
+	// loses a few bits per stage, and the shader's twiddles use a shortened pi.
+	const double Tolerance = 1e-4;
+
+	// What ComputeOceanDisplacement should produce for one slice of h~(t):
+	// texel (x, y) of the result is
+	//
+	//   1 / size^2 * sum over (u, v) of h~(shift(u), shift(v)) W^(u y + v x)
+	//
+	// with shift(i) = (i + size / 2) mod size and W = e^(-2 pi i / size), that
+	// is the 2D transform of the shifted plane, transposed.
+	std::vector<ComplexD> DirectTransform(const CpuOceanMap::ComplexPlane& hTilde, int size)
+	{
+		const double pi = 3.14159265358979323846;
+		const int half = size / 2;
+
+		std::vector<ComplexD> twiddles(size);
+		for (int k = 0; k < size; ++k)
+			twiddles[k] = std::polar(1.0, -2.0 * pi * k / size);
+
+		// Rows of the shifted plane first, then its columns; still a direct sum
+		// per output, just in two steps.
+		std::vector<ComplexD> rows((size_t)size * size);
+		for (int v = 0; v < size; ++v)
+		{
+			const size_t srcRow = (size_t)((v + half) % size) * size;
+			for (int y = 0; y < size; ++y)
+			{
+				ComplexD sum = 0.0;
+				for (int u = 0; u < size; ++u)
+				{
+					const size_t src = srcRow + (u + half) % size;
+					sum += ComplexD(hTilde.Real[src], hTilde.Imag[src]) * twiddles[((size_t)u * y) % size];
+				}
+				rows[(size_t)v * size + y] = sum;
+			}
+		}
+
+		std::vector<ComplexD> result((size_t)size * size);
+		for (int y = 0; y < size; ++y)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				ComplexD sum = 0.0;
+				for (int v = 0; v < size; ++v)
+					sum += rows[(size_t)v * size + y] * twiddles[((size_t)v * x) % size];
+				result[(size_t)y * size + x] = sum / ((double)size * size);
+			}
+		}
+		return result;
+	}
+
+	bool MatchesDirectTransform(const CpuOceanMap& oceanMap, int slice)
+	{
+		const int size = oceanMap.GetSize();
+		const std::vector<ComplexD> expected = DirectTransform(oceanMap.GetHTilde(slice), size);
+		const CpuOceanMap::ComplexPlane displacement = oceanMap.GetDisplacement(slice);
+
+		double largest = 0.0;
+		for (const ComplexD& value : expected)
+			largest = std::max(largest, std::abs(value));
+
+		// An all-zero slice must stay zero.
+		const double tolerance = std::max(largest, 1e-30) * Tolerance;
+		for (size_t i = 0; i < expected.size(); ++i)
+		{
+			const ComplexD actual(displacement.Real[i], displacement.Imag[i]);
+			if (std::abs(actual - expected[i]) > tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	void TestDirectTransform(CpuOceanMap::FftPath path)
+	{
+		for (int size = 4; size <= 128; size *= 2)
+		{
+			CpuOceanMap oceanMap(size);
+			oceanMap.SetFftPath(path);
+			oceanMap.BuildOceanBasis();
+
+			for (float waveTime : { 0.0f, 1.7f })
+			{
+				oceanMap.Update(waveTime);
+
+				for (int slice = 0; slice < CpuOceanMap::NUM_OCEAN_FREQUENCY; ++slice)
+					CHECK(MatchesDirectTransform(oceanMap, slice));
+			}
+		}
+	}
+
+	// Both paths run the same butterflies, so they agree to rounding.
+	void TestPathsAgree()
+	{
+		const int size = 256;
+
+		CpuOceanMap scalar(size);
+		CpuOceanMap sse(size);
+		scalar.SetFftPath(CpuOceanMap::FftPath::Scalar);
+		sse.SetFftPath(CpuOceanMap::FftPath::Sse);
+
+		scalar.BuildOceanBasis();
+		sse.BuildOceanBasis();
+		scalar.Update(3.0f);
+		sse.Update(3.0f);
+
+		for (int slice = 0; slice < CpuOceanMap::NUM_OCEAN_FREQUENCY; ++slice)
+		{
+			const CpuOceanMap::ComplexPlane a = scalar.GetDisplacement(slice);
+			const CpuOceanMap::ComplexPlane b = sse.GetDisplacement(slice);
+
+			float largest = 0.0f;
+			float largestDifference = 0.0f;
+			for (size_t i = 0; i < (size_t)size * size; ++i)
+			{
+				largest = std::max(largest, std::max(std::fabs(a.Real[i]), std::fabs(a.Imag[i])));
+				largestDifference = std::max(largestDifference, std::fabs(a.Real[i] - b.Real[i]));
+				largestDifference = std::max(largestDifference, std::fabs(a.Imag[i] - b.Imag[i]));
+			}
+			CHECK(largestDifference <= 1e-5f * largest);
+		}
+	}
+}
+
+int main()
+{
+	TestDirectTransform(CpuOceanMap::FftPath::Scalar);
+	TestDirectTransform(CpuOceanMap::FftPath::Sse);
+	TestPathsAgree();
+
+	return TestUtil::Finish();
+}
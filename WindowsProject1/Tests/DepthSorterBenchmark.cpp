@@ -0,0 +1,144 @@
+// Sorts the depths of items scattered over a plane, for a first frame, for a
+// camera that orbits them slowly and for frames whose order has nothing to do
+// with the last one, and reports the time per frame of DepthSorter and of a
+// std::stable_sort of the indices.
+//
+//   DepthSorterBenchmark [itemCount] [radiansPerFrame]
+
+#include "DepthSorter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	const int FrameCount = 100;
+
+	struct Item
+	{
+		float X;
+		float Z;
+	};
+
+	// Depths seen by a camera 300 units away, turned by angle about the plane.
+	void ComputeDepths(const std::vector<Item>& items, float angle, std::vector<float>& depths)
+	{
+		const float dirX = std::sin(angle);
+		const float dirZ = std::cos(angle);
+		for (size_t i = 0; i < items.size(); ++i)
+			depths[i] = 300.0f + items[i].X * dirX + items[i].Z * dirZ;
+	}
+
+	void StableSortBackToFront(const std::vector<float>& depths, std::vector<uint32_t>& order)
+	{
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+			{
+				return depths[a] > depths[b];
+			});
+	}
+
+	double MillisecondsSince(Clock::time_point start, int rounds)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / rounds;
+	}
+
+	void Report(const char* name, double sorterMilliseconds, double stableSortMilliseconds, int radixCount)
+	{
+		std::printf("%-10s %10.3f %12.3f %8.1fx %8d\n", name, sorterMilliseconds, stableSortMilliseconds,
+			stableSortMilliseconds / sorterMilliseconds, radixCount);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int itemCount = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+	// How fast the camera orbits.  The further apart two frames are in item
+	// ranks, the more the insertion sort has to move.
+	const float radiansPerFrame = argc > 2 ? (float)std::atof(argv[2]) : 0.002f;
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+	std::vector<Item> items(itemCount);
+	for (Item& item : items)
+		item = { position(rng), position(rng) };
+
+	// Each frame's depths are computed up front, so only the sorting is timed.
+	std::vector<std::vector<float>> coherentDepths(FrameCount, std::vector<float>(itemCount));
+	std::vector<std::vector<float>> shuffledDepths(FrameCount, std::vector<float>(itemCount));
+	for (int frame = 0; frame < FrameCount; ++frame)
+	{
+		ComputeDepths(items, radiansPerFrame * frame, coherentDepths[frame]);
+
+		shuffledDepths[frame] = coherentDepths[frame];
+		std::shuffle(shuffledDepths[frame].begin(), shuffledDepths[frame].end(), rng);
+	}
+
+	const uint32_t count = static_cast<uint32_t>(itemCount);
+	std::vector<uint32_t> order(itemCount);
+	DepthSorter sorter;
+
+	// std::stable_sort first, which also brings the depths into the caches.
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < FrameCount; ++frame)
+		StableSortBackToFront(coherentDepths[frame], order);
+	const double coherentStableSortMilliseconds = MillisecondsSince(start, FrameCount);
+
+	start = Clock::now();
+	for (int frame = 0; frame < FrameCount; ++frame)
+		StableSortBackToFront(shuffledDepths[frame], order);
+	const double shuffledStableSortMilliseconds = MillisecondsSince(start, FrameCount);
+
+	// A first frame starts from the identity order every time.
+	int radixCount = 0;
+	start = Clock::now();
+	for (int frame = 0; frame < FrameCount; ++frame)
+	{
+		sorter.Reset();
+		sorter.SortBackToFront(coherentDepths[frame].data(), count);
+		radixCount += sorter.GetLastPath() == DepthSorter::SortPath::Radix ? 1 : 0;
+	}
+	const double firstMilliseconds = MillisecondsSince(start, FrameCount);
+	const int firstRadixCount = radixCount;
+
+	// Coherent frames start from the order of the frame before.
+	sorter.Reset();
+	sorter.SortBackToFront(coherentDepths[0].data(), count);
+
+	radixCount = 0;
+	start = Clock::now();
+	for (int frame = 1; frame < FrameCount; ++frame)
+	{
+		sorter.SortBackToFront(coherentDepths[frame].data(), count);
+		radixCount += sorter.GetLastPath() == DepthSorter::SortPath::Radix ? 1 : 0;
+	}
+	const double coherentMilliseconds = MillisecondsSince(start, FrameCount - 1);
+	const int coherentRadixCount = radixCount;
+
+	radixCount = 0;
+	start = Clock::now();
+	for (int frame = 0; frame < FrameCount; ++frame)
+	{
+		sorter.SortBackToFront(shuffledDepths[frame].data(), count);
+		radixCount += sorter.GetLastPath() == DepthSorter::SortPath::Radix ? 1 : 0;
+	}
+	const double shuffledMilliseconds = MillisecondsSince(start, FrameCount);
+
+	std::printf("%d items, %d frames\n", itemCount, FrameCount);
+	std::printf("%-10s %10s %12s %9s %8s\n", "frames", "sorter ms", "stable ms", "speedup", "radix");
+	Report("first", firstMilliseconds, coherentStableSortMilliseconds, firstRadixCount);
+	Report("coherent", coherentMilliseconds, coherentStableSortMilliseconds, coherentRadixCount);
+	Report("shuffled", shuffledMilliseconds, shuffledStableSortMilliseconds, radixCount);
+
+	return 0;
+}
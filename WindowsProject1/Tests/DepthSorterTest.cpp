@@ -0,0 +1,155 @@
+// DepthSorter over a camera that moves a little each frame, and over orders
+// that have nothing to do with the last one.
+
+#include "DepthSorter.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Farthest first, and items at the same depth in the order they had before.
+	bool IsBackToFront(const DepthSorter& sorter, const std::vector<float>& depths)
+	{
+		const auto& order = sorter.GetOrder();
+		if (order.size() != depths.size())
+			return false;
+
+		// Depths closer than a key step may tie, so only a larger inversion is
+		// an error.
+		const auto range = std::minmax_element(depths.begin(), depths.end());
+		const float tolerance = depths.empty() ? 0.0f : (*range.second - *range.first) / 65535.0f * 1.01f;
+
+		std::vector<bool> bSeen(depths.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			if (order[i] >= depths.size() || bSeen[order[i]])
+				return false;
+			bSeen[order[i]] = true;
+
+			if (i > 0 && depths[order[i]] > depths[order[i - 1]] + tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	void TestPaths()
+	{
+		DepthSorter sorter;
+
+		sorter.SortBackToFront(nullptr, 0);
+		CHECK(sorter.GetOrder().empty());
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::AlreadySorted);
+
+		std::vector<float> depths(1000);
+		for (size_t i = 0; i < depths.size(); ++i)
+			depths[i] = 1000.0f - static_cast<float>(i);
+
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::AlreadySorted);
+		CHECK(IsBackToFront(sorter, depths));
+
+		// Every other pair of neighbours swapped: half the keys are smaller than
+		// the one before, yet each item is one move from its place.
+		for (size_t i = 0; i + 1 < depths.size(); i += 2)
+			std::swap(depths[i], depths[i + 1]);
+
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::Insertion);
+		CHECK(IsBackToFront(sorter, depths));
+
+		// A shuffle is too far from the last order for the insertion sort.
+		std::mt19937 rng(3);
+		std::shuffle(depths.begin(), depths.end(), rng);
+
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::Radix);
+		CHECK(IsBackToFront(sorter, depths));
+
+		// Once sorted, the same depths again need nothing.
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::AlreadySorted);
+
+		// Turning around reverses the order, which is the worst case for the
+		// insertion sort; it gives up and the radix sort finishes.
+		for (float& depth : depths)
+			depth = -depth;
+
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::Radix);
+		CHECK(IsBackToFront(sorter, depths));
+	}
+
+	// Items scattered over a plane, seen by a camera that orbits them slowly: the
+	// frames after the first sort without a radix pass.
+	void TestOrbitingCamera()
+	{
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+		struct Item
+		{
+			float X;
+			float Z;
+		};
+
+		std::vector<Item> items(5000);
+		for (Item& item : items)
+			item = { position(rng), position(rng) };
+
+		DepthSorter sorter;
+		std::vector<float> depths(items.size());
+		int radixCount = 0;
+
+		for (int frame = 0; frame < 120; ++frame)
+		{
+			const float angle = 0.002f * static_cast<float>(frame);
+			const float dirX = std::sin(angle);
+			const float dirZ = std::cos(angle);
+			for (size_t i = 0; i < items.size(); ++i)
+				depths[i] = 300.0f + items[i].X * dirX + items[i].Z * dirZ;
+
+			sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+			CHECK(IsBackToFront(sorter, depths));
+
+			radixCount += sorter.GetLastPath() == DepthSorter::SortPath::Radix ? 1 : 0;
+		}
+
+		// Only the first frame starts from the identity order.
+		CHECK(radixCount == 1);
+	}
+
+	// Equal depths keep the order they had, frame after frame.
+	void TestStableTies()
+	{
+		std::vector<float> depths = { 5.0f, 7.0f, 5.0f, 7.0f, 5.0f, 1.0f, 7.0f };
+
+		DepthSorter sorter;
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+
+		const std::vector<uint32_t> expected = { 1, 3, 6, 0, 2, 4, 5 };
+		CHECK(sorter.GetOrder() == expected);
+
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		CHECK(sorter.GetOrder() == expected);
+		CHECK(sorter.GetLastPath() == DepthSorter::SortPath::AlreadySorted);
+
+		// A new count starts over from the identity order.
+		depths.pop_back();
+		sorter.SortBackToFront(depths.data(), static_cast<uint32_t>(depths.size()));
+		const std::vector<uint32_t> shorter = { 1, 3, 0, 2, 4, 5 };
+		CHECK(sorter.GetOrder() == shorter);
+	}
+}
+
+int main()
+{
+	TestPaths();
+	TestOrbitingCamera();
+	TestStableTies();
+
+	return TestUtil::Finish();
+}
@@ -0,0 +1,263 @@
+// DrawQueue sort keys, sorting and recording, checked through the command
+// stream the way a DrawSubmitter would replay it.
+
+#include "DrawQueue.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	uint64_t Mask(uint32_t bits)
+	{
+		return (1ull << bits) - 1;
+	}
+
+	// Each field lands in its own bits, in layer, pipeline, geometry, material,
+	// depth order, and is truncated to them.
+	void TestSortKeyPacking()
+	{
+		constexpr uint32_t depthShift = 0;
+		constexpr uint32_t materialShift = depthShift + DrawQueue::DepthBits;
+		constexpr uint32_t geometryShift = materialShift + DrawQueue::MaterialBits;
+		constexpr uint32_t pipelineShift = geometryShift + DrawQueue::GeometryBits;
+		constexpr uint32_t layerShift = pipelineShift + DrawQueue::PipelineBits;
+		static_assert(layerShift + DrawQueue::LayerBits == 64, "the key fields fill 64 bits");
+
+		const uint64_t key = DrawQueue::MakeSortKey(3, 517, 9001, 2047, 123456);
+		CHECK(((key >> layerShift) & Mask(DrawQueue::LayerBits)) == 3);
+		CHECK(((key >> pipelineShift) & Mask(DrawQueue::PipelineBits)) == 517);
+		CHECK(((key >> geometryShift) & Mask(DrawQueue::GeometryBits)) == 9001);
+		CHECK(((key >> materialShift) & Mask(DrawQueue::MaterialBits)) == 2047);
+		CHECK(((key >> depthShift) & Mask(DrawQueue::DepthBits)) == 123456);
+
+		// Out of range fields do not spill into their neighbours.
+		const uint64_t truncated = DrawQueue::MakeSortKey(0, 0, 0, 1u << DrawQueue::MaterialBits, UINT32_MAX);
+		CHECK(truncated == Mask(DrawQueue::DepthBits));
+
+		// Each field outranks every field below it.
+		const uint32_t maxDepth = static_cast<uint32_t>(Mask(DrawQueue::DepthBits));
+		CHECK(DrawQueue::MakeSortKey(1, 0, 0, 0, 0) > DrawQueue::MakeSortKey(0, 1023, 16383, 4095, maxDepth));
+		CHECK(DrawQueue::MakeSortKey(0, 1, 0, 0, 0) > DrawQueue::MakeSortKey(0, 0, 16383, 4095, maxDepth));
+		CHECK(DrawQueue::MakeSortKey(0, 0, 1, 0, 0) > DrawQueue::MakeSortKey(0, 0, 0, 4095, maxDepth));
+		CHECK(DrawQueue::MakeSortKey(0, 0, 0, 1, 0) > DrawQueue::MakeSortKey(0, 0, 0, 0, maxDepth));
+	}
+
+	void TestQuantizeDepth()
+	{
+		const uint32_t maxDepth = static_cast<uint32_t>(Mask(DrawQueue::DepthBits));
+
+		CHECK(DrawQueue::QuantizeDepth(1.0f, 1.0f, 1000.0f) == 0);
+		CHECK(DrawQueue::QuantizeDepth(1000.0f, 1.0f, 1000.0f) == maxDepth);
+		CHECK(DrawQueue::QuantizeDepth(-5.0f, 1.0f, 1000.0f) == 0);
+		CHECK(DrawQueue::QuantizeDepth(5000.0f, 1.0f, 1000.0f) == maxDepth);
+		CHECK(DrawQueue::QuantizeDepth(10.0f, 1.0f, 1000.0f) < DrawQueue::QuantizeDepth(11.0f, 1.0f, 1000.0f));
+
+		CHECK(DrawQueue::QuantizeDepth(1.0f, 1.0f, 1000.0f, true) == maxDepth);
+		CHECK(DrawQueue::QuantizeDepth(1000.0f, 1.0f, 1000.0f, true) == 0);
+		CHECK(DrawQueue::QuantizeDepth(10.0f, 1.0f, 1000.0f, true) > DrawQueue::QuantizeDepth(11.0f, 1.0f, 1000.0f, true));
+	}
+
+	// The packets in the order the stream draws them.
+	std::vector<uint32_t> DrawOrder(const DrawCommandStream& stream)
+	{
+		std::vector<uint32_t> order;
+		for (const DrawCommand& command : stream.Commands)
+		{
+			if (command.Type == DrawCommandType::DrawIndexed)
+				order.push_back(command.Packet);
+		}
+		return order;
+	}
+
+	// Replays the stream against a fake command list: every draw must see the
+	// state its packet asks for, and every set call must change something.
+	void CheckStream(const DrawQueue& queue, const DrawCommandStream& stream)
+	{
+		bool bSet[4] = {};
+		DrawQueue::Packet current;
+
+		for (const DrawCommand& command : stream.Commands)
+		{
+			const DrawQueue::Packet& packet = queue.GetPacket(command.Packet);
+
+			switch (command.Type)
+			{
+			case DrawCommandType::SetPipeline:
+				CHECK(!bSet[0] || current.Pipeline != packet.Pipeline);
+				current.Pipeline = packet.Pipeline;
+				bSet[0] = true;
+				break;
+
+			case DrawCommandType::SetGeometry:
+				CHECK(!bSet[1] || current.Geometry != packet.Geometry);
+				current.Geometry = packet.Geometry;
+				bSet[1] = true;
+				break;
+
+			case DrawCommandType::SetTopology:
+				CHECK(!bSet[2] || current.Topology != packet.Topology);
+				current.Topology = packet.Topology;
+				bSet[2] = true;
+				break;
+
+			case DrawCommandType::SetObjectConstants:
+				CHECK(!bSet[3] || current.ObjectConstants != packet.ObjectConstants);
+				current.ObjectConstants = packet.ObjectConstants;
+				bSet[3] = true;
+				break;
+
+			case DrawCommandType::DrawIndexed:
+				CHECK(bSet[0] && bSet[1] && bSet[2] && bSet[3]);
+				CHECK(current.Pipeline == packet.Pipeline);
+				CHECK(current.Geometry == packet.Geometry);
+				CHECK(current.Topology == packet.Topology);
+				CHECK(current.ObjectConstants == packet.ObjectConstants);
+				break;
+
+			default:
+				CHECK(false);
+				break;
+			}
+		}
+
+		size_t counted = 0;
+		for (size_t type = 0; type < static_cast<size_t>(DrawCommandType::Count); ++type)
+			counted += stream.Counts[type];
+		CHECK(counted == stream.Commands.size());
+		CHECK(stream.GetCount(DrawCommandType::DrawIndexed) == queue.GetPacketCount());
+		CHECK(stream.NaiveSetCount == 4 * queue.GetPacketCount());
+	}
+
+	// Both the insertion sort for short queues and the radix sort for long ones
+	// order by key and keep packets with equal keys in insertion order.
+	void TestSortIsStable()
+	{
+		std::mt19937 rng(7);
+
+		for (size_t count : { size_t(0), size_t(1), size_t(10), size_t(63), size_t(64), size_t(1000), size_t(20000) })
+		{
+			DrawQueue queue;
+			std::vector<uint64_t> keys;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				DrawQueue::Packet packet;
+				packet.Pipeline = rng() % 4;
+				packet.Geometry = rng() % 8;
+				packet.Topology = 4;
+				packet.ObjectConstants = 0x10000 + 256 * (rng() % 64);
+				packet.IndexCount = 36;
+
+				// Few distinct depths, so many keys tie.
+				packet.SortKey = DrawQueue::MakeSortKey(rng() % 2, packet.Pipeline, packet.Geometry, rng() % 4,
+					rng() % 16);
+				keys.push_back(packet.SortKey);
+				queue.Add(packet);
+			}
+
+			std::vector<uint32_t> expected(count);
+			for (uint32_t i = 0; i < count; ++i)
+				expected[i] = i;
+			std::stable_sort(expected.begin(), expected.end(),
+				[&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+			queue.Sort();
+
+			DrawCommandStream stream;
+			queue.Record(stream);
+
+			CHECK(DrawOrder(stream) == expected);
+			CheckStream(queue, stream);
+		}
+	}
+
+	// Draws of one pipeline and geometry with different materials only set the
+	// geometry once per geometry, whatever order they were added in.
+	void TestGeometryOutranksMaterial()
+	{
+		constexpr uint32_t geometryCount = 3;
+		constexpr uint32_t materialCount = 5;
+
+		DrawQueue queue;
+		uint32_t objectIndex = 0;
+		for (uint32_t material = 0; material < materialCount; ++material)
+		{
+			for (uint32_t geometry = 0; geometry < geometryCount; ++geometry)
+			{
+				DrawQueue::Packet packet;
+				packet.Pipeline = 1;
+				packet.Geometry = geometry;
+				packet.Topology = 4;
+				packet.ObjectConstants = 0x10000 + 256 * objectIndex++;
+				packet.IndexCount = 36;
+				packet.SortKey = DrawQueue::MakeSortKey(0, packet.Pipeline, geometry, material, 0);
+				queue.Add(packet);
+			}
+		}
+
+		queue.Sort();
+
+		DrawCommandStream stream;
+		queue.Record(stream);
+		CheckStream(queue, stream);
+
+		CHECK(stream.GetCount(DrawCommandType::SetPipeline) == 1);
+		CHECK(stream.GetCount(DrawCommandType::SetGeometry) == geometryCount);
+		CHECK(stream.GetCount(DrawCommandType::SetTopology) == 1);
+		CHECK(stream.GetCount(DrawCommandType::SetObjectConstants) == geometryCount * materialCount);
+		CHECK(stream.GetSetCount() == 2 + geometryCount + geometryCount * materialCount);
+	}
+
+	// Packets that share their object constants, as instanced passes drawing the
+	// same object twice do, set them once.
+	void TestRedundantSetsSkipped()
+	{
+		DrawQueue queue;
+		for (uint32_t i = 0; i < 6; ++i)
+		{
+			DrawQueue::Packet packet;
+			packet.Pipeline = i / 3;
+			packet.Geometry = 2;
+			packet.Topology = 4;
+			packet.ObjectConstants = 0x20000;
+			packet.IndexCount = 6;
+			packet.SortKey = DrawQueue::MakeSortKey(0, packet.Pipeline, packet.Geometry, 0, i);
+			queue.Add(packet);
+		}
+
+		queue.Sort();
+
+		DrawCommandStream stream;
+		queue.Record(stream);
+		CheckStream(queue, stream);
+
+		CHECK(stream.GetCount(DrawCommandType::SetPipeline) == 2);
+		CHECK(stream.GetCount(DrawCommandType::SetGeometry) == 1);
+		CHECK(stream.GetCount(DrawCommandType::SetTopology) == 1);
+		CHECK(stream.GetCount(DrawCommandType::SetObjectConstants) == 1);
+		CHECK(stream.GetSetCount() == 5);
+
+		// Clear empties the queue, and the stream starts over from nothing set.
+		queue.Clear();
+		CHECK(queue.GetPacketCount() == 0);
+
+		stream.Clear();
+		queue.Record(stream);
+		CHECK(stream.Commands.empty());
+		CHECK(stream.NaiveSetCount == 0);
+	}
+}
+
+int main()
+{
+	TestSortKeyPacking();
+	TestQuantizeDepth();
+	TestSortIsStable();
+	TestGeometryOutranksMaterial();
+	TestRedundantSetsSkipped();
+
+	return TestUtil::Finish();
+}
@@ -0,0 +1,255 @@
+// JobSystem loops, nested waits from inside jobs, TaskGraph ordering and the
+// scratch arenas, on systems with one worker, a few and the default count.
+
+#include "JobSystem.h"
+#include "TestUtil.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Every index is visited exactly once, in chunks of at most the grain size
+	// that cover [begin, end) without overlapping.
+	void TestParallelForCoverage(JobSystem& jobs)
+	{
+		for (int count : { 0, 1, 2, 7, 100, 1000, 12345 })
+		{
+			for (int grainSize : { 0, 1, 3, 16, 64, 1000, 100000 })
+			{
+				const int begin = 5;
+				const int end = begin + count;
+
+				std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count + 1]);
+				for (int i = 0; i <= count; ++i)
+					visits[i].store(0);
+
+				std::atomic<bool> bChunkTooLarge{ false };
+				jobs.ParallelForRange(begin, end, grainSize, [&](int first, int last)
+					{
+						if (grainSize > 0 && last - first > grainSize)
+							bChunkTooLarge = true;
+
+						for (int i = first; i < last; ++i)
+							visits[i - begin].fetch_add(1);
+					});
+
+				CHECK(!bChunkTooLarge);
+				for (int i = 0; i < count; ++i)
+					CHECK(visits[i].load() == 1);
+
+				std::atomic<long long> sum{ 0 };
+				jobs.ParallelFor(begin, end, grainSize, [&](int i) { sum.fetch_add(i); });
+				CHECK(sum.load() == (long long)(begin + end - 1) * count / 2);
+			}
+		}
+
+		// An empty or reversed range calls nothing.
+		bool bCalled = false;
+		jobs.ParallelFor(10, 10, 1, [&](int) { bCalled = true; });
+		jobs.ParallelFor(10, 3, 1, [&](int) { bCalled = true; });
+		CHECK(!bCalled);
+	}
+
+	// Jobs that wait on their own ParallelFor and Run submissions help run the
+	// queues instead of blocking the worker, so this finishes however few
+	// workers there are.
+	void TestNestedWaits(JobSystem& jobs)
+	{
+		constexpr int OuterCount = 64;
+		constexpr int InnerCount = 500;
+
+		std::atomic<long long> total{ 0 };
+		jobs.ParallelFor(0, OuterCount, 1, [&](int outer)
+			{
+				std::atomic<long long> inner{ 0 };
+				jobs.ParallelFor(0, InnerCount, 7, [&](int i)
+					{
+						// A third level, submitted with Run and waited on here.
+						JobCounter counter;
+						std::atomic<int> leaf{ 0 };
+						for (int k = 0; k < 3; ++k)
+							jobs.Run([&leaf]() { leaf.fetch_add(1); }, &counter);
+						jobs.Wait(counter);
+
+						inner.fetch_add(leaf.load() * (i + 1));
+					});
+				total.fetch_add(inner.load() + outer);
+			});
+
+		const long long innerSum = 3LL * InnerCount * (InnerCount + 1) / 2;
+		CHECK(total.load() == OuterCount * innerSum + (long long)OuterCount * (OuterCount - 1) / 2);
+
+		// Waiting on a counter nobody added to returns at once.
+		JobCounter idle;
+		jobs.Wait(idle);
+		CHECK(idle.IsDone());
+	}
+
+	// A task starts only after every task it depends on has finished, and a
+	// graph runs again the same way.
+	void TestTaskGraphOrdering(JobSystem& jobs)
+	{
+		TaskGraph empty;
+		empty.Run(jobs);
+		CHECK(empty.GetTaskCount() == 0);
+
+		std::mt19937 rng(11);
+
+		for (int trial = 0; trial < 20; ++trial)
+		{
+			const int taskCount = 1 + (int)(rng() % 200);
+
+			// Edges only go from lower to higher ids, so the graph has no cycle.
+			struct Edge
+			{
+				TaskGraph::TaskId Before;
+				TaskGraph::TaskId After;
+			};
+			std::vector<Edge> edges;
+
+			std::atomic<int> clock{ 0 };
+			std::vector<int> startTimes(taskCount);
+			std::vector<int> finishTimes(taskCount);
+			std::vector<int> runCounts(taskCount);
+
+			TaskGraph graph;
+			for (int id = 0; id < taskCount; ++id)
+			{
+				const TaskGraph::TaskId task = graph.AddTask([&, id]()
+					{
+						startTimes[id] = clock.fetch_add(1);
+						++runCounts[id];
+						finishTimes[id] = clock.fetch_add(1);
+					});
+				CHECK(task == id);
+
+				const int dependencyCount = id == 0 ? 0 : (int)(rng() % 4);
+				for (int k = 0; k < dependencyCount; ++k)
+				{
+					const TaskGraph::TaskId before = (TaskGraph::TaskId)(rng() % id);
+					graph.AddDependency(before, id);
+					edges.push_back({ before, id });
+				}
+			}
+			CHECK(graph.GetTaskCount() == (size_t)taskCount);
+
+			for (int run = 1; run <= 2; ++run)
+			{
+				clock = 0;
+				graph.Run(jobs);
+
+				for (int id = 0; id < taskCount; ++id)
+					CHECK(runCounts[id] == run);
+				for (const Edge& edge : edges)
+					CHECK(finishTimes[edge.Before] < startTimes[edge.After]);
+			}
+		}
+
+		// A diamond: both middle tasks see the first, the last sees both.
+		std::atomic<int> value{ 0 };
+		int left = 0;
+		int right = 0;
+		int last = 0;
+
+		TaskGraph diamond;
+		const TaskGraph::TaskId a = diamond.AddTask([&]() { value = 1; });
+		const TaskGraph::TaskId b = diamond.AddTask([&]() { left = value.load() * 2; });
+		const TaskGraph::TaskId c = diamond.AddTask([&]() { right = value.load() * 3; });
+		const TaskGraph::TaskId d = diamond.AddTask([&]() { last = left + right; });
+		diamond.AddDependency(a, b);
+		diamond.AddDependency(a, c);
+		diamond.AddDependency(b, d);
+		diamond.AddDependency(c, d);
+		diamond.Run(jobs);
+		CHECK(last == 5);
+
+		diamond.Clear();
+		CHECK(diamond.GetTaskCount() == 0);
+	}
+
+	void TestScratchArena()
+	{
+		ScratchArena arena(1024);
+
+		void* first = arena.Allocate(100);
+		CHECK(first != nullptr);
+
+		double* aligned = arena.AllocateArray<double>(10);
+		CHECK(reinterpret_cast<uintptr_t>(aligned) % alignof(double) == 0);
+
+		void* wide = arena.Allocate(16, 256);
+		CHECK(reinterpret_cast<uintptr_t>(wide) % 256 == 0);
+
+		// Rewinding hands out the same memory again.
+		const ScratchArena::Marker marker = arena.GetMarker();
+		void* before = arena.Allocate(64);
+		{
+			ScratchScope scope(arena);
+			arena.Allocate(200);
+		}
+		arena.Rewind(marker);
+		CHECK(arena.Allocate(64) == before);
+
+		// Larger than a block gets a block of its own, and the earlier blocks are
+		// reused after a reset.
+		unsigned char* large = static_cast<unsigned char*>(arena.Allocate(4096));
+		large[0] = 1;
+		large[4095] = 2;
+		arena.Reset();
+		CHECK(arena.Allocate(100) == first);
+	}
+
+	// Jobs on the same worker share its arena; jobs may use it without locks.
+	void TestWorkerScratch(JobSystem& jobs)
+	{
+		std::atomic<bool> bCorrupted{ false };
+		jobs.ParallelFor(0, 2000, 4, [&](int i)
+			{
+				ScratchArena& scratch = jobs.GetScratch();
+				ScratchScope scope(scratch);
+
+				int* values = scratch.AllocateArray<int>(64);
+				for (int k = 0; k < 64; ++k)
+					values[k] = i + k;
+				for (int k = 0; k < 64; ++k)
+				{
+					if (values[k] != i + k)
+						bCorrupted = true;
+				}
+			});
+		CHECK(!bCorrupted);
+
+		// The caller is not a worker.
+		CHECK(jobs.GetCurrentWorkerIndex() == -1);
+	}
+
+	void TestSystem(unsigned workerCount)
+	{
+		JobSystem jobs(workerCount);
+		if (workerCount != 0)
+			CHECK(jobs.GetWorkerCount() == workerCount);
+		CHECK(jobs.GetConcurrency() == jobs.GetWorkerCount() + 1);
+
+		TestParallelForCoverage(jobs);
+		TestNestedWaits(jobs);
+		TestTaskGraphOrdering(jobs);
+		TestWorkerScratch(jobs);
+	}
+}
+
+int main()
+{
+	TestScratchArena();
+
+	// One worker, a few, and one per hardware thread besides the caller's, which
+	// is none at all on a single core.
+	TestSystem(1);
+	TestSystem(3);
+	TestSystem(0);
+
+	return TestUtil::Finish();
+}
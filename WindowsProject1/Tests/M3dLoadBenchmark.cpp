@@ -0,0 +1,142 @@
+// Loads an .m3d file through the text parser and through its binary sidecar, and
+// reports the time, heap allocations and peak heap use of each.  M3DLoader maps
+// files through the Win32 API, so this only builds on Windows.
+//
+//   M3dLoadBenchmark [file.m3d] [repeats]
+
+#include "M3dLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Every heap block is prefixed with its size, so the live total can be kept.
+	constexpr size_t BlockHeaderSize = alignof(std::max_align_t);
+
+	std::atomic<size_t> liveBytes{ 0 };
+	std::atomic<size_t> peakBytes{ 0 };
+	std::atomic<size_t> allocationCount{ 0 };
+
+	void* CountedAllocate(size_t byteSize)
+	{
+		unsigned char* block = static_cast<unsigned char*>(std::malloc(byteSize + BlockHeaderSize));
+		if (block == nullptr)
+			throw std::bad_alloc();
+
+		*reinterpret_cast<size_t*>(block) = byteSize;
+
+		const size_t live = liveBytes.fetch_add(byteSize) + byteSize;
+		size_t peak = peakBytes.load();
+		while (live > peak && !peakBytes.compare_exchange_weak(peak, live))
+		{
+		}
+
+		allocationCount.fetch_add(1);
+		return block + BlockHeaderSize;
+	}
+
+	void CountedFree(void* p)
+	{
+		if (p == nullptr)
+			return;
+
+		unsigned char* block = static_cast<unsigned char*>(p) - BlockHeaderSize;
+		liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block));
+		std::free(block);
+	}
+
+	struct Measurement
+	{
+		double Milliseconds = 0.0;
+		size_t Allocations = 0;
+		size_t PeakBytes = 0;
+		bool bFromSidecar = false;
+	};
+
+	bool Load(const std::string& filename, bool bSidecar, Measurement& measurement)
+	{
+		std::vector<M3DLoader::SkinnedVertex> vertices;
+		std::vector<USHORT> indices;
+		std::vector<M3DLoader::Subset> subsets;
+		std::vector<M3DLoader::M3dMaterial> mats;
+		SkinnedData skinInfo;
+
+		M3DLoader loader;
+		loader.SetBinarySidecarEnabled(bSidecar);
+
+		// Peak heap use is measured above what was live before the load.
+		const size_t baseBytes = liveBytes.load();
+		const size_t baseAllocations = allocationCount.load();
+		peakBytes.store(baseBytes);
+
+		if (!loader.LoadM3d(filename, vertices, indices, subsets, mats, skinInfo))
+			return false;
+
+		measurement.Milliseconds = loader.GetLastLoadStats().Seconds * 1000.0;
+		measurement.Allocations = allocationCount.load() - baseAllocations;
+		measurement.PeakBytes = peakBytes.load() - baseBytes;
+		measurement.bFromSidecar = loader.GetLastLoadStats().bFromSidecar;
+		return true;
+	}
+
+	void Print(const char* name, std::vector<Measurement>& runs)
+	{
+		std::sort(runs.begin(), runs.end(),
+			[](const Measurement& a, const Measurement& b) { return a.Milliseconds < b.Milliseconds; });
+
+		const Measurement& median = runs[runs.size() / 2];
+		std::printf("%-8s %10.3f %10.3f %12zu %14zu\n",
+			name, runs.front().Milliseconds, median.Milliseconds, median.Allocations, median.PeakBytes);
+	}
+}
+
+void* operator new(size_t byteSize) { return CountedAllocate(byteSize); }
+void* operator new[](size_t byteSize) { return CountedAllocate(byteSize); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+
+int main(int argc, char** argv)
+{
+	const std::string filename = argc > 1 ? argv[1] : "Models\\soldier.m3d";
+	const int repeats = std::max(1, argc > 2 ? std::atoi(argv[2]) : 10);
+
+	std::vector<Measurement> textRuns(repeats);
+	std::vector<Measurement> sidecarRuns(repeats);
+
+	for (int run = 0; run < repeats; ++run)
+	{
+		if (!Load(filename, false, textRuns[run]))
+		{
+			std::fprintf(stderr, "cannot load %s\n", filename.c_str());
+			return 1;
+		}
+	}
+
+	// The first load with the sidecar enabled parses the text and writes it, in
+	// case it is missing or stale.
+	Measurement conversion;
+	Load(filename, true, conversion);
+
+	for (int run = 0; run < repeats; ++run)
+	{
+		if (!Load(filename, true, sidecarRuns[run]) || !sidecarRuns[run].bFromSidecar)
+		{
+			std::fprintf(stderr, "cannot load the sidecar of %s\n", filename.c_str());
+			return 1;
+		}
+	}
+
+	std::printf("%s, %d runs\n", filename.c_str(), repeats);
+	std::printf("%-8s %10s %10s %12s %14s\n", "path", "best ms", "median ms", "allocations", "peak bytes");
+	Print("text", textRuns);
+	Print("sidecar", sidecarRuns);
+	return 0;
+}
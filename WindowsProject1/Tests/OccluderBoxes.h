@@ -0,0 +1,44 @@
+#pragma once
+
+#include "OcclusionCuller.h"
+
+// Unit box occluders for the OcclusionCuller test and benchmark, laid out like
+// GeometryGenerator's box: 24 vertices, clockwise front faces.
+namespace OccluderBoxes
+{
+	inline OccluderMesh MakeUnitBox()
+	{
+		const float h = 0.5f;
+
+		OccluderMesh mesh;
+		mesh.Positions =
+		{
+			{ -h, -h, -h }, { -h, +h, -h }, { +h, +h, -h }, { +h, -h, -h },	// front
+			{ -h, -h, +h }, { +h, -h, +h }, { +h, +h, +h }, { -h, +h, +h },	// back
+			{ -h, +h, -h }, { -h, +h, +h }, { +h, +h, +h }, { +h, +h, -h },	// top
+			{ -h, -h, -h }, { +h, -h, -h }, { +h, -h, +h }, { -h, -h, +h },	// bottom
+			{ -h, -h, +h }, { -h, +h, +h }, { -h, +h, -h }, { -h, -h, -h },	// left
+			{ +h, -h, -h }, { +h, +h, -h }, { +h, +h, +h }, { +h, -h, +h }	// right
+		};
+
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			const uint32_t v = 4 * face;
+			mesh.Indices.insert(mesh.Indices.end(), { v, v + 1, v + 2, v, v + 2, v + 3 });
+		}
+
+		return mesh;
+	}
+
+	// World matrix that scales the unit box to size and centers it at center.
+	inline DirectX::XMFLOAT4X4 MakeWorld(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& size)
+	{
+		using namespace DirectX;
+
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixMultiply(
+			XMMatrixScaling(size.x, size.y, size.z),
+			XMMatrixTranslation(center.x, center.y, center.z)));
+		return world;
+	}
+}
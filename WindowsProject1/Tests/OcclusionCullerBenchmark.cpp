@@ -0,0 +1,103 @@
+// Renders a city block of box occluders and tests a field of small boxes against
+// it, reporting the time of each step and how many boxes the occluders hide.
+//
+//   OcclusionCullerBenchmark [boxCount]
+
+#include "OcclusionCuller.h"
+#include "OccluderBoxes.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	const int RenderRounds = 50;
+	const int TestRounds = 10;
+
+	// Boxes per job of the visibility test, as InstancedRenderItem chunks them.
+	const int TestChunkSize = 1024;
+
+	double MillisecondsSince(Clock::time_point start, int rounds)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / rounds;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int boxCount = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// A 20 x 20 grid of buildings, with streets between them.
+	OcclusionCuller culler;
+	const OcclusionCuller::MeshId box = culler.AddMesh(OccluderBoxes::MakeUnitBox());
+	for (int x = -10; x < 10; ++x)
+	{
+		for (int z = 0; z < 20; ++z)
+		{
+			const float height = 8.0f + 20.0f * unit(rng);
+			culler.AddOccluder(box, OccluderBoxes::MakeWorld(
+				XMFLOAT3(12.0f * x + 6.0f, 0.5f * height, 12.0f * z + 6.0f), XMFLOAT3(9.0f, height, 9.0f)));
+		}
+	}
+
+	// Small boxes near the ground all over the block.
+	std::vector<XMFLOAT3> boxMins(boxCount);
+	std::vector<XMFLOAT3> boxMaxs(boxCount);
+	for (int i = 0; i < boxCount; ++i)
+	{
+		const float x = 120.0f * (2.0f * unit(rng) - 1.0f);
+		const float y = 3.0f * unit(rng);
+		const float z = 240.0f * unit(rng);
+		boxMins[i] = XMFLOAT3(x, y, z);
+		boxMaxs[i] = XMFLOAT3(x + 0.8f, y + 0.8f, z + 0.8f);
+	}
+
+	// Standing in a street, looking down it.
+	const XMMATRIX view = XMMatrixLookAtLH(
+		XMVectorSet(0.0f, 2.0f, -5.0f, 1.0f), XMVectorSet(0.0f, 2.0f, 100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * 3.14159265f, 320.0f / 192.0f, 1.0f, 1000.0f);
+	const XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+	// One round to warm the caches and the job system.
+	culler.RenderOccluders(viewProj);
+
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < RenderRounds; ++round)
+		culler.RenderOccluders(viewProj);
+	const double renderMilliseconds = MillisecondsSince(start, RenderRounds);
+
+	std::vector<unsigned char> bVisible(boxCount);
+	start = Clock::now();
+	for (int round = 0; round < TestRounds; ++round)
+	{
+		JobSystem::Default().ParallelFor(0, boxCount, TestChunkSize, [&](int i)
+			{
+				bVisible[i] = culler.IsVisible(boxMins[i], boxMaxs[i]) ? 1 : 0;
+			});
+	}
+	const double testMilliseconds = MillisecondsSince(start, TestRounds);
+
+	int visibleCount = 0;
+	for (unsigned char visible : bVisible)
+		visibleCount += visible;
+
+	std::printf("%u threads, %u x %u depth buffer\n",
+		JobSystem::Default().GetConcurrency(), culler.GetWidth(), culler.GetHeight());
+	std::printf("render   %8.3f ms  %u triangles\n", renderMilliseconds, culler.GetRasterizedTriangleCount());
+	std::printf("test     %8.3f ms  %d boxes, %.1f ns per box\n",
+		testMilliseconds, boxCount, 1e6 * testMilliseconds / boxCount);
+	std::printf("visible  %8d of %d\n", visibleCount, boxCount);
+
+	return 0;
+}
@@ -0,0 +1,183 @@
+// OcclusionCuller against box occluders seen from a fixed camera: boxes behind
+// them are hidden, boxes in front, beside or reaching past them are not, and a
+// box that crosses the near plane is always visible.  A simplified occluder
+// hides no more than the mesh it came from.
+
+#include "OcclusionCuller.h"
+#include "OccluderBoxes.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	XMMATRIX MakeViewProj(FXMVECTOR eye, FXMVECTOR target)
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * 3.14159265f, 320.0f / 192.0f, 1.0f, 1000.0f);
+		return XMMatrixMultiply(view, proj);
+	}
+
+	XMMATRIX MakeForwardViewProj()
+	{
+		return MakeViewProj(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f));
+	}
+
+	// A 6 x 6 wall one unit thick at z = 10, seen from the origin looking down +z.
+	OcclusionCuller::OccluderId RenderWall(OcclusionCuller& culler)
+	{
+		const OcclusionCuller::MeshId box = culler.AddMesh(OccluderBoxes::MakeUnitBox());
+		const OcclusionCuller::OccluderId wall = culler.AddOccluder(box,
+			OccluderBoxes::MakeWorld(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(6.0f, 6.0f, 1.0f)));
+		culler.RenderOccluders(MakeForwardViewProj());
+		return wall;
+	}
+
+	// Nothing is hidden before the occluders are rendered once.
+	void TestVisibleBeforeRendering()
+	{
+		OcclusionCuller culler;
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 20.0f), XMFLOAT3(1.0f, 1.0f, 22.0f)));
+	}
+
+	void TestHiddenBox()
+	{
+		OcclusionCuller culler;
+		RenderWall(culler);
+
+		// The wall's front face, and nothing else, reaches the depth buffer.
+		CHECK(culler.GetRasterizedTriangleCount() == 2);
+
+		CHECK(!culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 20.0f), XMFLOAT3(1.0f, 1.0f, 22.0f)));
+		CHECK(!culler.IsVisible(XMFLOAT3(-0.1f, -0.1f, 500.0f), XMFLOAT3(0.1f, 0.1f, 501.0f)));
+	}
+
+	void TestVisibleBox()
+	{
+		OcclusionCuller culler;
+		RenderWall(culler);
+
+		// In front of the wall, beside it, and partly behind it with one edge past
+		// its silhouette.
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 5.0f), XMFLOAT3(1.0f, 1.0f, 6.0f)));
+		CHECK(culler.IsVisible(XMFLOAT3(30.0f, -1.0f, 40.0f), XMFLOAT3(32.0f, 1.0f, 42.0f)));
+		CHECK(culler.IsVisible(XMFLOAT3(2.0f, -1.0f, 15.0f), XMFLOAT3(6.0f, 1.0f, 16.0f)));
+
+		// Poking through the wall.
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 9.0f), XMFLOAT3(1.0f, 1.0f, 11.0f)));
+	}
+
+	void TestBoxCrossingNearPlane()
+	{
+		OcclusionCuller culler;
+		RenderWall(culler);
+
+		// Around the camera, with corners behind it that would project onto the
+		// wall if the near plane were ignored.
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, -3.0f), XMFLOAT3(1.0f, 1.0f, 3.0f)));
+		CHECK(culler.IsVisible(XMFLOAT3(-0.2f, -0.2f, 0.5f), XMFLOAT3(0.2f, 0.2f, 20.0f)));
+
+		// Occluders are clipped to the near plane too: a slab the camera stands
+		// over still hides what is under it.
+		OcclusionCuller groundCuller;
+		const OcclusionCuller::MeshId box = groundCuller.AddMesh(OccluderBoxes::MakeUnitBox());
+		groundCuller.AddOccluder(box, OccluderBoxes::MakeWorld(XMFLOAT3(0.0f, -1.5f, 0.0f), XMFLOAT3(400.0f, 1.0f, 400.0f)));
+		groundCuller.RenderOccluders(MakeViewProj(XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f), XMVectorSet(0.0f, -1.0f, 20.0f, 1.0f)));
+
+		CHECK(!groundCuller.IsVisible(XMFLOAT3(-1.0f, -6.0f, 20.0f), XMFLOAT3(1.0f, -4.0f, 22.0f)));
+		CHECK(groundCuller.IsVisible(XMFLOAT3(-1.0f, 0.0f, 20.0f), XMFLOAT3(1.0f, 2.0f, 22.0f)));
+	}
+
+	// From inside a box only its back faces face the camera, so nothing is drawn.
+	void TestBackFacesSkipped()
+	{
+		OcclusionCuller culler;
+		const OcclusionCuller::MeshId box = culler.AddMesh(OccluderBoxes::MakeUnitBox());
+		culler.AddOccluder(box, OccluderBoxes::MakeWorld(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(100.0f, 100.0f, 100.0f)));
+		culler.RenderOccluders(MakeForwardViewProj());
+
+		CHECK(culler.GetRasterizedTriangleCount() == 0);
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 80.0f), XMFLOAT3(1.0f, 1.0f, 82.0f)));
+	}
+
+	// Moving the occluder out of the way uncovers what it hid.
+	void TestMovedOccluder()
+	{
+		OcclusionCuller culler;
+		const OcclusionCuller::OccluderId wall = RenderWall(culler);
+		CHECK(!culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 20.0f), XMFLOAT3(1.0f, 1.0f, 22.0f)));
+
+		culler.SetOccluderWorld(wall, OccluderBoxes::MakeWorld(XMFLOAT3(50.0f, 0.0f, 10.0f), XMFLOAT3(6.0f, 6.0f, 1.0f)));
+		culler.RenderOccluders(MakeForwardViewProj());
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 20.0f), XMFLOAT3(1.0f, 1.0f, 22.0f)));
+	}
+
+	// A unit wall in the z = 0 plane split into quadsPerSide^2 quads, facing -z.
+	void MakeTessellatedWall(uint32_t quadsPerSide, std::vector<XMFLOAT3>& positions, std::vector<uint16_t>& indices)
+	{
+		const uint32_t side = quadsPerSide + 1;
+		for (uint32_t y = 0; y < side; ++y)
+		{
+			for (uint32_t x = 0; x < side; ++x)
+				positions.push_back(XMFLOAT3((float)x / quadsPerSide - 0.5f, (float)y / quadsPerSide - 0.5f, 0.0f));
+		}
+
+		for (uint32_t y = 0; y < quadsPerSide; ++y)
+		{
+			for (uint32_t x = 0; x < quadsPerSide; ++x)
+			{
+				const uint16_t v00 = (uint16_t)(y * side + x);
+				const uint16_t v01 = (uint16_t)(v00 + side);
+				indices.insert(indices.end(), { v00, v01, (uint16_t)(v01 + 1), v00, (uint16_t)(v01 + 1), (uint16_t)(v00 + 1) });
+			}
+		}
+	}
+
+	// The wall's edge cells pull their corners inwards rather than out, so a box
+	// seen just past the full wall's edge stays visible.
+	void TestSimplifiedOccluder()
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<uint16_t> indices;
+		MakeTessellatedWall(12, positions, indices);
+
+		OccluderMesh mesh = OccluderMesh::Simplify(positions.data(), sizeof(XMFLOAT3),
+			indices.data(), sizeof(uint16_t), (uint32_t)indices.size(), 0, 0, 4);
+		CHECK(!mesh.Indices.empty());
+		CHECK(mesh.Indices.size() < indices.size());
+
+		bool bOriginalPositions = true;
+		for (const XMFLOAT3& p : mesh.Positions)
+		{
+			bOriginalPositions = bOriginalPositions && std::any_of(positions.begin(), positions.end(),
+				[&](const XMFLOAT3& q) { return p.x == q.x && p.y == q.y && p.z == q.z; });
+		}
+		CHECK(bOriginalPositions);
+
+		// The full wall would reach x = 3 at z = 10.
+		OcclusionCuller culler;
+		const OcclusionCuller::MeshId wall = culler.AddMesh(std::move(mesh));
+		culler.AddOccluder(wall, OccluderBoxes::MakeWorld(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(6.0f, 6.0f, 1.0f)));
+		culler.RenderOccluders(MakeForwardViewProj());
+
+		CHECK(!culler.IsVisible(XMFLOAT3(-1.0f, -1.0f, 20.0f), XMFLOAT3(1.0f, 1.0f, 22.0f)));
+		CHECK(culler.IsVisible(XMFLOAT3(5.0f, -1.0f, 15.0f), XMFLOAT3(6.0f, 1.0f, 16.0f)));
+		CHECK(culler.IsVisible(XMFLOAT3(-1.0f, -6.0f, 15.0f), XMFLOAT3(1.0f, -5.0f, 16.0f)));
+	}
+}
+
+int main()
+{
+	TestVisibleBeforeRendering();
+	TestHiddenBox();
+	TestVisibleBox();
+	TestBoxCrossingNearPlane();
+	TestBackFacesSkipped();
+	TestMovedOccluder();
+	TestSimplifiedOccluder();
+
+	return TestUtil::Finish();
+}
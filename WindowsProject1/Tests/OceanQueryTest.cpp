@@ -0,0 +1,283 @@
+// OceanQuery on a smooth made-up displacement field: batches of four agree
+// with single points, undoing the horizontal displacement finds the same grid
+// point a brute-force search does, and a query racing Publish only ever sees
+// one whole snapshot.
+
+#include "OceanQuery.h"
+#include "TestUtil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const int Size = 64;
+	const float TwoPi = 6.28318531f;
+
+	// A 10 x 10 patch with its origin at (0, 0), scaled 1:1.
+	const float PatchSize = 10.0f;
+
+	// The horizontal displacement moves neighbouring points by less than a third
+	// of their distance, so p -> p + D(p) cannot fold over.
+	const float HorizontalAmplitude = 0.25f;
+	const float VerticalAmplitude = 1.0f;
+
+	OceanQuery::SurfaceMapping MakeMapping(int inverseIterations)
+	{
+		OceanQuery::SurfaceMapping mapping;
+		mapping.OriginX = 0.0f;
+		mapping.OriginZ = 0.0f;
+		mapping.UPerX = 1.0f / PatchSize;
+		mapping.VPerZ = 1.0f / PatchSize;
+		mapping.DisplacementScale = 1.0f;
+		mapping.InverseIterations = inverseIterations;
+		return mapping;
+	}
+
+	void PublishWaves(OceanQuery& query, float waveTime)
+	{
+		std::vector<float> dx((size_t)Size * Size);
+		std::vector<float> dy((size_t)Size * Size);
+		std::vector<float> dz((size_t)Size * Size);
+		for (int y = 0; y < Size; ++y)
+		{
+			for (int x = 0; x < Size; ++x)
+			{
+				const float u = (x + 0.5f) / Size;
+				const float v = (y + 0.5f) / Size;
+				const size_t i = (size_t)y * Size + x;
+
+				dx[i] = HorizontalAmplitude * std::sin(TwoPi * u + 0.3f) * std::cos(TwoPi * v);
+				dz[i] = HorizontalAmplitude * std::cos(TwoPi * u) * std::sin(TwoPi * v + 1.1f);
+				dy[i] = VerticalAmplitude * std::sin(TwoPi * (u + 2.0f * v));
+			}
+		}
+		query.Publish(dx.data(), dy.data(), dz.data(), waveTime);
+	}
+
+	std::vector<float> MakeCoordinates(size_t count, float offset)
+	{
+		std::vector<float> coordinates(count);
+		for (size_t i = 0; i < count; ++i)
+			coordinates[i] = offset + 0.37f * i;
+		return coordinates;
+	}
+
+	void TestNothingPublished()
+	{
+		OceanQuery query(Size);
+		CHECK(!query.HasData());
+
+		const float x = 1.0f;
+		const float z = 2.0f;
+		float height = 0.0f;
+		CHECK(query.QueryHeights(&x, &z, 1, &height) == -1.0f);
+		CHECK(query.QueryDisplacements(&x, &z, 1, nullptr, nullptr, nullptr) == -1.0f);
+	}
+
+	// Batches go through the four-wide path where it exists; single points never
+	// do.  Points outside the patch wrap around.
+	void TestBatchesMatchSinglePoints()
+	{
+		OceanQuery query(Size);
+		query.SetMapping(MakeMapping(4));
+		PublishWaves(query, 2.5f);
+		CHECK(query.HasData());
+
+		const size_t count = 4099;
+		const std::vector<float> x = MakeCoordinates(count, -13.0f);
+		const std::vector<float> z = MakeCoordinates(count, 7.0f);
+
+		std::vector<float> heights(count);
+		std::vector<float> dx(count);
+		std::vector<float> dy(count);
+		std::vector<float> dz(count);
+		CHECK(query.QueryHeights(x.data(), z.data(), count, heights.data()) == 2.5f);
+		CHECK(query.QueryDisplacements(x.data(), z.data(), count, dx.data(), dy.data(), dz.data()) == 2.5f);
+
+		const float tolerance = 1e-5f;
+		bool bMatches = true;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float height = 0.0f;
+			float single[3] = {};
+			query.QueryHeights(&x[i], &z[i], 1, &height);
+			query.QueryDisplacements(&x[i], &z[i], 1, &single[0], &single[1], &single[2]);
+
+			bMatches = bMatches &&
+				std::fabs(heights[i] - height) <= tolerance &&
+				std::fabs(dx[i] - single[0]) <= tolerance &&
+				std::fabs(dy[i] - single[1]) <= tolerance &&
+				std::fabs(dz[i] - single[2]) <= tolerance;
+		}
+		CHECK(bMatches);
+
+		// Outputs that are not wanted may be null.
+		std::vector<float> onlyY(count);
+		query.QueryDisplacements(x.data(), z.data(), count, nullptr, onlyY.data(), nullptr);
+		CHECK(onlyY == dy);
+	}
+
+	// The grid point p with p + D(p) closest to q, searched on ever finer grids
+	// around q, and the height there.
+	float FindHeightByBruteForce(const OceanQuery& query, float qx, float qz)
+	{
+		const int steps = 41;
+		float centerX = qx;
+		float centerZ = qz;
+		float radius = 2.0f * HorizontalAmplitude;
+
+		std::vector<float> px((size_t)steps * steps);
+		std::vector<float> pz((size_t)steps * steps);
+		std::vector<float> dx(px.size());
+		std::vector<float> dy(px.size());
+		std::vector<float> dz(px.size());
+
+		float height = 0.0f;
+		for (int level = 0; level < 4; ++level)
+		{
+			const float step = 2.0f * radius / (steps - 1);
+			for (int j = 0; j < steps; ++j)
+			{
+				for (int i = 0; i < steps; ++i)
+				{
+					px[(size_t)j * steps + i] = centerX - radius + step * i;
+					pz[(size_t)j * steps + i] = centerZ - radius + step * j;
+				}
+			}
+			query.QueryDisplacements(px.data(), pz.data(), px.size(), dx.data(), dy.data(), dz.data());
+
+			float bestDistanceSq = INFINITY;
+			for (size_t k = 0; k < px.size(); ++k)
+			{
+				const float ex = px[k] + dx[k] - qx;
+				const float ez = pz[k] + dz[k] - qz;
+				if (ex * ex + ez * ez < bestDistanceSq)
+				{
+					bestDistanceSq = ex * ex + ez * ez;
+					centerX = px[k];
+					centerZ = pz[k];
+					height = dy[k];
+				}
+			}
+
+			radius = 2.0f * step;
+		}
+		return height;
+	}
+
+	float GetLargestHeightError(int inverseIterations, const std::vector<float>& x, const std::vector<float>& z,
+		const std::vector<float>& expected)
+	{
+		OceanQuery query(Size);
+		query.SetMapping(MakeMapping(inverseIterations));
+		PublishWaves(query, 0.0f);
+
+		std::vector<float> heights(x.size());
+		query.QueryHeights(x.data(), z.data(), x.size(), heights.data());
+
+		float largestError = 0.0f;
+		for (size_t i = 0; i < x.size(); ++i)
+			largestError = std::max(largestError, std::fabs(heights[i] - expected[i]));
+		return largestError;
+	}
+
+	void TestInverseConverges()
+	{
+		const size_t count = 37;
+		const std::vector<float> x = MakeCoordinates(count, 0.2f);
+		const std::vector<float> z = MakeCoordinates(count, 3.1f);
+
+		// The brute-force search only needs the forward lookup.
+		OceanQuery forward(Size);
+		forward.SetMapping(MakeMapping(0));
+		PublishWaves(forward, 0.0f);
+
+		std::vector<float> expected(count);
+		for (size_t i = 0; i < count; ++i)
+			expected[i] = FindHeightByBruteForce(forward, x[i], z[i]);
+
+		// Each iteration shrinks the error by the slope of the displacement, and
+		// without any the height is read at the wrong grid point.
+		const float tolerance = 1e-4f * VerticalAmplitude;
+		CHECK(GetLargestHeightError(12, x, z, expected) <= tolerance);
+		CHECK(GetLargestHeightError(4, x, z, expected) <= 10.0f * tolerance);
+		CHECK(GetLargestHeightError(0, x, z, expected) > 50.0f * tolerance);
+	}
+
+	// Every publish fills all texels with its own number, so a query that mixed
+	// two snapshots would see two numbers.
+	void TestQueryDuringPublish()
+	{
+		const int publishCount = 2000;
+
+		OceanQuery query(Size);
+		query.SetMapping(MakeMapping(2));
+
+		std::vector<float> plane((size_t)Size * Size);
+		auto publish = [&](int generation)
+			{
+				std::fill(plane.begin(), plane.end(), (float)generation);
+				query.Publish(plane.data(), plane.data(), plane.data(), (float)generation);
+			};
+		publish(0);
+
+		std::atomic<bool> bDone{ false };
+		std::atomic<bool> bTorn{ false };
+		std::atomic<int> queryCount{ 0 };
+
+		std::thread reader([&]()
+			{
+				const size_t count = 256;
+				const std::vector<float> x = MakeCoordinates(count, 0.0f);
+				const std::vector<float> z = MakeCoordinates(count, 5.0f);
+				std::vector<float> dx(count);
+				std::vector<float> dy(count);
+				std::vector<float> dz(count);
+				float lastWaveTime = 0.0f;
+
+				while (!bDone.load() || queryCount.load() == 0)
+				{
+					const float waveTime = query.QueryDisplacements(x.data(), z.data(), count, dx.data(), dy.data(), dz.data());
+					if (waveTime < lastWaveTime)
+						bTorn = true;
+					lastWaveTime = waveTime;
+
+					// Bilinear weights sum to one only up to rounding.
+					const float tolerance = 1e-3f * (1.0f + waveTime);
+					for (size_t i = 0; i < count; ++i)
+					{
+						if (std::fabs(dx[i] - waveTime) > tolerance ||
+							std::fabs(dy[i] - waveTime) > tolerance ||
+							std::fabs(dz[i] - waveTime) > tolerance)
+						{
+							bTorn = true;
+						}
+					}
+					++queryCount;
+				}
+			});
+
+		for (int generation = 1; generation <= publishCount; ++generation)
+			publish(generation);
+
+		bDone = true;
+		reader.join();
+
+		CHECK(!bTorn);
+		CHECK(queryCount.load() > 0);
+	}
+}
+
+int main()
+{
+	TestNothingPublished();
+	TestBatchesMatchSinglePoints();
+	TestInverseConverges();
+	TestQueryDuringPublish();
+
+	return TestUtil::Finish();
+}
@@ -0,0 +1,330 @@
+// RenderGraph compiled with made-up states, and its schedule replayed over a few
+// frames the way RenderGraphExecutor records it, tracking the state of every
+// resource.
+
+#include "RenderGraph.h"
+#include "TestUtil.h"
+
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t RenderTarget = 0x4;
+	constexpr uint32_t UnorderedAccess = 0x8;
+	constexpr uint32_t DepthWrite = 0x10;
+	constexpr uint32_t PixelShaderResource = 0x80;
+	constexpr uint32_t CopyDest = 0x400;
+	constexpr uint32_t Present = 0;
+
+	// A graph that remembers what each pass declared, to check the replay against.
+	struct TestGraph
+	{
+		struct Access
+		{
+			RenderGraph::PassHandle Pass;
+			RenderGraph::ResourceHandle Resource;
+			uint32_t State;
+		};
+
+		RenderGraph Graph{ UnorderedAccess };
+		std::vector<Access> Accesses;
+
+		void Read(RenderGraph::PassHandle pass, RenderGraph::ResourceHandle resource, uint32_t state)
+		{
+			Graph.Read(pass, resource, state);
+			Accesses.push_back({ pass, resource, state });
+		}
+
+		void Write(RenderGraph::PassHandle pass, RenderGraph::ResourceHandle resource, uint32_t state)
+		{
+			Graph.Write(pass, resource, state);
+			Accesses.push_back({ pass, resource, state });
+		}
+	};
+
+	// Runs the schedule frameCount times from the states the resources are created
+	// in.  Every barrier must start from the state the resource is in, and every
+	// pass must find its resources in the states it declared.
+	void Replay(const TestGraph& test, int frameCount)
+	{
+		const RenderGraph& graph = test.Graph;
+
+		std::vector<uint32_t> states(graph.GetResourceCount());
+		for (RenderGraph::ResourceHandle i = 0; i < states.size(); ++i)
+			states[i] = graph.GetInitialState(i);
+
+		auto apply = [&states](const RenderGraph::Transition& transition)
+		{
+			if (transition.bUnorderedAccess)
+			{
+				CHECK(states[transition.Resource] == UnorderedAccess);
+				return;
+			}
+
+			CHECK(transition.StateBefore != transition.StateAfter);
+			CHECK(states[transition.Resource] == transition.StateBefore);
+			states[transition.Resource] = transition.StateAfter;
+		};
+
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			// Imported resources come back in their initial state every frame.
+			for (RenderGraph::ResourceHandle i = 0; i < states.size(); ++i)
+			{
+				if (graph.IsImported(i))
+					states[i] = graph.GetInitialState(i);
+			}
+
+			for (const auto& scheduled : graph.GetSchedule())
+			{
+				for (const auto& transition : scheduled.Transitions)
+					apply(transition);
+
+				for (const auto& access : test.Accesses)
+				{
+					if (access.Pass != scheduled.Pass)
+						continue;
+
+					// Reads may find the resource in a read state that includes theirs.
+					const uint32_t state = states[access.Resource];
+					CHECK(state == access.State || (access.State != 0 && (access.State & ~state) == 0));
+				}
+			}
+
+			for (const auto& transition : graph.GetFinalTransitions())
+				apply(transition);
+		}
+	}
+
+	// Passes whose results nobody uses are dropped, along with the passes that
+	// only feed them.
+	void TestCulling()
+	{
+		TestGraph test;
+		RenderGraph& graph = test.Graph;
+
+		const auto backBuffer = graph.ImportResource("BackBuffer", Present, Present);
+		const auto used = graph.CreateTransient("Used", 1024, 256);
+		const auto unused = graph.CreateTransient("Unused", 1024, 256);
+		const auto feedsUnused = graph.CreateTransient("FeedsUnused", 1024, 256);
+
+		const auto writeUsed = graph.AddPass("WriteUsed");
+		test.Write(writeUsed, used, RenderTarget);
+
+		const auto writeFeed = graph.AddPass("WriteFeed");
+		test.Write(writeFeed, feedsUnused, RenderTarget);
+
+		const auto writeUnused = graph.AddPass("WriteUnused");
+		test.Read(writeUnused, feedsUnused, PixelShaderResource);
+		test.Write(writeUnused, unused, RenderTarget);
+
+		const auto sideEffect = graph.AddPass("SideEffect", true);
+
+		const auto present = graph.AddPass("Present");
+		test.Read(present, used, PixelShaderResource);
+		test.Write(present, backBuffer, RenderTarget);
+
+		graph.Compile();
+
+		CHECK(!graph.IsCulled(writeUsed));
+		CHECK(graph.IsCulled(writeFeed));
+		CHECK(graph.IsCulled(writeUnused));
+		CHECK(!graph.IsCulled(sideEffect));
+		CHECK(!graph.IsCulled(present));
+		CHECK(graph.GetSchedule().size() == 3);
+
+		CHECK(graph.GetMemorySlot(used) != RenderGraph::InvalidHandle);
+		CHECK(graph.GetMemorySlot(unused) == RenderGraph::InvalidHandle);
+		CHECK(graph.GetMemorySlot(feedsUnused) == RenderGraph::InvalidHandle);
+
+		Replay(test, 3);
+	}
+
+	// A transient that ends the frame in another state than it starts in is
+	// created in the end state and brought back at its first use, so every frame,
+	// the first included, runs the same barriers.
+	void TestTransientStateAcrossFrames()
+	{
+		TestGraph test;
+		RenderGraph& graph = test.Graph;
+
+		const auto backBuffer = graph.ImportResource("BackBuffer", Present, Present);
+		const auto color = graph.CreateTransient("Color", 1024, 256);
+
+		const auto draw = graph.AddPass("Draw");
+		test.Write(draw, color, RenderTarget);
+
+		const auto resolve = graph.AddPass("Resolve");
+		test.Read(resolve, color, PixelShaderResource);
+		test.Write(resolve, backBuffer, RenderTarget);
+
+		graph.Compile();
+
+		CHECK(graph.GetFirstUseState(color) == RenderTarget);
+		CHECK(graph.GetInitialState(color) == PixelShaderResource);
+
+		const auto& schedule = graph.GetSchedule();
+		CHECK(schedule.size() == 2);
+		CHECK(schedule[0].Transitions.size() == 1);
+		CHECK(schedule[0].Transitions[0].Resource == color);
+		CHECK(schedule[0].Transitions[0].StateBefore == PixelShaderResource);
+		CHECK(schedule[0].Transitions[0].StateAfter == RenderTarget);
+
+		// Present -> RenderTarget for the back buffer, RenderTarget -> read for
+		// the color buffer, then the back buffer back to Present.
+		CHECK(schedule[1].Transitions.size() == 2);
+		CHECK(graph.GetFinalTransitions().size() == 1);
+		CHECK(graph.GetBarrierCount() == 4);
+		CHECK(graph.GetBarrierBatchCount() == 3);
+
+		Replay(test, 3);
+	}
+
+	// A transient that ends where it starts needs no barrier for it.
+	void TestTransientSameStateNoBarrier()
+	{
+		TestGraph test;
+		RenderGraph& graph = test.Graph;
+
+		const auto output = graph.ImportResource("Output", CopyDest, CopyDest);
+		const auto scratch = graph.CreateTransient("Scratch", 4096, 256);
+
+		const auto first = graph.AddPass("First");
+		test.Write(first, scratch, UnorderedAccess);
+
+		const auto second = graph.AddPass("Second");
+		test.Read(second, scratch, UnorderedAccess);
+		test.Write(second, output, UnorderedAccess);
+
+		graph.Compile();
+
+		CHECK(graph.GetInitialState(scratch) == UnorderedAccess);
+
+		const auto& schedule = graph.GetSchedule();
+		CHECK(schedule.size() == 2);
+		CHECK(schedule[0].Transitions.empty());
+
+		// The read after the write needs an unordered access barrier.
+		bool bFoundUavBarrier = false;
+		for (const auto& transition : schedule[1].Transitions)
+		{
+			if (transition.Resource == scratch)
+				bFoundUavBarrier = transition.bUnorderedAccess;
+		}
+		CHECK(bFoundUavBarrier);
+
+		Replay(test, 3);
+	}
+
+	// Transients with disjoint lifetimes share a slot of their memory class, and
+	// each is activated, behind an aliasing barrier, at its first use.
+	void TestAliasing()
+	{
+		TestGraph test;
+		RenderGraph& graph = test.Graph;
+
+		const auto backBuffer = graph.ImportResource("BackBuffer", Present, Present);
+		const auto depth = graph.CreateTransient("Depth", 2048, 256, 1);
+		const auto a = graph.CreateTransient("A", 1024, 256);
+		const auto b = graph.CreateTransient("B", 2048, 512);
+		const auto c = graph.CreateTransient("C", 1024, 256);
+
+		const auto writeA = graph.AddPass("WriteA");
+		test.Write(writeA, depth, DepthWrite);
+		test.Write(writeA, a, RenderTarget);
+
+		const auto readA = graph.AddPass("ReadA");
+		test.Read(readA, a, PixelShaderResource);
+		test.Write(readA, b, RenderTarget);
+
+		const auto readB = graph.AddPass("ReadB");
+		test.Read(readB, depth, PixelShaderResource);
+		test.Read(readB, b, PixelShaderResource);
+		test.Write(readB, c, RenderTarget);
+
+		const auto present = graph.AddPass("Present");
+		test.Read(present, c, PixelShaderResource);
+		test.Write(present, backBuffer, RenderTarget);
+
+		graph.Compile();
+
+		// A and B overlap in ReadA, B and C in ReadB; A and C do not.  Depth is
+		// of another memory class.
+		CHECK(graph.GetMemorySlot(a) == graph.GetMemorySlot(c));
+		CHECK(graph.GetMemorySlot(a) != graph.GetMemorySlot(b));
+		CHECK(graph.GetMemorySlot(depth) != graph.GetMemorySlot(a));
+		CHECK(graph.GetMemorySlot(depth) != graph.GetMemorySlot(b));
+		CHECK(graph.GetMemorySlots().size() == 3);
+		CHECK(graph.GetTransientByteSize() == 2048 + 1024 + 2048 + 1024);
+		CHECK(graph.GetAliasedByteSize() == 2048 + 1024 + 2048);
+
+		const auto& schedule = graph.GetSchedule();
+		CHECK(schedule.size() == 4);
+
+		// The shared slot changes hands at the first use of A and of C; the other
+		// slots have one occupant and need no aliasing barrier.
+		CHECK(schedule[0].Aliasings.size() == 1);
+		CHECK(schedule[0].Aliasings[0].ResourceBefore == c);
+		CHECK(schedule[0].Aliasings[0].ResourceAfter == a);
+		CHECK(schedule[1].Aliasings.empty());
+		CHECK(schedule[2].Aliasings.size() == 1);
+		CHECK(schedule[2].Aliasings[0].ResourceBefore == a);
+		CHECK(schedule[2].Aliasings[0].ResourceAfter == c);
+		CHECK(schedule[3].Aliasings.empty());
+
+		CHECK(schedule[0].Activations.size() == 2);
+		CHECK(schedule[1].Activations.size() == 1 && schedule[1].Activations[0] == b);
+		CHECK(schedule[2].Activations.size() == 1 && schedule[2].Activations[0] == c);
+		CHECK(schedule[3].Activations.empty());
+
+		Replay(test, 3);
+	}
+
+	// Imported resources are put back into their final state in one batch.
+	void TestFinalTransitions()
+	{
+		TestGraph test;
+		RenderGraph& graph = test.Graph;
+
+		const auto backBuffer = graph.ImportResource("BackBuffer", Present, Present);
+		const auto shadowMap = graph.ImportResource("ShadowMap", PixelShaderResource, PixelShaderResource);
+		const auto history = graph.ImportResource("History", CopyDest, PixelShaderResource);
+
+		const auto shadow = graph.AddPass("Shadow");
+		test.Write(shadow, shadowMap, DepthWrite);
+
+		const auto draw = graph.AddPass("Draw");
+		test.Read(draw, shadowMap, PixelShaderResource);
+		test.Write(draw, backBuffer, RenderTarget);
+
+		const auto copy = graph.AddPass("CopyHistory");
+		test.Read(copy, backBuffer, PixelShaderResource);
+		test.Write(copy, history, CopyDest);
+
+		graph.Compile();
+
+		const auto& finalTransitions = graph.GetFinalTransitions();
+		CHECK(finalTransitions.size() == 2);
+		for (const auto& transition : finalTransitions)
+		{
+			CHECK(transition.Resource != shadowMap);
+			if (transition.Resource == backBuffer)
+				CHECK(transition.StateBefore == PixelShaderResource && transition.StateAfter == Present);
+			if (transition.Resource == history)
+				CHECK(transition.StateBefore == CopyDest && transition.StateAfter == PixelShaderResource);
+		}
+
+		Replay(test, 3);
+	}
+}
+
+int main()
+{
+	TestCulling();
+	TestTransientStateAcrossFrames();
+	TestTransientSameStateNoBarrier();
+	TestAliasing();
+	TestFinalTransitions();
+
+	return TestUtil::Finish();
+}
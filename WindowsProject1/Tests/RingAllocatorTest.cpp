@@ -0,0 +1,242 @@
+// RingAllocator and GrowableRing driven by a fake fence that lags a few frames
+// behind, the way the GPU does.
+
+#include "RingAllocator.h"
+#include "TestUtil.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Range
+	{
+		uint64_t Offset;
+		uint64_t ByteSize;
+		uint64_t FenceValue;
+	};
+
+	bool Overlaps(const Range& a, uint64_t offset, uint64_t byteSize)
+	{
+		return offset < a.Offset + a.ByteSize && a.Offset < offset + byteSize;
+	}
+
+	// A frame's memory must not be handed out again before its fence completes,
+	// and must be handed out again after.
+	void TestWrapAndReuse()
+	{
+		std::mt19937 rng(1);
+
+		for (int trial = 0; trial < 200; ++trial)
+		{
+			const uint64_t capacity = 100 + rng() % 5000;
+			RingAllocator ring(capacity);
+
+			std::vector<Range> live;
+			uint64_t fenceValue = 0;
+			uint64_t completedFenceValue = 0;
+			uint64_t lastOffset = 0;
+			int wrapCount = 0;
+
+			for (int frame = 0; frame < 500; ++frame)
+			{
+				// The GPU runs two to three frames behind.
+				if (fenceValue > 3)
+					completedFenceValue = std::max(completedFenceValue, fenceValue - 3 + (rng() % 3 == 0 ? 1 : 0));
+
+				ring.Reclaim(completedFenceValue);
+				live.erase(std::remove_if(live.begin(), live.end(),
+					[completedFenceValue](const Range& r) { return r.FenceValue <= completedFenceValue; }),
+					live.end());
+
+				std::vector<Range> frameRanges;
+				const int allocationCount = rng() % 6;
+				for (int k = 0; k < allocationCount; ++k)
+				{
+					const uint64_t byteSize = 1 + rng() % (capacity / 6 + 1);
+					const uint64_t alignment = 1 + rng() % 300;
+					const uint64_t offset = ring.Allocate(byteSize, alignment);
+					if (offset == RingAllocator::InvalidOffset)
+						continue;
+
+					CHECK(offset % alignment == 0);
+					CHECK(offset + byteSize <= capacity);
+
+					if (offset < lastOffset)
+						++wrapCount;
+					lastOffset = offset;
+
+					for (const Range& r : live)
+						CHECK(!Overlaps(r, offset, byteSize));
+					for (const Range& r : frameRanges)
+						CHECK(!Overlaps(r, offset, byteSize));
+
+					frameRanges.push_back({ offset, byteSize, 0 });
+				}
+
+				++fenceValue;
+				for (Range& r : frameRanges)
+				{
+					r.FenceValue = fenceValue;
+					live.push_back(r);
+				}
+				ring.FinishFrame(fenceValue);
+			}
+
+			CHECK(wrapCount > 0);
+
+			ring.Reclaim(fenceValue);
+			CHECK(ring.GetUsedByteSize() == 0);
+			CHECK(ring.GetPendingFrameCount() == 0);
+		}
+	}
+
+	void TestFullRingWaitsForFence()
+	{
+		RingAllocator ring(1024);
+
+		CHECK(ring.Allocate(600, 1) == 0);
+		ring.FinishFrame(1);
+
+		// 424 bytes are left at the end, too few; the start is still in use.
+		CHECK(ring.Allocate(600, 1) == RingAllocator::InvalidOffset);
+
+		ring.Reclaim(0);
+		CHECK(ring.Allocate(600, 1) == RingAllocator::InvalidOffset);
+
+		// Once the frame completes the ring is empty and starts over.
+		ring.Reclaim(1);
+		CHECK(ring.GetUsedByteSize() == 0);
+		CHECK(ring.Allocate(600, 1) == 0);
+	}
+
+	struct Block
+	{
+		explicit Block(uint64_t byteSize)
+			: Bytes(byteSize)
+		{
+			++liveBlockCount;
+		}
+
+		~Block()
+		{
+			--liveBlockCount;
+		}
+
+		std::vector<unsigned char> Bytes;
+
+		static int liveBlockCount;
+	};
+
+	int Block::liveBlockCount = 0;
+
+	// A frame that grows the ring halfway through must still be able to write the
+	// allocations it made before, and the old block must outlive the frame.
+	void TestGrowKeepsOldBlockUntilFence()
+	{
+		{
+			GrowableRing<Block> ring(256, 256,
+				[](uint64_t byteSize) { return std::make_unique<Block>(byteSize); });
+
+			CHECK(ring.GetCapacity() == 256);
+
+			// Frame 1 fills the first block, then grows.
+			const auto first = ring.Allocate(200, 16);
+			CHECK(first.OwnerBlock == &ring.GetBlock());
+
+			const auto second = ring.Allocate(200, 16);
+			CHECK(ring.GetGrowCount() == 1);
+			CHECK(ring.GetCapacity() >= 512);
+			CHECK(second.OwnerBlock == &ring.GetBlock());
+			CHECK(first.OwnerBlock != second.OwnerBlock);
+			CHECK(Block::liveBlockCount == 2);
+
+			// Both allocations are written after the grow, as FrameResource does.
+			std::memset(first.OwnerBlock->Bytes.data() + first.Offset, 1, 200);
+			std::memset(second.OwnerBlock->Bytes.data() + second.Offset, 2, 200);
+			CHECK(first.OwnerBlock->Bytes[first.Offset + 199] == 1);
+
+			ring.FinishFrame(1);
+			CHECK(ring.GetRetiredBlockCount() == 1);
+
+			// Frame 2 runs while the GPU is still on frame 1.
+			ring.Reclaim(0);
+			CHECK(ring.GetRetiredBlockCount() == 1);
+			ring.Allocate(100, 16);
+			ring.FinishFrame(2);
+
+			// Frame 1 is done with the old block; frame 2 never used it.
+			ring.Reclaim(1);
+			CHECK(ring.GetRetiredBlockCount() == 0);
+			CHECK(Block::liveBlockCount == 1);
+
+			ring.Reclaim(2);
+			CHECK(ring.GetUsedByteSize() == 0);
+		}
+
+		CHECK(Block::liveBlockCount == 0);
+	}
+
+	// An allocation bigger than twice the ring grows it far enough in one step.
+	void TestGrowFitsLargeAllocation()
+	{
+		GrowableRing<Block> ring(256, 256,
+			[](uint64_t byteSize) { return std::make_unique<Block>(byteSize); });
+
+		const auto allocation = ring.Allocate(5000, 256);
+		CHECK(ring.GetGrowCount() == 1);
+		CHECK(allocation.Offset % 256 == 0);
+		CHECK(allocation.Offset + 5000 <= allocation.OwnerBlock->Bytes.size());
+		CHECK(ring.GetCapacity() % 256 == 0);
+	}
+
+	// Growing in a steady state never loses track of a frame's memory.
+	void TestGrowUnderLoad()
+	{
+		std::mt19937 rng(7);
+		GrowableRing<Block> ring(1024, 64,
+			[](uint64_t byteSize) { return std::make_unique<Block>(byteSize); });
+
+		uint64_t fenceValue = 0;
+		for (int frame = 0; frame < 300; ++frame)
+		{
+			if (fenceValue >= 3)
+				ring.Reclaim(fenceValue - 2);
+
+			// The scene keeps getting bigger for a while.
+			const int allocationCount = 1 + std::min(frame, 100) / 10;
+			std::vector<GrowableRing<Block>::Allocation> allocations;
+			for (int k = 0; k < allocationCount; ++k)
+				allocations.push_back(ring.Allocate(64 + rng() % 512, 64));
+
+			for (const auto& a : allocations)
+			{
+				CHECK(a.OwnerBlock != nullptr);
+				CHECK(a.Offset % 64 == 0);
+			}
+
+			++fenceValue;
+			ring.FinishFrame(fenceValue);
+
+			// At most the frames in flight can hold on to old blocks.
+			CHECK(ring.GetRetiredBlockCount() <= 4);
+		}
+
+		ring.Reclaim(fenceValue);
+		CHECK(ring.GetRetiredBlockCount() == 0);
+		CHECK(ring.GetUsedByteSize() == 0);
+		CHECK(ring.GetGrowCount() > 0);
+		CHECK(Block::liveBlockCount == 1);
+	}
+}
+
+int main()
+{
+	TestWrapAndReuse();
+	TestFullRingWaitsForFence();
+	TestGrowKeepsOldBlockUntilFence();
+	TestGrowFitsLargeAllocation();
+	TestGrowUnderLoad();
+	return TestUtil::Finish();
+}
@@ -0,0 +1,82 @@
+// Animates a crowd of characters on one rig, once per character through
+// SkinnedData::GetFinalTransforms and once through SkinnedAnimationBatch, and
+// reports the time per frame of each.
+//
+//   SkinnedAnimationBatchBenchmark [characterCount] [boneCount]
+
+#include "SkinnedAnimationBatch.h"
+#include "SkinnedRig.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	const int FrameCount = 200;
+	const float FrameTime = 1.0f / 60.0f;
+
+	double MillisecondsSince(Clock::time_point start, int rounds)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / rounds;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int characterCount = argc > 1 ? std::atoi(argv[1]) : 1000;
+
+	// About as many bones as soldier.m3d, with its clip's key density.
+	const int boneCount = argc > 2 ? std::atoi(argv[2]) : 58;
+	const SkinnedData skinnedInfo = SkinnedRig::MakeRig(boneCount, 4, 60, 3u);
+
+	// Characters spread over the clips and out of step with each other.
+	std::vector<int> clips(characterCount);
+	std::vector<float> timePos(characterCount);
+	for (int i = 0; i < characterCount; ++i)
+	{
+		clips[i] = i % skinnedInfo.GetClipCount();
+		timePos[i] = skinnedInfo.GetClipEndTime(clips[i]) * (float)(i % 97) / 97.0f;
+	}
+
+	// One state per character, as SkinningApp kept before the batch.
+	std::vector<SkinnedAnimationState> states(characterCount);
+	std::vector<float> stateTimePos = timePos;
+
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < FrameCount; ++frame)
+	{
+		for (int i = 0; i < characterCount; ++i)
+		{
+			stateTimePos[i] += FrameTime;
+			if (stateTimePos[i] > skinnedInfo.GetClipEndTime(clips[i]))
+				stateTimePos[i] = 0.0f;
+
+			skinnedInfo.GetFinalTransforms(clips[i], stateTimePos[i], states[i]);
+		}
+	}
+	const double singleMilliseconds = MillisecondsSince(start, FrameCount);
+
+	SkinnedAnimationBatch batch(skinnedInfo);
+	for (int i = 0; i < characterCount; ++i)
+		batch.AddInstance(clips[i], timePos[i]);
+
+	// One frame to warm the caches and the job system.
+	batch.Update(FrameTime);
+
+	start = Clock::now();
+	for (int frame = 0; frame < FrameCount; ++frame)
+		batch.Update(FrameTime);
+	const double batchMilliseconds = MillisecondsSince(start, FrameCount);
+
+	std::printf("%d characters, %d bones, %u threads\n",
+		characterCount, boneCount, JobSystem::Default().GetConcurrency());
+	std::printf("single   %8.3f ms per frame\n", singleMilliseconds);
+	std::printf("batch    %8.3f ms per frame, %.1fx\n", batchMilliseconds, singleMilliseconds / batchMilliseconds);
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+// SkinnedAnimationBatch against SkinnedData::GetFinalTransforms on made-up rigs:
+// before, on, between and after the keys of every clip, for instance counts
+// that do not fill the last group of four, and while playing and looping.
+
+#include "SkinnedAnimationBatch.h"
+#include "SkinnedRig.h"
+#include "TestUtil.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// The batch blends rotations with nlerp, SkinnedData with slerp.  Over the
+	// few degrees between keys they differ by about a ten-thousandth of a
+	// radian, which the bone chains add up.
+	const float Tolerance = 2e-3f;
+
+	bool MatchesSkinnedData(const SkinnedData& skinnedInfo, const SkinnedAnimationBatch& batch,
+		UINT instance, int clip, float timePos)
+	{
+		SkinnedAnimationState state;
+		skinnedInfo.GetFinalTransforms(clip, timePos, state);
+
+		const XMFLOAT4X4* transforms = batch.GetFinalTransforms(instance);
+		for (UINT b = 0; b < batch.GetBoneCount(); ++b)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int col = 0; col < 4; ++col)
+				{
+					if (std::fabs(transforms[b].m[row][col] - state.FinalTransforms[b].m[row][col]) > Tolerance)
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Times that hit every case of the key search in some track of the clip.
+	std::vector<float> GetSampleTimes(const SkinnedData& skinnedInfo, int clip)
+	{
+		std::vector<float> times = { 0.0f, skinnedInfo.GetClipEndTime(clip) };
+
+		const AnimationClip& source = skinnedInfo.GetClip(clip);
+		for (const BoneAnimation& bone : source.BoneAnimations)
+		{
+			for (size_t k = 0; k < bone.Keyframes.size() && times.size() < 64; ++k)
+			{
+				times.push_back(bone.Keyframes[k].TimePos);
+				if (k + 1 < bone.Keyframes.size())
+					times.push_back(0.3f * bone.Keyframes[k].TimePos + 0.7f * bone.Keyframes[k + 1].TimePos);
+			}
+		}
+		return times;
+	}
+
+	void TestSampleTimes(int boneCount, int instanceCount)
+	{
+		const SkinnedData skinnedInfo = SkinnedRig::MakeRig(boneCount, 3, 12, 5u + boneCount);
+
+		SkinnedAnimationBatch batch(skinnedInfo);
+		for (int i = 0; i < instanceCount; ++i)
+			batch.AddInstance(i % skinnedInfo.GetClipCount());
+		CHECK(batch.GetInstanceCount() == (UINT)instanceCount);
+		CHECK(batch.GetBoneCount() == (UINT)boneCount);
+
+		for (int clip = 0; clip < skinnedInfo.GetClipCount(); ++clip)
+		{
+			const std::vector<float> times = GetSampleTimes(skinnedInfo, clip);
+
+			// Each instance plays this clip at its own time.  An update by zero
+			// evaluates them where they are.
+			for (size_t first = 0; first < times.size(); first += instanceCount)
+			{
+				for (int i = 0; i < instanceCount; ++i)
+					batch.SetInstance(i, clip, times[(first + i) % times.size()]);
+				batch.Update(0.0f);
+
+				for (int i = 0; i < instanceCount; ++i)
+					CHECK(MatchesSkinnedData(skinnedInfo, batch, i, clip, times[(first + i) % times.size()]));
+			}
+		}
+	}
+
+	// Playing forward walks the keyframe cursors, and looping moves them back.
+	void TestPlayback()
+	{
+		const SkinnedData skinnedInfo = SkinnedRig::MakeRig(30, 2, 20, 17u);
+		const int instanceCount = 6;
+
+		SkinnedAnimationBatch batch(skinnedInfo);
+		std::vector<int> clips(instanceCount);
+		std::vector<float> timePos(instanceCount);
+		for (int i = 0; i < instanceCount; ++i)
+		{
+			clips[i] = i % 2;
+			timePos[i] = 0.1f * i;
+			batch.AddInstance(clips[i], timePos[i]);
+		}
+
+		const float dt = 1.0f / 60.0f;
+		for (int frame = 0; frame < 300; ++frame)
+		{
+			batch.Update(dt);
+
+			for (int i = 0; i < instanceCount; ++i)
+			{
+				timePos[i] += dt;
+				if (timePos[i] > skinnedInfo.GetClipEndTime(clips[i]))
+					timePos[i] = 0.0f;
+
+				CHECK(MatchesSkinnedData(skinnedInfo, batch, i, clips[i], timePos[i]));
+			}
+
+			// Switching clips partway through starts the cursors over.
+			if (frame == 150)
+			{
+				clips[0] = 1 - clips[0];
+				batch.SetInstance(0, clips[0], timePos[0]);
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestSampleTimes(1, 1);
+	TestSampleTimes(7, 3);
+	TestSampleTimes(24, 4);
+	TestSampleTimes(58, 9);
+	TestPlayback();
+
+	return TestUtil::Finish();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "SkinnedData.h"
+
+#include <random>
+#include <string>
+
+// Made-up skeletons for the SkinnedAnimationBatch test and benchmark.  Parents
+// come before their children, as SkinnedData expects, and every bone has its
+// own keyframe times, so tracks start and end at different times of a clip.
+namespace SkinnedRig
+{
+	// Rotations turn by up to a few degrees per axis from one key to the next,
+	// about as much as in a sampled clip.
+	const float MaxKeyAngleStep = 0.08f;
+
+	inline SkinnedData MakeRig(int boneCount, int clipCount, int maxKeyCount, unsigned seed)
+	{
+		using namespace DirectX;
+
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+		std::vector<int> boneHierarchy(boneCount);
+		std::vector<XMFLOAT4X4> boneOffsets(boneCount);
+		for (int b = 0; b < boneCount; ++b)
+		{
+			boneHierarchy[b] = b == 0 ? -1 : (int)(rng() % b);
+
+			const XMVECTOR rotation = XMQuaternionRotationRollPitchYaw(
+				3.0f * signedUnit(rng), 3.0f * signedUnit(rng), 3.0f * signedUnit(rng));
+			const XMVECTOR translation = XMVectorSet(signedUnit(rng), signedUnit(rng), signedUnit(rng), 1.0f);
+			XMStoreFloat4x4(&boneOffsets[b], XMMatrixAffineTransformation(
+				XMVectorSplatOne(), XMVectorZero(), rotation, translation));
+		}
+
+		std::unordered_map<std::string, AnimationClip> animations;
+		for (int c = 0; c < clipCount; ++c)
+		{
+			AnimationClip& clip = animations["Clip" + std::to_string(c)];
+			clip.BoneAnimations.resize(boneCount);
+
+			for (BoneAnimation& bone : clip.BoneAnimations)
+			{
+				const int keyCount = 1 + (int)(rng() % maxKeyCount);
+				bone.Keyframes.resize(keyCount);
+
+				float pitch = 3.0f * signedUnit(rng);
+				float yaw = 3.0f * signedUnit(rng);
+				float roll = 3.0f * signedUnit(rng);
+				float time = 0.2f * unit(rng);
+
+				for (Keyframe& key : bone.Keyframes)
+				{
+					key.TimePos = time;
+					key.Translation = XMFLOAT3(signedUnit(rng), signedUnit(rng), signedUnit(rng));
+					key.Scale = XMFLOAT3(0.8f + 0.4f * unit(rng), 0.8f + 0.4f * unit(rng), 0.8f + 0.4f * unit(rng));
+					XMStoreFloat4(&key.RotationQuat, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+
+					time += 0.01f + 0.1f * unit(rng);
+					pitch += MaxKeyAngleStep * signedUnit(rng);
+					yaw += MaxKeyAngleStep * signedUnit(rng);
+					roll += MaxKeyAngleStep * signedUnit(rng);
+				}
+			}
+		}
+
+		SkinnedData skinnedInfo;
+		skinnedInfo.Set(boneHierarchy, boneOffsets, animations);
+		return skinnedInfo;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdio>
+
+// Checks for the test executables.  A failed CHECK is reported and the test
+// carries on; main returns TestUtil::Finish() so ctest sees the failures.  Unlike
+// assert, checks stay on in release builds.
+namespace TestUtil
+{
+	inline int& GetFailureCount()
+	{
+		static int failureCount = 0;
+		return failureCount;
+	}
+
+	inline void ReportFailure(const char* expression, const char* file, int line)
+	{
+		std::fprintf(stderr, "%s(%d): CHECK(%s) failed\n", file, line, expression);
+		++GetFailureCount();
+	}
+
+	inline int Finish()
+	{
+		if (GetFailureCount() == 0)
+			return 0;
+
+		std::fprintf(stderr, "%d checks failed\n", GetFailureCount());
+		return 1;
+	}
+}
+
+#define CHECK(expression) \
+	((expression) ? (void)0 : TestUtil::ReportFailure(#expression, __FILE__, __LINE__))
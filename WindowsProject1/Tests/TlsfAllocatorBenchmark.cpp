@@ -0,0 +1,128 @@
+// Times TlsfAllocator::Allocate and Free for a few allocation patterns of GPU
+// resources, and reports how fragmented each leaves the heap.
+//
+//   TlsfAllocatorBenchmark [rounds]
+
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Placed resources use 64KB alignment, and the default granularity matches
+	// buffers in GpuHeapAllocator.
+	const uint64_t ResourceAlignment = 64 * 1024;
+	const uint64_t HeapByteSize = 4ull << 30;
+	const uint64_t Granularity = 256;
+
+	struct Result
+	{
+		double NanosecondsPerOperation = 0.0;
+		long long OperationCount = 0;
+		long long FailedCount = 0;
+		TlsfAllocator::Stats Stats;
+	};
+
+	void Print(const char* name, const Result& result)
+	{
+		std::printf("%-22s %10.1f %12lld %8lld %10.3f %12.1f\n",
+			name, result.NanosecondsPerOperation, result.OperationCount, result.FailedCount,
+			result.Stats.GetFragmentation(), result.Stats.PeakUsedByteSize / (1024.0 * 1024.0));
+	}
+
+	// Allocates a frame's worth of resources and frees them all, over and over:
+	// the transient render targets of a frame.
+	Result RunFrames(int rounds)
+	{
+		TlsfAllocator allocator(HeapByteSize, Granularity);
+		std::vector<TlsfAllocator::Handle> handles;
+		Result result;
+
+		const auto start = Clock::now();
+		for (int round = 0; round < rounds; ++round)
+		{
+			for (int i = 0; i < 10000; ++i)
+			{
+				handles.push_back(allocator.Allocate(4096 * (1 + i % 37), ResourceAlignment));
+				++result.OperationCount;
+			}
+
+			// Every other one first, so the frees have to merge both ways.
+			for (size_t i = 0; i < handles.size(); i += 2)
+				allocator.Free(handles[i]);
+			for (size_t i = 1; i < handles.size(); i += 2)
+				allocator.Free(handles[i]);
+			result.OperationCount += (long long)handles.size();
+			handles.clear();
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+		result.NanosecondsPerOperation = elapsed.count() / result.OperationCount;
+		result.Stats = allocator.GetStats();
+		return result;
+	}
+
+	// Keeps a working set of long-lived resources of mixed sizes and replaces a
+	// random one at a time: streaming textures and buffers.
+	Result RunChurn(int rounds, uint64_t maxByteSize, uint64_t alignment)
+	{
+		std::mt19937_64 rng(1);
+		TlsfAllocator allocator(HeapByteSize, Granularity);
+		std::vector<TlsfAllocator::Handle> handles;
+		Result result;
+
+		for (int i = 0; i < 4096; ++i)
+		{
+			const TlsfAllocator::Handle handle = allocator.Allocate(1 + rng() % maxByteSize, alignment);
+			if (handle != TlsfAllocator::InvalidHandle)
+				handles.push_back(handle);
+		}
+
+		// Sizes are drawn up front so the timing only covers the allocator.
+		std::vector<uint64_t> sizes(4096);
+		for (uint64_t& byteSize : sizes)
+			byteSize = 1 + rng() % maxByteSize;
+
+		const auto start = Clock::now();
+		for (int round = 0; round < rounds; ++round)
+		{
+			for (size_t i = 0; i < sizes.size(); ++i)
+			{
+				const size_t victim = (i * 2654435761u + round) % handles.size();
+				allocator.Free(handles[victim]);
+
+				handles[victim] = allocator.Allocate(sizes[(i + round) % sizes.size()], alignment);
+				if (handles[victim] == TlsfAllocator::InvalidHandle)
+				{
+					++result.FailedCount;
+					handles[victim] = allocator.Allocate(Granularity, 1);
+				}
+
+				result.OperationCount += 2;
+			}
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+		result.NanosecondsPerOperation = elapsed.count() / result.OperationCount;
+		result.Stats = allocator.GetStats();
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int rounds = std::max(1, argc > 1 ? std::atoi(argv[1]) : 200);
+
+	std::printf("%-22s %10s %12s %8s %10s %12s\n", "pattern", "ns/op", "operations", "failed", "fragment", "peak MB");
+	Print("frame transients", RunFrames(rounds));
+	Print("churn, buffers", RunChurn(rounds, 256 * 1024, Granularity));
+	Print("churn, textures", RunChurn(rounds, 16 << 20, ResourceAlignment));
+	return 0;
+}
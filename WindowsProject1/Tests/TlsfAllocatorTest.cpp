@@ -0,0 +1,179 @@
+// Random allocation and freeing with TlsfAllocator, checked against a map of
+// the live blocks: alignment, bounds, overlap, the used byte count and that all
+// free memory merges back into one block.
+
+#include "TlsfAllocator.h"
+#include "TestUtil.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct LiveBlock
+	{
+		uint64_t ByteSize;
+		TlsfAllocator::Handle Handle;
+	};
+
+	void TestRandom(uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+
+		const uint64_t capacity = 64ull << 20;
+		const uint64_t granularity = 1ull << (1 + rng() % 12);
+		TlsfAllocator allocator(capacity, granularity);
+
+		// Keyed by offset, so overlaps show up as neighbours.
+		std::map<uint64_t, LiveBlock> live;
+		uint64_t usedByteSize = 0;
+		int failedCount = 0;
+
+		for (int step = 0; step < 200000; ++step)
+		{
+			if (live.empty() || rng() % 2 == 0)
+			{
+				const uint64_t byteSize = 1 + rng() % (rng() % 4 == 0 ? (4ull << 20) : 65536);
+				const uint64_t alignment = 1ull << (rng() % 23);
+
+				const TlsfAllocator::Handle handle = allocator.Allocate(byteSize, alignment);
+				if (handle == TlsfAllocator::InvalidHandle)
+				{
+					++failedCount;
+					continue;
+				}
+
+				const uint64_t offset = allocator.GetOffset(handle);
+				const uint64_t blockByteSize = allocator.GetByteSize(handle);
+				CHECK(offset % alignment == 0);
+				CHECK(offset % granularity == 0);
+				CHECK(blockByteSize >= byteSize);
+				CHECK(blockByteSize % granularity == 0);
+				CHECK(offset + blockByteSize <= capacity);
+
+				const auto next = live.lower_bound(offset);
+				if (next != live.end())
+					CHECK(offset + blockByteSize <= next->first);
+				if (next != live.begin())
+				{
+					const auto prev = std::prev(next);
+					CHECK(prev->first + prev->second.ByteSize <= offset);
+				}
+
+				live[offset] = { blockByteSize, handle };
+				usedByteSize += blockByteSize;
+			}
+			else
+			{
+				auto block = live.begin();
+				std::advance(block, rng() % live.size());
+
+				allocator.Free(block->second.Handle);
+				usedByteSize -= block->second.ByteSize;
+				live.erase(block);
+			}
+
+			CHECK(allocator.GetUsedByteSize() == usedByteSize);
+			CHECK(allocator.GetAllocationCount() == live.size());
+		}
+
+		// The heap is small for the requests, so it must have run full.
+		CHECK(failedCount > 0);
+
+		const TlsfAllocator::Stats busy = allocator.GetStats();
+		CHECK(busy.PeakUsedByteSize >= busy.UsedByteSize);
+		CHECK(busy.PeakUsedByteSize <= capacity);
+		CHECK(busy.LargestFreeBlockByteSize <= capacity - busy.UsedByteSize);
+
+		for (const auto& block : live)
+			allocator.Free(block.second.Handle);
+
+		const TlsfAllocator::Stats stats = allocator.GetStats();
+		CHECK(allocator.IsEmpty());
+		CHECK(stats.UsedByteSize == 0);
+		CHECK(stats.FreeBlockCount == 1);
+		CHECK(stats.LargestFreeBlockByteSize == capacity);
+		CHECK(stats.GetFragmentation() == 0.0f);
+	}
+
+	// Freeing a block merges it with free neighbours on either side.
+	void TestCoalescing()
+	{
+		TlsfAllocator allocator(4 * 1024, 1024);
+
+		const TlsfAllocator::Handle a = allocator.Allocate(1024, 1);
+		const TlsfAllocator::Handle b = allocator.Allocate(1024, 1);
+		const TlsfAllocator::Handle c = allocator.Allocate(1024, 1);
+		const TlsfAllocator::Handle d = allocator.Allocate(1024, 1);
+		CHECK(allocator.Allocate(1, 1) == TlsfAllocator::InvalidHandle);
+		CHECK(allocator.GetStats().FreeBlockCount == 0);
+
+		// Two separate holes: 1KB each, so 2KB does not fit.
+		allocator.Free(a);
+		allocator.Free(c);
+		CHECK(allocator.GetStats().FreeBlockCount == 2);
+		CHECK(allocator.GetStats().GetFragmentation() == 0.5f);
+		CHECK(allocator.Allocate(2048, 1) == TlsfAllocator::InvalidHandle);
+
+		// b joins both holes into one of 3KB.
+		const uint64_t offsetA = allocator.GetOffset(a);
+		allocator.Free(b);
+		CHECK(allocator.GetStats().FreeBlockCount == 1);
+		CHECK(allocator.GetStats().LargestFreeBlockByteSize == 3 * 1024);
+
+		const TlsfAllocator::Handle big = allocator.Allocate(3 * 1024, 1);
+		CHECK(big != TlsfAllocator::InvalidHandle);
+		CHECK(allocator.GetOffset(big) == offsetA);
+
+		allocator.Free(big);
+		allocator.Free(d);
+		CHECK(allocator.GetStats().LargestFreeBlockByteSize == 4 * 1024);
+	}
+
+	// Alignments above the granularity give their padding back.
+	void TestLargeAlignment()
+	{
+		TlsfAllocator allocator(1 << 20, 256);
+
+		const TlsfAllocator::Handle small = allocator.Allocate(256, 256);
+		const TlsfAllocator::Handle aligned = allocator.Allocate(256, 64 * 1024);
+		CHECK(allocator.GetOffset(aligned) == 64 * 1024);
+		CHECK(allocator.GetUsedByteSize() == 512);
+
+		// The padding between the two is a free block of its own.
+		CHECK(allocator.GetStats().FreeBlockCount == 2);
+
+		// Freeing the first block merges it into the padding.
+		allocator.Free(small);
+		CHECK(allocator.GetStats().FreeBlockCount == 2);
+
+		allocator.Free(aligned);
+		CHECK(allocator.GetStats().FreeBlockCount == 1);
+	}
+
+	void TestReset()
+	{
+		TlsfAllocator allocator(1 << 16, 256);
+		allocator.Allocate(1000, 256);
+		allocator.Allocate(5000, 4096);
+
+		allocator.Reset(1 << 20);
+		CHECK(allocator.IsEmpty());
+		CHECK(allocator.GetCapacity() == 1 << 20);
+		CHECK(allocator.GetStats().LargestFreeBlockByteSize == 1 << 20);
+		CHECK(allocator.Allocate(1 << 20, 1) != TlsfAllocator::InvalidHandle);
+	}
+}
+
+int main()
+{
+	for (uint64_t seed = 1; seed <= 8; ++seed)
+		TestRandom(seed);
+
+	TestCoalescing();
+	TestLargeAlignment();
+	TestReset();
+	return TestUtil::Finish();
+}
@@ -0,0 +1,282 @@
+// TransformHierarchy after random sequences of added nodes, world-space nodes
+// and local changes, against worlds recomputed from scratch up each node's
+// chain of parents.  Update must recompute exactly the changed nodes and what
+// lies below them, parents first, and nothing when nothing changed.
+
+#include "TransformHierarchy.h"
+#include "TestUtil.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float Tolerance = 1e-4f;
+
+	// What the test set on each node, by node.
+	struct NodeState
+	{
+		TransformHierarchy::Node Parent = TransformHierarchy::InvalidNode;
+		XMFLOAT3 Scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		XMFLOAT4 Rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		XMFLOAT3 Translation = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		bool bWorldSpace = false;
+		XMFLOAT4X4 WorldTransform;
+	};
+
+	XMMATRIX ComputeWorld(const std::vector<NodeState>& nodes, TransformHierarchy::Node node)
+	{
+		const NodeState& state = nodes[node];
+
+		XMMATRIX world = XMMatrixMultiply(
+			XMMatrixMultiply(
+				XMMatrixScaling(state.Scale.x, state.Scale.y, state.Scale.z),
+				XMMatrixRotationQuaternion(XMLoadFloat4(&state.Rotation))),
+			XMMatrixTranslation(state.Translation.x, state.Translation.y, state.Translation.z));
+
+		if (state.Parent != TransformHierarchy::InvalidNode)
+			world = XMMatrixMultiply(world, ComputeWorld(nodes, state.Parent));
+		if (state.bWorldSpace)
+			world = XMMatrixMultiply(world, XMLoadFloat4x4(&state.WorldTransform));
+		return world;
+	}
+
+	bool IsNear(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int col = 0; col < 4; ++col)
+			{
+				if (std::fabs(a.m[row][col] - b.m[row][col]) > Tolerance * (1.0f + std::fabs(b.m[row][col])))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	class RandomEdits
+	{
+	public:
+		explicit RandomEdits(unsigned seed)
+			: rng(seed)
+		{
+		}
+
+		XMFLOAT3 MakeScale()
+		{
+			return XMFLOAT3(Between(0.5f, 1.5f), Between(0.5f, 1.5f), Between(0.5f, 1.5f));
+		}
+
+		XMFLOAT4 MakeRotation()
+		{
+			XMFLOAT4 rotation;
+			XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(
+				Between(-3.0f, 3.0f), Between(-3.0f, 3.0f), Between(-3.0f, 3.0f)));
+			return rotation;
+		}
+
+		XMFLOAT3 MakeTranslation()
+		{
+			return XMFLOAT3(Between(-5.0f, 5.0f), Between(-5.0f, 5.0f), Between(-5.0f, 5.0f));
+		}
+
+		// A reflection through a random plane, like StencilApp's mirror, or a
+		// plain affine change of frame.
+		XMFLOAT4X4 MakeWorldTransform()
+		{
+			XMFLOAT4X4 worldTransform;
+			XMStoreFloat4x4(&worldTransform, XMMatrixMultiply(
+				XMMatrixScaling(Between(-1.5f, 1.5f), 1.0f, Between(0.5f, 1.5f)),
+				XMMatrixTranslation(Between(-3.0f, 3.0f), Between(-3.0f, 3.0f), Between(-3.0f, 3.0f))));
+			return worldTransform;
+		}
+
+		uint32_t Pick(uint32_t count)
+		{
+			return static_cast<uint32_t>(rng() % count);
+		}
+
+	private:
+		float Between(float low, float high)
+		{
+			return std::uniform_real_distribution<float>(low, high)(rng);
+		}
+
+		std::mt19937 rng;
+	};
+
+	void TestRandomEdits(unsigned seed)
+	{
+		RandomEdits edits(seed);
+		TransformHierarchy hierarchy;
+		std::vector<NodeState> nodes;
+		std::vector<bool> bTouched;
+
+		for (int round = 0; round < 60; ++round)
+		{
+			// A burst of new nodes, more of them early on.
+			const uint32_t addCount = edits.Pick(round < 5 ? 40 : 6);
+			for (uint32_t i = 0; i < addCount; ++i)
+			{
+				NodeState state;
+				const uint32_t kind = edits.Pick(10);
+
+				if (nodes.empty() || kind == 0)
+				{
+					state.Translation = edits.MakeTranslation();
+					nodes.push_back(state);
+					CHECK(hierarchy.AddNode(TransformHierarchy::InvalidNode, state.Scale, state.Rotation,
+						state.Translation) == nodes.size() - 1);
+				}
+				else if (kind == 1)
+				{
+					state.Parent = edits.Pick(static_cast<uint32_t>(nodes.size()));
+					state.bWorldSpace = true;
+					state.WorldTransform = edits.MakeWorldTransform();
+					nodes.push_back(state);
+					CHECK(hierarchy.AddWorldSpaceNode(state.Parent, state.WorldTransform) == nodes.size() - 1);
+				}
+				else
+				{
+					state.Parent = edits.Pick(static_cast<uint32_t>(nodes.size()));
+					if (kind < 5)
+					{
+						nodes.push_back(state);
+						CHECK(hierarchy.AddNode(state.Parent) == nodes.size() - 1);
+					}
+					else
+					{
+						state.Scale = edits.MakeScale();
+						state.Rotation = edits.MakeRotation();
+						state.Translation = edits.MakeTranslation();
+						nodes.push_back(state);
+						CHECK(hierarchy.AddNode(state.Parent, state.Scale, state.Rotation, state.Translation) ==
+							nodes.size() - 1);
+					}
+				}
+				bTouched.push_back(true);
+			}
+
+			// Some changes to nodes old and new.
+			const uint32_t editCount = edits.Pick(8);
+			for (uint32_t i = 0; i < editCount && !nodes.empty(); ++i)
+			{
+				const TransformHierarchy::Node node = edits.Pick(static_cast<uint32_t>(nodes.size()));
+				NodeState& state = nodes[node];
+
+				switch (edits.Pick(5))
+				{
+				case 0:
+					state.Scale = edits.MakeScale();
+					hierarchy.SetScale(node, state.Scale);
+					break;
+				case 1:
+					state.Rotation = edits.MakeRotation();
+					hierarchy.SetRotation(node, state.Rotation);
+					break;
+				case 2:
+					state.Translation = edits.MakeTranslation();
+					hierarchy.SetTranslation(node, state.Translation);
+					break;
+				case 3:
+					state.Scale = edits.MakeScale();
+					state.Rotation = edits.MakeRotation();
+					state.Translation = edits.MakeTranslation();
+					hierarchy.SetLocal(node, state.Scale, state.Rotation, state.Translation);
+					break;
+				default:
+					if (!state.bWorldSpace)
+						continue;
+					state.WorldTransform = edits.MakeWorldTransform();
+					hierarchy.SetWorldTransform(node, state.WorldTransform);
+					break;
+				}
+				bTouched[node] = true;
+			}
+
+			// Exactly the touched nodes and everything below them come back, each
+			// once and after its parent.
+			std::vector<bool> bExpected(nodes.size());
+			for (TransformHierarchy::Node node = 0; node < nodes.size(); ++node)
+			{
+				for (TransformHierarchy::Node n = node; n != TransformHierarchy::InvalidNode; n = nodes[n].Parent)
+					bExpected[node] = bExpected[node] || bTouched[n];
+			}
+
+			const std::vector<TransformHierarchy::Node>& updated = hierarchy.Update();
+			CHECK(&updated == &hierarchy.GetUpdatedNodes());
+
+			std::vector<bool> bUpdated(nodes.size());
+			bool bParentsFirst = true;
+			bool bNoRepeats = true;
+			for (TransformHierarchy::Node node : updated)
+			{
+				const TransformHierarchy::Node parent = nodes[node].Parent;
+				bNoRepeats = bNoRepeats && !bUpdated[node];
+				bParentsFirst = bParentsFirst && (parent == TransformHierarchy::InvalidNode ||
+					!bExpected[parent] || bUpdated[parent]);
+				bUpdated[node] = true;
+			}
+			CHECK(bNoRepeats);
+			CHECK(bParentsFirst);
+			CHECK(bUpdated == bExpected);
+
+			bool bWorldsMatch = true;
+			for (TransformHierarchy::Node node = 0; node < nodes.size(); ++node)
+			{
+				XMFLOAT4X4 expected;
+				XMStoreFloat4x4(&expected, ComputeWorld(nodes, node));
+				bWorldsMatch = bWorldsMatch && IsNear(hierarchy.GetWorld(node), expected);
+
+				CHECK(hierarchy.GetParent(node) == nodes[node].Parent);
+			}
+			CHECK(bWorldsMatch);
+			CHECK(hierarchy.GetNodeCount() == nodes.size());
+
+			bTouched.assign(nodes.size(), false);
+		}
+	}
+
+	// Nothing changed, nothing to do; a root with no changes keeps its identity.
+	void TestUntouchedHierarchy()
+	{
+		TransformHierarchy empty;
+		CHECK(empty.Update().empty());
+
+		TransformHierarchy hierarchy;
+		const TransformHierarchy::Node root = hierarchy.AddNode();
+		const TransformHierarchy::Node child = hierarchy.AddNode(root);
+		hierarchy.AddNode(child);
+		CHECK(hierarchy.Update().size() == 3);
+
+		const XMFLOAT4X4 identity(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+		CHECK(IsNear(hierarchy.GetWorld(root), identity));
+
+		CHECK(hierarchy.Update().empty());
+		CHECK(hierarchy.Update().empty());
+		CHECK(hierarchy.GetUpdatedNodes().empty());
+
+		// Setting a node twice before an update recomputes it once.
+		hierarchy.SetTranslation(child, XMFLOAT3(1.0f, 2.0f, 3.0f));
+		hierarchy.SetScale(child, XMFLOAT3(2.0f, 2.0f, 2.0f));
+		CHECK(hierarchy.Update().size() == 2);
+		CHECK(hierarchy.GetWorld(child)._42 == 2.0f);
+		CHECK(hierarchy.Update().empty());
+	}
+}
+
+int main()
+{
+	TestUntouchedHierarchy();
+	for (unsigned seed = 1; seed <= 8; ++seed)
+		TestRandomEdits(seed);
+
+	return TestUtil::Finish();
+}
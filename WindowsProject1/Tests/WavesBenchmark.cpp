@@ -0,0 +1,65 @@
+// Steps fully awake Waves grids of growing size and reports the throughput of the
+// fused height and normal pass in interior cells per second.
+//
+//   WavesBenchmark [maxSize]
+
+#include "Waves.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	// Steps per grid size are chosen so every size touches about this many cells.
+	const long long CellBudget = 1LL << 28;
+	const int MinSteps = 8;
+
+	const char* GetSolverPathName(Waves::SolverPath path)
+	{
+		switch (path)
+		{
+		case Waves::SolverPath::Scalar: return "scalar";
+		case Waves::SolverPath::Sse: return "sse";
+		case Waves::SolverPath::Avx2: return "avx2";
+		default: return "auto";
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int maxSize = argc > 1 ? std::atoi(argv[1]) : 4096;
+	const float timeStep = 0.03f;
+
+	std::printf("%u threads\n", JobSystem::Default().GetConcurrency());
+	std::printf("%6s %8s %8s %14s\n", "size", "path", "steps", "cells/s");
+
+	for (int size = 128; size <= maxSize; size *= 2)
+	{
+		const int steps = (int)std::max<long long>(MinSteps, CellBudget / ((long long)size * size));
+
+		Waves waves(size, size, 1.0f, timeStep, 4.0f, 0.2f);
+
+		// A zero threshold never lets a tile sleep, and resetting the tile size
+		// wakes all of them, so every step covers the whole grid.
+		waves.SetSleepThreshold(0.0f);
+		waves.SetTileRowCount(waves.TileRowCount());
+		waves.SetMaxSubsteps(1);
+
+		for (int k = 0; k < 16; ++k)
+			waves.Disturb(2 + (k * 7919) % (size - 4), 2 + (k * 104729) % (size - 4), 0.5f);
+
+		// One step to warm the caches and the job system.
+		waves.Update(timeStep);
+		waves.ResetStats();
+
+		for (int step = 0; step < steps; ++step)
+			waves.Update(timeStep);
+
+		std::printf("%6d %8s %8d %14.4g\n", size, GetSolverPathName(waves.GetSolverPath()), steps, waves.CellsPerSecond());
+	}
+
+	return 0;
+}